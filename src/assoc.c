@@ -0,0 +1,508 @@
+/*
+* src/assoc.c
+* implementation of a set associative cache
+*/
+
+#include "assoc.h"
+#include "direct.h"
+
+extern int flags; // from util.c
+
+assoc_cache_t * assoc_cache_init(uint32_t num_blocks, uint32_t block_size, uint32_t ways, cache_replace_t replace, cache_fill_t fill_order){
+    if(ways == 0 || ways > CACHE_MAX_WAYS || (ways & (ways - 1)) || num_blocks % ways){
+        cprintf(ANSI_C_RED, "cache_init: %d ways do not fit a cache of %d blocks\n", ways, num_blocks);
+        assert(0);
+    }
+    uint32_t num_sets = num_blocks / ways;
+    assoc_cache_t *cache = (assoc_cache_t *)malloc(sizeof(assoc_cache_t));
+    if(cache == NULL){
+        cprintf(ANSI_C_RED, "cache_init: Unable to allocate set associative cache\n");
+        assert(0);
+    }
+    cache->tags = (uint32_t *)calloc(num_blocks, sizeof(uint32_t));
+    cache->present = (bool *)calloc(num_blocks, sizeof(bool));
+    cache->dirty = (bool *)calloc(num_blocks, sizeof(bool));
+    cache->age = (uint8_t *)malloc(sizeof(uint8_t) * num_blocks);
+    //Individual valid bits for each word so we can have early start...
+    cache->valid = (bool *)calloc(num_blocks * block_size, sizeof(bool));
+    cache->data = (word_t *)calloc(num_blocks * block_size, sizeof(word_t));
+    cache->plru = (uint16_t *)calloc(num_sets, sizeof(uint16_t));
+    cache->fifo = (uint8_t *)calloc(num_sets, sizeof(uint8_t));
+    //crash if unable to allocate memory
+    if(!cache->tags || !cache->present || !cache->dirty || !cache->age || !cache->valid || !cache->data || !cache->plru || !cache->fifo){
+        cprintf(ANSI_C_RED, "cache_init: Unable to allocate set associative cache\n");
+        assert(0);
+    }
+    cache->num_sets = num_sets;
+    cache->ways = ways;
+    cache->block_size = block_size;
+    cache->replace = replace;
+    cache->random = 0x2545f491;
+
+    //Same masks as the direct mapped cache, with one index per set (see direct.h)
+    uint32_t index_size = 1;
+    while((num_sets>>index_size) != 0) index_size+=1;
+    index_size--;
+    cache->index_size = index_size;
+    uint32_t inner_index_size = 1;
+    while((block_size>>inner_index_size) != 0) inner_index_size+=1;
+    inner_index_size--;
+    cache->inner_index_size = inner_index_size;
+    cache->inner_index_mask = ((1 << (inner_index_size + 2)) - 1) & ~3;
+    cache->index_mask = ((1 << (cache->index_size + cache->inner_index_size + 2)) - 1);
+    cache->tag_mask = ~cache->index_mask;
+    cache->index_mask &= ~(cache->inner_index_mask | 0x3);
+
+    if(flags & MASK_DEBUG){
+        printf("creating %d-way cache masks...\n", ways);
+        printf("tag_mask: 0x%08x\n", cache->tag_mask);
+        printf("index_mask: 0x%08x, index_size: %d\n", cache->index_mask, cache->index_size);
+        printf("inner_index_mask: 0x%08x, inner_index_size: %d\n", cache->inner_index_mask, cache->inner_index_size);
+    }
+
+    //Line 0 is the least recently used, so an empty set fills in order
+    for(uint32_t i = 0; i < num_blocks; i++){
+        cache->age[i] = ways - 1 - (i % ways);
+    }
+
+    //Set up the fetch variables
+    cache->fetching = false;
+    cache->penalty_count = 0;
+    cache->subsequent_fetching = 0;
+    cache->fill_way = 0;
+    cache->fill_order = fill_order;
+    cache->fill_word = 0;
+    cache->miss_penalty = CACHE_MISS_PENALTY;
+    cache->subsequent_penalty = CACHE_MISS_SUBSEQUENT_PENALTY;
+    cache->to_memory = false;
+    return cache;
+}
+
+void assoc_cache_free(assoc_cache_t *cache){
+    free(cache->tags);
+    free(cache->present);
+    free(cache->dirty);
+    free(cache->age);
+    free(cache->valid);
+    free(cache->data);
+    free(cache->plru);
+    free(cache->fifo);
+    free(cache);
+}
+
+/* Replacement state */
+
+void assoc_cache_touch(assoc_cache_t *cache, uint32_t index, uint32_t way){
+    uint32_t base = index * cache->ways;
+    switch(cache->replace){
+        case CACHE_LRU: {
+            uint8_t age = cache->age[base + way];
+            for(uint32_t i = 0; i < cache->ways; i++){
+                if(cache->age[base + i] < age) cache->age[base + i]++;
+            }
+            cache->age[base + way] = 0;
+            break;
+        }
+        case CACHE_PLRU: {
+            //Point every node on the way's path at the other half
+            uint32_t node = 0;
+            for(uint32_t half = cache->ways >> 1; half; half >>= 1){
+                if(way & half){
+                    cache->plru[index] &= ~(1 << node);
+                    node = 2 * node + 2;
+                } else {
+                    cache->plru[index] |= (1 << node);
+                    node = 2 * node + 1;
+                }
+            }
+            break;
+        }
+        default:
+            //FIFO and random replacement do not care about hits
+            break;
+    }
+}
+
+void assoc_cache_insert(assoc_cache_t *cache, uint32_t index, uint32_t way){
+    if(cache->replace == CACHE_FIFO){
+        cache->fifo[index] = (way + 1) & (cache->ways - 1);
+    } else {
+        assoc_cache_touch(cache, index, way);
+    }
+}
+
+uint32_t assoc_cache_victim(assoc_cache_t *cache, uint32_t index){
+    uint32_t base = index * cache->ways;
+    uint32_t victim = 0;
+    if(cache->replace != CACHE_FIFO){
+        //Use up the invalid lines first (FIFO fills them in order anyway)
+        for(uint32_t i = 0; i < cache->ways; i++){
+            if(!cache->present[base + i]) return i;
+        }
+    }
+    switch(cache->replace){
+        case CACHE_LRU:
+            for(uint32_t i = 1; i < cache->ways; i++){
+                if(cache->age[base + i] > cache->age[base + victim]) victim = i;
+            }
+            break;
+        case CACHE_PLRU: {
+            uint32_t node = 0;
+            for(uint32_t half = cache->ways >> 1; half; half >>= 1){
+                if(cache->plru[index] & (1 << node)){
+                    victim |= half;
+                    node = 2 * node + 2;
+                } else {
+                    node = 2 * node + 1;
+                }
+            }
+            break;
+        }
+        case CACHE_FIFO:
+            victim = cache->fifo[index];
+            break;
+        case CACHE_RANDOM:
+            cache->random ^= cache->random << 13;
+            cache->random ^= cache->random >> 17;
+            cache->random ^= cache->random << 5;
+            victim = cache->random & (cache->ways - 1);
+            break;
+        default:
+            cprintf(ANSI_C_RED, "assoc_cache_victim: Undefined replacement policy %d\n", cache->replace);
+            assert(0);
+            break;
+    }
+    return victim;
+}
+
+uint32_t assoc_cache_find(assoc_cache_t *cache, uint32_t index, uint32_t tag){
+    uint32_t base = index * cache->ways;
+    const uint32_t *tags = cache->tags + base;
+    for(uint32_t i = 0; i < cache->ways; i++){
+        if(tags[i] == tag && cache->present[base + i]) return i;
+    }
+    return cache->ways;
+}
+
+word_t *assoc_cache_line_data(assoc_cache_t *cache, uint32_t index, uint32_t way){
+    return cache->data + (index * cache->ways + way) * cache->block_size;
+}
+
+bool *assoc_cache_line_valid(assoc_cache_t *cache, uint32_t index, uint32_t way){
+    return cache->valid + (index * cache->ways + way) * cache->block_size;
+}
+
+
+void assoc_cache_digest(sim_t *sim, assoc_cache_t *cache, memory_status_t proceed_condition){
+    cache_access_t info;
+    assoc_cache_get_tag_and_index(&info, cache, &(cache->target_address));
+    bool granted = (get_mem_status(sim) == proceed_condition);
+    //A split bus lets the wait for the first word go on without it
+    bool overlapping = !granted && cache->fetching && !cache->subsequent_fetching && bus_split(sim);
+    if((granted || overlapping) && cache->to_memory){
+        //Memory has the request, so the DRAM knows how long the fill takes
+        uint32_t first;
+        dram_timing(sim, cache->target_address, false, &first, &cache->subsequent_penalty);
+        cache->miss_penalty += first;
+        cache->to_memory = false;
+    }
+    if(overlapping) bus_overlap(&cache->penalty_count, cache->miss_penalty);
+    if(granted){
+        //Increment the wait count
+        cache->penalty_count++;
+        if(flags & MASK_DEBUG){
+            printf("\tassoc_cache_digest: Value of incremented penalty_count %d, pending address: 0x%08x\n",cache->penalty_count, cache->target_address);
+        }
+        uint32_t line = info.index * cache->ways + cache->fill_way;
+        word_t *data = cache->data + line * cache->block_size;
+        bool *valid = cache->valid + line * cache->block_size;
+        if(!cache->subsequent_fetching && cache->penalty_count == cache->miss_penalty){
+            cache_event(sim);
+            //Finished waiting, get data and return it
+            if(flags & MASK_DEBUG){
+                printf("\tassoc_cache_digest: Reached stall count retreiveing data into line %d.\n", cache->fill_way);
+            }
+            mem_read_w(sim, cache->target_address, &info.data);
+            write_buffer_forward(sim, cache->target_address, &info.data);
+            data[info.inner_index] = info.data;
+            cache->tags[line] = info.tag;
+            cache->present[line] = true;
+            valid[info.inner_index] = true;
+            //Invalidate the rest of the data in the line since the tag changed
+            for(uint8_t i = 0; i < cache->block_size; i++){
+                if(i != info.inner_index) valid[i] = false;
+            }
+            cache->dirty[line] = false;
+            assoc_cache_insert(cache, info.index, cache->fill_way);
+            cache->fetching = false;
+            cache->penalty_count = 0;
+            cache->fill_word = info.inner_index;
+            if(cache->subsequent_fetching != (cache->block_size - 1)){
+                //get the second word in the block
+                info.address &= ~(cache->inner_index_mask);
+                info.address |= ((cache->fill_word + 1) & (cache->block_size - 1)) << 2;
+                cache->subsequent_fetching = 1;
+                assoc_cache_queue_mem_access(sim, cache, info);
+            } else {
+                //Were done, relenquish memory
+                set_mem_status(sim, MEM_IDLE);
+            }
+            return;
+        }
+        if(cache->subsequent_fetching && (cache->penalty_count == cache->subsequent_penalty)){
+            cache_event(sim);
+            //Have the next word for the block
+            mem_read_w(sim, cache->target_address, &info.data);
+            write_buffer_forward(sim, cache->target_address, &info.data);
+            data[info.inner_index] = info.data;
+            valid[info.inner_index] = true;
+            cache->fetching = false;
+            cache->penalty_count = 0;
+            if(cache->subsequent_fetching < (cache->block_size - 1)){
+                //get the next word for the block
+                cache->subsequent_fetching++;
+                info.address &= ~(cache->inner_index_mask);
+                info.address |= ((cache->fill_word + cache->subsequent_fetching) & (cache->block_size - 1)) << 2;
+                assoc_cache_queue_mem_access(sim, cache, info);
+            } else if(cache->subsequent_fetching == (cache->block_size - 1)){
+                cache->subsequent_fetching = 0;
+                set_mem_status(sim, MEM_IDLE);
+            }
+            return;
+        }
+    }
+}
+
+
+cache_status_t assoc_cache_read_w(sim_t *sim, assoc_cache_t *cache, uint32_t *address, uint32_t *data){
+    cache_access_t info;
+    cache_status_t status;
+    assoc_cache_get_tag_and_index(&info, cache, address);
+    if(flags & MASK_DEBUG){
+        printf("\tassoc_cache_read_w: looking for address 0x%08x in set %d\n", *address, info.index);
+    }
+    uint32_t way = assoc_cache_find(cache, info.index, info.tag);
+    if(way < cache->ways && assoc_cache_line_valid(cache, info.index, way)[info.inner_index]){
+        *data = assoc_cache_line_data(cache, info.index, way)[info.inner_index];
+        if(flags & MASK_DEBUG){
+            printf("\tassoc_cache_read_w: CACHE_HIT Found valid data 0x%08x for address 0x%08x in set: %d, line: %d, inner_index: %d\n", *data, info.address, info.index, way, info.inner_index);
+        }
+        assoc_cache_touch(cache, info.index, way);
+        return CACHE_HIT;
+    }
+    if(cache->fetching){
+        if(flags & MASK_DEBUG){
+            printf("\tassoc_cache_read_w: CACHE_MISS, cache is fetching data.\n");
+        }
+        return CACHE_MISS;
+    }
+    //Data is not in the cache. Start retrieval into the line it is arriving
+    //in, if the block is already on its way, or the one to replace
+    if(way == cache->ways){
+        way = assoc_cache_victim(cache, info.index);
+    }
+    if(flags & MASK_DEBUG){
+        printf("\tassoc_cache_read_w: CACHE_MISS, data is not in the cache. Queueing read into line %d\n", way);
+    }
+    uint32_t line = info.index * cache->ways + way;
+    if(cache->dirty[line] && (get_write_policy(sim) == CACHE_WRITEBACK)){
+        if(flags & MASK_DEBUG){
+            printf("\tassoc_cache_read_w: data in line is dirty. Queueing write.\n");
+        }
+        cache_access_t write_info;
+        uint32_t write_address = (cache->tags[line] << (2 + cache->index_size + cache->inner_index_size)) | (info.index << (2 + cache->inner_index_size)) | (info.inner_index << 2);
+        assoc_cache_get_tag_and_index(&write_info, cache, &write_address);
+        write_info.way = way;
+        status = write_buffer_enqueue(sim, write_info);
+        if(status == CACHE_MISS){
+            if(flags & MASK_DEBUG){
+                printf("\tassoc_cache_read_w: write buffer is full. \n");
+            }
+            return status;
+        }
+    }
+    cache->fill_way = way;
+    assoc_cache_queue_mem_access(sim, cache, info);
+    return CACHE_MISS;
+}
+
+cache_status_t assoc_cache_write_w(sim_t *sim, assoc_cache_t *cache, uint32_t *address, uint32_t *data){
+    cache_access_t info;
+    assoc_cache_get_tag_and_index(&info, cache, address);
+    info.data = *data;
+    uint32_t way = assoc_cache_find(cache, info.index, info.tag);
+    if(way == cache->ways || !assoc_cache_line_valid(cache, info.index, way)[info.inner_index]){
+        //The processor is writing to a place in memory that isnt in the cache
+        //The transaction becomes a READ MODIFY WRITE
+        if(flags & MASK_DEBUG){
+            printf("\tassoc_cache_write_w: no valid data in the cache for the specified address.\n");
+        }
+        return CACHE_MISS;
+    }
+    uint32_t line = info.index * cache->ways + way;
+    word_t *words = cache->data + line * cache->block_size;
+    info.way = way;
+    if(get_write_policy(sim) == CACHE_WRITETHROUGH){
+        const bool *valid = cache->valid + line * cache->block_size;
+        for(uint32_t i = 0; i < cache->block_size; i++){
+            if(valid[i] == false){
+                gprintf("\tWhole block isnt valid yet...\n");
+                return CACHE_MISS;
+            }
+        }
+        if(write_buffer_enqueue(sim, info) == CACHE_MISS){
+            if(flags & MASK_DEBUG){
+                printf("\tassoc_cache_write_w: Write buffer is full. Cannot fill cache without losing data.\n");
+            }
+            //The write buffer is full! Don't fill the block
+            return CACHE_MISS;
+        }
+        words[info.inner_index] = *data;
+        assoc_cache_touch(cache, info.index, way);
+        return CACHE_HIT;
+    }
+    if(words[info.inner_index] != *data || !cache->dirty[line]){
+        cache_event(sim);
+    }
+    words[info.inner_index] = *data;
+    cache->dirty[line] = true;
+    assoc_cache_touch(cache, info.index, way);
+    return CACHE_HIT;
+}
+
+
+bool assoc_cache_leaving(assoc_cache_t *cache, uint32_t address){
+    cache_access_t info, target;
+    if(!cache->fetching) return false;
+    assoc_cache_get_tag_and_index(&info, cache, &address);
+    assoc_cache_get_tag_and_index(&target, cache, &cache->target_address);
+    uint32_t line = target.index * cache->ways + cache->fill_way;
+    return info.index == target.index && info.tag != target.tag &&
+        cache->present[line] && cache->tags[line] == info.tag;
+}
+
+void assoc_cache_queue_mem_access(sim_t *sim, assoc_cache_t *cache, cache_access_t info){
+    if(flags & MASK_DEBUG){
+        printf("\tassoc_cache_queue_mem_access: Queueing memory access for address 0x%08x\n", info.address);
+    }
+    cache_event(sim);
+    cache->fetching = true;
+    if(cache->subsequent_fetching == 0 && cache->fill_order == CACHE_FILL_CRITICAL){
+        //Get the word that missed first
+        cache->target_address = info.address & ~0x3;
+    }
+    else if(cache->subsequent_fetching == 0){
+        //We must get the first word in a block first
+        cache->target_address = info.address & (cache->tag_mask | cache->index_mask);
+    }
+    else {
+        cache->target_address = info.address;
+    }
+    cache->penalty_count = 0;
+    if(cache->subsequent_fetching == 0){
+        //A new fill. The second level decides how long its words take.
+        uint32_t line = info.index * cache->ways + cache->fill_way;
+        bool replacing = cache->present[line] && cache->tags[line] != info.tag;
+        uint32_t victim = (cache->tags[line] << (2 + cache->index_size + cache->inner_index_size)) | (info.index << (2 + cache->inner_index_size));
+        cache->to_memory = l2_fill(sim, info.address, replacing, victim, &cache->miss_penalty, &cache->subsequent_penalty);
+    }
+    if(write_buffer_writing(sim)){
+        //There is data to be written to memory from the write buffer
+        uint32_t wb_address = write_buffer_get_address(sim);
+        if((wb_address & (cache->tag_mask | cache->index_mask)) == (info.address & (cache->tag_mask | cache->index_mask))){
+            //The block on its way to memory has to get there before we can read it
+            gprintf("\tassoc_cache_queue_mem_access: Data in the write buffer matches the requested address.\n");
+            set_mem_status(sim, MEM_WRITING);
+        }
+    }
+}
+
+void assoc_cache_warm(sim_t *sim, assoc_cache_t *cache, uint32_t address, bool write){
+    cache_access_t info;
+    assoc_cache_get_tag_and_index(&info, cache, &address);
+    uint32_t way = assoc_cache_find(cache, info.index, info.tag);
+    bool present = way < cache->ways;
+    if(present){
+        const bool *valid = assoc_cache_line_valid(cache, info.index, way);
+        for(uint32_t i = 0; i < cache->block_size; i++){
+            present = present && valid[i];
+        }
+    } else {
+        way = assoc_cache_victim(cache, info.index);
+    }
+    uint32_t line = info.index * cache->ways + way;
+    word_t *data = cache->data + line * cache->block_size;
+    if(!present){
+        //Replace the whole block. Anything dirty in it is already in memory,
+        //since the functional model writes memory directly.
+        uint32_t base = address & (cache->tag_mask | cache->index_mask);
+        bool *valid = cache->valid + line * cache->block_size;
+        for(uint32_t i = 0; i < cache->block_size; i++){
+            mem_read_w(sim, base | (i << 2), &(data[i]));
+            valid[i] = true;
+        }
+        cache->tags[line] = info.tag;
+        cache->present[line] = true;
+        cache->dirty[line] = false;
+        assoc_cache_insert(cache, info.index, way);
+    } else {
+        if(write){
+            //Pick up the word that was just stored
+            mem_read_w(sim, address & ~0x3, &(data[info.inner_index]));
+        }
+        assoc_cache_touch(cache, info.index, way);
+    }
+    if(write && get_write_policy(sim) == CACHE_WRITEBACK){
+        cache->dirty[line] = true;
+    }
+}
+
+void assoc_cache_flush(sim_t *sim, assoc_cache_t *cache){
+    uint32_t address;
+    for(uint32_t set = 0; set < cache->num_sets; set++){
+        for(uint32_t way = 0; way < cache->ways; way++){
+            uint32_t line = set * cache->ways + way;
+            if(!cache->dirty[line]) continue;
+            word_t *data = cache->data + line * cache->block_size;
+            for(uint32_t j = 0; j < cache->block_size; j++){
+                address = (cache->tags[line] << (2 + cache->index_size + cache->inner_index_size)) | (set << (2 + cache->inner_index_size)) | (j << 2);
+                eprintf("\tWriting 0x%08x (0d%d) to 0x%08x\n", data[j], data[j], address);
+                mem_write_w(sim, address, &(data[j]));
+            }
+        }
+    }
+}
+
+uint32_t assoc_cache_cycles_to_event(assoc_cache_t *cache){
+    uint32_t penalty = cache->subsequent_fetching ? cache->subsequent_penalty : cache->miss_penalty;
+    if(cache->penalty_count + 1 >= penalty) return 0;
+    return penalty - 1 - cache->penalty_count;
+}
+
+void assoc_cache_get_tag_and_index(cache_access_t *info, assoc_cache_t *cache, uint32_t *address){
+    info->index = (*address & cache->index_mask) >> (2 + cache->inner_index_size);
+    info->tag = (*address & cache->tag_mask) >> (2 + cache->index_size + cache->inner_index_size);
+    info->inner_index = (*address & cache->inner_index_mask) >> 2;
+    info->address = *address;
+}
+
+
+void assoc_cache_print(assoc_cache_t *cache){
+    for(uint32_t i = 0; i < cache->num_sets; i++){
+        assoc_cache_print_set(cache, i);
+    }
+}
+
+void assoc_cache_print_set(assoc_cache_t *cache, int index){
+    printf("Set: %d\n", index);
+    for(uint32_t way = 0; way < cache->ways; way++){
+        uint32_t line = index * cache->ways + way;
+        const word_t *data = cache->data + line * cache->block_size;
+        const bool *valid = cache->valid + line * cache->block_size;
+        printf("  Line: %d\tDirty: %d\tTag: 0x%08x\tAge: %d\n", way, cache->dirty[line], cache->tags[line], cache->age[line]);
+        for(uint32_t i = 0; i < cache->block_size; i++){
+            printf("\t0x%08x", data[i]);
+            printf("\t       %d\n", valid[i]);
+        }
+    }
+}
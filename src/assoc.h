@@ -0,0 +1,128 @@
+/*
+* src/assoc.h
+* header for the set associative cache implementation functions
+*/
+
+#ifndef _ASSOC_H
+#define _ASSOC_H
+
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "main_memory.h"
+#include "types.h"
+#include "cache.h"
+
+/* A set associative cache. Its timing is the same as the direct mapped
+* cache's (see direct.h): a miss fetches the block a word at a time, in the
+* fill order of the cache, and a dirty victim goes to the write buffer
+* before the fill is queued. Only where a block may go and which block a fill replaces differ.
+*
+* The line state is kept as a structure of arrays. Line l of set s is entry
+* s * ways + l of tags, dirty and age, so a lookup scans the tags of one set,
+* which sit next to each other, and only then looks at the valid bit of the
+* word it wants (valid and data hold block_size entries per line, in the same
+* order). A line holds a block once any of its words is valid (present),
+* which need not be its first with a critical word first fill.
+*/
+typedef struct ASSOC_CACHE {
+    uint32_t num_sets;
+    uint32_t ways;
+    uint32_t block_size;
+    uint32_t tag_mask;
+    uint32_t index_size;
+    uint32_t index_mask;
+    uint32_t inner_index_size;
+    uint32_t inner_index_mask;
+    cache_replace_t replace;
+    //Per line
+    uint32_t *tags;
+    bool *present;
+    bool *dirty;
+    uint8_t *age;       //LRU: 0 is the most recently used line of its set
+    //Per word
+    bool *valid;
+    word_t *data;
+    //Per set
+    uint16_t *plru;     //PLRU: tree bits, set means the victim is in the upper half
+    uint8_t *fifo;      //FIFO: the next line to replace
+    uint32_t random;    //RANDOM: xorshift state
+    //Flag to tell if active fetch from memory
+    bool fetching;
+    //Used for getting multiple block lines
+    uint8_t subsequent_fetching;
+    uint32_t penalty_count;
+    uint32_t target_address;
+    //Line of the target set the fetch fills
+    uint32_t fill_way;
+    //Which word of the block a fill starts with, and the one it started with
+    cache_fill_t fill_order;
+    uint32_t fill_word;
+    //Cycles for the first word of the fill and each one after it (see l2_fill())
+    uint32_t miss_penalty;
+    uint32_t subsequent_penalty;
+    //The fill still has to add the memory time (see dram_timing())
+    bool to_memory;
+} assoc_cache_t;
+
+
+/*
+* assoc_cache_t * assoc_cache_init(uint32_t num_blocks, uint32_t block_size, uint32_t ways, cache_replace_t replace, cache_fill_t fill_order)
+* Creates a cache of num_blocks blocks of block_size words in sets of ways
+* blocks. ways must be a power of two that divides num_blocks, at most
+* CACHE_MAX_WAYS. All lines start out invalid.
+*/
+assoc_cache_t * assoc_cache_init(uint32_t num_blocks, uint32_t block_size, uint32_t ways, cache_replace_t replace, cache_fill_t fill_order);
+
+void assoc_cache_free(assoc_cache_t *cache);
+
+// Same as direct_cache_digest()
+void assoc_cache_digest(sim_t *sim, assoc_cache_t *cache, memory_status_t proceed_condition);
+
+/* Same as direct_cache_read_w(). A hit makes the line the most recently used;
+* a miss picks the line to replace (an invalid one if the set has any) and
+* starts filling it. */
+cache_status_t assoc_cache_read_w(sim_t *sim, assoc_cache_t *cache, uint32_t *address, uint32_t *data);
+
+// Same as direct_cache_write_w()
+cache_status_t assoc_cache_write_w(sim_t *sim, assoc_cache_t *cache, uint32_t *address, uint32_t *data);
+
+void assoc_cache_queue_mem_access(sim_t *sim, assoc_cache_t *cache, cache_access_t info);
+
+// Same as direct_cache_leaving()
+bool assoc_cache_leaving(assoc_cache_t *cache, uint32_t address);
+
+// Same as direct_cache_cycles_to_event()
+uint32_t assoc_cache_cycles_to_event(assoc_cache_t *cache);
+
+// Same as direct_cache_warm()
+void assoc_cache_warm(sim_t *sim, assoc_cache_t *cache, uint32_t address, bool write);
+
+// Write every dirty line to main memory (the lines stay dirty)
+void assoc_cache_flush(sim_t *sim, assoc_cache_t *cache);
+
+/* Helper functions specific to the set associative cache */
+// info->index is the set, info->way is left alone
+void assoc_cache_get_tag_and_index(cache_access_t *info, assoc_cache_t *cache, uint32_t *address);
+// The line of set index holding tag, or ways if there is none
+uint32_t assoc_cache_find(assoc_cache_t *cache, uint32_t index, uint32_t tag);
+// The line of set index the next fill replaces
+uint32_t assoc_cache_victim(assoc_cache_t *cache, uint32_t index);
+// Line way of set index was just used
+void assoc_cache_touch(assoc_cache_t *cache, uint32_t index, uint32_t way);
+// Line way of set index was just filled with a new block
+void assoc_cache_insert(assoc_cache_t *cache, uint32_t index, uint32_t way);
+// Word 0 of line way of set index, and its valid bits
+word_t *assoc_cache_line_data(assoc_cache_t *cache, uint32_t index, uint32_t way);
+bool *assoc_cache_line_valid(assoc_cache_t *cache, uint32_t index, uint32_t way);
+
+
+/* Debugging functions */
+void assoc_cache_print(assoc_cache_t *cache);
+void assoc_cache_print_set(assoc_cache_t *cache, int index);
+
+
+#endif /* _ASSOC_H */
@@ -0,0 +1,91 @@
+/*
+* src/bus.c
+* The bus between the caches and the L2 or main memory
+*/
+
+#include "bus.h"
+#include "cache.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+bus_t * bus_init(bus_config_t *config, uint32_t write_buffer){
+    bus_t *bus = (bus_t *)calloc(1, sizeof(bus_t));
+    if(bus == NULL){
+        cprintf(ANSI_C_RED, "bus_init: Unable to allocate the bus\n");
+        assert(0);
+    }
+    bus->config = *config;
+    if(bus->config.width == 0 || bus->config.width > BUS_MAX_WIDTH){
+        cprintf(ANSI_C_RED, "bus_init: bus width %d, must be 1 to %d\n", bus->config.width, BUS_MAX_WIDTH);
+        assert(0);
+    }
+    if(bus->config.drain_high == 0 || bus->config.drain_high > write_buffer){
+        bus->config.drain_high = write_buffer;
+    }
+    if(bus->config.drain_low >= bus->config.drain_high){
+        cprintf(ANSI_C_YELLOW, "bus_init: drain low watermark %d not below the high one, using 0\n", bus->config.drain_low);
+        bus->config.drain_low = 0;
+    }
+    //Round-robin starts with the D cache
+    bus->last = MEM_WRITING;
+    bus->filled = true;
+    return bus;
+}
+
+void bus_free(bus_t *bus){
+    free(bus);
+}
+
+void bus_order(sim_t *sim, uint32_t writes, memory_status_t order[BUS_UNITS]){
+    static const memory_status_t units[BUS_UNITS] = {MEM_READING_D, MEM_READING_I, MEM_WRITING};
+    bus_t *bus = sim->bus;
+    uint32_t start = 0;
+    switch(bus->config.arbitration){
+        case BUS_ROUND_ROBIN:
+            while(units[start] != bus->last) start++;
+            start = (start + 1) % BUS_UNITS;
+            break;
+        case BUS_READ_FIRST:
+            if(bus->draining && (writes <= bus->config.drain_low ||
+                    bus->drained >= bus->config.drain_high - bus->config.drain_low)){
+                bus->draining = false;
+            } else if(!bus->draining && bus->filled && writes >= bus->config.drain_high){
+                gprintf("\tbus_order: draining the write buffer\n");
+                bus->draining = true;
+                bus->drained = 0;
+                bus->filled = false;
+                bus->drains++;
+            }
+            if(bus->draining) start = BUS_UNITS - 1;
+            break;
+        default:
+            break;
+    }
+    for(uint32_t i = 0; i < BUS_UNITS; i++){
+        order[i] = units[(start + i) % BUS_UNITS];
+    }
+}
+
+void bus_grant(sim_t *sim, memory_status_t unit){
+    bus_t *bus = sim->bus;
+    bus->last = unit;
+    bus->transactions++;
+    if(unit != MEM_WRITING) bus->filled = true;
+    else if(bus->draining) bus->drained++;
+}
+
+bool bus_split(sim_t *sim){
+    return sim->bus && sim->bus->config.split;
+}
+
+void bus_overlap(uint32_t *penalty_count, uint32_t penalty){
+    if(*penalty_count + 1 >= penalty) return;
+    (*penalty_count)++;
+}
+
+uint32_t bus_word_cycles(sim_t *sim, uint32_t subsequent){
+    if(sim->bus == NULL) return subsequent;
+    uint32_t cycles = (subsequent + sim->bus->config.width - 1) / sim->bus->config.width;
+    return cycles ? cycles : 1;
+}
@@ -0,0 +1,86 @@
+/*
+* src/bus.h
+* The bus between the caches and the L2 or main memory
+*/
+
+#ifndef _BUS_H
+#define _BUS_H
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "types.h"
+
+// The units that share the bus: the D fill, the I fill and the write buffer
+#define BUS_UNITS 3
+
+/* Without a bus model, the D and I fills and the write buffer take the bus
+* one transaction at a time, in a fixed order (see cache_digest()), and a
+* transaction holds it from its request to its last word, including the time
+* memory takes to find the first one.
+*
+* A split transaction bus only holds the bus to carry words. Each unit sends
+* its request as soon as it has one, and the wait for its first word goes on
+* while another unit has the bus, so the waits of a D fill, an I fill and a
+* write can overlap. The bus then goes to a unit whose first word is ready,
+* and it keeps it for the rest of its words. (Each unit has one transaction
+* at a time, so its request queue holds one request.) A write is posted: its
+* words go out as soon as it has the bus, and memory finishes it on its own,
+* so only a fill waits for memory. With a DRAM model, a request learns its
+* timing when it is sent rather than when it gets the bus.
+*
+* A bus width words wide carries the words after the first of a memory
+* access width at a time, so each takes 1/width of the memory's time for it,
+* but at least a cycle, since the caches take a word a cycle.
+*
+* When more than one unit is ready, the arbitration decides:
+*   fixed       - the D fill, then the I fill, then the write buffer.
+*   round-robin - each in turn, starting after the last one served.
+*   read-first  - the fills first, until the write buffer holds drain_high
+*                 entries. Then it drains first, until it is down to
+*                 drain_low or has written drain_high - drain_low entries,
+*                 and it does not drain again before a fill has had the bus.
+*                 (A frozen pipeline retries its stores, which could
+*                 otherwise keep the buffer full and the fills waiting.)
+*/
+typedef struct BUS {
+    bus_config_t config;
+    memory_status_t last;   // the unit served last
+    bool draining;          // the write buffer goes first
+    uint32_t drained;       // entries written since it started draining
+    bool filled;            // a fill had the bus since the last drain
+    //Statistics
+    uint32_t transactions;
+    uint32_t drains;
+    uint64_t overlapped;    // cycles with more than one transaction under way
+} bus_t;
+
+/*
+* bus_t * bus_init(bus_config_t *config, uint32_t write_buffer)
+* Creates a bus in front of a write buffer of write_buffer entries
+*/
+bus_t * bus_init(bus_config_t *config, uint32_t write_buffer);
+
+void bus_free(bus_t *bus);
+
+/* The order in which the units may have the bus next, with writes entries
+* in the write buffer */
+void bus_order(sim_t *sim, uint32_t writes, memory_status_t order[BUS_UNITS]);
+
+// Count a transaction of unit
+void bus_grant(sim_t *sim, memory_status_t unit);
+
+// True if the bus is a split transaction one
+bool bus_split(sim_t *sim);
+
+/* Count a cycle of the wait for the first word of a transaction of penalty
+* cycles that does not have the bus, if it may go on without it: the last
+* cycle carries the word, so it needs the bus. */
+void bus_overlap(uint32_t *penalty_count, uint32_t penalty);
+
+// The cycles for each word after the first, for a memory taking subsequent
+uint32_t bus_word_cycles(sim_t *sim, uint32_t subsequent);
+
+#endif /* _BUS_H */
@@ -3,42 +3,193 @@
 */
 
 #include "cache.h"
+#include "sim.h"
 
 extern int flags; // from util.c
-extern profile_t *prof;
 
-direct_cache_t *d_cache;
-direct_cache_t *i_cache;
-write_buffer_t *write_buffer;
-memory_status_t memory_status = MEM_IDLE;
+/* Each cache is either direct mapped or set associative (see sim.h), and
+* these look at whichever one it is. A unified cache is the D cache, and
+* there is no I cache to fetch into. */
+static bool d_cache_fetching(sim_t *sim){
+    return sim->d_assoc ? sim->d_assoc->fetching : sim->d_cache->fetching;
+}
+static bool i_cache_fetching(sim_t *sim){
+    if (sim->cache_cfg.mode == CACHE_UNIFIED) return false;
+    return sim->i_assoc ? sim->i_assoc->fetching : sim->i_cache->fetching;
+}
+static uint32_t d_cache_block_size(sim_t *sim){
+    return sim->d_assoc ? sim->d_assoc->block_size : sim->d_cache->block_size;
+}
+static uint32_t i_cache_block_size(sim_t *sim){
+    if (sim->cache_cfg.mode == CACHE_UNIFIED) return d_cache_block_size(sim);
+    return sim->i_assoc ? sim->i_assoc->block_size : sim->i_cache->block_size;
+}
+
+memory_status_t get_mem_status(sim_t *sim){
+    return sim->memory_status;
+}
+void set_mem_status(sim_t *sim, memory_status_t status){
+    if(sim->memory_status != status) cache_event(sim);
+    sim->memory_status = status;
+}
 
-cache_config_t *config;
+void cache_event(sim_t *sim){
+    sim->memory_events++;
+}
+
+uint32_t cache_get_events(sim_t *sim){
+    return sim->memory_events;
+}
+
+static uint32_t *cache_first_wait(sim_t *sim, memory_status_t unit, uint32_t *penalty, bool *to_memory);
+
+// The fills and write buffer entries under way, or waiting for the bus
+static uint32_t cache_in_flight(sim_t *sim){
+    return d_cache_fetching(sim) + i_cache_fetching(sim) + sim->write_buffer->writing;
+}
+
+/* On a split bus, the cycles the units waiting for a first word without the
+* bus can go on counting before one of them changes: it needs the DRAM
+* timing, or its word is ready. 0 if a ready one only needs the bus to be
+* free, and UINT32_MAX if none is waiting. */
+static uint32_t cache_overlap_cycles(sim_t *sim){
+    static const memory_status_t units[BUS_UNITS] = {MEM_READING_D, MEM_READING_I, MEM_WRITING};
+    uint32_t cycles = UINT32_MAX;
+    uint32_t penalty;
+    bool to_memory;
+    if (!bus_split(sim)) return cycles;
+    for (uint32_t i = 0; i < BUS_UNITS; i++) {
+        if (units[i] == get_mem_status(sim)) continue;
+        uint32_t *count = cache_first_wait(sim, units[i], &penalty, &to_memory);
+        if (count == NULL) continue;
+        if (to_memory) return 0;
+        if (*count + 1 < penalty) {
+            if (penalty - 1 - *count < cycles) cycles = penalty - 1 - *count;
+        } else if (get_mem_status(sim) == MEM_IDLE) {
+            return 0;
+        }
+    }
+    return cycles;
+}
+
+// The active unit's cycles to its next event
+static uint32_t cache_active_cycles(sim_t *sim){
+    uint32_t penalty;
+    switch (get_mem_status(sim)) {
+        case MEM_READING_D:
+            if (sim->d_assoc && sim->d_assoc->fetching) return assoc_cache_cycles_to_event(sim->d_assoc);
+            if (sim->d_cache && sim->d_cache->fetching) return direct_cache_cycles_to_event(sim->d_cache);
+            break;
+        case MEM_READING_I:
+            if (sim->i_assoc && sim->i_assoc->fetching) return assoc_cache_cycles_to_event(sim->i_assoc);
+            if (sim->i_cache && sim->i_cache->fetching) return direct_cache_cycles_to_event(sim->i_cache);
+            break;
+        case MEM_WRITING:
+            if (sim->write_buffer->writing) {
+                penalty = sim->write_buffer->subsequent_writing ? sim->write_buffer->subsequent_penalty : sim->write_buffer->penalty;
+                if (sim->write_buffer->penalty_count + 1 >= penalty) return 0;
+                return penalty - 1 - sim->write_buffer->penalty_count;
+            }
+            break;
+        case MEM_IDLE:
+            // Only units waiting without the bus could be counting
+            if (bus_split(sim)) return UINT32_MAX;
+            break;
+        default:
+            break;
+    }
+    // Idle, or about to switch to another unit
+    return 0;
+}
 
-memory_status_t get_mem_status(void){
-    return memory_status;
+uint32_t cache_cycles_to_event(sim_t *sim){
+    uint32_t active = cache_active_cycles(sim);
+    uint32_t overlap = cache_overlap_cycles(sim);
+    if (overlap < active) return overlap;
+    // Nothing at all is counting
+    if (active == UINT32_MAX) return 0;
+    return active;
 }
-void set_mem_status(memory_status_t status){
-    memory_status = status;
+
+void cache_skip(sim_t *sim, uint32_t cycles){
+    static const memory_status_t units[BUS_UNITS] = {MEM_READING_D, MEM_READING_I, MEM_WRITING};
+    uint32_t penalty;
+    bool to_memory;
+    if (bus_split(sim)) {
+        for (uint32_t i = 0; i < BUS_UNITS; i++) {
+            if (units[i] == get_mem_status(sim)) continue;
+            uint32_t *count = cache_first_wait(sim, units[i], &penalty, &to_memory);
+            if (count == NULL || *count + 1 >= penalty) continue;
+            *count += cycles;
+        }
+        if (cache_in_flight(sim) > 1) sim->bus->overlapped += cycles;
+    }
+    switch (get_mem_status(sim)) {
+        case MEM_READING_D:
+            if (sim->d_assoc) sim->d_assoc->penalty_count += cycles;
+            else sim->d_cache->penalty_count += cycles;
+            break;
+        case MEM_READING_I:
+            if (sim->i_assoc) sim->i_assoc->penalty_count += cycles;
+            else sim->i_cache->penalty_count += cycles;
+            break;
+        case MEM_WRITING:
+            sim->write_buffer->penalty_count += cycles;
+            break;
+        default:
+            break;
+    }
 }
 
-void cache_init(cache_config_t *cpu_cfg){
-    config = (cache_config_t*)malloc(sizeof(cache_config_t));
-    memcpy(config, cpu_cfg, sizeof(cache_config_t));
-    set_mem_status(MEM_IDLE);
+void cache_init(sim_t *sim){
+    cache_config_t *config = &sim->cache_cfg;
+    set_mem_status(sim, MEM_IDLE);
     if(config->mode == CACHE_DISABLE){
         return;
     } else if(config->mode == CACHE_SPLIT){
-        d_cache_init(config);
-        i_cache_init(config);
-        write_buffer = write_buffer_init();
+        d_cache_init(sim, config);
+        i_cache_init(sim, config);
+        sim->write_buffer = write_buffer_init(config->write_buffer, d_cache_block_size(sim));
     } else if(config->mode == CACHE_UNIFIED){
-        d_cache_init(config);
-        write_buffer = write_buffer_init();
+        u_cache_init(sim, config);
+        sim->write_buffer = write_buffer_init(config->write_buffer, d_cache_block_size(sim));
+    }
+    if(config->mshrs){
+        sim->mshr = mshr_init(config->mshrs, d_cache_block_size(sim));
+    }
+    if(config->victims){
+        if(sim->d_cache) sim->d_cache->victims = victim_init(config->victims);
+        if(sim->i_cache) sim->i_cache->victims = victim_init(config->victims);
+    }
+    if(config->data_prefetch != PREFETCH_NONE){
+        sim->d_prefetch = prefetch_init(config->data_prefetch, false, config->prefetch_degree, d_cache_block_size(sim));
+    }
+    if(config->inst_prefetch != PREFETCH_NONE){
+        sim->i_prefetch = prefetch_init(config->inst_prefetch, true, config->prefetch_degree, i_cache_block_size(sim));
+    }
+    if(config->l2_size){
+        uint32_t block = d_cache_block_size(sim);
+        if(i_cache_block_size(sim) > block) block = i_cache_block_size(sim);
+        sim->l2 = l2_init(config, block);
+    }
+    if(config->dram.enabled){
+        sim->dram = dram_init(&config->dram);
+    }
+    if(config->bus.split || config->bus.width > 1 || config->bus.arbitration != BUS_FIXED){
+        sim->bus = bus_init(&config->bus, config->write_buffer);
     }
+}
 
+// A cache too small for its sets is fully associative instead
+static uint32_t cache_fit_ways(uint32_t num_blocks, uint32_t ways){
+    if(ways > num_blocks){
+        cprintf(ANSI_C_YELLOW, "cache_init: only %d blocks, so only %d ways\n", num_blocks, num_blocks);
+        return num_blocks;
+    }
+    return ways;
 }
 
-void d_cache_init(cache_config_t *cpu_cfg){
+void d_cache_init(sim_t *sim, cache_config_t *cpu_cfg){
 
     //Check if cache size is a power of two
     if((cpu_cfg->data_size & (cpu_cfg->data_size - 1)) != 0) {
@@ -51,10 +202,14 @@ void d_cache_init(cache_config_t *cpu_cfg){
     }
     //Each block contains a word of data
     uint32_t num_blocks = (cpu_cfg->data_size >> 2) / cpu_cfg->data_block;
-    d_cache = direct_cache_init(num_blocks, cpu_cfg->data_block);
+    if(cpu_cfg->data_type == CACHE_ASSOC){
+        sim->d_assoc = assoc_cache_init(num_blocks, cpu_cfg->data_block, cache_fit_ways(num_blocks, cpu_cfg->data_ways), cpu_cfg->data_replace, cpu_cfg->fill_order);
+    } else {
+        sim->d_cache = direct_cache_init(num_blocks, cpu_cfg->data_block, cpu_cfg->fill_order);
+    }
 }
 
-void i_cache_init(cache_config_t *cpu_cfg){
+void i_cache_init(sim_t *sim, cache_config_t *cpu_cfg){
     //chech to make sure instruction cache size is a power of two
     if((cpu_cfg->inst_size & (cpu_cfg->inst_size - 1)) != 0) {
         cprintf(ANSI_C_RED, "cache_init: I_CACHE_SIZE %d not a power of two\n", cpu_cfg->inst_size);
@@ -64,109 +219,210 @@ void i_cache_init(cache_config_t *cpu_cfg){
         printf("Creating Instruction Cache (I Cache)\n");
     }
     uint32_t num_blocks = (cpu_cfg->inst_size >> 2) / cpu_cfg->inst_block;
-    i_cache = direct_cache_init(num_blocks, cpu_cfg->inst_block);
+    if(cpu_cfg->inst_type == CACHE_ASSOC){
+        sim->i_assoc = assoc_cache_init(num_blocks, cpu_cfg->inst_block, cache_fit_ways(num_blocks, cpu_cfg->inst_ways), cpu_cfg->inst_replace, cpu_cfg->fill_order);
+    } else {
+        sim->i_cache = direct_cache_init(num_blocks, cpu_cfg->inst_block, cpu_cfg->fill_order);
+    }
+}
+
+void u_cache_init(sim_t *sim, cache_config_t *cpu_cfg){
+    //check to make sure unified cache size is a power of two
+    if((cpu_cfg->size & (cpu_cfg->size - 1)) != 0) {
+        cprintf(ANSI_C_RED, "cache_init: CACHE_SIZE %d not a power of two\n", cpu_cfg->size);
+        assert(0);
+    }
+    if(flags & MASK_DEBUG){
+        printf("Creating Unified Cache\n");
+    }
+    //The unified cache takes the place of the D cache, and both ports use it
+    uint32_t num_blocks = (cpu_cfg->size >> 2) / cpu_cfg->block;
+    if(cpu_cfg->type == CACHE_ASSOC){
+        sim->d_assoc = assoc_cache_init(num_blocks, cpu_cfg->block, cache_fit_ways(num_blocks, cpu_cfg->ways), cpu_cfg->replace, cpu_cfg->fill_order);
+    } else {
+        sim->d_cache = direct_cache_init(num_blocks, cpu_cfg->block, cpu_cfg->fill_order);
+    }
+}
+
+
+void cache_destroy(sim_t *sim){
+    if (sim->d_cache) direct_cache_free(sim->d_cache);
+    if (sim->i_cache) direct_cache_free(sim->i_cache);
+    if (sim->d_assoc) assoc_cache_free(sim->d_assoc);
+    if (sim->i_assoc) assoc_cache_free(sim->i_assoc);
+    if (sim->write_buffer) write_buffer_destroy(sim->write_buffer);
+    if (sim->mshr) mshr_free(sim->mshr);
+    if (sim->l2) l2_free(sim->l2);
+    if (sim->dram) dram_free(sim->dram);
+    if (sim->bus) bus_free(sim->bus);
+    if (sim->d_prefetch) prefetch_free(sim->d_prefetch);
+    if (sim->i_prefetch) prefetch_free(sim->i_prefetch);
+    sim->d_cache = NULL;
+    sim->i_cache = NULL;
+    sim->d_assoc = NULL;
+    sim->i_assoc = NULL;
+    sim->write_buffer = NULL;
+    sim->mshr = NULL;
+    sim->l2 = NULL;
+    sim->dram = NULL;
+    sim->bus = NULL;
+    sim->d_prefetch = NULL;
+    sim->i_prefetch = NULL;
+}
+
+/* The D or I fill, or the write buffer entry, of unit, if there is one and
+* it is still waiting for its first word: its counter, with the penalty of
+* that word and whether it still has to add the memory time. NULL otherwise. */
+static uint32_t *cache_first_wait(sim_t *sim, memory_status_t unit, uint32_t *penalty, bool *to_memory){
+    write_buffer_t *wb = sim->write_buffer;
+    switch (unit) {
+        case MEM_READING_D:
+            if (sim->d_assoc && sim->d_assoc->fetching && !sim->d_assoc->subsequent_fetching) {
+                *penalty = sim->d_assoc->miss_penalty;
+                *to_memory = sim->d_assoc->to_memory;
+                return &sim->d_assoc->penalty_count;
+            }
+            if (sim->d_cache && sim->d_cache->fetching && !sim->d_cache->subsequent_fetching) {
+                *penalty = sim->d_cache->miss_penalty;
+                *to_memory = sim->d_cache->to_memory;
+                return &sim->d_cache->penalty_count;
+            }
+            break;
+        case MEM_READING_I:
+            if (sim->cache_cfg.mode == CACHE_UNIFIED) break;
+            if (sim->i_assoc && sim->i_assoc->fetching && !sim->i_assoc->subsequent_fetching) {
+                *penalty = sim->i_assoc->miss_penalty;
+                *to_memory = sim->i_assoc->to_memory;
+                return &sim->i_assoc->penalty_count;
+            }
+            if (sim->i_cache && sim->i_cache->fetching && !sim->i_cache->subsequent_fetching) {
+                *penalty = sim->i_cache->miss_penalty;
+                *to_memory = sim->i_cache->to_memory;
+                return &sim->i_cache->penalty_count;
+            }
+            break;
+        case MEM_WRITING:
+            if (wb->writing && !wb->subsequent_writing) {
+                *penalty = wb->penalty;
+                *to_memory = wb->to_memory;
+                return &wb->penalty_count;
+            }
+            break;
+        default:
+            break;
+    }
+    return NULL;
 }
 
+// The address unit is fetching or writing
+static uint32_t cache_unit_address(sim_t *sim, memory_status_t unit){
+    switch (unit) {
+        case MEM_READING_D:
+            return sim->d_assoc ? sim->d_assoc->target_address : sim->d_cache->target_address;
+        case MEM_READING_I:
+            return sim->i_assoc ? sim->i_assoc->target_address : sim->i_cache->target_address;
+        default:
+            return sim->write_buffer->address;
+    }
+}
 
-void cache_destroy(void){
+/* Whether unit has a transaction for the bus to take now. On a split bus it
+* also needs its first word to be ready, or to be past it. */
+static bool cache_bus_ready(sim_t *sim, memory_status_t unit){
+    uint32_t penalty;
+    bool to_memory;
+    bool requesting = (unit == MEM_READING_D) ? d_cache_fetching(sim) :
+        (unit == MEM_READING_I) ? i_cache_fetching(sim) : sim->write_buffer->writing;
+    if (!requesting || !bus_split(sim)) return requesting;
+    uint32_t *count = cache_first_wait(sim, unit, &penalty, &to_memory);
+    return count == NULL || (!to_memory && *count + 1 >= penalty);
+}
 
-    direct_cache_free(d_cache);
+/* Whether the transaction of unit can start at once with FR-FCFS scheduling:
+* it does not need the DRAM, or the DRAM has its row open */
+static bool cache_row_ready(sim_t *sim, memory_status_t unit){
+    uint32_t penalty;
+    bool to_memory;
+    if (cache_first_wait(sim, unit, &penalty, &to_memory) == NULL || !to_memory) return true;
+    return dram_row_open(sim, cache_unit_address(sim, unit));
+}
 
-    direct_cache_free(i_cache);
-    return;
+/* The unit memory goes to next, once the one it was with is done: the first
+* of the units ready for it in the order of the bus arbitration (see bus.h),
+* the D cache, then the I cache, then the write buffer without one, unless
+* FR-FCFS scheduling finds one whose row is open (see dram.h) */
+static memory_status_t cache_arbitrate(sim_t *sim){
+    memory_status_t order[BUS_UNITS] = {MEM_READING_D, MEM_READING_I, MEM_WRITING};
+    memory_status_t first = MEM_IDLE;
+    memory_status_t ready = MEM_IDLE;
+    if (sim->bus) bus_order(sim, sim->write_buffer->count, order);
+    for (uint32_t i = 0; i < BUS_UNITS; i++) {
+        if (!cache_bus_ready(sim, order[i])) continue;
+        if (first == MEM_IDLE) first = order[i];
+        if (ready == MEM_IDLE && cache_row_ready(sim, order[i])) ready = order[i];
+    }
+    memory_status_t next = first;
+    dram_t *dram = sim->dram;
+    if (dram && dram->config.scheduling == DRAM_FR_FCFS && dram->bypassed < DRAM_FR_FCFS_CAP &&
+            ready != MEM_IDLE && ready != first) {
+        dram->bypassed++;
+        next = ready;
+    } else if (dram) {
+        dram->bypassed = 0;
+    }
+    if (sim->bus && next != MEM_IDLE) bus_grant(sim, next);
+    return next;
 }
 
-/* void cache_digest(void)
+/* void cache_digest(sim_t *sim)
 * processes the cache on each cycle
 * handles the business logic of fetching data from main memory,
 * waiting the specified cache miss penalty, retreiving subsequent lines from
 * memory.
 */
 
-void cache_digest(void){
+void cache_digest(sim_t *sim){
     gcprintf(ANSI_C_CYAN, "CACHE DIGEST:\n");
-    if (d_cache == NULL) {
+    if (sim->d_cache == NULL && sim->d_assoc == NULL) {
         cprintf(ANSI_C_RED, "cache_digest: data cache is not initialized\n", NULL);
         assert(0);
     }
-    if (i_cache == NULL) {
+    if (sim->i_cache == NULL && sim->i_assoc == NULL && sim->cache_cfg.mode != CACHE_UNIFIED) {
         cprintf(ANSI_C_RED, "cache_digest: instruction cache is not initialized\n", NULL);
         assert(0);
     }
-    if (write_buffer == NULL) {
+    if (sim->write_buffer == NULL) {
         cprintf(ANSI_C_RED, "cache_digest: write buffer is not initialized\n", NULL);
         assert(0);
     }
 
     // State machine to ensure we do not have more than one memory access at a time
     // This is a state that is consistent between all
-    switch (get_mem_status()) {
+    switch (get_mem_status(sim)) {
         case MEM_IDLE:
             // Ready to accept new memory accesses
-            // Check for data cache read requests
-            if (d_cache->fetching) {
-                set_mem_status(MEM_READING_D);
-            } else if(i_cache->fetching) {
-                set_mem_status(MEM_READING_I);
-            } else if(write_buffer->writing) {
-                set_mem_status(MEM_WRITING);
-            }
+            set_mem_status(sim, cache_arbitrate(sim));
             break;
         case MEM_READING_D:
             // Last digest cycle, we were reading into data cache. See if still reading
-            if (d_cache->fetching) {
-                // Still reading, no state change
-                break;
-            } else if (i_cache->fetching) {
-                // Now instruction cache is reading
-                set_mem_status(MEM_READING_I);
-            } else if(write_buffer->writing) {
-                // Writing from data cache to memory
-                set_mem_status(MEM_WRITING);
-            } else {
-                set_mem_status(MEM_IDLE);
-            }
+            if (!d_cache_fetching(sim)) set_mem_status(sim, cache_arbitrate(sim));
             break;
         case MEM_READING_I:
             // Last cycle we were reading into instruction cache
-            if (i_cache->fetching) {
-                // Still reading into I cache
-                break;
-            } else if (d_cache->fetching) {
-                // Now we are reading into D cache
-                set_mem_status(MEM_READING_D);
-            } else if (write_buffer->writing) {
-                // Now we are writing into memory from D cache
-                set_mem_status(MEM_WRITING);
-            } else {
-                // Nothing to do
-                set_mem_status(MEM_IDLE);
-            }
+            if (!i_cache_fetching(sim)) set_mem_status(sim, cache_arbitrate(sim));
             break;
         case MEM_WRITING:
             // Last cycle we were writing to memory
-            if (write_buffer->writing) {
-                // Still writing
-                break;
-            } else if (d_cache->fetching) {
-                // Now reading into D cache
-                set_mem_status(MEM_READING_D);
-            } else if (i_cache->fetching) {
-                //Now reading into I cache
-                set_mem_status(MEM_READING_I);
-            } else {
-                // Nothing to do
-                set_mem_status(MEM_IDLE);
-            }
+            if (!sim->write_buffer->writing) set_mem_status(sim, cache_arbitrate(sim));
             break;
         default:
-            cprintf(ANSI_C_RED, "cache_digest: Undefined Memory State %d\n", get_mem_status());
+            cprintf(ANSI_C_RED, "cache_digest: Undefined Memory State %d\n", get_mem_status(sim));
             assert(0);
             break;
     }
     if (flags & MASK_DEBUG) {
         printf("\tcache_digest: Memory state is ");
-        switch (get_mem_status()) {
+        switch (get_mem_status(sim)) {
             case MEM_IDLE:
                 printf("MEM_IDLE\n");
                 break;
@@ -185,49 +441,318 @@ void cache_digest(void){
         }
     }
 
-    direct_cache_digest(d_cache, MEM_READING_D);
-    direct_cache_digest(i_cache, MEM_READING_I);
-    write_buffer_digest();
+    if (sim->d_assoc) assoc_cache_digest(sim, sim->d_assoc, MEM_READING_D);
+    else direct_cache_digest(sim, sim->d_cache, MEM_READING_D);
+    if (sim->i_assoc) assoc_cache_digest(sim, sim->i_assoc, MEM_READING_I);
+    else if (sim->i_cache) direct_cache_digest(sim, sim->i_cache, MEM_READING_I);
+    write_buffer_digest(sim);
+    if (bus_split(sim) && cache_in_flight(sim) > 1) sim->bus->overlapped++;
+    if (sim->mshr) mshr_digest(sim);
+    if (sim->d_prefetch) prefetch_digest(sim, sim->d_prefetch);
+    if (sim->i_prefetch) prefetch_digest(sim, sim->i_prefetch);
+
+    //print_cache(sim->i_cache);
+}
 
-    //print_cache(i_cache);
+/* Unified mode: the port's access through the shared cache, or the word it
+* latched if this is a retry of an access that already hit (see cache.h).
+* The data access is made before the fetch in every cycle, so when both miss
+* the data fill is queued first and the fetch waits for it to finish. */
+static cache_status_t u_cache_read_w(sim_t *sim, cache_latch_t *latch, uint32_t *address, word_t *data){
+    if (sim->frozen && latch->valid && latch->address == *address) {
+        *data = latch->data;
+        return CACHE_HIT;
+    }
+    cache_status_t status;
+    if (sim->d_assoc) status = assoc_cache_read_w(sim, sim->d_assoc, address, data);
+    else status = direct_cache_read_w(sim, sim->d_cache, address, data);
+    latch->valid = (status == CACHE_HIT);
+    latch->stored = false;
+    latch->address = *address;
+    if (latch->valid) latch->data = *data;
+    return status;
 }
 
-cache_status_t d_cache_read_w(uint32_t *address, word_t *data){
+cache_status_t d_cache_read_w(sim_t *sim, uint32_t *address, word_t *data){
     // Get data from the D cache
-    cache_status_t status = direct_cache_read_w(d_cache, address, data);
+    if (sim->cache_cfg.mode == CACHE_UNIFIED) return u_cache_read_w(sim, &sim->d_latch, address, data);
+    if (sim->d_assoc) return assoc_cache_read_w(sim, sim->d_assoc, address, data);
+    cache_status_t status = direct_cache_read_w(sim, sim->d_cache, address, data);
     return status;
 }
 
-cache_status_t d_cache_write_w(uint32_t *address, word_t *data){
+cache_status_t d_cache_write_w(sim_t *sim, uint32_t *address, word_t *data){
+    cache_status_t status;
+    if (sim->cache_cfg.mode == CACHE_UNIFIED) {
+        // A store that already went into the cache is not made again
+        cache_latch_t *latch = &sim->d_latch;
+        if (sim->frozen && latch->stored && latch->address == *address) return CACHE_HIT;
+        if (sim->d_assoc) status = assoc_cache_write_w(sim, sim->d_assoc, address, data);
+        else status = direct_cache_write_w(sim, sim->d_cache, address, data);
+        latch->stored = (status == CACHE_HIT);
+        // The retry reads the word again, its block may be gone by then
+        if (!latch->stored) latch->valid = false;
+        latch->address = *address;
+        return status;
+    }
     // Write data to the D cache
-    cache_status_t status = direct_cache_write_w(d_cache, address, data);
+    if (sim->d_assoc) return assoc_cache_write_w(sim, sim->d_assoc, address, data);
+    status = direct_cache_write_w(sim, sim->d_cache, address, data);
     return status;
 }
 
-cache_status_t i_cache_read_w(uint32_t *address, word_t *data){
+bool d_cache_probe_w(sim_t *sim, uint32_t address, word_t *data){
+    cache_access_t info;
+    if (sim->d_assoc) {
+        assoc_cache_get_tag_and_index(&info, sim->d_assoc, &address);
+        uint32_t way = assoc_cache_find(sim->d_assoc, info.index, info.tag);
+        if (way == sim->d_assoc->ways || !assoc_cache_line_valid(sim->d_assoc, info.index, way)[info.inner_index]) return false;
+        *data = assoc_cache_line_data(sim->d_assoc, info.index, way)[info.inner_index];
+        return true;
+    }
+    direct_cache_get_tag_and_index(&info, sim->d_cache, &address);
+    direct_cache_block_t *block = &sim->d_cache->blocks[info.index];
+    if (!block->valid[info.inner_index] || block->tag != info.tag) return false;
+    *data = block->data[info.inner_index];
+    return true;
+}
+
+void d_cache_request(sim_t *sim, uint32_t address){
+    // Not through the unified latch: this is not the pipeline's access
+    word_t data;
+    if (d_cache_fetching(sim)) return;
+    if (sim->d_assoc) assoc_cache_read_w(sim, sim->d_assoc, &address, &data);
+    else direct_cache_read_w(sim, sim->d_cache, &address, &data);
+}
+
+/* The cache the prefetcher of a port fills, as one of the two kinds. Unified
+* mode has only the D cache. */
+static void cache_of_port(sim_t *sim, bool inst, direct_cache_t **direct, assoc_cache_t **assoc){
+    if (inst && sim->cache_cfg.mode != CACHE_UNIFIED) {
+        *direct = sim->i_cache;
+        *assoc = sim->i_assoc;
+    } else {
+        *direct = sim->d_cache;
+        *assoc = sim->d_assoc;
+    }
+}
+
+bool cache_holds_block(sim_t *sim, bool inst, uint32_t address){
+    direct_cache_t *direct;
+    assoc_cache_t *assoc;
+    cache_access_t info;
+    const bool *valid;
+    uint32_t block_size;
+    cache_of_port(sim, inst, &direct, &assoc);
+    if (assoc) {
+        assoc_cache_get_tag_and_index(&info, assoc, &address);
+        uint32_t way = assoc_cache_find(assoc, info.index, info.tag);
+        if (way == assoc->ways) return false;
+        valid = assoc_cache_line_valid(assoc, info.index, way);
+        block_size = assoc->block_size;
+    } else {
+        direct_cache_get_tag_and_index(&info, direct, &address);
+        if (direct->blocks[info.index].tag != info.tag) return false;
+        valid = direct->blocks[info.index].valid;
+        block_size = direct->block_size;
+    }
+    for (uint32_t i = 0; i < block_size; i++) {
+        if (!valid[i]) return false;
+    }
+    return true;
+}
+
+/* Drop the block of address from the cache of one port, unless a fill is
+* using its line. A dirty copy goes to the write buffer first, and stays if
+* the buffer has no room for it. When warming, memory already has it.
+* Returns true if the block was dropped. */
+static bool cache_invalidate_block(sim_t *sim, bool inst, uint32_t address, bool warm){
+    direct_cache_t *direct;
+    assoc_cache_t *assoc;
+    cache_access_t info;
+    cache_of_port(sim, inst, &direct, &assoc);
+    if (assoc) {
+        assoc_cache_get_tag_and_index(&info, assoc, &address);
+        info.way = assoc_cache_find(assoc, info.index, info.tag);
+        if (info.way == assoc->ways) return false;
+        cache_access_t target;
+        assoc_cache_get_tag_and_index(&target, assoc, &assoc->target_address);
+        if (assoc->fetching && target.index == info.index && assoc->fill_way == info.way) return false;
+        uint32_t line = info.index * assoc->ways + info.way;
+        if (!inst && !warm && assoc->dirty[line] && get_write_policy(sim) == CACHE_WRITEBACK &&
+                write_buffer_enqueue(sim, info) == CACHE_MISS) return false;
+        for (uint32_t i = 0; i < assoc->block_size; i++) assoc->valid[line * assoc->block_size + i] = false;
+        assoc->present[line] = false;
+        assoc->dirty[line] = false;
+        return true;
+    }
+    // The victim cache only has the block's tag, so it can always let it go
+    victim_invalidate(direct->victims, address);
+    direct_cache_get_tag_and_index(&info, direct, &address);
+    direct_cache_block_t *block = &direct->blocks[info.index];
+    if (block->tag != info.tag) return false;
+    cache_access_t target;
+    direct_cache_get_tag_and_index(&target, direct, &direct->target_address);
+    if (direct->fetching && target.index == info.index) return false;
+    bool present = false;
+    for (uint32_t i = 0; i < direct->block_size; i++) present = present || block->valid[i];
+    if (!present) return false;
+    if (!inst && !warm && block->dirty && get_write_policy(sim) == CACHE_WRITEBACK &&
+            write_buffer_enqueue(sim, info) == CACHE_MISS) return false;
+    for (uint32_t i = 0; i < direct->block_size; i++) block->valid[i] = false;
+    block->dirty = false;
+    return true;
+}
+
+uint32_t cache_back_invalidate(sim_t *sim, uint32_t address, uint32_t bytes, bool warm){
+    uint32_t dropped = 0;
+    gprintf("\tcache_back_invalidate: dropping 0x%08x to 0x%08x from the first level\n", address, address + bytes - 1);
+    for (uint32_t port = 0; port < 2; port++) {
+        bool inst = (port == 1);
+        if (inst && sim->cache_cfg.mode == CACHE_UNIFIED) break;
+        direct_cache_t *direct;
+        assoc_cache_t *assoc;
+        cache_of_port(sim, inst, &direct, &assoc);
+        if (direct == NULL && assoc == NULL) continue;
+        uint32_t block_bytes = (assoc ? assoc->block_size : direct->block_size) << 2;
+        for (uint32_t offset = 0; offset < bytes; offset += block_bytes) {
+            if (cache_invalidate_block(sim, inst, address + offset, warm)) dropped++;
+        }
+    }
+    cache_event(sim);
+    return dropped;
+}
+
+bool cache_fetching_block(sim_t *sim, bool inst, uint32_t address){
+    direct_cache_t *direct;
+    assoc_cache_t *assoc;
+    cache_of_port(sim, inst, &direct, &assoc);
+    if (assoc) {
+        uint32_t mask = assoc->tag_mask | assoc->index_mask;
+        return assoc->fetching && (assoc->target_address & mask) == (address & mask);
+    }
+    uint32_t mask = direct->tag_mask | direct->index_mask;
+    return direct->fetching && (direct->target_address & mask) == (address & mask);
+}
+
+bool cache_request_block(sim_t *sim, bool inst, uint32_t address){
+    // Not through the unified latch: this is not the pipeline's access
+    direct_cache_t *direct;
+    assoc_cache_t *assoc;
+    word_t data;
+    cache_of_port(sim, inst, &direct, &assoc);
+    if (assoc) {
+        assoc_cache_read_w(sim, assoc, &address, &data);
+        return assoc->fetching;
+    }
+    direct_cache_read_w(sim, direct, &address, &data);
+    return direct->fetching;
+}
+
+bool cache_idle(sim_t *sim){
+    return get_mem_status(sim) == MEM_IDLE && !d_cache_fetching(sim) && !i_cache_fetching(sim) &&
+        !sim->write_buffer->writing && !(sim->mshr && mshr_busy(sim));
+}
+
+bool d_cache_replacing(sim_t *sim, uint32_t address){
+    // Only a writeback cache keeps a store in the block alone
+    if (get_write_policy(sim) != CACHE_WRITEBACK) return false;
+    // A retry of a store that already went in is not made again
+    cache_latch_t *latch = &sim->d_latch;
+    if (sim->cache_cfg.mode == CACHE_UNIFIED && sim->frozen && latch->stored && latch->address == address) return false;
+    if (sim->d_assoc) return assoc_cache_leaving(sim->d_assoc, address);
+    return direct_cache_leaving(sim->d_cache, address);
+}
+
+bool d_cache_has_block(sim_t *sim, uint32_t address){
+    return cache_holds_block(sim, false, address) || cache_fetching_block(sim, false, address);
+}
+
+cache_status_t d_cache_write_around(sim_t *sim, uint32_t address, word_t data, word_t mask){
+    // A store already made by an earlier try of a frozen cycle
+    cache_latch_t *latch = &sim->d_latch;
+    bool unified = sim->cache_cfg.mode == CACHE_UNIFIED;
+    if (unified && sim->frozen && latch->stored && latch->address == address) return CACHE_PENDING;
+    uint32_t word_address = address & ~0x3;
+    if (mask != 0xffffffff) {
+        word_t word;
+        mem_read_w(sim, word_address, &word);
+        write_buffer_forward(sim, word_address, &word);
+        data = (word & ~mask) | (data & mask);
+    }
+    gprintf("\td_cache_write_around: storing 0x%08x to 0x%08x around the D cache\n", data, word_address);
+    cache_status_t status = write_buffer_enqueue_word(sim, word_address, data);
+    if (unified) {
+        latch->valid = false;
+        latch->stored = (status == CACHE_HIT);
+        latch->address = address;
+    }
+    return status == CACHE_HIT ? CACHE_PENDING : CACHE_MISS;
+}
+
+cache_status_t i_cache_read_w(sim_t *sim, uint32_t *address, word_t *data){
     // Get data from the I cache
-    cache_status_t status = direct_cache_read_w(i_cache, address, data);
+    if (sim->cache_cfg.mode == CACHE_UNIFIED) return u_cache_read_w(sim, &sim->i_latch, address, data);
+    if (sim->i_assoc) return assoc_cache_read_w(sim, sim->i_assoc, address, data);
+    cache_status_t status = direct_cache_read_w(sim, sim->i_cache, address, data);
     return status;
 }
 
-cache_wpolicy_t get_write_policy(void){
-    if (config->mode ==CACHE_UNIFIED) {
-        return config->wpolicy;
+void d_cache_warm(sim_t *sim, uint32_t address, bool write){
+    l2_warm(sim, address);
+    if (sim->d_assoc) assoc_cache_warm(sim, sim->d_assoc, address, write);
+    else direct_cache_warm(sim, sim->d_cache, address, write);
+}
+
+void i_cache_warm(sim_t *sim, uint32_t address){
+    if (sim->cache_cfg.mode == CACHE_UNIFIED) {
+        d_cache_warm(sim, address, false);
+        return;
+    }
+    l2_warm(sim, address);
+    if (sim->i_assoc) assoc_cache_warm(sim, sim->i_assoc, address, false);
+    else direct_cache_warm(sim, sim->i_cache, address, false);
+}
+
+cache_wpolicy_t get_write_policy(sim_t *sim){
+    if (sim->cache_cfg.mode ==CACHE_UNIFIED) {
+        return sim->cache_cfg.wpolicy;
     } else {
-        return config->data_wpolicy;
+        return sim->cache_cfg.data_wpolicy;
     }
 }
 
 /* Write buffer implementation functions */
 /* @brief Initializes a new write buffer
-*  @returns an instance of a new write buffer depending on what write policy is defined
+*  @returns an empty write buffer of entries blocks of block_size words
 */
-write_buffer_t *write_buffer_init(void) {
+write_buffer_t *write_buffer_init(uint32_t entries, uint32_t block_size) {
     write_buffer_t *wb = (write_buffer_t *)malloc(sizeof(write_buffer_t));
-    wb->penalty_count = 0;
+    wb->size = entries;
+    wb->block_size = block_size;
+    wb->entries = (write_buffer_entry_t *)malloc(sizeof(write_buffer_entry_t)*entries);
+    //The words of every entry are in one array, as in the caches
+    word_t *words = (word_t *)malloc(sizeof(word_t)*entries*block_size);
+    bool *pending = (bool *)calloc(entries*block_size, sizeof(bool));
+    if (wb->entries == NULL || words == NULL || pending == NULL) {
+        cprintf(ANSI_C_RED, "write_buffer_init: Unable to allocate write buffer\n");
+        assert(0);
+    }
+    for (uint32_t i = 0; i < entries; i++) {
+        wb->entries[i].address = 0;
+        wb->entries[i].data = words + i * block_size;
+        wb->entries[i].pending = pending + i * block_size;
+    }
+    wb->head = 0;
+    wb->count = 0;
     wb->writing = false;
+    wb->address = 0;
+    wb->penalty_count = 0;
+    wb->penalty = CACHE_WRITE_PENALTY;
+    wb->subsequent_penalty = CACHE_WRITE_SUBSEQUENT_PENALTY;
     wb->subsequent_writing = 0;
-    wb->data = (word_t *)malloc(sizeof(word_t)*d_cache->block_size);
+    wb->to_memory = false;
+    wb->full = false;
     return wb;
 }
 
@@ -235,145 +760,255 @@ write_buffer_t *write_buffer_init(void) {
 *  @params the write buffer to be destroyed.
 */
 void write_buffer_destroy(write_buffer_t *wb) {
-    free(wb->data);
+    free(wb->entries[0].data);
+    free(wb->entries[0].pending);
+    free(wb->entries);
     free(wb);
 }
 
-uint32_t write_buffer_get_address(void){
-    if(write_buffer->writing == false){
+// The i-th oldest entry in use
+static write_buffer_entry_t *write_buffer_entry(write_buffer_t *wb, uint32_t i) {
+    return &wb->entries[(wb->head + i) % wb->size];
+}
+
+// Start writing the oldest entry, from its first pending word
+static void write_buffer_start(sim_t *sim, write_buffer_t *wb) {
+    write_buffer_entry_t *entry = write_buffer_entry(wb, 0);
+    uint32_t word = 0;
+    while (!entry->pending[word]) word++;
+    wb->address = entry->address | (word << 2);
+    wb->penalty_count = 0;
+    wb->subsequent_writing = 0;
+    wb->to_memory = l2_write(sim, entry->address, &wb->penalty, &wb->subsequent_penalty);
+}
+
+uint32_t write_buffer_get_address(sim_t *sim){
+    if(sim->write_buffer->writing == false){
         //We should never be writing to this memory address
         return 0xffffffff;
     } else {
-        return write_buffer->address;
-    }
-}
-
-void write_buffer_digest(void) {
-    //word_t temp;
-    if (write_buffer->writing) {
-        if (get_mem_status() != MEM_WRITING) {
-            //Its not my turn!!!
-            return;
-        } else {
-            write_buffer->penalty_count++;
-            if (write_buffer->penalty_count == CACHE_WRITE_PENALTY) {
-                mem_write_w(write_buffer->address, &write_buffer->data[write_buffer->subsequent_writing]);
-                write_buffer->writing = false;
-                write_buffer->penalty_count = 0;
-                if(write_buffer->subsequent_writing != (d_cache->block_size - 1) && (get_write_policy() == CACHE_WRITEBACK)){
-                    //enqueue the next data address
-                    write_buffer->address+=4;
-                    write_buffer->writing = true;
-                    write_buffer->penalty_count = 0;
-                    write_buffer->subsequent_writing = 1;
-                } else {
-                    set_mem_status(MEM_IDLE);
-                }
-            } else if (write_buffer->subsequent_writing && write_buffer->penalty_count == CACHE_WRITE_SUBSEQUENT_PENALTY) {
-                mem_write_w(write_buffer->address, &write_buffer->data[write_buffer->subsequent_writing]);
-                write_buffer->writing = false;
-                write_buffer->penalty_count = 0;
-                if (write_buffer->subsequent_writing != (d_cache->block_size - 1)) {
-                    write_buffer->address += 4;
-                    write_buffer->writing = true;
-                    write_buffer->subsequent_writing++;
-                    write_buffer->penalty_count = 0;
-                } else {
-                    set_mem_status(MEM_IDLE);
-                }
-            }
-        }
+        return sim->write_buffer->address;
     }
 }
 
-cache_status_t write_buffer_get_status(void){
-    if(write_buffer->writing){
+void write_buffer_digest(sim_t *sim) {
+    write_buffer_t *wb = sim->write_buffer;
+    bool granted = (get_mem_status(sim) == MEM_WRITING);
+    //A split bus lets the wait for the first word go on without it
+    bool overlapping = !granted && wb->writing && !wb->subsequent_writing && bus_split(sim);
+    if ((granted || overlapping) && wb->to_memory) {
+        uint32_t first;
+        dram_timing(sim, wb->address, true, &first, &wb->subsequent_penalty);
+        //A split bus posts the write, memory finishes it once its words are across
+        wb->penalty += bus_split(sim) ? wb->subsequent_penalty : first;
+        wb->to_memory = false;
+    }
+    if (overlapping) bus_overlap(&wb->penalty_count, wb->penalty);
+    if (!wb->writing || !granted) {
+        //Its not my turn!!!
+        return;
+    }
+    wb->penalty_count++;
+    if (wb->penalty_count < (wb->subsequent_writing ? wb->subsequent_penalty : wb->penalty)) {
+        return;
+    }
+    cache_event(sim);
+    write_buffer_entry_t *entry = write_buffer_entry(wb, 0);
+    uint32_t word = (wb->address >> 2) & (wb->block_size - 1);
+    mem_write_w(sim, wb->address, &entry->data[word]);
+    entry->pending[word] = false;
+    wb->penalty_count = 0;
+    wb->subsequent_writing++;
+    //Move on to the next pending word of the entry
+    while (++word < wb->block_size && !entry->pending[word]);
+    if (word < wb->block_size) {
+        wb->address = entry->address | (word << 2);
+        return;
+    }
+    //The entry is done. Let a waiting fill have the memory before the next one
+    wb->head = (wb->head + 1) % wb->size;
+    wb->count--;
+    wb->writing = (wb->count != 0);
+    if (wb->writing) write_buffer_start(sim, wb);
+    set_mem_status(sim, MEM_IDLE);
+}
+
+cache_status_t write_buffer_get_status(sim_t *sim){
+    if(sim->write_buffer->count == sim->write_buffer->size){
         return CACHE_MISS;
     } else {
         return CACHE_HIT;
     }
 }
 
-cache_status_t write_buffer_enqueue(cache_access_t info){
-    if (write_buffer == NULL) {
-        cprintf(ANSI_C_RED, "write_buffer_enqueue: buffer is not initialized\n", NULL);
-        assert(0);
+bool write_buffer_writing(sim_t *sim){
+    return sim->write_buffer->writing;
+}
+
+/* The entry a write to address goes into: the newest entry of its block,
+ * unless that is the oldest one, or else a new one. NULL if every entry is
+ * in use. */
+static write_buffer_entry_t *write_buffer_claim(sim_t *sim, write_buffer_t *wb, uint32_t address) {
+    uint32_t block = address & ~((wb->block_size << 2) - 1);
+    write_buffer_entry_t *entry;
+    for (uint32_t i = wb->count; i-- > 1;) {
+        entry = write_buffer_entry(wb, i);
+        if (entry->address == block) {
+            if (flags & MASK_DEBUG) {
+                printf("\twrite_buffer_enqueue: merging into the entry for block 0x%08x\n", block);
+            }
+            return entry;
+        }
     }
-    if (write_buffer->writing) {
+    if (wb->count == wb->size) {
         // Buffer is full!!
         if (flags & MASK_DEBUG) {
             printf("\twrite_buffer_enqueue: Write buffer is full!\n");
         }
-        return CACHE_MISS;
+        wb->full = true;
+        return NULL;
+    }
+    entry = write_buffer_entry(wb, wb->count);
+    entry->address = block;
+    for (uint32_t i = 0; i < wb->block_size; i++) {
+        entry->pending[i] = false;
+    }
+    wb->count++;
+    cache_event(sim);
+    return entry;
+}
+
+cache_status_t write_buffer_enqueue(sim_t *sim, cache_access_t info){
+    write_buffer_t *wb = sim->write_buffer;
+    if (wb == NULL) {
+        cprintf(ANSI_C_RED, "write_buffer_enqueue: buffer is not initialized\n", NULL);
+        assert(0);
+    }
+    // The line of the D cache the data comes from
+    uint32_t block_size = wb->block_size;
+    const word_t *data;
+    const bool *valid;
+    if (sim->d_assoc) {
+        data = assoc_cache_line_data(sim->d_assoc, info.index, info.way);
+        valid = assoc_cache_line_valid(sim->d_assoc, info.index, info.way);
     } else {
-        uint8_t i = 0;
-        for (i = 0; i < d_cache->block_size; i++) {
-            if (d_cache->blocks[info.index].valid[i] == false) {
-                if (flags & MASK_DEBUG) {
-                    printf("\tEntire block is not valid. Waiting until block is valid before proceeding.\n");
-                }
-                return CACHE_MISS;
+        data = sim->d_cache->blocks[info.index].data;
+        valid = sim->d_cache->blocks[info.index].valid;
+    }
+    uint32_t i = 0;
+    for (i = 0; i < block_size; i++) {
+        if (valid[i] == false) {
+            if (flags & MASK_DEBUG) {
+                printf("\tEntire block is not valid. Waiting until block is valid before proceeding.\n");
             }
+            return CACHE_MISS;
         }
-        if (flags & MASK_DEBUG) {
-            printf("\twrite_buffer_enqueue: filling write buffer with block index %d and tag 0x%08x\n", info.index, info.tag);
+    }
+    write_buffer_entry_t *entry = write_buffer_claim(sim, wb, info.address);
+    if (entry == NULL) return CACHE_MISS;
+    if (flags & MASK_DEBUG) {
+        printf("\twrite_buffer_enqueue: filling write buffer with block index %d and tag 0x%08x\n", info.index, info.tag);
+    }
+    if(get_write_policy(sim) == CACHE_WRITEBACK){
+        for (i = 0; i < block_size; i++) {
+            if (!entry->pending[i] || entry->data[i] != data[i]) cache_event(sim);
+            entry->data[i] = data[i];
+            entry->pending[i] = true;
         }
-        if(get_write_policy() == CACHE_WRITEBACK){
-            write_buffer->address = (info.address & (d_cache->tag_mask | d_cache->index_mask));
-            for (i = 0; i < d_cache->block_size; i++) {
-                write_buffer->data[i] = d_cache->blocks[info.index].data[i];
-            }
-        } else {
-            write_buffer->address = info.address;
-            write_buffer->data[0] = d_cache->blocks[info.index].data[info.inner_index];
+    } else {
+        if (!entry->pending[info.inner_index] || entry->data[info.inner_index] != info.data) cache_event(sim);
+        entry->data[info.inner_index] = info.data;
+        entry->pending[info.inner_index] = true;
+    }
+    if (wb->count == 1) {
+        wb->writing = true;
+        write_buffer_start(sim, wb);
+    }
+    return CACHE_HIT;
+}
+
+cache_status_t write_buffer_enqueue_word(sim_t *sim, uint32_t address, word_t data){
+    write_buffer_t *wb = sim->write_buffer;
+    write_buffer_entry_t *entry = write_buffer_claim(sim, wb, address);
+    if (entry == NULL) return CACHE_MISS;
+    uint32_t word = (address >> 2) & (wb->block_size - 1);
+    if (!entry->pending[word] || entry->data[word] != data) cache_event(sim);
+    entry->data[word] = data;
+    entry->pending[word] = true;
+    if (wb->count == 1) {
+        wb->writing = true;
+        write_buffer_start(sim, wb);
+    }
+    return CACHE_HIT;
+}
+
+bool write_buffer_forward(sim_t *sim, uint32_t address, word_t *data){
+    write_buffer_t *wb = sim->write_buffer;
+    uint32_t block = address & ~((wb->block_size << 2) - 1);
+    uint32_t word = (address >> 2) & (wb->block_size - 1);
+    for (uint32_t i = wb->count; i-- > 0;) {
+        write_buffer_entry_t *entry = write_buffer_entry(wb, i);
+        if (entry->address == block && entry->pending[word]) {
+            gprintf("\twrite_buffer_forward: 0x%08x for address 0x%08x\n", entry->data[word], address);
+            *data = entry->data[word];
+            return true;
         }
-        write_buffer->writing = true;
-        write_buffer->penalty_count = 0;
-        write_buffer->subsequent_writing = 0;
-        return CACHE_HIT;
     }
+    return false;
 }
 
-void flush_dcache(void){
+void flush_dcache(sim_t *sim){
     eprintf("Flushing cache...\n");
     uint32_t address;
-    for (uint32_t i = 0; i < d_cache->num_blocks; i++) {
-        if (d_cache->blocks[i].dirty) {
-            for (uint32_t j = 0; j < d_cache->block_size; j++) {
-                address = (d_cache->blocks[i].tag << (2 + d_cache->index_size + d_cache->inner_index_size)) | (i << (2 + d_cache->inner_index_size)) | (j << 2);
-                eprintf("\tWriting 0x%08x (0d%d) to 0x%08x\n", d_cache->blocks[i].data[j], d_cache->blocks[i].data[j], address);
-                mem_write_w(address, &(d_cache->blocks[i].data[j]));
+    if (sim->d_assoc) assoc_cache_flush(sim, sim->d_assoc);
+    for (uint32_t i = 0; sim->d_cache && i < sim->d_cache->num_blocks; i++) {
+        if (sim->d_cache->blocks[i].dirty) {
+            for (uint32_t j = 0; j < sim->d_cache->block_size; j++) {
+                address = (sim->d_cache->blocks[i].tag << (2 + sim->d_cache->index_size + sim->d_cache->inner_index_size)) | (i << (2 + sim->d_cache->inner_index_size)) | (j << 2);
+                eprintf("\tWriting 0x%08x (0d%d) to 0x%08x\n", sim->d_cache->blocks[i].data[j], sim->d_cache->blocks[i].data[j], address);
+                mem_write_w(sim, address, &(sim->d_cache->blocks[i].data[j]));
             }
         }
     }
     eprintf("Flushing write buffer...\n");
-    while (write_buffer->writing) {
-        set_mem_status(MEM_WRITING);
-        write_buffer_digest();
+    while (sim->write_buffer->writing) {
+        set_mem_status(sim, MEM_WRITING);
+        write_buffer_digest(sim);
     }
 }
 
-void print_icache(int block) {
-    direct_cache_print_block(i_cache, block);
+// block is a set of a set associative cache
+void print_icache(sim_t *sim, int block) {
+    if (sim->cache_cfg.mode == CACHE_UNIFIED) print_dcache(sim, block);
+    else if (sim->i_assoc) assoc_cache_print_set(sim->i_assoc, block);
+    else direct_cache_print_block(sim->i_cache, block);
 }
-void dump_dcache(void) {
-    for (uint32_t i = 0; i < d_cache->num_blocks; i++) {
-        print_dcache(i);
+void dump_dcache(sim_t *sim) {
+    uint32_t blocks = sim->d_assoc ? sim->d_assoc->num_sets : sim->d_cache->num_blocks;
+    for (uint32_t i = 0; i < blocks; i++) {
+        print_dcache(sim, i);
     }
 }
-void print_dcache(int block) {
-    direct_cache_print_block(d_cache, block);
+void print_dcache(sim_t *sim, int block) {
+    if (sim->d_assoc) assoc_cache_print_set(sim->d_assoc, block);
+    else direct_cache_print_block(sim->d_cache, block);
 }
 
-void print_write_buffer(void) {
-    if (write_buffer == NULL) {
+void print_write_buffer(sim_t *sim) {
+    if (sim->write_buffer == NULL) {
         cprintf(ANSI_C_RED, "write_buffer_enqueue: buffer is not initialized\n", NULL);
         assert(0);
     }
-    eprintf("Writing: %d, Penalty Count: %d, Subsequent Writing: %d\n", write_buffer->writing, write_buffer->penalty_count, write_buffer->subsequent_writing);
-    eprintf("Address: 0x%08x\n", write_buffer->address);
-    eprintf("Data: \t0x%08x\n", write_buffer->data[0]);
-    for (uint32_t i = 1; i < d_cache->block_size; i++) {
-        printf("\t0x%08x\n", write_buffer->data[i]);
+    write_buffer_t *wb = sim->write_buffer;
+    eprintf("Entries: %d of %d, Writing: %d, Penalty Count: %d, Subsequent Writing: %d\n", wb->count, wb->size, wb->writing, wb->penalty_count, wb->subsequent_writing);
+    eprintf("Address: 0x%08x\n", wb->address);
+    for (uint32_t i = 0; i < wb->count; i++) {
+        write_buffer_entry_t *entry = write_buffer_entry(wb, i);
+        eprintf("Block 0x%08x:", entry->address);
+        for (uint32_t j = 0; j < wb->block_size; j++) {
+            if (entry->pending[j]) eprintf(" 0x%08x", entry->data[j]);
+            else eprintf(" ----------");
+        }
+        eprintf("\n");
     }
 }
@@ -13,6 +13,12 @@
 #include "types.h"
 #include "main_memory.h"
 #include "direct.h"
+#include "assoc.h"
+#include "mshr.h"
+#include "l2.h"
+#include "dram.h"
+#include "bus.h"
+#include "prefetch.h"
 
 // Write to main memory penalty for first block written
 #define CACHE_WRITE_PENALTY 6
@@ -20,43 +26,147 @@
 #define CACHE_WRITE_SUBSEQUENT_PENALTY 2
 // Write policy for the cache (EXACTLY ONE MUST BE DEFINED)
 
-memory_status_t get_mem_status(void);
-void set_mem_status(memory_status_t status);
+memory_status_t get_mem_status(sim_t *sim);
+void set_mem_status(sim_t *sim, memory_status_t status);
 
-void cache_init(cache_config_t *cache_cfg);
-void cache_destroy(void);
-void cache_digest(void);
+void cache_init(sim_t *sim);
+void cache_destroy(sim_t *sim);
+void cache_digest(sim_t *sim);
+
+/* Next-event support. cache_event() is called whenever the state of the memory
+ * system changes (a fill is queued or a word arrives, the write buffer is
+ * filled or drains, the memory status changes), and cache_get_events() counts
+ * those calls. While nothing changes, the only thing cache_digest() does is
+ * advance the active penalty counter: cache_cycles_to_event() returns how many
+ * more digests will do nothing else, and cache_skip() applies that many at once.
+ */
+void cache_event(sim_t *sim);
+uint32_t cache_get_events(sim_t *sim);
+uint32_t cache_cycles_to_event(sim_t *sim);
+void cache_skip(sim_t *sim, uint32_t cycles);
+
+cache_status_t d_cache_read_w(sim_t *sim, uint32_t *address, word_t *data);
+cache_status_t d_cache_write_w(sim_t *sim, uint32_t *address, word_t *data);
+// For the MSHRs: look up a word without side effects, and start a fill
+bool d_cache_probe_w(sim_t *sim, uint32_t address, word_t *data);
+void d_cache_request(sim_t *sim, uint32_t address);
+/* For the prefetchers, on the I (inst) or D cache, which in unified mode
+ * are the same: whether the cache has every word of the block of address,
+ * whether it is fetching that block, and starting a fill of the block.
+ * cache_request_block() returns false if the fill could not start. */
+bool cache_holds_block(sim_t *sim, bool inst, uint32_t address);
+bool cache_fetching_block(sim_t *sim, bool inst, uint32_t address);
+bool cache_request_block(sim_t *sim, bool inst, uint32_t address);
+/* For an inclusive L2: drop the bytes at address from the I and D caches
+ * (and their victim caches), sending dirty blocks to the write buffer, or
+ * only dropping them when warming. A block in a line a fill is using, or a
+ * dirty one the write buffer has no room for, stays. Returns the number of
+ * first level blocks dropped. */
+uint32_t cache_back_invalidate(sim_t *sim, uint32_t address, uint32_t bytes, bool warm);
+/* True if the D cache holds the block of address in the line a fill under
+ * way is replacing, in writeback mode. A store to it would be lost with the
+ * block, since the copy for the write buffer was taken when the fill began. */
+bool d_cache_replacing(sim_t *sim, uint32_t address);
+// True if the D cache has the block of address, or is fetching it
+bool d_cache_has_block(sim_t *sim, uint32_t address);
+/* No-write-allocate: store the bytes of data that mask selects at address
+ * straight into the write buffer, leaving the D cache alone. The other bytes
+ * of the word are the ones memory and the write buffer hold, as if the
+ * buffer kept a byte mask. Returns CACHE_PENDING, or CACHE_MISS if the
+ * buffer has no room. */
+cache_status_t d_cache_write_around(sim_t *sim, uint32_t address, word_t data, word_t mask);
+// True if nothing in the memory system is busy or waiting to be
+bool cache_idle(sim_t *sim);
 
-cache_status_t d_cache_read_w(uint32_t *address, word_t *data);
-cache_status_t d_cache_write_w(uint32_t *address, word_t *data);
 
+void d_cache_init(sim_t *sim, cache_config_t *cache_cfg);
+void i_cache_init(sim_t *sim, cache_config_t *cache_cfg);
+// A unified cache is the D cache, and the I port reads it too
+void u_cache_init(sim_t *sim, cache_config_t *cache_cfg);
+cache_status_t i_cache_read_w(sim_t *sim, uint32_t *address, word_t *data);
+cache_status_t i_cache_write_w(sim_t *sim, uint32_t *address, word_t *data);
 
-void d_cache_init(cache_config_t *cache_cfg);
-void i_cache_init(cache_config_t *cache_cfg);
-cache_status_t i_cache_read_w(uint32_t *address, word_t *data);
-cache_status_t i_cache_write_w(uint32_t *address, word_t *data);
+// Install blocks without timing, for warming up the caches while fast-forwarding
+void d_cache_warm(sim_t *sim, uint32_t address, bool write);
+void i_cache_warm(sim_t *sim, uint32_t address);
+
+/* The last access of one port of a unified cache. While the pipeline is
+ * frozen it retries both its accesses every cycle, and with one cache for
+ * both a fill for one port can replace the block the other already hit, so
+ * that each would evict the other's block forever. A port that has hit holds
+ * its word (and a store holds its completion) the way the pipeline register
+ * would, and its retries do not touch the cache again.
+ */
+typedef struct CACHE_LATCH {
+    bool        valid;      // the read of address hit, data is its word
+    bool        stored;     // the store to address hit
+    uint32_t    address;
+    word_t      data;
+} cache_latch_t;
+
+/* The write buffer is a FIFO of entries, each holding the words of one D
+ * cache block that still have to go to memory: a written back block, or the
+ * stores of a write-through cache. It drains in the background, one entry at
+ * a time, whenever the memory is not busy with a fill (MEM_WRITING), and the
+ * words of an entry are written back to back (CACHE_WRITE_PENALTY for the
+ * first, CACHE_WRITE_SUBSEQUENT_PENALTY for each one after it).
+ *
+ * The oldest entry is the one on its way to memory. It takes no more writes,
+ * and a fill of its block waits until it is written. A write to the block of
+ * any later entry is merged into it, and a fill picks up the words those
+ * entries hold (see write_buffer_forward()). A write that finds no entry to
+ * merge into and every entry in use waits, stalling the pipeline.
+ */
+typedef struct WRITE_BUFFER_ENTRY {
+    uint32_t address;   // first byte of the block
+    word_t *data;
+    bool *pending;      // the words still to be written
+} write_buffer_entry_t;
 
 typedef struct WRITE_BUFFER {
-    uint32_t address;
-    bool writing;
+    uint32_t size;              // number of entries
+    uint32_t block_size;        // words per entry
+    write_buffer_entry_t *entries;
+    uint32_t head;              // the oldest entry
+    uint32_t count;             // entries in use
+    //Writing the oldest entry
+    bool writing;               // count != 0
+    uint32_t address;           // of the word being written
     uint32_t penalty_count;
-    uint32_t subsequent_writing;
-    word_t *data;
+    uint32_t penalty;           // cycles for the first word of the entry
+    uint32_t subsequent_penalty; // and for each word after it
+    uint32_t subsequent_writing; // words of the entry already written
+    bool to_memory;             // the entry still has to add the memory time
+    //A write had to wait for a free entry this cycle
+    bool full;
 } write_buffer_t;
 
-write_buffer_t *write_buffer_init(void);
+write_buffer_t *write_buffer_init(uint32_t entries, uint32_t block_size);
 void write_buffer_destroy(write_buffer_t *wb);
-void write_buffer_digest(void);
-cache_status_t write_buffer_get_status(void);
-cache_status_t write_buffer_enqueue(cache_access_t info);
-uint32_t write_buffer_get_address(void);
-cache_wpolicy_t get_write_policy(void);
+void write_buffer_digest(sim_t *sim);
+// CACHE_MISS if every entry is in use
+cache_status_t write_buffer_get_status(sim_t *sim);
+// True while there is anything left to write
+bool write_buffer_writing(sim_t *sim);
+/* Queue a written back block (the whole line info.index/info.way of the D
+ * cache) or a write-through store (info.data to info.address). Returns
+ * CACHE_MISS, queueing nothing, if it has to wait. */
+cache_status_t write_buffer_enqueue(sim_t *sim, cache_access_t info);
+/* Queue the word data at address on its own, for a store that is not in the
+ * D cache. Returns CACHE_MISS, queueing nothing, if it has to wait. */
+cache_status_t write_buffer_enqueue_word(sim_t *sim, uint32_t address, word_t data);
+// The address being written to memory, 0xffffffff if the buffer is empty
+uint32_t write_buffer_get_address(sim_t *sim);
+/* If the buffer holds the word at address, copy the newest value of it into
+ * data and return true. A fill overlays what it read from memory with this. */
+bool write_buffer_forward(sim_t *sim, uint32_t address, word_t *data);
+cache_wpolicy_t get_write_policy(sim_t *sim);
 
 /* Debugging stuff */
-void print_icache(int block);
-void print_dcache(int block);
-void dump_dcache(void);
-void print_write_buffer(void);
-void flush_dcache(void);
+void print_icache(sim_t *sim, int block);
+void print_dcache(sim_t *sim, int block);
+void dump_dcache(sim_t *sim);
+void print_write_buffer(sim_t *sim);
+void flush_dcache(sim_t *sim);
 
 #endif /*_CACHE_H*/
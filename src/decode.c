@@ -6,10 +6,99 @@
 
 extern int flags; // from util.c
 
-int decode(control_t *ifid , control_t *idex) {
+int decode(sim_t *sim, control_t *ifid, control_t *idex) {
 
     copy_pipeline_register(ifid, idex);
 
+    // Set the control bits, from the predecoded template if there is one
+    predecode_entry_t *entry = predecode_lookup(sim, ifid->pcNext - 4, ifid->instr);
+    if (entry) {
+        predecode_apply_decode(entry, idex);
+    } else {
+        switch (decode_control(idex)) {
+            case 0:
+                break;
+            case DECODE_ILLEGAL_RTYPE:
+                cprintf(ANSI_C_RED, "Illegal R-type instruction, funct 0x%02x (instruction 0x%08x). Halting.\n", idex->funct, idex->instr);
+                assert(0);
+                break; // never reached
+            case DECODE_ILLEGAL_SPECIAL3:
+                cprintf(ANSI_C_RED, "Illegal SPECIAL3-type instruction, funct (special3) 0x%02x, shamt (BSHFL) 0x%02x (instruction 0x%08x). Halting.\n",
+                    idex->funct, idex->shamt, idex->instr);
+                assert(0);
+                break; // never reached
+            default:
+                cprintf(ANSI_C_RED, "Illegal instruction, opcode 0x%02x (instruction 0x%08x). Halting.\n",
+                    idex->opCode, idex->instr);
+                assert(0);
+                break; // never reached
+        }
+    }
+
+    // Set register values for input to the ALU
+    reg_read(sim, (int)(idex->regRs), &(idex->regRsValue));
+    reg_read(sim, (int)(idex->regRt), &(idex->regRtValue));
+    // Load ALUresult so that ALUresult can remain "unmodified" for MOVZ/MOVN
+    // This is needed if a MOVZ/MOVN result needs to be forwarded
+    reg_read(sim, (int)(idex->regRd), &(idex->ALUresult));
+
+    // Jump address calculation
+    idex->address = (idex->address << 2);// Word aligned
+    // Don't think i need to bitmask the address since in theory it shouldn't be
+    //"signed"
+    if (idex->jump && (idex->opCode != OPC_RTYPE)) {
+        // RA value goes into ALU, gets added to zero to set RA (for JAL)
+        idex->regRtValue = idex->pcNext + 4;
+        // Update pcNext with jump address
+        idex->pcNext = ( idex->pcNext & 0xF0000000 ) | idex->address;
+    } else if (idex->jump && (idex->opCode == OPC_RTYPE)) {
+        // This is a jr instruction, pc comes from rs
+        idex->pcNext = idex->regRsValue;
+    } else {
+        // Branch determination in ID phase, dont want to overwrite jump
+        idex->pcNext = idex->pcNext + (idex->immed << 2);
+    }
+    if (idex->opCode == OPC_BEQ) {
+        if (idex->regRsValue == idex->regRtValue) {
+            idex->PCSrc = true; // Branch is taken, use pcNext for address
+        } else {
+            idex->PCSrc = false; // Branch not taken
+        }
+    } else if (idex->opCode == OPC_BNE){
+        if (idex->regRsValue != idex->regRtValue) {
+            idex->PCSrc = true;  // Branch taken
+        } else {
+            idex->PCSrc = false; // Branch not taken
+        }
+    } else if (idex->opCode == OPC_BLTZ) {
+        if ((int)idex->regRsValue < 0) {
+            idex->PCSrc = true;
+        } else {
+            idex->PCSrc = false;
+        }
+    } else if (idex->opCode == OPC_BGTZ) {
+        if ((int)idex->regRsValue > 0) {
+            idex->PCSrc = true;
+        } else {
+            idex->PCSrc = false;
+        }
+    } else if (idex->opCode == OPC_BLEZ) {
+        if ((int)idex->regRsValue <= 0) {
+            idex->PCSrc = true;
+        } else {
+            idex->PCSrc = false;
+        }
+    }
+
+    if(flags & MASK_DEBUG){
+        cprintf(ANSI_C_CYAN, "DECODE: \n");
+        print_pipeline_register(idex);
+    }
+    return 0;
+}
+
+// Set the control bits and ALU operation from the opcode/funct fields
+int decode_control(control_t *idex) {
     switch(idex->opCode){
         case OPC_RTYPE:
             idex->regDst = true;
@@ -70,8 +159,7 @@ int decode(control_t *ifid , control_t *idex) {
                     idex->ALUop = OPR_XOR;
                     break;
                 default:
-                    cprintf(ANSI_C_RED, "Illegal R-type instruction, funct 0x%02x (instruction 0x%08x). Halting.\n", idex->funct, idex->instr);
-                    assert(0);
+                    return DECODE_ILLEGAL_RTYPE;
             }
             break;
         case OPC_LW:
@@ -199,84 +287,15 @@ int decode(control_t *ifid , control_t *idex) {
                             idex->ALUop = OPR_SEH;
                             break;
                         default:
-                            cprintf(ANSI_C_RED, "Illegal SPECIAL3-type instruction, funct (special3) 0x%02x, shamt (BSHFL) 0x%02x (instruction 0x%08x). Halting.\n",
-                                idex->funct, idex->shamt, idex->instr);
-                            assert(0);
-                            break; // never reached
+                            return DECODE_ILLEGAL_SPECIAL3;
                     }
                     break;
                 default:
-                    cprintf(ANSI_C_RED, "Illegal SPECIAL3-type instruction, funct (special3) 0x%02x, shamt (BSHFL) 0x%02x (instruction 0x%08x). Halting.\n",
-                        idex->funct, idex->shamt, idex->instr);
-                    assert(0);
-                    break; // never reached
+                    return DECODE_ILLEGAL_SPECIAL3;
             }
             break;
         default:
-            cprintf(ANSI_C_RED, "Illegal instruction, opcode 0x%02x (instruction 0x%08x). Halting.\n",
-                idex->opCode, idex->instr);
-            assert(0);
-            break; // never reached
-    }
-
-    // Set register values for input to the ALU
-    reg_read((int)(idex->regRs), &(idex->regRsValue));
-    reg_read((int)(idex->regRt), &(idex->regRtValue));
-    // Load ALUresult so that ALUresult can remain "unmodified" for MOVZ/MOVN
-    // This is needed if a MOVZ/MOVN result needs to be forwarded
-    reg_read((int)(idex->regRd), &(idex->ALUresult));
-
-    // Jump address calculation
-    idex->address = (idex->address << 2);// Word aligned
-    // Don't think i need to bitmask the address since in theory it shouldn't be
-    //"signed"
-    if (idex->jump && (idex->opCode != OPC_RTYPE)) {
-        // RA value goes into ALU, gets added to zero to set RA (for JAL)
-        idex->regRtValue = idex->pcNext + 4;
-        // Update pcNext with jump address
-        idex->pcNext = ( idex->pcNext & 0xF0000000 ) | idex->address;
-    } else if (idex->jump && (idex->opCode == OPC_RTYPE)) {
-        // This is a jr instruction, pc comes from rs
-        idex->pcNext = idex->regRsValue;
-    } else {
-        // Branch determination in ID phase, dont want to overwrite jump
-        idex->pcNext = idex->pcNext + (idex->immed << 2);
-    }
-    if (idex->opCode == OPC_BEQ) {
-        if (idex->regRsValue == idex->regRtValue) {
-            idex->PCSrc = true; // Branch is taken, use pcNext for address
-        } else {
-            idex->PCSrc = false; // Branch not taken
-        }
-    } else if (idex->opCode == OPC_BNE){
-        if (idex->regRsValue != idex->regRtValue) {
-            idex->PCSrc = true;  // Branch taken
-        } else {
-            idex->PCSrc = false; // Branch not taken
-        }
-    } else if (idex->opCode == OPC_BLTZ) {
-        if ((int)idex->regRsValue < 0) {
-            idex->PCSrc = true;
-        } else {
-            idex->PCSrc = false;
-        }
-    } else if (idex->opCode == OPC_BGTZ) {
-        if ((int)idex->regRsValue > 0) {
-            idex->PCSrc = true;
-        } else {
-            idex->PCSrc = false;
-        }
-    } else if (idex->opCode == OPC_BLEZ) {
-        if ((int)idex->regRsValue <= 0) {
-            idex->PCSrc = true;
-        } else {
-            idex->PCSrc = false;
-        }
-    }
-
-    if(flags & MASK_DEBUG){
-        cprintf(ANSI_C_CYAN, "DECODE: \n");
-        print_pipeline_register(idex);
+            return DECODE_ILLEGAL_OPCODE;
     }
     return 0;
 }
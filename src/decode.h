@@ -11,8 +11,21 @@
 #include "types.h"
 #include "util.h"
 #include "registers.h"
+#include "predecode.h"
 
-int decode(control_t *ifid, control_t *idex);
+int decode(sim_t *sim, control_t *ifid, control_t *idex);
+
+/* decode_control() sets the control bits and ALU operation of a pipeline
+ * register from its opcode/funct/shamt fields, without touching the register
+ * file. Returns 0 on success, or one of the values below for an illegal
+ * instruction. Used by decode() and to build predecoded templates.
+ */
+int decode_control(control_t *idex);
+
+// decode_control() signalling return values
+#define DECODE_ILLEGAL_OPCODE   1
+#define DECODE_ILLEGAL_RTYPE    2
+#define DECODE_ILLEGAL_SPECIAL3 3
 
 // Helper functions
 void setidexImmedArithmetic(control_t *idex);
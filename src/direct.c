@@ -7,7 +7,7 @@
 
 extern int flags; // from util.c
 
-direct_cache_t * direct_cache_init(uint32_t num_blocks, uint32_t block_size){
+direct_cache_t * direct_cache_init(uint32_t num_blocks, uint32_t block_size, cache_fill_t fill_order){
     //The linear memory that the cache blocks point to
     word_t *words = (word_t *)malloc(sizeof(word_t)*num_blocks*block_size);
     //The cache struct itself
@@ -65,6 +65,12 @@ direct_cache_t * direct_cache_init(uint32_t num_blocks, uint32_t block_size){
     cache->fetching = false;
     cache->penalty_count = 0;
     cache->subsequent_fetching = 0;
+    cache->fill_order = fill_order;
+    cache->fill_word = 0;
+    cache->miss_penalty = CACHE_MISS_PENALTY;
+    cache->subsequent_penalty = CACHE_MISS_SUBSEQUENT_PENALTY;
+    cache->to_memory = false;
+    cache->victims = NULL;
 
     //Invalidate all data in the cache
     uint8_t j;
@@ -79,51 +85,69 @@ direct_cache_t * direct_cache_init(uint32_t num_blocks, uint32_t block_size){
 
 void direct_cache_free(direct_cache_t *cache){
 
+    if(cache->victims) victim_free(cache->victims);
     free(cache->words);
     free(cache->blocks);
     free(cache);
 }
 
 
-void direct_cache_digest(direct_cache_t *cache, memory_status_t proceed_condition){
+void direct_cache_digest(sim_t *sim, direct_cache_t *cache, memory_status_t proceed_condition){
     cache_access_t info;
     direct_cache_get_tag_and_index(&info, cache, &(cache->target_address));
-    if(get_mem_status() == proceed_condition){
+    bool granted = (get_mem_status(sim) == proceed_condition);
+    //A split bus lets the wait for the first word go on without it
+    bool overlapping = !granted && cache->fetching && !cache->subsequent_fetching && bus_split(sim);
+    if((granted || overlapping) && cache->to_memory){
+        //Memory has the request, so the DRAM knows how long the fill takes
+        uint32_t first;
+        dram_timing(sim, cache->target_address, false, &first, &cache->subsequent_penalty);
+        cache->miss_penalty += first;
+        cache->to_memory = false;
+    }
+    if(overlapping) bus_overlap(&cache->penalty_count, cache->miss_penalty);
+    if(granted){
         //Increment the wait count
         cache->penalty_count++;
         if(flags & MASK_DEBUG){
             printf("\tdirect_cache_digest: Value of incremented penalty_count %d, pending address: 0x%08x\n",cache->penalty_count, cache->target_address);
         }
-        if(cache->penalty_count == CACHE_MISS_PENALTY){
+        if(!cache->subsequent_fetching && cache->penalty_count == cache->miss_penalty){
+            cache_event(sim);
             //Finished waiting, get data and return it
             if(flags & MASK_DEBUG){
                 printf("\tdirect_cache_digest: Reached stall count retreiveing data.\n");
             }
-            mem_read_w(cache->target_address, &info.data);
+            mem_read_w(sim, cache->target_address, &info.data);
+            write_buffer_forward(sim, cache->target_address, &info.data);
             cache->blocks[info.index].data[info.inner_index] = info.data;
             cache->blocks[info.index].tag = info.tag;
             cache->blocks[info.index].valid[info.inner_index] = true;
             //Invalidate the rest of the data in the cache since the tag changed
-            for(uint8_t i = 1; i < cache->block_size; i++){
-                cache->blocks[info.index].valid[i] = false;
+            for(uint8_t i = 0; i < cache->block_size; i++){
+                if(i != info.inner_index) cache->blocks[info.index].valid[i] = false;
             }
             cache->blocks[info.index].dirty = false;
             cache->fetching = false;
             cache->penalty_count = 0;
+            cache->fill_word = info.inner_index;
             if(cache->subsequent_fetching != (cache->block_size - 1)){
                 //get the second word in the block
-                info.address |= (1 << 2);
+                info.address &= ~(cache->inner_index_mask);
+                info.address |= ((cache->fill_word + 1) & (cache->block_size - 1)) << 2;
                 cache->subsequent_fetching = 1;
-                direct_cache_queue_mem_access(cache, info);
+                direct_cache_queue_mem_access(sim, cache, info);
             } else {
                 //Were done, relenquish memory
-                set_mem_status(MEM_IDLE);
+                set_mem_status(sim, MEM_IDLE);
             }
             return;
         }
-        if(cache->subsequent_fetching && (cache->penalty_count == CACHE_MISS_SUBSEQUENT_PENALTY)){
+        if(cache->subsequent_fetching && (cache->penalty_count == cache->subsequent_penalty)){
+            cache_event(sim);
             //Have the next word for the block
-            mem_read_w(cache->target_address, &info.data);
+            mem_read_w(sim, cache->target_address, &info.data);
+            write_buffer_forward(sim, cache->target_address, &info.data);
             cache->blocks[info.index].data[info.inner_index] = info.data;
             cache->blocks[info.index].tag = info.tag;
             cache->blocks[info.index].valid[info.inner_index] = true;
@@ -133,11 +157,11 @@ void direct_cache_digest(direct_cache_t *cache, memory_status_t proceed_conditio
                 //get the next word for the block
                 cache->subsequent_fetching++;
                 info.address &= ~(cache->inner_index_mask);
-                info.address |= (cache->subsequent_fetching << 2);
-                direct_cache_queue_mem_access(cache, info);
+                info.address |= ((cache->fill_word + cache->subsequent_fetching) & (cache->block_size - 1)) << 2;
+                direct_cache_queue_mem_access(sim, cache, info);
             } else if(cache->subsequent_fetching == (cache->block_size - 1)){
                 cache->subsequent_fetching = 0;
-                set_mem_status(MEM_IDLE);
+                set_mem_status(sim, MEM_IDLE);
             }
             return;
         }
@@ -146,7 +170,7 @@ void direct_cache_digest(direct_cache_t *cache, memory_status_t proceed_conditio
 }
 
 
-cache_status_t direct_cache_read_w(direct_cache_t *cache, uint32_t *address, uint32_t *data){
+cache_status_t direct_cache_read_w(sim_t *sim, direct_cache_t *cache, uint32_t *address, uint32_t *data){
     cache_access_t info;
     cache_status_t status;
     direct_cache_get_tag_and_index(&info, cache, address);
@@ -188,7 +212,7 @@ cache_status_t direct_cache_read_w(direct_cache_t *cache, uint32_t *address, uin
             if(flags & MASK_DEBUG){
                 printf("\tdirect_cache_read_w: CACHE_MISS, data is not in the cache. Queueing read\n");
             }
-            if(cache->blocks[info.index].dirty && (get_write_policy() == CACHE_WRITEBACK)){
+            if(cache->blocks[info.index].dirty && (get_write_policy(sim) == CACHE_WRITEBACK)){
                 if(flags & MASK_DEBUG){
                     printf("\tdirect_cache_read_w: data in block is dirty. Queueing write.\n");
                 }
@@ -196,7 +220,7 @@ cache_status_t direct_cache_read_w(direct_cache_t *cache, uint32_t *address, uin
                 uint32_t write_address = (cache->blocks[info.index].tag << (2 + cache->index_size + cache->inner_index_size)) | (info.index << (2 + cache->inner_index_size)) | (info.inner_index << 2);
                 gprintf("\tdirect_cache_read_w:calculated write_address: 0x%08x\n", write_address);
                 direct_cache_get_tag_and_index(&write_info, cache, &write_address);
-                status = write_buffer_enqueue(write_info);
+                status = write_buffer_enqueue(sim, write_info);
                 if(status == CACHE_MISS){
                     if(flags & MASK_DEBUG){
                         printf("\tdirect_cache_read_w: write buffer is full. \n");
@@ -204,41 +228,42 @@ cache_status_t direct_cache_read_w(direct_cache_t *cache, uint32_t *address, uin
                     return status;
                 }
             }
-            direct_cache_queue_mem_access(cache, info);
+            direct_cache_queue_mem_access(sim, cache, info);
         }
         return CACHE_MISS;
     }
 
 }
 
-cache_status_t direct_cache_write_w(direct_cache_t *cache, uint32_t *address, uint32_t *data){
+cache_status_t direct_cache_write_w(sim_t *sim, direct_cache_t *cache, uint32_t *address, uint32_t *data){
     cache_access_t info;
     cache_status_t status;
     direct_cache_get_tag_and_index(&info, cache, address);
     info.data = *data;
     if(cache->blocks[info.index].valid[info.inner_index] == true && cache->blocks[info.index].tag == info.tag){
-        if (get_write_policy() == CACHE_WRITETHROUGH){
-            status = write_buffer_get_status();
+        if (get_write_policy(sim) == CACHE_WRITETHROUGH){
+            for(uint32_t i = 0; i < cache->block_size; i++){
+                if(cache->blocks[info.index].valid[i] == false){
+                    gprintf("\tWhole block isnt valid yet...\n");
+                    return CACHE_MISS;
+                }
+            }
+            status = write_buffer_enqueue(sim, info);
             if(status == CACHE_MISS){
                 if(flags & MASK_DEBUG){
                     printf("\tdirect_cache_write_w: Write buffer is full. Cannot fill cache without losing data.\n");
                 }
                 //The write buffer is full! Don't fill the block
                 return CACHE_MISS;
-            } else {
-                for(uint32_t i = 0; i < cache->block_size; i++){
-                    if(cache->blocks[info.index].valid[i] == false){
-                        gprintf("\tWhole block isnt valid yet...\n");
-                        return CACHE_MISS;
-                    }
-                }
-                cache->blocks[info.index].data[info.inner_index] = *data;
-                cache->blocks[info.index].tag = info.tag;
-                write_buffer_enqueue(info);
-                return CACHE_HIT;
             }
+            cache->blocks[info.index].data[info.inner_index] = *data;
+            cache->blocks[info.index].tag = info.tag;
+            return CACHE_HIT;
         }
         status = CACHE_HIT;
+        if(cache->blocks[info.index].data[info.inner_index] != *data || !cache->blocks[info.index].dirty){
+            cache_event(sim);
+        }
         cache->blocks[info.index].data[info.inner_index] = *data;
         cache->blocks[info.index].tag = info.tag;
         cache->blocks[info.index].dirty = true;
@@ -257,12 +282,26 @@ cache_status_t direct_cache_write_w(direct_cache_t *cache, uint32_t *address, ui
 
 
 
-void direct_cache_queue_mem_access(direct_cache_t *cache, cache_access_t info){
+bool direct_cache_leaving(direct_cache_t *cache, uint32_t address){
+    cache_access_t info, target;
+    if(!cache->fetching) return false;
+    direct_cache_get_tag_and_index(&info, cache, &address);
+    direct_cache_get_tag_and_index(&target, cache, &cache->target_address);
+    return info.index == target.index && info.tag != target.tag &&
+        cache->blocks[info.index].tag == info.tag;
+}
+
+void direct_cache_queue_mem_access(sim_t *sim, direct_cache_t *cache, cache_access_t info){
     if(flags & MASK_DEBUG){
         printf("\tdirect_cache_queue_mem_access: Queueing memory access for address 0x%08x\n", info.address);
     }
+    cache_event(sim);
     cache->fetching = true;
-    if(cache->subsequent_fetching == 0){
+    if(cache->subsequent_fetching == 0 && cache->fill_order == CACHE_FILL_CRITICAL){
+        //Get the word that missed first
+        cache->target_address = info.address & ~0x3;
+    }
+    else if(cache->subsequent_fetching == 0){
         //We must get the first word in a block first
         cache->target_address = info.address & (cache->tag_mask | cache->index_mask);
     }
@@ -270,13 +309,26 @@ void direct_cache_queue_mem_access(direct_cache_t *cache, cache_access_t info){
         cache->target_address = info.address;
     }
     cache->penalty_count = 0;
-    if(write_buffer_get_status() == CACHE_MISS){
-        //There is data to be written to in the write buffer
-        uint32_t wb_address = write_buffer_get_address();
+    if(cache->subsequent_fetching == 0){
+        //A new fill. The victim cache or the second level decides how long
+        //its words take.
+        direct_cache_block_t *block = &(cache->blocks[info.index]);
+        bool replacing = false;
+        for(uint32_t i = 0; i < cache->block_size; i++){
+            replacing = replacing || block->valid[i];
+        }
+        replacing = replacing && block->tag != info.tag;
+        uint32_t victim = (block->tag << (2 + cache->index_size + cache->inner_index_size)) | (info.index << (2 + cache->inner_index_size));
+        cache->to_memory = victim_fill(sim, cache->victims, info.address & (cache->tag_mask | cache->index_mask), replacing, victim,
+            &cache->miss_penalty, &cache->subsequent_penalty);
+    }
+    if(write_buffer_writing(sim)){
+        //There is data to be written to memory from the write buffer
+        uint32_t wb_address = write_buffer_get_address(sim);
         if((wb_address & (cache->tag_mask | cache->index_mask)) == (info.address & (cache->tag_mask | cache->index_mask))){
-            //The data in the write buffer need to be written to memory before we can read it
+            //The block on its way to memory has to get there before we can read it
             gprintf("\tdirect_cache_queue_mem_access: Data in the write buffer matches the requested address.\n");
-            set_mem_status(MEM_WRITING);
+            set_mem_status(sim, MEM_WRITING);
         }
     }
     if(flags & MASK_DEBUG && cache->block_size > 1){
@@ -284,6 +336,46 @@ void direct_cache_queue_mem_access(direct_cache_t *cache, cache_access_t info){
     }
 }
 
+void direct_cache_warm(sim_t *sim, direct_cache_t *cache, uint32_t address, bool write){
+    cache_access_t info;
+    direct_cache_get_tag_and_index(&info, cache, &address);
+    direct_cache_block_t *block = &(cache->blocks[info.index]);
+    bool present = (block->tag == info.tag);
+    for(uint32_t i = 0; i < cache->block_size; i++){
+        present = present && block->valid[i];
+    }
+    if(!present){
+        //Replace the whole block. Anything dirty in it is already in memory,
+        //since the functional model writes memory directly.
+        uint32_t base = address & (cache->tag_mask | cache->index_mask);
+        bool replacing = false;
+        for(uint32_t i = 0; i < cache->block_size; i++){
+            replacing = replacing || block->valid[i];
+        }
+        replacing = replacing && block->tag != info.tag;
+        uint32_t victim = (block->tag << (2 + cache->index_size + cache->inner_index_size)) | (info.index << (2 + cache->inner_index_size));
+        victim_warm(cache->victims, base, replacing, victim);
+        for(uint32_t i = 0; i < cache->block_size; i++){
+            mem_read_w(sim, base | (i << 2), &(block->data[i]));
+            block->valid[i] = true;
+        }
+        block->tag = info.tag;
+        block->dirty = false;
+    } else if(write){
+        //Pick up the word that was just stored
+        mem_read_w(sim, address & ~0x3, &(block->data[info.inner_index]));
+    }
+    if(write && get_write_policy(sim) == CACHE_WRITEBACK){
+        block->dirty = true;
+    }
+}
+
+uint32_t direct_cache_cycles_to_event(direct_cache_t *cache){
+    uint32_t penalty = cache->subsequent_fetching ? cache->subsequent_penalty : cache->miss_penalty;
+    if(cache->penalty_count + 1 >= penalty) return 0;
+    return penalty - 1 - cache->penalty_count;
+}
+
 void direct_cache_get_tag_and_index(cache_access_t *info, direct_cache_t *cache, uint32_t *address){
     info->index = (*address & cache->index_mask) >> (2 + cache->inner_index_size);
     info->tag = (*address & cache->tag_mask) >> (2 + cache->index_size + cache->inner_index_size);
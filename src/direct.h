@@ -15,6 +15,7 @@
 #include "main_memory.h"
 #include "types.h"
 #include "cache.h"
+#include "victim.h"
 
 //Cache miss penalty
 #define CACHE_MISS_PENALTY 8
@@ -49,6 +50,16 @@ typedef struct DIRECT_CACHE {
     uint8_t subsequent_fetching;
     uint32_t penalty_count;
     uint32_t target_address;
+    //Which word of the block a fill starts with, and the one it started with
+    cache_fill_t fill_order;
+    uint32_t fill_word;
+    //Cycles for the first word of the fill and each one after it (see l2_fill())
+    uint32_t miss_penalty;
+    uint32_t subsequent_penalty;
+    //The fill still has to add the memory time (see dram_timing())
+    bool to_memory;
+    //The blocks it replaced last (see victim.h), or NULL
+    victim_cache_t *victims;
     direct_cache_block_t *blocks;
     word_t *words;
 } direct_cache_t;
@@ -57,12 +68,16 @@ typedef struct DIRECT_CACHE {
 
 
 /*
-* direct_cache_t * direct_cache_init(uint32_t num_blocks)
+* direct_cache_t * direct_cache_init(uint32_t num_blocks, uint32_t block_size, cache_fill_t fill_order)
 * Creates an instance of a direct mapped cache with the number
 * of blocks as a parameter. From the number of blocks we can determine
 * dynamically the tag size. This function also initializes all of the
 * blocks to have invalid data and sets up bitmasks to easily obtain
 * index and tags from an address.
+* A miss fetches the block a word at a time, from its first word or, with
+* CACHE_FILL_CRITICAL, from the word that missed, wrapping around to the
+* words before it. Either way every word is valid as soon as it arrives, so
+* the access that missed goes on (early restart) while the rest streams in.
 */
 /* Get the bit masks for the tag and index
 hopefully this example will make this look less like magic
@@ -75,12 +90,12 @@ index_mask =                1111 1111 1111 1111 1111 (index_mask - 1)
 tag_mask   = 1111 1111 1111 0000 0000 0000 0000 0000 (tag_mask = ~index_mask)
 index_mask =                1111 1111 1111 1111 1100 (index_mask & ~3)//helper functions do not call directly
 */
-direct_cache_t * direct_cache_init(uint32_t num_blocks, uint32_t block_size);
+direct_cache_t * direct_cache_init(uint32_t num_blocks, uint32_t block_size, cache_fill_t fill_order);
 
 void direct_cache_free(direct_cache_t *cache);
 
 /*
-* void direct_cache_digest(direct_cache_t *cache, memory_status_t proceed_condition)
+* void direct_cache_digest(sim_t *sim, direct_cache_t *cache, memory_status_t proceed_condition)
 * function to be called every cycle of the clock.
 * No advancement on stall counters will occur if the memory state does not
 * match the given proceed condition
@@ -88,14 +103,14 @@ void direct_cache_free(direct_cache_t *cache);
 * @params proceed_condition is a memory state to ensure a read doesn't proceed
 *         if there is another memory operation occuring
 */
-void direct_cache_digest(direct_cache_t *cache, memory_status_t proceed_condition);
+void direct_cache_digest(sim_t *sim, direct_cache_t *cache, memory_status_t proceed_condition);
 
 /* cache_status_t direct_cache_get_word(direct_cache_t *cache, uint32_t *address, uint32_t *data)
 * returns CACHE_HIT or CACHE_MISS depending on if the data is available in the cache
 * if there is a CACHE_MISS, function will set up the direct mapped cache to
 * start fetching the data from main memory.
 */
-cache_status_t direct_cache_read_w(direct_cache_t *cache, uint32_t *address, uint32_t *data);
+cache_status_t direct_cache_read_w(sim_t *sim, direct_cache_t *cache, uint32_t *address, uint32_t *data);
 
 /*  @brief Sets up a word to be written back to main memory
 *   If writeback, the dirty bit in the cache gets set and returns. Once the
@@ -104,13 +119,34 @@ cache_status_t direct_cache_read_w(direct_cache_t *cache, uint32_t *address, uin
 *   If the write buffer is full, this will return CACHE_MISS to inform the processor
 *   if needs to stall
 */
-cache_status_t direct_cache_write_w(direct_cache_t *cache, uint32_t *address, uint32_t *data);
+cache_status_t direct_cache_write_w(sim_t *sim, direct_cache_t *cache, uint32_t *address, uint32_t *data);
 
 void direct_cache_fill_word(direct_cache_t *cache, cache_access_t info);
 
 cache_status_t direct_cache_access_word(direct_cache_t *cache, cache_access_t *info);
 
-void direct_cache_queue_mem_access(direct_cache_t *cache, cache_access_t info);
+void direct_cache_queue_mem_access(sim_t *sim, direct_cache_t *cache, cache_access_t info);
+
+/* bool direct_cache_leaving(direct_cache_t *cache, uint32_t address)
+* True if the cache holds the block of address, and a fill under way is
+* replacing it.
+*/
+bool direct_cache_leaving(direct_cache_t *cache, uint32_t address);
+
+/* uint32_t direct_cache_cycles_to_event(direct_cache_t *cache)
+* Number of digests of an active fetch that will only increment the penalty
+* counter before the next word arrives.
+*/
+uint32_t direct_cache_cycles_to_event(direct_cache_t *cache);
+
+/* void direct_cache_warm(sim_t *sim, direct_cache_t *cache, uint32_t address, bool write)
+* Functionally installs the block containing address, as if it had been read
+* or written, without any miss penalty or memory traffic. Main memory must
+* already hold the current data (including the word being written), so the
+* block is loaded straight from it. Used to warm up the cache while
+* fast-forwarding.
+*/
+void direct_cache_warm(sim_t *sim, direct_cache_t *cache, uint32_t address, bool write);
 
 /* Helper functions specific to the direct mapped cache */
 void direct_cache_get_tag_and_index(cache_access_t *info, direct_cache_t *cache, uint32_t *address);
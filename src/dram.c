@@ -0,0 +1,138 @@
+/*
+* src/dram.c
+* Timing of main memory, as DRAM banks with open rows
+*/
+
+#include <string.h>
+#include "dram.h"
+#include "cache.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+dram_t * dram_init(dram_config_t *config){
+    dram_t *dram = (dram_t *)calloc(1, sizeof(dram_t));
+    if(dram == NULL){
+        cprintf(ANSI_C_RED, "dram_init: Unable to allocate the DRAM\n");
+        assert(0);
+    }
+    if(config->banks == 0 || config->banks > DRAM_MAX_BANKS){
+        cprintf(ANSI_C_RED, "dram_init: %d banks, must be 1 to %d\n", config->banks, DRAM_MAX_BANKS);
+        assert(0);
+    }
+    if(config->row_size < 4 || (config->row_size & (config->row_size - 1)) != 0){
+        cprintf(ANSI_C_RED, "dram_init: row size %d not a power of two of at least a word\n", config->row_size);
+        assert(0);
+    }
+    dram->config = *config;
+    return dram;
+}
+
+void dram_free(dram_t *dram){
+    free(dram);
+}
+
+// Parse value as a number of at least min into *out. Returns false if it is not one.
+static bool dram_read_number(const char *value, unsigned int min, unsigned int *out){
+    char *end;
+    long number = strtol(value, &end, 0);
+    if(*value == '\0' || *end != '\0' || number < (long)min) return false;
+    *out = (unsigned int)number;
+    return true;
+}
+
+bool dram_read_config(const char *path, dram_config_t *config){
+    FILE *file = fopen(path, "r");
+    if(file == NULL){
+        cprintf(ANSI_C_RED, "dram_read_config: Unable to open %s\n", path);
+        return false;
+    }
+    char line[256];
+    unsigned int number = 0;
+    bool ok = true;
+    while(ok && fgets(line, sizeof(line), file)){
+        number++;
+        char *comment = strchr(line, '#');
+        if(comment) *comment = '\0';
+        char key[64], value[64], extra[2];
+        int fields = sscanf(line, "%63s %63s %1s", key, value, extra);
+        if(fields <= 0) continue;
+        if(fields != 2){
+            ok = false;
+        } else if(strcmp(key, "banks") == 0){
+            ok = dram_read_number(value, 1, &config->banks) && config->banks <= DRAM_MAX_BANKS;
+        } else if(strcmp(key, "row-size") == 0){
+            ok = dram_read_number(value, 4, &config->row_size) && (config->row_size & (config->row_size - 1)) == 0;
+        } else if(strcmp(key, "t-cas") == 0){
+            ok = dram_read_number(value, 1, &config->t_cas);
+        } else if(strcmp(key, "t-rcd") == 0){
+            ok = dram_read_number(value, 0, &config->t_rcd);
+        } else if(strcmp(key, "t-rp") == 0){
+            ok = dram_read_number(value, 0, &config->t_rp);
+        } else if(strcmp(key, "t-burst") == 0){
+            ok = dram_read_number(value, 1, &config->t_burst);
+        } else if(strcmp(key, "page") == 0){
+            if(strcmp(value, "open") == 0) config->page = DRAM_OPEN_PAGE;
+            else if(strcmp(value, "closed") == 0) config->page = DRAM_CLOSED_PAGE;
+            else ok = false;
+        } else if(strcmp(key, "scheduling") == 0){
+            if(strcmp(value, "fcfs") == 0) config->scheduling = DRAM_FCFS;
+            else if(strcmp(value, "fr-fcfs") == 0) config->scheduling = DRAM_FR_FCFS;
+            else ok = false;
+        } else {
+            ok = false;
+        }
+    }
+    fclose(file);
+    if(!ok){
+        cprintf(ANSI_C_RED, "dram_read_config: %s line %d not understood\n", path, number);
+        return false;
+    }
+    config->enabled = true;
+    return true;
+}
+
+// The bank holding address, and the row of it within that bank
+static dram_bank_t *dram_locate(dram_t *dram, uint32_t address, uint32_t *row){
+    uint32_t n = address / dram->config.row_size;
+    *row = n / dram->config.banks;
+    return &dram->banks[n % dram->config.banks];
+}
+
+void dram_timing(sim_t *sim, uint32_t address, bool write, uint32_t *first, uint32_t *subsequent){
+    dram_t *dram = sim->dram;
+    if(dram == NULL){
+        *first = write ? CACHE_WRITE_PENALTY : CACHE_MISS_PENALTY;
+        *subsequent = bus_word_cycles(sim, write ? CACHE_WRITE_SUBSEQUENT_PENALTY : CACHE_MISS_SUBSEQUENT_PENALTY);
+        return;
+    }
+    dram_config_t *config = &dram->config;
+    uint32_t row;
+    dram_bank_t *bank = dram_locate(dram, address, &row);
+    if(bank->open && bank->row == row){
+        gprintf("\tdram_timing: row hit for 0x%08x\n", address);
+        *first = config->t_cas;
+        dram->row_hits++;
+    } else if(bank->open){
+        gprintf("\tdram_timing: row conflict for 0x%08x\n", address);
+        *first = config->t_rp + config->t_rcd + config->t_cas;
+        dram->row_conflicts++;
+    } else {
+        gprintf("\tdram_timing: row miss for 0x%08x\n", address);
+        *first = config->t_rcd + config->t_cas;
+    }
+    *subsequent = bus_word_cycles(sim, config->t_burst);
+    //A closed page policy precharges in the background once the access is done
+    bank->open = (config->page == DRAM_OPEN_PAGE);
+    bank->row = row;
+    if(write) dram->writes++;
+    else dram->reads++;
+    dram->latency += *first;
+}
+
+bool dram_row_open(sim_t *sim, uint32_t address){
+    uint32_t row;
+    if(sim->dram == NULL) return false;
+    dram_bank_t *bank = dram_locate(sim->dram, address, &row);
+    return bank->open && bank->row == row;
+}
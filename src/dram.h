@@ -0,0 +1,84 @@
+/*
+* src/dram.h
+* Timing of main memory, as DRAM banks with open rows
+*/
+
+#ifndef _DRAM_H
+#define _DRAM_H
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "types.h"
+
+/* Without a DRAM model, every access to main memory takes the same time:
+* CACHE_MISS_PENALTY for the first word of a fill and
+* CACHE_MISS_SUBSEQUENT_PENALTY for each one after it, or CACHE_WRITE_PENALTY
+* and CACHE_WRITE_SUBSEQUENT_PENALTY for a write buffer entry.
+*
+* With one, memory is split into banks of rows, and each bank keeps the last
+* row it opened. Rows are interleaved across the banks, so consecutive rows
+* are in different banks. The first word of an access takes:
+*   row hit      - t_cas, if its row is open.
+*   row miss     - t_rcd + t_cas, if its bank has no open row.
+*   row conflict - t_rp + t_rcd + t_cas, if another row is open, which has to
+*                  be closed first.
+* and each word after it t_burst (less on a wider bus, see bus.h). A closed
+* page policy closes the row after
+* every access, so there are only row misses.
+*
+* The cache units still take memory one at a time (see cache_digest()), and
+* an access learns its timing when it gets memory, not when it is queued.
+* With FR-FCFS scheduling, when several units are waiting, the first one
+* whose row is open goes first, but only DRAM_FR_FCFS_CAP times in a row
+* ahead of the same access, so that a run of row hits (a write buffer
+* draining into one row, say) cannot starve a fill of another row.
+*
+* The timing can be read from a file of "key value" lines, with # starting
+* a comment. The keys are banks, row-size, t-cas, t-rcd, t-rp, t-burst, page
+* (open or closed) and scheduling (fcfs or fr-fcfs).
+*/
+// Times in a row FR-FCFS may let a row hit go ahead of the first access in line
+#define DRAM_FR_FCFS_CAP 4
+
+typedef struct DRAM_BANK {
+    bool open;
+    uint32_t row;
+} dram_bank_t;
+
+typedef struct DRAM {
+    dram_config_t config;
+    dram_bank_t banks[DRAM_MAX_BANKS];
+    uint32_t bypassed;      // times in a row FR-FCFS passed over the first in line
+    //Statistics
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t row_hits;
+    uint32_t row_conflicts;
+    uint64_t latency;       // cycles to the first word, over every access
+} dram_t;
+
+/*
+* dram_t * dram_init(dram_config_t *config)
+* Creates banks with no open rows
+*/
+dram_t * dram_init(dram_config_t *config);
+
+void dram_free(dram_t *dram);
+
+/* Reads a DRAM configuration file into config, over the values it already
+* has, and enables the model. Returns false (with a message) if the file
+* cannot be read or has a line it does not understand. */
+bool dram_read_config(const char *path, dram_config_t *config);
+
+/* The cycles to the first word, and to each one after it, of an access to
+* main memory at address that is starting now. With a DRAM model this opens
+* the row of address. */
+void dram_timing(sim_t *sim, uint32_t address, bool write, uint32_t *first, uint32_t *subsequent);
+
+// True if an access to address would find its row open
+bool dram_row_open(sim_t *sim, uint32_t address);
+
+#endif /* _DRAM_H */
@@ -0,0 +1,250 @@
+/* src/elf_loader.c
+ * Loading ELF32 big-endian MIPS executables, and their function symbols
+ */
+
+#define _POSIX_C_SOURCE 200809L // for fileno(), mmap() and strnlen()
+
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "elf_loader.h"
+#include "main_memory.h"
+#include "predecode.h"
+#include "registers.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+// The parts of the ELF specification the loader uses
+#define ELF_HEADER_SIZE     52
+#define ELF_CLASS_32        1
+#define ELF_DATA_BE         2
+#define ELF_TYPE_EXEC       2
+#define ELF_MACHINE_MIPS    8
+#define ELF_PT_LOAD         1
+#define ELF_PF_X            1
+#define ELF_SHT_SYMTAB      2
+#define ELF_SHT_MIPS_REGINFO 0x70000006
+#define ELF_STT_FUNC        2
+
+// The mapped file, and bounds-checked big-endian reads from it
+typedef struct ELF_FILE {
+    const uint8_t   *data;
+    uint32_t        size;
+} elf_file_t;
+
+static bool elf_has(elf_file_t *elf, uint32_t offset, uint32_t length) {
+    return offset <= elf->size && length <= elf->size - offset;
+}
+
+static uint32_t elf_u16(elf_file_t *elf, uint32_t offset) {
+    return ((uint32_t)elf->data[offset] << 8) | elf->data[offset + 1];
+}
+
+static uint32_t elf_u32(elf_file_t *elf, uint32_t offset) {
+    return ((uint32_t)elf->data[offset] << 24) | ((uint32_t)elf->data[offset + 1] << 16) |
+        ((uint32_t)elf->data[offset + 2] << 8) | elf->data[offset + 3];
+}
+
+bool elf_detect(FILE *fp) {
+    uint8_t magic[4];
+    long position = ftell(fp);
+    bool found = (fread(magic, 1, 4, fp) == 4) &&
+        magic[0] == 0x7f && magic[1] == 'E' && magic[2] == 'L' && magic[3] == 'F';
+    fseek(fp, position, SEEK_SET);
+    return found;
+}
+
+/* Copy length bytes of the file to address. Words only partly covered keep
+ * the bytes around them, which matters when segments share a word. */
+static void elf_copy(sim_t *sim, elf_file_t *elf, uint32_t offset, uint32_t address, uint32_t length) {
+    uint32_t end = address + length;
+    for (uint32_t word_addr = address & ~0x3u; word_addr < end; word_addr += 4) {
+        word_t word = mem_peek_w(sim, word_addr);
+        for (uint32_t b = 0; b < 4; ++b) {
+            uint32_t a = word_addr + b;
+            if (a < address || a >= end) continue;
+            uint32_t shift = (3 - b) << 3; // memory is big-endian, like the file
+            word = (word & ~(0xffu << shift)) | ((word_t)elf->data[offset + (a - address)] << shift);
+        }
+        mem_load(sim, word_addr, &word, 1);
+    }
+}
+
+static int elf_symbol_compare(const void *a, const void *b) {
+    uint32_t x = ((const elf_symbol_t *)a)->addr, y = ((const elf_symbol_t *)b)->addr;
+    return (x > y) - (x < y);
+}
+
+/* Read the function symbols of the symbol table in section header sh, and
+ * the value of _gp into gp if it is there */
+static void elf_read_symbols(elf_file_t *elf, uint32_t shoff, uint32_t shentsize, uint32_t shnum,
+        uint32_t sh, elf_symbols_t *symbols, word_t *gp) {
+    uint32_t offset = elf_u32(elf, sh + 16), size = elf_u32(elf, sh + 20);
+    uint32_t link = elf_u32(elf, sh + 24);
+    if (!elf_has(elf, offset, size) || link >= shnum) return;
+    uint32_t strtab = shoff + link * shentsize;
+    uint32_t str_offset = elf_u32(elf, strtab + 16), str_size = elf_u32(elf, strtab + 20);
+    if (!elf_has(elf, str_offset, str_size)) return;
+    for (uint32_t sym = offset; sym + 16 <= offset + size; sym += 16) {
+        uint32_t name = elf_u32(elf, sym);
+        if (name >= str_size) continue;
+        const char *str = (const char *)elf->data + str_offset + name;
+        size_t length = strnlen(str, str_size - name);
+        if (length == str_size - name) continue; // not terminated
+        if (!strcmp(str, "_gp")) *gp = elf_u32(elf, sym + 4);
+        if (NULL == symbols || (elf->data[sym + 12] & 0xf) != ELF_STT_FUNC || !length) continue;
+        if (symbols->count % 256 == 0) {
+            symbols->syms = (elf_symbol_t *)realloc(symbols->syms, sizeof(elf_symbol_t) * (symbols->count + 256));
+            // If the table didn't get allocated, crash the program
+            if (NULL == symbols->syms) assert(0);
+        }
+        elf_symbol_t *entry = &symbols->syms[symbols->count++];
+        entry->addr = elf_u32(elf, sym + 4);
+        entry->size = elf_u32(elf, sym + 8);
+        entry->name = (char *)malloc(length + 1);
+        if (NULL == entry->name) assert(0);
+        memcpy(entry->name, str, length + 1);
+        entry->cycles = entry->insts = 0;
+    }
+}
+
+int elf_load(sim_t *sim, FILE *fp, elf_symbols_t *symbols) {
+    struct stat st;
+    int fd = fileno(fp);
+    if (fstat(fd, &st) != 0 || st.st_size < ELF_HEADER_SIZE || (uint64_t)st.st_size > 0xffffffffu) return -1;
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == map) return -1;
+    elf_file_t file = { .data = (const uint8_t *)map, .size = (uint32_t)st.st_size };
+    elf_file_t *elf = &file;
+    int rv = -1;
+
+    uint32_t phoff = elf_u32(elf, 28), phentsize = elf_u16(elf, 42), phnum = elf_u16(elf, 44);
+    uint32_t shoff = elf_u32(elf, 32), shentsize = elf_u16(elf, 46), shnum = elf_u16(elf, 48);
+    if (elf->data[4] != ELF_CLASS_32 || elf->data[5] != ELF_DATA_BE ||
+            elf_u16(elf, 16) != ELF_TYPE_EXEC || elf_u16(elf, 18) != ELF_MACHINE_MIPS ||
+            phentsize < 32 || !elf_has(elf, phoff, phnum * phentsize)) {
+        goto done;
+    }
+    if (shentsize < 40 || !elf_has(elf, shoff, shnum * shentsize)) shnum = 0;
+
+    // Find where the segments go, and which of them hold code
+    uint32_t low = 0xffffffff, high = 0, code_low = 0xffffffff, code_high = 0;
+    for (uint32_t i = 0; i < phnum; ++i) {
+        uint32_t ph = phoff + i * phentsize;
+        if (elf_u32(elf, ph) != ELF_PT_LOAD) continue;
+        uint32_t vaddr = elf_u32(elf, ph + 8), filesz = elf_u32(elf, ph + 16), memsz = elf_u32(elf, ph + 20);
+        if (filesz > memsz || !elf_has(elf, elf_u32(elf, ph + 4), filesz) || vaddr + memsz < vaddr) goto done;
+        if (memsz == 0) continue;
+        if (vaddr < low) low = vaddr;
+        if (vaddr + memsz > high) high = vaddr + memsz;
+        if (elf_u32(elf, ph + 24) & ELF_PF_X) {
+            if (vaddr < code_low) code_low = vaddr;
+            if (vaddr + memsz > code_high) code_high = vaddr + memsz;
+        }
+    }
+    if (low >= high) goto done;
+    low &= ~0x3u;
+    high = (high + 3) & ~0x3u;
+    mem_init(sim, high - low, low);
+    rv = 0;
+    for (uint32_t i = 0; i < phnum; ++i) {
+        uint32_t ph = phoff + i * phentsize;
+        if (elf_u32(elf, ph) != ELF_PT_LOAD || elf_u32(elf, ph + 20) == 0) continue;
+        uint32_t filesz = elf_u32(elf, ph + 16);
+        elf_copy(sim, elf, elf_u32(elf, ph + 4), elf_u32(elf, ph + 8), filesz);
+        bprintf("Loaded segment of %d bytes (%d in memory) at 0x%08x%s\n", filesz,
+            elf_u32(elf, ph + 20), elf_u32(elf, ph + 8), (elf_u32(elf, ph + 24) & ELF_PF_X) ? ", code" : "");
+        rv += filesz;
+    }
+
+    // Registers: the stack, and the global pointer from _gp or the .reginfo section
+    word_t gp = 0, sp = ELF_STACK_TOP;
+    for (uint32_t i = 0; i < shnum; ++i) {
+        uint32_t sh = shoff + i * shentsize;
+        if (elf_u32(elf, sh + 4) == ELF_SHT_MIPS_REGINFO && elf_has(elf, elf_u32(elf, sh + 16), 24)) {
+            if (!gp) gp = elf_u32(elf, elf_u32(elf, sh + 16) + 20);
+        }
+    }
+    for (uint32_t i = 0; i < shnum; ++i) {
+        uint32_t sh = shoff + i * shentsize;
+        if (elf_u32(elf, sh + 4) == ELF_SHT_SYMTAB) {
+            elf_read_symbols(elf, shoff, shentsize, shnum, sh, symbols, &gp);
+        }
+    }
+    if (symbols && symbols->count) {
+        qsort(symbols->syms, symbols->count, sizeof(elf_symbol_t), elf_symbol_compare);
+        symbols->last = 0;
+        bprintf("Read %d function symbols\n", symbols->count);
+    }
+    reg_write(sim, REG_SP, &sp);
+    reg_write(sim, REG_FP, &sp);
+    reg_write(sim, REG_GP, &gp);
+    sim->pc = elf_u32(elf, 24);
+
+    // Predecode the code, as parse() does
+    if (code_low < code_high) {
+        code_low &= ~0x3u;
+        predecode_init(sim, code_low, ((code_high + 3) & ~0x3u) - code_low);
+    } else {
+        predecode_init(sim, 0, 0);
+    }
+    predecode_build(sim);
+    bprintf("Loaded ELF executable, entry 0x%08x, $gp = 0x%08x\n", sim->pc, gp);
+done:
+    munmap(map, (size_t)st.st_size);
+    return rv;
+}
+
+elf_symbol_t *elf_symbol_find(elf_symbols_t *symbols, uint32_t addr) {
+    if (!symbols->count) return NULL;
+    // Straight-line code keeps finding the same function
+    elf_symbol_t *sym = &symbols->syms[symbols->last];
+    if (addr >= sym->addr && (addr - sym->addr < sym->size ||
+            (!sym->size && (symbols->last + 1 == symbols->count || addr < sym[1].addr)))) {
+        return sym;
+    }
+    // The last symbol starting at or before addr
+    uint32_t lo = 0, hi = symbols->count;
+    while (lo < hi) {
+        uint32_t mid = lo + ((hi - lo) >> 1);
+        if (symbols->syms[mid].addr <= addr) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return NULL;
+    sym = &symbols->syms[lo - 1];
+    if (sym->size && addr - sym->addr >= sym->size) return NULL;
+    symbols->last = lo - 1;
+    return sym;
+}
+
+void elf_symbols_free(elf_symbols_t *symbols) {
+    for (uint32_t i = 0; i < symbols->count; ++i) free(symbols->syms[i].name);
+    free(symbols->syms);
+    symbols->syms = NULL;
+    symbols->count = symbols->last = 0;
+}
+
+static int elf_profile_compare(const void *a, const void *b) {
+    uint64_t x = (*(elf_symbol_t * const *)a)->cycles, y = (*(elf_symbol_t * const *)b)->cycles;
+    return (x < y) - (x > y);
+}
+
+void elf_profile_print(elf_symbols_t *symbols, uint32_t cycles) {
+    elf_symbol_t **order = (elf_symbol_t **)malloc(sizeof(elf_symbol_t *) * (symbols->count ? symbols->count : 1));
+    if (NULL == order) assert(0);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < symbols->count; ++i) {
+        if (symbols->syms[i].cycles) order[n++] = &symbols->syms[i];
+    }
+    qsort(order, n, sizeof(elf_symbol_t *), elf_profile_compare);
+    printf("$f %-8s | %-6s | %-8s | %-6s | Function\n", "Cycles", "%", "Icount", "CPI");
+    for (uint32_t i = 0; i < n; ++i) {
+        printf("$f %8llu | %6.2f | %8llu | %6.3f | %s\n",
+            (unsigned long long)order[i]->cycles, 100*((float)order[i]->cycles)/((float)cycles),
+            (unsigned long long)order[i]->insts, ((float)order[i]->cycles)/((float)order[i]->insts),
+            order[i]->name);
+    }
+    free(order);
+}
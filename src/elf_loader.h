@@ -0,0 +1,54 @@
+/* src/elf_loader.h
+ * Loading ELF32 big-endian MIPS executables, and their function symbols
+ */
+
+#ifndef _ELF_LOADER_H
+#define _ELF_LOADER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "util.h"
+
+// The stack starts just below kseg0, where the MIPS ABI puts the user stack
+#define ELF_STACK_TOP 0x7ffffff0
+
+// A function from the executable's symbol table
+typedef struct ELF_SYMBOL {
+    uint32_t    addr;
+    uint32_t    size;       // bytes, 0 if the symbol table didn't say
+    char        *name;
+    // Per-function profile (see --profile-functions)
+    uint64_t    cycles;
+    uint64_t    insts;
+} elf_symbol_t;
+
+typedef struct ELF_SYMBOLS {
+    elf_symbol_t    *syms;  // sorted by address
+    uint32_t        count;
+    uint32_t        last;   // the symbol found last, which is usually found again
+} elf_symbols_t;
+
+// True if fp is at the start of an ELF file (fp is left where it was)
+bool elf_detect(FILE *fp);
+
+/* Load the executable in fp into sim: every PT_LOAD segment is copied to its
+ * virtual address (the rest of the segment's memory size reads as zero),
+ * memory is set up to span the segments, and the executable segments are
+ * predecoded. pc is set to e_entry, $sp and $fp to ELF_STACK_TOP, and $gp to
+ * the _gp symbol (or the .reginfo gp value). $ra stays 0, so a program whose
+ * entry function returns halts the simulation. The function symbols are put
+ * in symbols, if it is not NULL. Returns the number of bytes loaded, or -1 if
+ * fp is not a big-endian ELF32 MIPS executable.
+ */
+int elf_load(sim_t *sim, FILE *fp, elf_symbols_t *symbols);
+
+// The function containing addr, or NULL
+elf_symbol_t *elf_symbol_find(elf_symbols_t *symbols, uint32_t addr);
+void elf_symbols_free(elf_symbols_t *symbols);
+
+// Print the per-function profile, most cycles first
+void elf_profile_print(elf_symbols_t *symbols, uint32_t cycles);
+
+#endif /* _ELF_LOADER_H */
@@ -3,19 +3,20 @@
 */
 
 #include "fetch.h"
+#include "sim.h"
 
 extern int flags; // from util.c
-extern profile_t *prof;
 
-void fetch(control_t *ifid, pc_t *pc, cache_config_t *cache_cfg) {
+void fetch(sim_t *sim, control_t *ifid, pc_t *pc) {
+    cache_config_t *cache_cfg = &sim->cache_cfg;
     // Read the instruction at the current program counter
     if (cache_cfg->mode != CACHE_DISABLE && cache_cfg->inst_enabled) {
-        ifid->status = i_cache_read_w(pc, &(ifid->instr));
+        ifid->status = i_cache_read_w(sim, pc, &(ifid->instr));
         if (ifid->status == CACHE_HIT) {
             // Check to make sure it's the same one from memory
             // We will want to remove this check once we are sure the cache works
             uint32_t temp;
-            mem_read_w(*pc, &temp);
+            mem_read_w(sim, *pc, &temp);
             if(temp != ifid->instr){
                 cprintf(ANSI_C_RED,
                     "Inconsistent data from cache! Data 0x%08x from cache does "
@@ -24,29 +25,29 @@ void fetch(control_t *ifid, pc_t *pc, cache_config_t *cache_cfg) {
                 assert(0);
             }
         }
+        // Only the first try at this pc trains the prefetcher, not the retries
+        if (sim->i_prefetch && !sim->frozen) prefetch_access(sim, sim->i_prefetch, *pc, *pc, ifid->status);
     } else {
-        mem_read_w(*pc, &(ifid->instr));
+        mem_read_w(sim, *pc, &(ifid->instr));
+    }
+    if (sim->trace_out && !(cache_cfg->mode != CACHE_DISABLE && cache_cfg->inst_enabled &&
+            ifid->status == CACHE_MISS)) {
+        trace_writer_stage(sim->trace_out, TRACE_FETCH, *pc, *pc, 4);
     }
 
     /*if(ifid->instr == 0x8c430000){
-        prof->debug++;
-        printf("%d\n", prof->debug);
+        sim->prof.debug++;
+        printf("%d\n", sim->prof.debug);
     }*/
 
-    // Break the instruction into the specific fields
-    ifid->opCode =  ( ifid->instr & OP_MASK ) >> OP_SHIFT;
-    ifid->regRs =   ( ifid->instr & RS_MASK ) >> RS_SHIFT;
-    ifid->regRt =   ( ifid->instr & RT_MASK ) >> RT_SHIFT;
-    ifid->regRd =   ( ifid->instr & RD_MASK ) >> RD_SHIFT;
-    ifid->shamt =   ( ifid->instr & SH_MASK ) >> SH_SHIFT;
-    ifid->funct =   ( ifid->instr & FC_MASK );
-    ifid->address = ( ifid->instr & AD_MASK );
-    uint32_t immed = ( ifid->instr & IM_MASK );
-
-    // Sign extension of the immediate field
-    ifid->immed = ((ifid->instr & BIT15) && (ifid->opCode != OPC_SLTIU) &&
-        (ifid->opCode != OPC_ANDI) && (ifid->opCode != OPC_ORI) &&
-        (ifid->opCode != OPC_XORI)) ? immed | EXT_16_32 : immed;
+    // Use the predecoded fields if this word was predecoded at load time,
+    // otherwise break the instruction into the specific fields
+    predecode_entry_t *entry = predecode_lookup(sim, *pc, ifid->instr);
+    if (entry) {
+        predecode_apply_fetch(entry, ifid);
+    } else {
+        fetch_fields(ifid);
+    }
 
     // Update the program counter by 4
     ifid->pcNext = *pc + 4;
@@ -64,3 +65,20 @@ void fetch(control_t *ifid, pc_t *pc, cache_config_t *cache_cfg) {
         }
     }
 }
+
+void fetch_fields(control_t *ifid) {
+    // Break the instruction into the specific fields
+    ifid->opCode =  ( ifid->instr & OP_MASK ) >> OP_SHIFT;
+    ifid->regRs =   ( ifid->instr & RS_MASK ) >> RS_SHIFT;
+    ifid->regRt =   ( ifid->instr & RT_MASK ) >> RT_SHIFT;
+    ifid->regRd =   ( ifid->instr & RD_MASK ) >> RD_SHIFT;
+    ifid->shamt =   ( ifid->instr & SH_MASK ) >> SH_SHIFT;
+    ifid->funct =   ( ifid->instr & FC_MASK );
+    ifid->address = ( ifid->instr & AD_MASK );
+    uint32_t immed = ( ifid->instr & IM_MASK );
+
+    // Sign extension of the immediate field
+    ifid->immed = ((ifid->instr & BIT15) && (ifid->opCode != OPC_SLTIU) &&
+        (ifid->opCode != OPC_ANDI) && (ifid->opCode != OPC_ORI) &&
+        (ifid->opCode != OPC_XORI)) ? immed | EXT_16_32 : immed;
+}
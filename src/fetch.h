@@ -12,8 +12,13 @@
 #include "util.h"
 #include "main_memory.h"
 #include "cache.h"
+#include "predecode.h"
 
-void fetch(control_t *ifid, pc_t *pc, cache_config_t *cache_cfg);
+void fetch(sim_t *sim, control_t *ifid, pc_t *pc);
+
+// Split ifid->instr into opcode, register, shamt, funct, address and
+// (sign-extended) immediate fields
+void fetch_fields(control_t *ifid);
 
 // Instruction decoding bitmasks
 #define OP_MASK 0xFC000000
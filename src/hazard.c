@@ -2,29 +2,26 @@
 * Hazard detection unit. Control and data hazard detection and forwarding
 */
 #include "hazard.h"
+#include "sim.h"
 
 extern int flags; // from util.c
-extern profile_t *prof;  //from util.c
 
-control_t *ifid_backup;
-control_t *idex_backup;
-control_t *exmem_backup;
-control_t *memwb_backup;
-pc_t pc_backup;
-
-int hazard(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb, pc_t *pc, cache_config_t *cache_cfg) {
+int hazard(sim_t *sim, control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb, pc_t *pc) {
     bool forward = false;
-    pc_backup = *pc;
-    cache_status_t status = CACHE_NO_ACCESS;
-    if (cache_cfg->mode != CACHE_DISABLE && (cache_cfg->inst_enabled || cache_cfg->data_enabled)) {
-        if (memwb->status == CACHE_MISS || ifid->status == CACHE_MISS) {
-            status = CACHE_MISS;
-        }
-    }
-
 
     gcprintf(ANSI_C_CYAN, "HAZARD:\n");
 
+    /* An instruction that needs the register of a load still waiting in an
+     * MSHR stays in decode: it is decoded again next cycle, the instruction
+     * just fetched is fetched again, and a nop goes on to execute. */
+    if (sim->mshr && (mshr_pending(sim, idex->regRs) || mshr_pending(sim, idex->regRt))) {
+        bprintf("\tWaiting for a load that missed: holding the instruction in decode\n");
+        copy_pipeline_register(sim->ifid, ifid);
+        flush(idex);
+        sim->prof.mshr_held++;
+        return 0;
+    }
+
     // Reset stall
     bool stall = false;
     // Our destination register could be Rd or Rt
@@ -105,7 +102,7 @@ int hazard(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb,
             } else {
                 idex->PCSrc = false;
             }
-            prof->cycles = (status == CACHE_MISS) ? prof->cycles : prof->cycles + cycle_incr;
+            sim->prof.cycles += cycle_incr;
         } else if(idex->opCode == OPC_BEQ) {
             gprintf("\tRecalculating BEQ\n");
             if (idex->regRsValue == idex->regRtValue) { // Branch taken
@@ -113,7 +110,7 @@ int hazard(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb,
             } else {
                 idex->PCSrc = false;
             }
-            prof->cycles = (status == CACHE_MISS) ? prof->cycles : prof->cycles + cycle_incr;
+            sim->prof.cycles += cycle_incr;
         } else if (idex->opCode == OPC_BLTZ) {
             gprintf("\tRecalculating BLTZ\n");
             if ((int)idex->regRsValue < 0) { // Branch taken
@@ -121,7 +118,7 @@ int hazard(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb,
             } else{
                 idex->PCSrc = false;
             }
-            prof->cycles = (status == CACHE_MISS) ? prof->cycles : prof->cycles + cycle_incr;
+            sim->prof.cycles += cycle_incr;
         } else if (idex->opCode == OPC_BGTZ) {
             gprintf("\tRecalculating BGTZ\n");
             if ((int)idex->regRsValue > 0) { // Branch taken
@@ -129,7 +126,7 @@ int hazard(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb,
             } else {
                 idex->PCSrc = false;
             }
-            prof->cycles = (status == CACHE_MISS) ? prof->cycles : prof->cycles + cycle_incr;
+            sim->prof.cycles += cycle_incr;
         } else if (idex->opCode == OPC_BLEZ){
             gprintf("\tRecalculating BLEZ\n");
             if ((int)idex->regRsValue <= 0) {
@@ -137,11 +134,11 @@ int hazard(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb,
             } else {
                 idex->PCSrc = false;
             }
-            prof->cycles = (status == CACHE_MISS) ? prof->cycles : prof->cycles + cycle_incr;
+            sim->prof.cycles += cycle_incr;
         } else if ((idex->opCode == OPC_RTYPE) && (idex->funct == FNC_JR)) {
             gprintf("\tRecalculating JR\n");
             idex->pcNext = idex->regRsValue;
-            prof->cycles = (status == CACHE_MISS) ? prof->cycles : prof->cycles + cycle_incr;
+            sim->prof.cycles += cycle_incr;
         }
         if (idex->PCSrc) {
             gprintf("\tBranch will be taken\n");
@@ -179,40 +176,8 @@ int hazard(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb,
         *pc = *pc + 4;
     }
 
-    if (cache_cfg->mode != CACHE_DISABLE && (cache_cfg->inst_enabled || cache_cfg->data_enabled)) {
-        if (memwb->status == CACHE_MISS || ifid->status == CACHE_MISS) {
-            gprintf("\tcache miss! Restoring the pipeline\n");
-            restore(ifid, idex, exmem, memwb, pc);
-        } else {
-            if(!stall){
-                prof->instruction_count++;
-            }
-        }
-    } else {
-        if(!stall){
-            prof->instruction_count++;
-        }
+    if(!stall){
+        sim->prof.instruction_count++;
     }
     return 0;
 }
-
-void hazard_init(void) {
-    pipeline_init(&ifid_backup, &idex_backup, &exmem_backup, &memwb_backup, &pc_backup, 0);
-}
-
-void backup(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb, pc_t *pc) {
-    copy_pipeline_register(ifid, ifid_backup);
-    copy_pipeline_register(idex, idex_backup);
-    copy_pipeline_register(exmem, exmem_backup);
-    copy_pipeline_register(memwb, memwb_backup);
-    pc_backup = *pc;
-}
-
-void restore(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb, pc_t *pc) {
-    // Some checking to ensure the register file hasn't changed
-    copy_pipeline_register(ifid_backup, ifid);
-    copy_pipeline_register(idex_backup, idex);
-    copy_pipeline_register(exmem_backup, exmem);
-    copy_pipeline_register(memwb_backup, memwb);
-    *pc = pc_backup;
-}
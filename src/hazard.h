@@ -11,15 +11,13 @@
 
 /*To be called after the execution of a clock cycle. Unit will forward any data
 that will prevent a data hazard, insert nops into the pipeline if forwarding
-can't prevent the data hazard, and flush IFID if a branch is taken
+can't prevent the data hazard, and flush IFID if a branch is taken.
+Cycles that miss in the cache never reach the hazard unit; the pipeline is
+frozen instead and the cycle is retried (see sim.c). With MSHRs a load that
+misses goes on without its data, and the unit holds an instruction that reads
+its register in decode until the data is in (see mshr.h).
 */
 //HAZARD UPDATES THE PC, SO IT MUST BE CALLED
-int hazard(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb, pc_t *pc, cache_config_t *cache_cfg);
-
-void hazard_init(void);
-
-void restore(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb, pc_t *pc);
-
-void backup(control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb, pc_t *pc);
+int hazard(sim_t *sim, control_t *ifid, control_t *idex, control_t *exmem, control_t *memwb, pc_t *pc);
 
 #endif /* _HAZARD_H */
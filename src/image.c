@@ -0,0 +1,132 @@
+/* src/image.c
+ * Binary program images, written by --save-image and loaded in place of a source file
+ */
+
+#define _POSIX_C_SOURCE 200112L // for fileno() and mmap()
+
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "image.h"
+#include "main_memory.h"
+#include "predecode.h"
+#include "registers.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+static void put_le32(uint8_t *out, uint32_t value) {
+    for (uint32_t i = 0; i < 4; ++i) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t get_le32(const uint8_t *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// Words are stored in the host's order when it is little-endian, so they can be copied as they are
+static bool host_little_endian(void) {
+    const uint32_t one = 1;
+    return *(const uint8_t *)&one == 1;
+}
+
+bool image_detect(FILE *fp) {
+    char magic[4];
+    long position = ftell(fp);
+    bool found = (fread(magic, 1, 4, fp) == 4) && memcmp(magic, IMAGE_MAGIC, 4) == 0;
+    fseek(fp, position, SEEK_SET);
+    return found;
+}
+
+int image_load(sim_t *sim, FILE *fp) {
+    struct stat st;
+    int fd = fileno(fp);
+    if (fstat(fd, &st) != 0 || st.st_size < IMAGE_HEADER_SIZE) return -1;
+    uint8_t *map = (uint8_t *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == map) return -1;
+    uint32_t header_size = map[6] | (map[7] << 8);
+    uint32_t pages = get_le32(map + 8);
+    if (memcmp(map, IMAGE_MAGIC, 4) != 0 || (map[4] | (map[5] << 8)) != IMAGE_VERSION ||
+            header_size < IMAGE_HEADER_SIZE || get_le32(map + 12) != MEM_PAGE_WORDS ||
+            (header_size & 0x3) || (uint64_t)st.st_size < header_size + (uint64_t)pages * IMAGE_RECORD_SIZE) {
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    mem_init(sim, get_le32(map + 20), get_le32(map + 16));
+    for (uint32_t p = 0; p < pages; ++p) {
+        const uint8_t *record = map + header_size + (size_t)p * IMAGE_RECORD_SIZE;
+        uint32_t address = get_le32(record) & ~((1u << MEM_PAGE_BITS) - 1);
+        const uint8_t *body = record + 4;
+        if (host_little_endian()) {
+            mem_load(sim, address, (const word_t *)body, MEM_PAGE_WORDS);
+        } else {
+            for (uint32_t i = 0; i < MEM_PAGE_WORDS; ++i) {
+                word_t word = get_le32(body + (i<<2));
+                mem_load(sim, address + (i<<2), &word, 1);
+            }
+        }
+    }
+    word_t sp = get_le32(map + 28), fp_value = get_le32(map + 32), gp = get_le32(map + 36);
+    reg_write(sim, REG_SP, &sp);
+    reg_write(sim, REG_FP, &fp_value);
+    reg_write(sim, REG_GP, &gp);
+    sim->pc = get_le32(map + 24);
+    uint32_t code = get_le32(map + 40), code_words = get_le32(map + 44);
+    munmap(map, (size_t)st.st_size);
+    bprintf("Loaded image of %d pages, entry 0x%08x\n", pages, sim->pc);
+    // Predecode the code, as the loader that made the image did
+    predecode_init(sim, code, code_words<<2);
+    predecode_build(sim);
+    return (int)pages;
+}
+
+// True if none of the words of a page are set
+static bool image_page_empty(const word_t *words) {
+    for (uint32_t i = 0; i < MEM_PAGE_WORDS; ++i) {
+        if (words[i]) return false;
+    }
+    return true;
+}
+
+int image_save(sim_t *sim, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (NULL == fp) return 1;
+    // Only pages that were written and hold something; the rest read as zero anyway
+    uint32_t pages = 0;
+    const word_t *words;
+    for (uint32_t page = 0; (words = mem_next_page(sim, &page)) != NULL; ++page) {
+        if (!image_page_empty(words)) ++pages;
+    }
+    word_t sp, fp_value, gp;
+    reg_read(sim, REG_SP, &sp);
+    reg_read(sim, REG_FP, &fp_value);
+    reg_read(sim, REG_GP, &gp);
+    uint8_t header[IMAGE_HEADER_SIZE];
+    memcpy(header, IMAGE_MAGIC, 4);
+    header[4] = IMAGE_VERSION & 0xff;
+    header[5] = IMAGE_VERSION >> 8;
+    header[6] = IMAGE_HEADER_SIZE & 0xff;
+    header[7] = IMAGE_HEADER_SIZE >> 8;
+    put_le32(header + 8, pages);
+    put_le32(header + 12, MEM_PAGE_WORDS);
+    put_le32(header + 16, mem_start(sim));
+    put_le32(header + 20, mem_size_b(sim));
+    put_le32(header + 24, sim->pc);
+    put_le32(header + 28, sp);
+    put_le32(header + 32, fp_value);
+    put_le32(header + 36, gp);
+    put_le32(header + 40, sim->predecode.start);
+    put_le32(header + 44, sim->predecode.length);
+    fwrite(header, 1, IMAGE_HEADER_SIZE, fp);
+    for (uint32_t page = 0; (words = mem_next_page(sim, &page)) != NULL; ++page) {
+        if (image_page_empty(words)) continue;
+        uint8_t record[IMAGE_RECORD_SIZE];
+        put_le32(record, page << MEM_PAGE_BITS);
+        for (uint32_t i = 0; i < MEM_PAGE_WORDS; ++i) put_le32(record + 4 + (i<<2), words[i]);
+        fwrite(record, 1, IMAGE_RECORD_SIZE, fp);
+    }
+    int rv = ferror(fp) ? 1 : 0;
+    if (fclose(fp) != 0) rv = 1;
+    bprintf("Saved image of %d pages, entry 0x%08x to %s\n", pages, sim->pc, path);
+    return rv;
+}
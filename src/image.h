@@ -0,0 +1,42 @@
+/* src/image.h
+ * Binary program images, written by --save-image and loaded in place of a source file
+ */
+
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "util.h"
+#include "main_memory.h"
+
+/* A program image is the loaded program as parse() or elf_load() leave it:
+ * a 48 byte header ("MIMG", version and header length as 16 bit values, then
+ * as 32 bit values the number of page records, the words in a page, the start
+ * and size of the memory, the entry pc, the initial $sp, $fp and $gp, and the
+ * start and number of words of the code to predecode), followed by one record
+ * per page of main memory that holds anything: the page's address, then its
+ * MEM_PAGE_WORDS words. Everything is little-endian. Pages that are all zero
+ * are left out, so a program whose segments are far apart makes a small image,
+ * and loading only allocates the pages the program uses. The words are copied
+ * straight out of the mapped file into main memory, so loading does not
+ * depend on the length of the program's text.
+ */
+#define IMAGE_MAGIC "MIMG"
+#define IMAGE_VERSION 2
+#define IMAGE_HEADER_SIZE 48
+#define IMAGE_RECORD_SIZE (4 + (MEM_PAGE_WORDS << 2))
+
+// True if fp is at the start of a program image (fp is left where it was)
+bool image_detect(FILE *fp);
+/* Load the image in fp into sim's memory, predecode table and registers, and
+ * set sim->pc to its entry point. Returns the number of pages loaded, or -1
+ * if fp does not hold a valid image. */
+int image_load(sim_t *sim, FILE *fp);
+/* Write the program loaded in sim, starting at sim->pc, to path: every page
+ * of memory that is not all zero. Returns 0 on success. */
+int image_save(sim_t *sim, const char *path);
+
+#endif /* _IMAGE_H */
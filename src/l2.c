@@ -0,0 +1,169 @@
+/*
+* src/l2.c
+* Second level cache, shared by the I and D caches
+*/
+
+#include "l2.h"
+#include "cache.h"
+#include "dram.h"
+#include "bus.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+l2_cache_t * l2_init(cache_config_t *config, uint32_t l1_block){
+    l2_cache_t *l2 = (l2_cache_t *)calloc(1, sizeof(l2_cache_t));
+    if(l2 == NULL){
+        cprintf(ANSI_C_RED, "l2_init: Unable to allocate the L2 cache\n");
+        assert(0);
+    }
+    if((config->l2_size & (config->l2_size - 1)) != 0){
+        cprintf(ANSI_C_RED, "cache_init: L2 size %d not a power of two\n", config->l2_size);
+        assert(0);
+    }
+    uint32_t block = config->l2_block;
+    if(block < l1_block){
+        cprintf(ANSI_C_YELLOW, "cache_init: L2 blocks smaller than the L1 blocks, using %d words\n", l1_block);
+        block = l1_block;
+    }
+    uint32_t num_blocks = (config->l2_size >> 2) / block;
+    if(num_blocks == 0){
+        cprintf(ANSI_C_RED, "cache_init: L2 size %d is less than one block\n", config->l2_size);
+        assert(0);
+    }
+    uint32_t ways = config->l2_type == CACHE_ASSOC ? config->l2_ways : 1;
+    if(ways > num_blocks){
+        cprintf(ANSI_C_YELLOW, "cache_init: only %d L2 blocks, so only %d ways\n", num_blocks, num_blocks);
+        ways = num_blocks;
+    }
+    l2->tags = assoc_cache_init(num_blocks, block, ways, config->l2_replace, CACHE_FILL_SEQUENTIAL);
+    l2->latency = config->l2_latency;
+    l2->wpolicy = config->l2_wpolicy;
+    l2->fill = config->l2_fill;
+    return l2;
+}
+
+void l2_free(l2_cache_t *l2){
+    assoc_cache_free(l2->tags);
+    free(l2);
+}
+
+// The line of the L2 holding the block of address, or tags->ways
+static uint32_t l2_find(l2_cache_t *l2, uint32_t address, cache_access_t *info){
+    assoc_cache_get_tag_and_index(info, l2->tags, &address);
+    return assoc_cache_find(l2->tags, info->index, info->tag);
+}
+
+// The first byte of the block in line of set
+static uint32_t l2_line_address(assoc_cache_t *tags, uint32_t set, uint32_t line){
+    return (tags->tags[line] << (2 + tags->index_size + tags->inner_index_size)) | (set << (2 + tags->inner_index_size));
+}
+
+/* The cycles it takes to write the dirty block in line of set to memory.
+* Like a write buffer entry, it gets its timing from dram_timing(), which
+* opens its row, and a split bus posts it. */
+static uint32_t l2_writeback(sim_t *sim, uint32_t set, uint32_t line){
+    l2_cache_t *l2 = sim->l2;
+    assoc_cache_t *tags = l2->tags;
+    uint32_t first, subsequent;
+    dram_timing(sim, l2_line_address(tags, set, line), true, &first, &subsequent);
+    l2->writebacks++;
+    return (bus_split(sim) ? subsequent : first) + (tags->block_size - 1) * subsequent;
+}
+
+/* Put the block of address into the L2, dirty or not. Returns the cycles it
+* takes to write the block it replaces to memory first, if that was dirty.
+* An inclusive L2 also takes the block it replaces out of the first level.
+* When warming nothing is timed. */
+static uint32_t l2_allocate(sim_t *sim, uint32_t address, bool dirty, bool warm){
+    l2_cache_t *l2 = sim->l2;
+    assoc_cache_t *tags = l2->tags;
+    cache_access_t info;
+    uint32_t penalty = 0;
+    uint32_t way = l2_find(l2, address, &info);
+    if(way < tags->ways){
+        //Already there
+        assoc_cache_touch(tags, info.index, way);
+        tags->dirty[info.index * tags->ways + way] |= dirty;
+        return 0;
+    }
+    way = assoc_cache_victim(tags, info.index);
+    uint32_t line = info.index * tags->ways + way;
+    if(tags->present[line] && l2->fill == CACHE_INCLUSIVE){
+        l2->back_invalidations += cache_back_invalidate(sim, l2_line_address(tags, info.index, line), tags->block_size << 2, warm);
+    }
+    if(tags->present[line] && tags->dirty[line] && !warm){
+        gprintf("\tl2_allocate: writing back the dirty block in line %d of set %d\n", way, info.index);
+        penalty = l2_writeback(sim, info.index, line);
+    }
+    tags->tags[line] = info.tag;
+    tags->present[line] = true;
+    tags->dirty[line] = dirty;
+    assoc_cache_insert(tags, info.index, way);
+    return penalty;
+}
+
+bool l2_fill(sim_t *sim, uint32_t address, bool replacing, uint32_t victim, uint32_t *penalty, uint32_t *subsequent){
+    l2_cache_t *l2 = sim->l2;
+    if(l2 == NULL){
+        *penalty = 0;
+        return true;
+    }
+    assoc_cache_t *tags = l2->tags;
+    cache_access_t info;
+    uint32_t extra = 0;
+    bool memory = false;
+    l2->accesses++;
+    uint32_t way = l2_find(l2, address, &info);
+    if(way < tags->ways){
+        gprintf("\tl2_fill: L2 hit for 0x%08x\n", address);
+        l2->hits++;
+        *penalty = l2->latency;
+        *subsequent = L2_SUBSEQUENT_PENALTY;
+        if(l2->fill == CACHE_EXCLUSIVE){
+            //The block moves up, so the L2 no longer has it. The first level
+            //takes it clean, so if it was dirty it goes to memory first.
+            uint32_t line = info.index * tags->ways + way;
+            if(tags->dirty[line]){
+                extra += l2_writeback(sim, info.index, line);
+            }
+            tags->present[line] = false;
+            tags->dirty[line] = false;
+        } else {
+            assoc_cache_touch(tags, info.index, way);
+        }
+    } else {
+        gprintf("\tl2_fill: L2 miss for 0x%08x\n", address);
+        *penalty = l2->latency;
+        memory = true;
+        if(l2->fill == CACHE_INCLUSIVE) extra += l2_allocate(sim, address, false, false);
+    }
+    if(l2->fill == CACHE_EXCLUSIVE && replacing){
+        //The block leaving the first level goes down
+        extra += l2_allocate(sim, victim, false, false);
+    }
+    *penalty += extra;
+    return memory;
+}
+
+bool l2_write(sim_t *sim, uint32_t address, uint32_t *penalty, uint32_t *subsequent){
+    l2_cache_t *l2 = sim->l2;
+    *penalty = 0;
+    if(l2 == NULL) return true;
+    assoc_cache_t *tags = l2->tags;
+    cache_access_t info;
+    l2->writes++;
+    uint32_t way = l2_find(l2, address, &info);
+    if(way == tags->ways) return true;
+    l2->write_hits++;
+    assoc_cache_touch(tags, info.index, way);
+    if(l2->wpolicy != CACHE_WRITEBACK) return true;
+    tags->dirty[info.index * tags->ways + way] = true;
+    *penalty = l2->latency;
+    *subsequent = L2_SUBSEQUENT_PENALTY;
+    return false;
+}
+
+void l2_warm(sim_t *sim, uint32_t address){
+    if(sim->l2 && sim->l2->fill == CACHE_INCLUSIVE) l2_allocate(sim, address, false, true);
+}
@@ -0,0 +1,91 @@
+/*
+* src/l2.h
+* Second level cache, shared by the I and D caches
+*/
+
+#ifndef _L2_H
+#define _L2_H
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "types.h"
+#include "assoc.h"
+
+// Cycles for each word of a block after the first, to or from the L2
+#define L2_SUBSEQUENT_PENALTY 1
+
+/* The L2 sits between the first level caches and main memory, and only
+* changes how long they wait for it. It keeps tags, not data: main memory
+* (with the write buffer in front of it) still holds every value, so the L2
+* cannot change what a program computes.
+*
+* A fill of a first level cache looks up its block in the L2 when it is
+* queued. A hit takes latency cycles for the first word and
+* L2_SUBSEQUENT_PENALTY for each one after it. A miss goes on to memory, and
+* costs latency plus the memory time (see dram.h), CACHE_MISS_PENALTY then
+* CACHE_MISS_SUBSEQUENT_PENALTY a word without a DRAM model. Where the block ends up depends on the fill policy:
+*   inclusive - a missing block is filled into the L2 as well, and a block
+*               the L2 replaces is taken out of the first level caches
+*               (see cache_back_invalidate()), so they only hold blocks the
+*               L2 has.
+*   exclusive - a block lives in one level at a time. A hit moves it out of
+*               the L2, a miss does not fill it, and the block a first level
+*               fill replaces goes into the L2 instead.
+* Making room in the L2 for a block writes the dirty block it replaces to
+* memory first, which adds to the penalty of the fill.
+*
+* The write buffer drains into the L2 the same way. With a writeback L2, an
+* entry whose block is in the L2 takes latency and L2_SUBSEQUENT_PENALTY a
+* word, and leaves the block dirty. Anything else (a block that is not there,
+* or a writethrough L2) goes to memory at the usual write penalties. Dirty
+* blocks the L2 writes back are timed like a write buffer entry (see
+* dram_timing() and bus.h), when the fill that replaces them is queued.
+*
+* The L2 block must be at least as large as the blocks of both first level
+* caches, so that a first level block is in one L2 block. Exclusion works in
+* L2 blocks: a hit moves the whole L2 block out.
+*/
+typedef struct L2_CACHE {
+    //Only the tags, present and dirty bits are used. (assoc.h includes this
+    //header through cache.h, so the typedef may not be known yet.)
+    struct ASSOC_CACHE *tags;
+    uint32_t latency;
+    cache_wpolicy_t wpolicy;
+    cache_inclusion_t fill;
+    //Statistics
+    uint32_t accesses;      // first level fills
+    uint32_t hits;
+    uint32_t writes;        // write buffer entries
+    uint32_t write_hits;
+    uint32_t writebacks;    // dirty blocks written to memory to make room
+    uint32_t back_invalidations;    // first level blocks an inclusive L2 took out when replacing them
+} l2_cache_t;
+
+/*
+* l2_cache_t * l2_init(cache_config_t *config, uint32_t l1_block)
+* Creates the L2 described by the l2_ options of config, behind first level
+* caches with blocks of at most l1_block words
+*/
+l2_cache_t * l2_init(cache_config_t *config, uint32_t l1_block);
+
+void l2_free(l2_cache_t *l2);
+
+/* The penalties of a first level fill of the block of address, for its
+* first word and for each word after it. replacing says whether the fill
+* replaces the block at victim. Returns true if the fill goes on to main
+* memory: then penalty is only the time spent before it (nothing without an
+* L2), and dram_timing() adds the rest once the fill gets memory. */
+bool l2_fill(sim_t *sim, uint32_t address, bool replacing, uint32_t victim, uint32_t *penalty, uint32_t *subsequent);
+
+/* The penalties of writing the write buffer entry for the block of address.
+* Returns true, with a penalty of nothing, if the entry goes to main memory
+* (see dram_timing()). */
+bool l2_write(sim_t *sim, uint32_t address, uint32_t *penalty, uint32_t *subsequent);
+
+// Install the block of address without timing, when warming up the caches
+void l2_warm(sim_t *sim, uint32_t address);
+
+#endif /* _L2_H */
@@ -5,37 +5,78 @@
 #include "main.h"
 
 extern int flags; // from util.c
-extern profile_t *prof;  //from util.c
 
 /* Create and initialize CPU and cache settings with defaults */
 cpu_config_t cpu_config = {
     .single_cycle   = false,
     .mem_size       = DEFAULT_MEM_SIZE,
+    .ff_insts       = 0,
+    .detail_insts   = 0,
+    .ff_warm        = false,
 };
+// Function symbols of an ELF executable, for the debugger and --profile-functions
+elf_symbols_t symbols = { .syms = NULL, .count = 0, .last = 0 };
 cache_config_t cache_config = {
     .mode           = CACHE_DISABLE,
     .data_enabled   = true,
     .data_size      = 1024,
     .data_block     = 4,
     .data_type      = CACHE_DIRECT,
+    .data_ways      = 2,
+    .data_replace   = CACHE_LRU,
     .data_wpolicy   = CACHE_WRITETHROUGH,
     .inst_enabled   = true,
     .inst_size      = 1024,
     .inst_block     = 4,
     .inst_type      = CACHE_DIRECT,
+    .inst_ways      = 2,
+    .inst_replace   = CACHE_LRU,
     .inst_wpolicy   = CACHE_WRITETHROUGH,
     .size           = 1024,
     .block          = 4,
     .type           = CACHE_DIRECT,
+    .ways           = 2,
+    .replace        = CACHE_LRU,
     .wpolicy        = CACHE_WRITETHROUGH,
+    .fill_order     = CACHE_FILL_SEQUENTIAL,
+    .data_alloc     = CACHE_ALLOCATE,
+    .write_buffer   = 1,
+    .mshrs          = 0,
+    .victims        = 0,
+    .l2_size        = 0,
+    .l2_block       = 8,
+    .l2_type        = CACHE_ASSOC,
+    .l2_ways        = 4,
+    .l2_replace     = CACHE_LRU,
+    .l2_latency     = 4,
+    .l2_wpolicy     = CACHE_WRITEBACK,
+    .l2_fill        = CACHE_INCLUSIVE,
+    .bus            = {
+        .split      = false,
+        .width      = 1,
+        .arbitration = BUS_FIXED,
+        .drain_high = 0,
+        .drain_low  = 0,
+    },
+    .dram           = {
+        .enabled    = false,
+        .banks      = 8,
+        .row_size   = 2048,
+        .t_cas      = 4,
+        .t_rcd      = 4,
+        .t_rp       = 4,
+        .t_burst    = 2,
+        .page       = DRAM_OPEN_PAGE,
+        .scheduling = DRAM_FR_FCFS,
+    },
+    .inst_prefetch  = PREFETCH_NONE,
+    .data_prefetch  = PREFETCH_NONE,
+    .prefetch_degree = 1,
+};
+sweep_config_t sweep_config = {
+    .enabled        = false,
+    .threads        = 0,
 };
-
-/* CPU state */
-control_t* ifid  = NULL; // IF/ID pipeline register
-control_t* idex  = NULL; // ID/EX pipeline register
-control_t* exmem = NULL; // EX/MEM pipeline register
-control_t* memwb = NULL; // MEM/WB pipeline register
-pc_t pc = 0;             // Program counter
 
 /* Breakpoint state */
 #define BREAKPOINT_MAX 8
@@ -43,7 +84,6 @@ uint32_t breakpoints_address[BREAKPOINT_MAX] = {0}; // the address of a breakpoi
 uint8_t breakpoints_status[BREAKPOINT_MAX] = {0}; // breakpoint status, 0: disabled, 1:enabled
 
 int main(int argc, char *argv[]) {
-    int i;
     flags = 0; // Clear flags
     /* Automatically configure colorized output based on CLICOLOR and TERM
        environment variables (CLICOLOR=1 or TERM=xterm-256color) */
@@ -67,7 +107,7 @@ int main(int argc, char *argv[]) {
     }
     /* Parse command line arguments and options */
     FILE *source_fp = NULL;
-    int rv = arguments(argc,argv,&source_fp,&cpu_config,&cache_config);
+    int rv = arguments(argc,argv,&source_fp,&cpu_config,&cache_config,&sweep_config);
     if (rv !=  0) return rv;
     if (rv == -1) return 0;
     /* Display CPU and cache configuration */
@@ -75,6 +115,13 @@ int main(int argc, char *argv[]) {
     bprintf("\tArchitecture: %s\n",cpu_config.single_cycle?"single-cycle":"five-stage pipeline");
     bprintf("\tMemory size: %lu words (%lu bytes, top = 0x%08lx)\n",
         cpu_config.mem_size>>2,cpu_config.mem_size,cpu_config.mem_size-1);
+    if (cpu_config.ff_insts) {
+        bprintf("\tFast-forward: %u instructions, caches %s\n",
+            cpu_config.ff_insts,cpu_config.ff_warm?"warmed":"cold");
+    }
+    if (cpu_config.detail_insts) {
+        bprintf("\tDetailed simulation: %u instructions\n",cpu_config.detail_insts);
+    }
     bprintf("Cache settings:\n");
     if (cache_config.mode == CACHE_SPLIT) {
         bprintf("\tData cache:\n");
@@ -82,157 +129,355 @@ int main(int argc, char *argv[]) {
         bprintf("\t    Data cache size: %d\n",cache_config.data_size);
         bprintf("\t    Data cache block size: %d\n",cache_config.data_block);
         bprintf("\t    Data cache type: %s\n",CACHE_TYPE_STRINGS[cache_config.data_type]);
+        if (cache_config.data_type == CACHE_ASSOC) {
+            bprintf("\t    Data cache ways: %d, %s replacement\n",cache_config.data_ways,CACHE_REPLACE_STRINGS[cache_config.data_replace]);
+        }
         bprintf("\t    Data cache write policy: %s\n",CACHE_WPOLICY_STRINGS[cache_config.data_wpolicy]);
+        bprintf("\t    Data cache store misses: %s\n",CACHE_ALLOC_STRINGS[cache_config.data_alloc]);
         bprintf("\tInstruction cache:\n");
         bprintf("\t    Instruction cache %s\n",cache_config.inst_enabled?"enabled":"disabled");
         bprintf("\t    Instruction cache size: %d\n",cache_config.inst_size);
         bprintf("\t    Instruction cache block size: %d\n",cache_config.inst_block);
         bprintf("\t    Instruction cache type: %s\n",CACHE_TYPE_STRINGS[cache_config.inst_type]);
+        if (cache_config.inst_type == CACHE_ASSOC) {
+            bprintf("\t    Instruction cache ways: %d, %s replacement\n",cache_config.inst_ways,CACHE_REPLACE_STRINGS[cache_config.inst_replace]);
+        }
         bprintf("\t    Instruction cache write policy: %s\n",CACHE_WPOLICY_STRINGS[cache_config.inst_wpolicy]);
     } else if (cache_config.mode == CACHE_UNIFIED) {
         bprintf("\t    Unified cache size: %d\n",cache_config.size);
         bprintf("\t    Unified cache block size: %d\n",cache_config.block);
         bprintf("\t    Unified cache type: %s\n",CACHE_TYPE_STRINGS[cache_config.type]);
+        if (cache_config.type == CACHE_ASSOC) {
+            bprintf("\t    Unified cache ways: %d, %s replacement\n",cache_config.ways,CACHE_REPLACE_STRINGS[cache_config.replace]);
+        }
         bprintf("\t    Unified cache write policy: %s\n",CACHE_WPOLICY_STRINGS[cache_config.wpolicy]);
+        bprintf("\t    Unified cache store misses: %s\n",CACHE_ALLOC_STRINGS[cache_config.data_alloc]);
     } else {
         bprintf("\tAll caching disabled\n");
     }
+    if (cache_config.mode != CACHE_DISABLE) {
+        bprintf("\t    Fill order: %s\n",CACHE_FILL_STRINGS[cache_config.fill_order]);
+        bprintf("\t    Write buffer entries: %d\n",cache_config.write_buffer);
+        bprintf("\t    Data cache MSHRs: %d\n",cache_config.mshrs);
+        bprintf("\t    Victim cache entries: %d\n",cache_config.victims);
+        bprintf("\t    Instruction prefetcher: %s\n",CACHE_PREFETCH_STRINGS[cache_config.inst_prefetch]);
+        bprintf("\t    Data prefetcher: %s\n",CACHE_PREFETCH_STRINGS[cache_config.data_prefetch]);
+        bprintf("\t    Prefetch degree: %d\n",cache_config.prefetch_degree);
+        if (cache_config.l2_size) {
+            bprintf("\tL2 cache:\n");
+            bprintf("\t    L2 cache size: %d\n",cache_config.l2_size);
+            bprintf("\t    L2 cache block size: %d\n",cache_config.l2_block);
+            bprintf("\t    L2 cache type: %s\n",CACHE_TYPE_STRINGS[cache_config.l2_type]);
+            if (cache_config.l2_type == CACHE_ASSOC) {
+                bprintf("\t    L2 cache ways: %d, %s replacement\n",cache_config.l2_ways,CACHE_REPLACE_STRINGS[cache_config.l2_replace]);
+            }
+            bprintf("\t    L2 cache latency: %d\n",cache_config.l2_latency);
+            bprintf("\t    L2 cache write policy: %s\n",CACHE_WPOLICY_STRINGS[cache_config.l2_wpolicy]);
+            bprintf("\t    L2 cache fill policy: %s\n",CACHE_INCLUSION_STRINGS[cache_config.l2_fill]);
+        }
+        bprintf("\t    Memory bus: %s, %d word%s wide, %s arbitration\n",cache_config.bus.split ? "split transaction" : "serial",
+            cache_config.bus.width,cache_config.bus.width == 1 ? "" : "s",BUS_ARBITRATION_STRINGS[cache_config.bus.arbitration]);
+        if (cache_config.bus.arbitration == BUS_READ_FIRST) {
+            bprintf("\t    Write drain watermarks: %d, %d\n",cache_config.bus.drain_high,cache_config.bus.drain_low);
+        }
+        if (cache_config.dram.enabled) {
+            dram_config_t *dram = &cache_config.dram;
+            bprintf("\t    DRAM: %d banks of %d byte rows, %s, %s scheduling\n",dram->banks,dram->row_size,
+                DRAM_PAGE_STRINGS[dram->page],DRAM_SCHED_STRINGS[dram->scheduling]);
+            bprintf("\t    DRAM timing: tCAS %d, tRCD %d, tRP %d, burst %d\n",dram->t_cas,dram->t_rcd,dram->t_rp,dram->t_burst);
+        }
+    }
     /* Warn on unsupported features */
-    if (cache_config.mode == CACHE_UNIFIED) {
-        cprintf(ANSI_C_YELLOW,"Unified cache mode not yet supported! May produce unexpected results.\n");
+    if (sweep_config.enabled && cpu_config.single_cycle) {
+        cprintf(ANSI_C_RED,"Caches are not modeled by the single-cycle CPU, so there is nothing to sweep. Exiting.\n");
+        return 1;
     }
-    if (cache_config.type == CACHE_SA2 || cache_config.data_type == CACHE_SA2 || cache_config.inst_type == CACHE_SA2) {
-        cprintf(ANSI_C_YELLOW,"Set associative cache type not yet supported! May produce unexpected results.\n");
+    if (sweep_config.enabled && sweep_config.single_pass &&
+            (cache_config.data_type != CACHE_DIRECT || cache_config.inst_type != CACHE_DIRECT)) {
+        cprintf(ANSI_C_YELLOW,"A single-pass sweep only models direct-mapped caches, sweeping them instead.\n");
+    }
+    if (sweep_config.enabled && (flags & MASK_INTERACTIVE)) {
+        cprintf(ANSI_C_YELLOW,"Interactive mode is not available when sweeping, ignoring it.\n");
+        flags &= ~MASK_INTERACTIVE;
+    }
+    if (cpu_config.replay_trace && (cpu_config.single_cycle || sweep_config.enabled)) {
+        cprintf(ANSI_C_RED,"A trace can only be replayed through the pipeline's caches. Exiting.\n");
+        return 1;
+    }
+    if (cpu_config.replay_trace && cache_config.mshrs) {
+        cprintf(ANSI_C_YELLOW,"A trace has no register dependences, so replaying it with MSHRs never waits for a load (cycles are optimistic).\n");
+    }
+    if (cpu_config.single_cycle && cache_config.mode != CACHE_DISABLE) {
+        cprintf(ANSI_C_YELLOW,"Caches are not modeled by the single-cycle CPU, ignoring cache settings.\n");
+        cache_config.mode = CACHE_DISABLE;
     }
 
     /**************************************************************************
      * Beginning the actual simulation                                        *
      * All initialization and state configuration happens below here          *
      **************************************************************************/
-    // Initialize the register file
-    reg_init();
-    // Create an array to hold all the debug information
-    asm_line_t lines[cpu_config.mem_size];
-    for (i = 0; i < (int)cpu_config.mem_size; ++i) lines[i].type = 0; // initialize all invalid
-    // Parse the ASM file, parse() initializes the memory
-    parse(source_fp, lines, cpu_config);
-    mem_dump();
-    // Initialize the pipeline registers
-    pipeline_init(&ifid, &idex, &exmem, &memwb, &pc,  (pc_t)mem_start());
-    hazard_init();
-    if (cache_config.mode != CACHE_DISABLE) {
-        cache_init(&cache_config);
+    // Create the simulator context: register file, pipeline, caches and statistics
+    sim_t *sim = sim_init(&cpu_config, &cache_config);
+    profile_t *prof = &sim->prof;
+    // Debug information for the interactive debugger, read when it is first needed
+    asm_lines_t notes = { .lines = NULL, .count = 0, .capacity = 0, .loaded = false };
+    // Parse the ASM file (or load a saved image or executable), which initializes the memory
+    bool image = source_fp && image_detect(source_fp);
+    bool elf = !image && source_fp && elf_detect(source_fp);
+    if (image || elf) {
+        rv = image ? image_load(sim, source_fp) : elf_load(sim, source_fp, &symbols);
+        fclose(source_fp);
+        if (rv < 0) {
+            cprintf(ANSI_C_RED,"Not a valid %s: %s. Exiting.\n",
+                image ? "program image" : "big-endian 32-bit MIPS executable",argv[argc-1]);
+            sim_destroy(sim);
+            return 1;
+        }
+    } else if (source_fp) {
+        parse(sim, source_fp, cpu_config);
+    } else {
+        // Replaying a trace without its program, which only needs somewhere to put the data
+        mem_init(sim, cpu_config.mem_size, 0);
     }
+    mem_dump(sim);
+    // Start the pipeline at the beginning of memory (images and executables carry their own entry point)
     uint32_t word = 0;
-    if (flags & MASK_ALTFORMAT) {
+    if (!image && !elf) sim->pc = (pc_t)mem_start(sim);
+    if (!image && !elf && (flags & MASK_ALTFORMAT)) {
         // Set the program counter based on the fifth word of memory
-        mem_read_w(5<<2, &word);
-        pc = word * 4;
+        mem_read_w(sim, 5<<2, &word);
+        sim->pc = word * 4;
     }
-    // Logistics initialization
-    prof = (profile_t*)malloc(sizeof(profile_t));
-    if (cache_config.mode != CACHE_DISABLE) {
-        prof->i_cache_access_count = 0;
-        prof->i_cache_hit_count = 0;
-        prof->i_cache_status_prev = CACHE_HIT;
-        prof->i_cache_status = CACHE_NO_ACCESS;
-        prof->d_cache_status = CACHE_NO_ACCESS;
-        prof->d_cache_status_prev = CACHE_NO_ACCESS;
-        prof->d_cache_hit_count = 0;
-        prof->d_cache_access_count = 0;
-        prof->instruction_count = 0;
-        prof->cycles = 0;
-        prof->debug = 0;
+    // Saving an image only needs the loaded program
+    if (cpu_config.save_image) {
+        rv = image_save(sim, cpu_config.save_image);
+        if (rv != 0) {
+            cprintf(ANSI_C_RED,"Unable to write image file %s. Exiting.\n",cpu_config.save_image);
+        } else {
+            cprintf(ANSI_C_MAGENTA,"Saved program image to %s\n",cpu_config.save_image);
+        }
+        sim_destroy(sim);
+        return rv;
+    }
+    if (cpu_config.profile_functions && !symbols.count) {
+        cprintf(ANSI_C_YELLOW,"The program has no function symbols, ignoring --profile-functions.\n");
+        cpu_config.profile_functions = false;
+    }
+    // Sweep mode runs every configuration from a copy of the loaded program
+    if (sweep_config.enabled && cpu_config.trace_out) {
+        cprintf(ANSI_C_YELLOW,"Tracing is not available when sweeping, ignoring --trace-out.\n");
+    }
+    if (sweep_config.enabled) {
+        rv = sweep_run(&sweep_config, sim, &cache_config, argv[argc-1]);
+        sim_destroy(sim);
+        return rv;
+    }
+    // Replay mode sends a recorded trace through the caches instead of running the program
+    if (cpu_config.replay_trace) {
+        trace_reader_t *reader = trace_reader_open(cpu_config.replay_trace);
+        if (NULL == reader) {
+            cprintf(ANSI_C_RED,"Unable to read trace file %s. Exiting.\n",cpu_config.replay_trace);
+            sim_destroy(sim);
+            return 1;
+        }
+        replay_run(sim, reader);
+        trace_reader_close(reader);
+        cprintf(ANSI_C_MAGENTA,"\nReplayed %s in %d cycles\n",cpu_config.replay_trace,prof->cycles);
+        sim_print_summary_header();
+        sim_print_summary(sim, cpu_config.replay_trace);
+        sim_print_write_buffer(sim);
+        sim_print_mshr(sim);
+        sim_print_victims(sim);
+        sim_print_prefetch(sim);
+        sim_print_l2(sim);
+        sim_print_dram(sim);
+        sim_print_bus(sim);
+        sim_destroy(sim);
+        return 0;
     }
 
-    // Run the simulation
-    cprintf(ANSI_C_MAGENTA,"\nStarting simulation at pc = 0x%08x with flags = 0x%04x\n", pc, flags);
-    while (1) {
-        // Run a pipeline cycle
-        backup(ifid, idex, exmem, memwb, &pc);
-        writeback(memwb);
-        memory(exmem, memwb, &cache_config);
-        execute(idex, exmem);
-        decode(ifid, idex);
-        fetch(ifid, &pc, &cache_config);
-        hazard(ifid, idex, exmem, memwb, &pc, &cache_config);
-        if (cache_config.mode != CACHE_DISABLE) {
-            if(cache_config.inst_enabled){
-                prof->i_cache_status = ifid->status;
-                if (prof->i_cache_status_prev == CACHE_HIT) {
-                    prof->i_cache_access_count++;
-                    if (prof->i_cache_status == CACHE_HIT) {
-                        prof->i_cache_hit_count++;
-                    }
-                }
-                prof->i_cache_status_prev = prof->i_cache_status;
+    // Fast-forward functionally through the start of the program. None of
+    // this is profiled, but the caches may be warmed along the way.
+    bool halted = false;
+    if (cpu_config.ff_insts) {
+        uint32_t ff = sim_fast_forward(sim);
+        cprintf(ANSI_C_MAGENTA,"\nFast-forwarded %d instructions to pc = 0x%08x\n", ff, sim->pc);
+        halted = (sim->pc == 0);
+    }
+
+    if (cpu_config.trace_out) {
+        if (cpu_config.single_cycle) {
+            cprintf(ANSI_C_YELLOW,"Only the pipeline is traced, ignoring --trace-out.\n");
+        } else {
+            sim->trace_out = trace_writer_open(cpu_config.trace_out);
+            if (NULL == sim->trace_out) {
+                cprintf(ANSI_C_RED,"Unable to open trace file %s. Exiting.\n",cpu_config.trace_out);
+                sim_destroy(sim);
+                return 1;
             }
-            if (cache_config.data_enabled){
-                prof->d_cache_status = memwb->status;
-                if (prof->d_cache_status == CACHE_HIT && prof->d_cache_status_prev != CACHE_MISS){
-                    prof->d_cache_hit_count++;
-                    prof->d_cache_access_count++;
-                } else if (prof->d_cache_status == CACHE_MISS && prof->d_cache_status_prev != CACHE_MISS) {
-                    prof->d_cache_access_count++;
-                }
-                prof->d_cache_status_prev = prof->d_cache_status;
+        }
+    }
+
+    // Run the simulation
+    cprintf(ANSI_C_MAGENTA,"\nStarting simulation at pc = 0x%08x with flags = 0x%04x\n", sim->pc, flags);
+    while (cpu_config.single_cycle && !halted) {
+        // Every instruction takes one cycle. Run to completion (or the end of
+        // the detailed window) unless the interactive debugger needs to see every step.
+        uint32_t max_insts = 0;
+        if (cpu_config.detail_insts) max_insts = cpu_config.detail_insts - prof->instruction_count;
+        if (flags & MASK_INTERACTIVE || cpu_config.profile_functions) max_insts = 1;
+        pc_t fetch_pc = sim->pc;
+        prof->instruction_count += single_cycle_run(sim, &sim->pc, max_insts, false);
+        prof->cycles = prof->instruction_count;
+        if (cpu_config.profile_functions) {
+            elf_symbol_t *sym = elf_symbol_find(&symbols, fetch_pc);
+            if (sym) sym->cycles++, sym->insts++;
+        }
+        if (sim_done(sim)) break;
+        breakpoint_check(sim->pc);
+        if (flags & MASK_INTERACTIVE) { // Run interactive step
+            if (interactive(sim,&notes,prof->cycles,argv[argc-1]) !=0) return 1;
+        }
+    }
+    while (!cpu_config.single_cycle && !halted) {
+        // Run a pipeline cycle (several, if it is frozen waiting on memory).
+        // Stepping is kept for debugging output.
+        pc_t fetch_pc = sim->pc;
+        uint32_t insts = prof->instruction_count;
+        uint32_t cycles = sim_cycle(sim, !(flags & (MASK_DEBUG | MASK_INTERACTIVE)));
+        if (cpu_config.profile_functions) {
+            // Charged to the function being fetched from
+            elf_symbol_t *sym = elf_symbol_find(&symbols, fetch_pc);
+            if (sym) {
+                sym->cycles += cycles;
+                sym->insts += prof->instruction_count - insts;
             }
-            cache_digest();
         }
-        //printf("%d\n",prof->debug);
-        prof->cycles++;
-        // Check for a magic halt number (beq zero zero -1 or jr zero)
-        // if (ifid->instr == 0x1000ffff || ifid->instr == 0x00000008 || pc == 0) break;
-        if (pc ==0) break;
+        // Halted, or the end of the detailed simulation window
+        if (sim_done(sim)) break;
         // Breakpoint and interactive stuff
-        breakpoint_check(pc);
+        breakpoint_check(sim->pc);
         if (flags & MASK_INTERACTIVE) { // Run interactive step
-            if (interactive(lines,prof->cycles,argv[argc-1]) !=0) return 1;
+            if (interactive(sim,&notes,prof->cycles,argv[argc-1]) !=0) return 1;
         }
     }
-    cprintf(ANSI_C_MAGENTA,"\nHalted simulation at pc = 0x%08x after %d cycles\n",pc,prof->cycles);
+    // Loads still waiting in MSHRs get their data before the results are shown
+    if (!cpu_config.single_cycle) sim_drain(sim);
+    cprintf(ANSI_C_MAGENTA,"\nHalted simulation at pc = 0x%08x after %d cycles\n",sim->pc,prof->cycles);
+    if (sim->trace_out) {
+        sim->trace_out->instructions = prof->instruction_count;
+        bprintf("Wrote %llu trace records to %s\n",
+            (unsigned long long)sim->trace_out->records, cpu_config.trace_out);
+        if (trace_writer_close(sim->trace_out) != 0) {
+            cprintf(ANSI_C_RED,"Error writing trace file %s\n",cpu_config.trace_out);
+        }
+        sim->trace_out = NULL;
+    }
     // Flush data cache, if enabled, so we can see memory values
     if(cache_config.mode != CACHE_DISABLE && cache_config.data_enabled){
-        flush_dcache();
+        flush_dcache(sim);
     }
     // Dump registers and the first couple words of memory so we can see what's going on
-    if (flags & MASK_DEBUG) reg_dump();
-    mem_dump_cute(0,10);
+    if (flags & MASK_DEBUG) reg_dump(sim);
+    mem_dump_cute(sim,0,10);
     // Print out logistics for profiling
-    printf("$# %-6s | %-6s | %-6s | %-6s | %-6s | %-6s | %-6s | %-6s | %-8s | %-8s | File\n",
-        "Isize", "Dsize", "Iblock", "Dblock", "Dwrite", "Ihit %", "Dhit %", "CPI", "Cycles", "Icount");
-    if (cache_config.mode != CACHE_DISABLE) {
-        printf("$# %6d | %6d | %6d | %6d | %6s | %6.2f | %6.2f | %6.3f | %8d | %8d | %s\n",
-            cache_config.inst_size, cache_config.data_size,
-            cache_config.inst_block, cache_config.data_block,
-            (cache_config.data_wpolicy==CACHE_WRITEBACK?"WB":"WT"),
-            100*((float)prof->i_cache_hit_count)/((float)prof->i_cache_access_count),
-            100*((float)prof->d_cache_hit_count)/((float)prof->d_cache_access_count),
-            ((float)prof->cycles)/((float)prof->instruction_count), prof->cycles,
-            prof->instruction_count, argv[argc-1]);
+    sim_print_summary_header();
+    sim_print_summary(sim, argv[argc-1]);
+    sim_print_write_buffer(sim);
+    sim_print_mshr(sim);
+    sim_print_victims(sim);
+    sim_print_prefetch(sim);
+    sim_print_l2(sim);
+    sim_print_dram(sim);
+    sim_print_bus(sim);
+    if (cpu_config.profile_functions) elf_profile_print(&symbols, prof->cycles);
+
+    // Close memory, and clean up the pipeline, caches and the rest of the context
+    sim_destroy(sim);
+    annotations_free(&notes);
+    elf_symbols_free(&symbols);
+    return 0; // exit without errors
+}
+
+/* Parse a cache type, "direct" (or "d"), or "saN" (or "N") for an N-way set
+ * associative cache, N a power of two up to CACHE_MAX_WAYS. Returns false,
+ * changing nothing, if arg is neither. */
+static bool parse_cache_type(const char *arg, cache_type_t *type, unsigned int *ways) {
+    unsigned int n;
+    char extra;
+    if (!strcmp(arg,"direct") || !strcmp(arg,"d")) {
+        *type = CACHE_DIRECT;
+        return true;
+    }
+    if (!strncmp(arg,"sa",2)) arg += 2;
+    if (sscanf(arg,"%u%c",&n,&extra) != 1 || !n || (n&(n-1)) || n > CACHE_MAX_WAYS) return false;
+    *type = CACHE_ASSOC;
+    *ways = n;
+    return true;
+}
+
+// Parse a replacement policy: lru, plru, fifo or random
+static bool parse_cache_replace(const char *arg, cache_replace_t *replace) {
+    if (!strcmp(arg,"lru")) {
+        *replace = CACHE_LRU;
+    } else if (!strcmp(arg,"plru")) {
+        *replace = CACHE_PLRU;
+    } else if (!strcmp(arg,"fifo")) {
+        *replace = CACHE_FIFO;
+    } else if (!strcmp(arg,"random") || !strcmp(arg,"rand")) {
+        *replace = CACHE_RANDOM;
     } else {
-        printf("$# %6s | %6s | %6s | %6s | %6s | %6s | %6s | %6.3f | %8d | %8d | %s\n",
-            "n/a", "n/a", "n/a", "n/a", "n/a", "n/a", "n/a",
-            ((float)prof->cycles)/((float)prof->instruction_count), prof->cycles,
-            prof->instruction_count, argv[argc-1]);
+        return false;
     }
+    return true;
+}
 
-    // Close memory, and cleanup register files (we don't need to clean up registers)
-    pipeline_destroy(&ifid, &idex, &exmem, &memwb);
-    mem_close();
-    free(prof);
-    return 0; // exit without errors
+// Options with no short form, out of the range of the short ones
+enum long_only_option {
+    OPT_L2_SIZE = 256,
+    OPT_L2_BLOCK,
+    OPT_L2_TYPE,
+    OPT_L2_REPLACE,
+    OPT_L2_LATENCY,
+    OPT_L2_WRITE,
+    OPT_L2_FILL,
+    OPT_PREFETCH_I,
+    OPT_PREFETCH_D,
+    OPT_PREFETCH_DEGREE,
+    OPT_CACHE_VICTIMS,
+    OPT_CACHE_DALLOC,
+    OPT_DRAM,
+    OPT_BUS_MODE,
+    OPT_BUS_WIDTH,
+    OPT_BUS_ARBITRATION,
+    OPT_BUS_DRAIN,
+};
+
+// Parse a prefetcher: none, next-line, stream or stride
+static bool parse_cache_prefetch(const char *arg, cache_prefetch_t *prefetch) {
+    if (!strcmp(arg,"none")) {
+        *prefetch = PREFETCH_NONE;
+    } else if (!strcmp(arg,"next-line") || !strcmp(arg,"next")) {
+        *prefetch = PREFETCH_NEXT_LINE;
+    } else if (!strcmp(arg,"stream")) {
+        *prefetch = PREFETCH_STREAM;
+    } else if (!strcmp(arg,"stride")) {
+        *prefetch = PREFETCH_STRIDE;
+    } else {
+        return false;
+    }
+    return true;
 }
 
 /* Parse command line arguments and options
  * Returns > 1 on error, or -1 if no error occurred but the caller should still exit */
 int arguments(int argc, char **argv, FILE** source_fp,
-        cpu_config_t *cpu_cfg, cache_config_t *cache_cfg) {
+        cpu_config_t *cpu_cfg, cache_config_t *cache_cfg, sweep_config_t *sweep_cfg) {
 
     /* Parse command line options with getopt */
     int c;
     int option_index = 0;
-    int32_t temp, srv;
+    int32_t temp, temp2, srv;
     //opterr = 0; // disable getopt_long default errors
     while (1) {
         static struct option long_options[] = {
@@ -243,32 +488,73 @@ int arguments(int argc, char **argv, FILE** source_fp,
             {"help",            no_argument,        0, 'h'},
             {"interactive",     no_argument,        0, 'i'},
             {"sanity",          no_argument,        0, 'y'},
+            {"save-image",      required_argument,  0, 'X'}, // file name
             {"version",         no_argument,        0, 'V'},
             {"verbose",         no_argument,        0, 'v'},
             /* CPU options */
             {"single-cycle",    no_argument,        0, 'g'},
-            {"mem-size",        required_argument,  0, 'm'}, // 2^n, 0 <= n < 15
+            {"mem-size",        required_argument,  0, 'm'}, // 2^n, 0 <= n <= 30
+            {"ff-insts",        required_argument,  0, 'f'}, // instruction count
+            {"ff-warm",         no_argument,        0, 'w'},
+            {"detail-insts",    required_argument,  0, 'n'}, // instruction count
+            {"trace-out",       required_argument,  0, 'O'}, // file name
+            {"replay-trace",    required_argument,  0, 'R'}, // file name
+            {"profile-functions", no_argument,      0, 'P'},
             /* Cache options */
             {"cache-mode",      required_argument,  0, 'C'}, // (disabled,split,unified)
             /* Split cache options */
             {"cache-data",      required_argument,  0, 'D'}, // (enabled,disabled)
             {"cache-dsize",     required_argument,  0, 'E'}, // 2^n, 0 < n <= 15
             {"cache-dblock",    required_argument,  0, 'F'}, // 2^n, 0 < n <= 7
-            {"cache-dtype",     required_argument,  0, 'G'}, // (direct,sa2)
+            {"cache-dtype",     required_argument,  0, 'G'}, // (direct,saN)
+            {"cache-dreplace",  required_argument,  0, 'Q'}, // (lru,plru,fifo,random)
             {"cache-dwrite",    required_argument,  0, 'H'}, // (back,thru)
+            {"cache-dalloc",    required_argument,  0, OPT_CACHE_DALLOC}, // (allocate,no-allocate)
             {"cache-inst",      required_argument,  0, 'I'}, // (enabled,disabled)
             {"cache-isize",     required_argument,  0, 'J'}, // 2^n, 0 < n <= 15
             {"cache-iblock",    required_argument,  0, 'K'}, // 2^n, 0 < n <= 7
-            {"cache-itype",     required_argument,  0, 'L'}, // (direct,sa2)
+            {"cache-itype",     required_argument,  0, 'L'}, // (direct,saN)
+            {"cache-ireplace",  required_argument,  0, 'U'}, // (lru,plru,fifo,random)
             {"cache-iwrite",    required_argument,  0, 'M'}, // (back,thru)
             /* Unified cache options */
             {"cache-block",     required_argument,  0, 'B'}, // 2^n, 0 < n <= 15
             {"cache-size",      required_argument,  0, 'S'}, // 2^n, 0 < n <= 7
-            {"cache-type",      required_argument,  0, 'T'}, // (direct,sa2)
+            {"cache-type",      required_argument,  0, 'T'}, // (direct,saN)
+            {"cache-replace",   required_argument,  0, 'A'}, // (lru,plru,fifo,random)
             {"cache-write",     required_argument,  0, 'W'}, // (back,thru)
+            /* Options for every cache */
+            {"fill-order",      required_argument,  0, 'Z'}, // (sequential,critical-first)
+            {"write-buffer",    required_argument,  0, 'N'}, // entries, 0 < n <= 64
+            {"cache-mshrs",     required_argument,  0, 'Y'}, // MSHRs, 0 <= n <= 16
+            {"cache-victims",   required_argument,  0, OPT_CACHE_VICTIMS}, // entries, 0 <= n <= 16
+            /* Second level cache options */
+            {"l2-size",         required_argument,  0, OPT_L2_SIZE},    // 2^n bytes, 0 for none
+            {"l2-block",        required_argument,  0, OPT_L2_BLOCK},   // 2^n, 0 < n <= 15
+            {"l2-type",         required_argument,  0, OPT_L2_TYPE},    // (direct,saN)
+            {"l2-replace",      required_argument,  0, OPT_L2_REPLACE}, // (lru,plru,fifo,random)
+            {"l2-latency",      required_argument,  0, OPT_L2_LATENCY}, // cycles, 0 < n <= 64
+            {"l2-write",        required_argument,  0, OPT_L2_WRITE},   // (back,thru)
+            {"l2-fill",         required_argument,  0, OPT_L2_FILL},    // (inclusive,exclusive)
+            /* Main memory options */
+            {"dram",            required_argument,  0, OPT_DRAM},       // configuration file
+            {"bus-mode",        required_argument,  0, OPT_BUS_MODE},   // (serial,split)
+            {"bus-width",       required_argument,  0, OPT_BUS_WIDTH},  // words, 0 < n <= 8
+            {"bus-arbitration", required_argument,  0, OPT_BUS_ARBITRATION}, // (fixed,round-robin,read-first)
+            {"bus-drain",       required_argument,  0, OPT_BUS_DRAIN},  // high:low, write buffer entries
+            /* Prefetch options */
+            {"prefetch-i",      required_argument,  0, OPT_PREFETCH_I}, // (none,next-line,stream)
+            {"prefetch-d",      required_argument,  0, OPT_PREFETCH_D}, // (none,next-line,stream,stride)
+            {"prefetch-degree", required_argument,  0, OPT_PREFETCH_DEGREE}, // blocks, 0 < n <= 8
+            /* Sweep options */
+            {"sweep",           no_argument,        0, 's'},
+            {"sweep-sizes",     required_argument,  0, 'z'}, // I:D,I:D,...
+            {"sweep-blocks",    required_argument,  0, 'b'}, // 2^n,2^n,...
+            {"sweep-dwrite",    required_argument,  0, 'p'}, // (back,thru),...
+            {"sweep-threads",   required_argument,  0, 't'}, // thread count
+            {"sweep-single-pass", no_argument,      0, 'o'},
             {0, 0, 0, 0}
         };
-        c = getopt_long (argc, argv, "ac:dhiyVvgm:C:D:E:F:G:H:I:J:K:L:M:B:S:T:W:",long_options, &option_index);
+        c = getopt_long (argc, argv, "ac:dhiyX:Vvgm:f:wn:C:D:E:F:G:Q:H:I:J:K:L:U:M:B:S:T:A:W:Z:N:Y:sz:b:p:t:oO:R:P",long_options, &option_index);
         if (c == -1) break; // Detect the end of the options.
 
         switch (c) {
@@ -294,13 +580,15 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 bprintf("Debug output enabled (flags = 0x%04x).\n",flags);
                 break;
             case 'h': // --help
-                printf( "Usage: %s [OPTION]... FILE[.s,.txt]\n" \
+                printf( "Usage: %s [OPTION]... FILE[.s,.txt,ELF]\n" \
                         "   or: %s [--help|-h]\n" \
                         "   or: %s [--version|-V]\n" \
                         "  Run %s on an assembly source file, simulating a MIPS CPU execution of FILE,\n" \
                         "  or with [--help|h], display this usage information and exit,\n"
                         "  or with [--version|-V], display the version and exit.\n" \
-                        "  One, and only one, assembly file must be provided for simulation.\n\n" \
+                        "  One, and only one, assembly file must be provided for simulation.\n" \
+                        "  FILE may also be a big-endian 32-bit MIPS ELF executable, which is\n" \
+                        "  loaded by its segments and starts at its entry point.\n\n" \
                         "General simulator options:\n" \
                         "   "ANSI_BOLD"-a, --alternate"ANSI_RESET"\n" \
                         "   \tAlternate assembly format, expects lines like\n" \
@@ -320,6 +608,10 @@ int arguments(int argc, char **argv, FILE** source_fp,
                         "   \tbased debugging.\n" \
                         "   "ANSI_BOLD"--sanity, -y"ANSI_RESET"\n" \
                         "   \tEnables internal sanity checking with a slight speed penalty.\n" \
+                        "   "ANSI_BOLD"--save-image "ANSI_RUNDER"file"ANSI_RBOLD", -X "ANSI_RUNDER"file"ANSI_RESET"\n" \
+                        "   \tLoads the program, writes it to "ANSI_UNDER"file"ANSI_RESET" as a binary image and exits.\n" \
+                        "   \tAn image can be given in place of FILE, and loads without parsing\n" \
+                        "   \t(see src/image.h).\n" \
                         "   "ANSI_BOLD"--version, -V"ANSI_RESET"\n" \
                         "   \tPrints simulator version information.\n" \
                         "   "ANSI_BOLD"--verbose, -v"ANSI_RESET"\n" \
@@ -327,10 +619,23 @@ int arguments(int argc, char **argv, FILE** source_fp,
                         "CPU configuration options:\n" \
                         "   "ANSI_BOLD"--single-cycle, -g"ANSI_RESET"\n" \
                         "   \tModels a single-cycle CPU, where each instruction takes one cycle.\n" \
+                        "   \tThis is a fast functional model; caches are not simulated.\n" \
                         "   \tIf not set, the default is a five-stage pipeline architecture.\n" \
                         "   "ANSI_BOLD"--mem-size "ANSI_RUNDER"size"ANSI_RBOLD", -m "ANSI_RUNDER"size"ANSI_RESET"\n" \
-                        "   \tSets the size of main program memory. Defaults to %d bytes.\n" \
-                        "Cache configuration options:\n" \
+                        "   \tSets the size of main program memory, a power of two up to 1 GB.\n" \
+                        "   \tOnly the pages a program writes take space. Defaults to %d bytes.\n" \
+                        "   "ANSI_BOLD"--ff-insts "ANSI_RUNDER"n"ANSI_RBOLD", -f "ANSI_RUNDER"n"ANSI_RESET"\n" \
+                        "   \tFast-forwards through the first "ANSI_UNDER"n"ANSI_RESET" instructions with the functional\n" \
+                        "   \tsingle-cycle model before starting detailed simulation. Fast-forwarded\n" \
+                        "   \tinstructions are not included in the profile. Defaults to 0.\n" \
+                        "   "ANSI_BOLD"--ff-warm, -w"ANSI_RESET"\n" \
+                        "   \tWarms up the caches while fast-forwarding, so detailed simulation does\n" \
+                        "   \tnot start with cold caches.\n" \
+                        "   "ANSI_BOLD"--detail-insts "ANSI_RUNDER"n"ANSI_RBOLD", -n "ANSI_RUNDER"n"ANSI_RESET"\n" \
+                        "   \tStops the simulation after "ANSI_UNDER"n"ANSI_RESET" instructions have been simulated in detail.\n" \
+                        "   \tDefaults to 0, which runs the program to completion.\n", \
+                        TARGET_STRING,TARGET_STRING,TARGET_STRING,TARGET_STRING,DEFAULT_MEM_SIZE);
+                printf( "Cache configuration options:\n" \
                         "   "ANSI_BOLD"--cache-mode "ANSI_RUNDER"mode"ANSI_RBOLD", -C "ANSI_RUNDER"mode"ANSI_RESET"\n" \
                         "   \tSets the cache mode, where "ANSI_UNDER"mode"ANSI_RESET" must be ("ANSI_BOLD"disabled,split,unified"ANSI_RESET").\n" \
                         "   \t"ANSI_BOLD"disabled"ANSI_RESET" - turns off all caching.\n" \
@@ -355,9 +660,15 @@ int arguments(int argc, char **argv, FILE** source_fp,
                         "   "ANSI_BOLD"--cache-dtype "ANSI_RUNDER"type"ANSI_RBOLD", -G "ANSI_RUNDER"type"ANSI_RESET"\n" \
                         "   "ANSI_BOLD"--cache-itype "ANSI_RUNDER"type"ANSI_RBOLD", -L "ANSI_RUNDER"type"ANSI_RESET"\n" \
                         "   \tSets the type of the unified, data, or instruction cache,\n" \
-                        "   \trespectively. "ANSI_UNDER"type"ANSI_RESET" must be ("ANSI_BOLD"direct,sa2"ANSI_RESET").\n" \
+                        "   \trespectively. "ANSI_UNDER"type"ANSI_RESET" must be ("ANSI_BOLD"direct,saN"ANSI_RESET").\n" \
                         "   \t"ANSI_BOLD"direct"ANSI_RESET" - uses a direct-mapped cache.\n" \
-                        "   \t"ANSI_BOLD"sa2"ANSI_RESET" - uses a 2-way set associative cache.\n" \
+                        "   \t"ANSI_BOLD"saN"ANSI_RESET" - uses an N-way set associative cache, N = 1, 2, 4, 8 or 16.\n" \
+                        "   "ANSI_BOLD"--cache-replace "ANSI_RUNDER"policy"ANSI_RBOLD", -A "ANSI_RUNDER"policy"ANSI_RESET"\n" \
+                        "   "ANSI_BOLD"--cache-dreplace "ANSI_RUNDER"policy"ANSI_RBOLD", -Q "ANSI_RUNDER"policy"ANSI_RESET"\n" \
+                        "   "ANSI_BOLD"--cache-ireplace "ANSI_RUNDER"policy"ANSI_RBOLD", -U "ANSI_RUNDER"policy"ANSI_RESET"\n" \
+                        "   \tSets the replacement policy of the unified, data, or instruction\n" \
+                        "   \tset associative cache, respectively. "ANSI_UNDER"policy"ANSI_RESET" must be\n" \
+                        "   \t("ANSI_BOLD"lru,plru,fifo,random"ANSI_RESET"), defaults to lru.\n" \
                         "   "ANSI_BOLD"--cache-write "ANSI_RUNDER"policy"ANSI_RBOLD", -W "ANSI_RUNDER"policy"ANSI_RESET"\n" \
                         "   "ANSI_BOLD"--cache-dwrite "ANSI_RUNDER"policy"ANSI_RBOLD", -H "ANSI_RUNDER"policy"ANSI_RESET"\n" \
                         "   "ANSI_BOLD"--cache-iwrite "ANSI_RUNDER"policy"ANSI_RBOLD", -M "ANSI_RUNDER"policy"ANSI_RESET"\n" \
@@ -365,8 +676,131 @@ int arguments(int argc, char **argv, FILE** source_fp,
                         "   \trespectively. "ANSI_UNDER"policy"ANSI_RESET" must be ("ANSI_BOLD"back,thru"ANSI_RESET").\n" \
                         "   \t"ANSI_BOLD"back"ANSI_RESET" - uses a writeback policy.\n" \
                         "   \t"ANSI_BOLD"thru"ANSI_RESET" - uses a writethrough policy.\n" \
-                        "\nEmail bug reports to /dev/null\n", \
-                        TARGET_STRING,TARGET_STRING,TARGET_STRING,TARGET_STRING,DEFAULT_MEM_SIZE);
+                        "   "ANSI_BOLD"--cache-dalloc "ANSI_RUNDER"policy"ANSI_RESET"\n" \
+                        "   \tSets what a store that misses in the data or unified cache does.\n" \
+                        "   \t"ANSI_UNDER"policy"ANSI_RESET" must be ("ANSI_BOLD"allocate,no-allocate"ANSI_RESET"), defaults to allocate.\n" \
+                        "   \t"ANSI_BOLD"allocate"ANSI_RESET" - fills the block, then writes the word into it.\n" \
+                        "   \t"ANSI_BOLD"no-allocate"ANSI_RESET" - goes straight to the write buffer without a fill, and\n" \
+                        "   \tonly stalls if the buffer is full.\n");
+                printf( "   "ANSI_BOLD"--fill-order "ANSI_RUNDER"order"ANSI_RBOLD", -Z "ANSI_RUNDER"order"ANSI_RESET"\n" \
+                        "   \tSets the order in which every cache fetches the words of a block that\n" \
+                        "   \tmissed. "ANSI_UNDER"order"ANSI_RESET" must be ("ANSI_BOLD"sequential,critical-first"ANSI_RESET"), defaults to sequential.\n" \
+                        "   \t"ANSI_BOLD"sequential"ANSI_RESET" - from the first word of the block to the last.\n" \
+                        "   \t"ANSI_BOLD"critical-first"ANSI_RESET" - the word that missed first, then the ones after it,\n" \
+                        "   \twrapping around. Either way the access that missed goes on as soon\n" \
+                        "   \tas its word is in, while the rest of the block streams in.\n" \
+                        "   "ANSI_BOLD"--write-buffer "ANSI_RUNDER"n"ANSI_RBOLD", -N "ANSI_RUNDER"n"ANSI_RESET"\n" \
+                        "   \tSets the number of entries in the write buffer, each holding the\n" \
+                        "   \tpending words of one block. Writes to a block already waiting in the\n" \
+                        "   \tbuffer are merged into its entry. "ANSI_UNDER"n"ANSI_RESET" must be 0 < n <= 64, defaults to 1.\n" \
+                        "   "ANSI_BOLD"--cache-mshrs "ANSI_RUNDER"n"ANSI_RBOLD", -Y "ANSI_RUNDER"n"ANSI_RESET"\n" \
+                        "   \tGives the data cache "ANSI_UNDER"n"ANSI_RESET" miss status holding registers, so a load that\n" \
+                        "   \tmisses only stalls the instructions that use its register, and other\n" \
+                        "   \taccesses keep hitting meanwhile. "ANSI_UNDER"n"ANSI_RESET" must be 0 <= n <= 16, defaults to 0,\n" \
+                        "   \twhich blocks on every miss.\n" \
+                        "   "ANSI_BOLD"--cache-victims "ANSI_RUNDER"n"ANSI_RESET"\n" \
+                        "   \tGives each direct mapped cache a fully associative victim cache of "ANSI_UNDER"n"ANSI_RESET"\n" \
+                        "   \tblocks, holding the last blocks it replaced. A miss to one of them\n" \
+                        "   \tswaps it back in after a short wait. "ANSI_UNDER"n"ANSI_RESET" must be 0 <= n <= 16, defaults\n" \
+                        "   \tto 0, no victim cache.\n" \
+                        "\n");
+                printf( "Second level cache options:\n" \
+                        "   "ANSI_BOLD"--l2-size "ANSI_RUNDER"size"ANSI_RESET"\n" \
+                        "   \tAdds a unified L2 cache of "ANSI_UNDER"size"ANSI_RESET" bytes behind the caches above, a power\n" \
+                        "   \tof two. Their misses are served from it before main memory. Defaults\n" \
+                        "   \tto 0, no L2.\n" \
+                        "   "ANSI_BOLD"--l2-block "ANSI_RUNDER"size"ANSI_RESET"\n" \
+                        "   \tSets the block size of the L2 in words, at least that of the caches\n" \
+                        "   \tabove it. Defaults to 8.\n" \
+                        "   "ANSI_BOLD"--l2-type "ANSI_RUNDER"type"ANSI_RESET"\n" \
+                        "   "ANSI_BOLD"--l2-replace "ANSI_RUNDER"policy"ANSI_RESET"\n" \
+                        "   \tSet the type and replacement policy of the L2, as for the caches\n" \
+                        "   \tabove. Default to sa4 and lru.\n" \
+                        "   "ANSI_BOLD"--l2-latency "ANSI_RUNDER"cycles"ANSI_RESET"\n" \
+                        "   \tSets the cycles the L2 takes for the first word of a hit, or to find\n" \
+                        "   \tit has to go to memory. Each word after the first takes one more.\n" \
+                        "   \tMust be 0 < n <= 64, defaults to 4.\n" \
+                        "   "ANSI_BOLD"--l2-write "ANSI_RUNDER"policy"ANSI_RESET"\n" \
+                        "   \tSets the write policy of the L2, ("ANSI_BOLD"back,thru"ANSI_RESET"), defaults to back.\n" \
+                        "   "ANSI_BOLD"--l2-fill "ANSI_RUNDER"policy"ANSI_RESET"\n" \
+                        "   \tSets what the L2 holds, ("ANSI_BOLD"inclusive,exclusive"ANSI_RESET"), defaults to inclusive.\n" \
+                        "   \t"ANSI_BOLD"inclusive"ANSI_RESET" - every block filled into the caches above is filled into it,\n" \
+                        "   \tand a block it replaces is taken out of the caches above.\n" \
+                        "   \t"ANSI_BOLD"exclusive"ANSI_RESET" - it only holds blocks the caches above replaced, and a\n" \
+                        "   \tblock moves up out of it when it hits.\n" \
+                        "\n");
+                printf( "Main memory options:\n" \
+                        "   "ANSI_BOLD"--dram "ANSI_RUNDER"file"ANSI_RESET"\n" \
+                        "   \tTimes main memory as DRAM banks with open rows, set up by "ANSI_UNDER"file"ANSI_RESET"\n" \
+                        "   \t(see dram.cfg), instead of a fixed penalty for every access. An\n" \
+                        "   \taccess to an open row is faster than one that has to open its row,\n" \
+                        "   \tor close another one first.\n" \
+                        "   "ANSI_BOLD"--bus-mode "ANSI_RUNDER"mode"ANSI_RESET"\n" \
+                        "   \tSets how the fills and the write buffer share the bus to memory,\n" \
+                        "   \t("ANSI_BOLD"serial,split"ANSI_RESET"), defaults to serial.\n" \
+                        "   \t"ANSI_BOLD"serial"ANSI_RESET" - one transaction at a time, from its request to its last word.\n" \
+                        "   \t"ANSI_BOLD"split"ANSI_RESET" - the waits for first words overlap, only words hold the bus.\n" \
+                        "   "ANSI_BOLD"--bus-width "ANSI_RUNDER"n"ANSI_RESET"\n" \
+                        "   \tSets the words the bus carries at a time after the first word of a\n" \
+                        "   \tmemory access. "ANSI_UNDER"n"ANSI_RESET" must be 0 < n <= 8, defaults to 1.\n" \
+                        "   "ANSI_BOLD"--bus-arbitration "ANSI_RUNDER"policy"ANSI_RESET"\n" \
+                        "   \tSets who gets the bus when more than one is waiting,\n" \
+                        "   \t("ANSI_BOLD"fixed,round-robin,read-first"ANSI_RESET"), defaults to fixed.\n" \
+                        "   \t"ANSI_BOLD"fixed"ANSI_RESET" - the D cache, then the I cache, then the write buffer.\n" \
+                        "   \t"ANSI_BOLD"round-robin"ANSI_RESET" - each in turn.\n" \
+                        "   \t"ANSI_BOLD"read-first"ANSI_RESET" - the caches, until the write buffer needs draining.\n" \
+                        "   "ANSI_BOLD"--bus-drain "ANSI_RUNDER"high:low"ANSI_RESET"\n" \
+                        "   \tWith read-first, the write buffer goes first once it holds "ANSI_UNDER"high"ANSI_RESET"\n" \
+                        "   \tentries, until it is down to "ANSI_UNDER"low"ANSI_RESET". Defaults to 0:0, a full buffer.\n" \
+                        "\n");
+                printf( "Prefetch options:\n" \
+                        "   "ANSI_BOLD"--prefetch-i "ANSI_RUNDER"prefetcher"ANSI_RESET"\n" \
+                        "   "ANSI_BOLD"--prefetch-d "ANSI_RUNDER"prefetcher"ANSI_RESET"\n" \
+                        "   \tSets the prefetcher for instruction fetches, or for loads and stores.\n" \
+                        "   \tPrefetches are fetched only while memory has nothing else to do.\n" \
+                        "   \t"ANSI_UNDER"prefetcher"ANSI_RESET" must be ("ANSI_BOLD"none,next-line,stream,stride"ANSI_RESET"), defaults to none.\n" \
+                        "   \t"ANSI_BOLD"next-line"ANSI_RESET" - the blocks after one that missed or was prefetched.\n" \
+                        "   \t"ANSI_BOLD"stream"ANSI_RESET" - the blocks ahead of misses to neighbouring blocks, going\n" \
+                        "   \tup or down.\n" \
+                        "   \t"ANSI_BOLD"stride"ANSI_RESET" - the next addresses of a load or store whose address keeps\n" \
+                        "   \tchanging by the same amount. Data only.\n" \
+                        "   "ANSI_BOLD"--prefetch-degree "ANSI_RUNDER"n"ANSI_RESET"\n" \
+                        "   \tSets how many blocks ahead the prefetchers fetch. "ANSI_UNDER"n"ANSI_RESET" must be\n" \
+                        "   \t0 < n <= 8, defaults to 1.\n" \
+                        "\n");
+                printf( "Sweep options:\n" \
+                        "   "ANSI_BOLD"--sweep"ANSI_RESET"\n" \
+                        "   \tRuns every combination of the sweep lists below as a split cache, in\n" \
+                        "   \tparallel, and prints one summary line per configuration. Lists not\n" \
+                        "   \tgiven take their value from the cache options. Any list implies --sweep.\n" \
+                        "   "ANSI_BOLD"--sweep-sizes "ANSI_RUNDER"I:D,..."ANSI_RESET"\n" \
+                        "   \tInstruction and data cache size pairs; a single "ANSI_UNDER"size"ANSI_RESET" is used for both.\n" \
+                        "   "ANSI_BOLD"--sweep-blocks "ANSI_RUNDER"size,..."ANSI_RESET"\n" \
+                        "   \tBlock sizes, used for both caches.\n" \
+                        "   "ANSI_BOLD"--sweep-dwrite "ANSI_RUNDER"policy,..."ANSI_RESET"\n" \
+                        "   \tData cache write policies, each ("ANSI_BOLD"back,thru"ANSI_RESET").\n" \
+                        "   "ANSI_BOLD"--sweep-threads "ANSI_RUNDER"n"ANSI_RESET"\n" \
+                        "   \tNumber of worker threads, defaults to one per online CPU.\n" \
+                        "   "ANSI_BOLD"--sweep-single-pass"ANSI_RESET"\n" \
+                        "   \tRecords the program's address stream once and finds the hit rates of\n" \
+                        "   \tevery configuration from it, without timing (CPI and cycles are n/a).\n" \
+                        "   \tThe caches are evaluated as direct-mapped.\n" \
+                        "\nTrace options:\n" \
+                        "   "ANSI_BOLD"--trace-out "ANSI_RUNDER"file"ANSI_RBOLD", -O "ANSI_RUNDER"file"ANSI_RESET"\n" \
+                        "   \tWrites every instruction fetch and data access the pipeline completes\n" \
+                        "   \t(pc, address, size, read/write and cycle) to "ANSI_UNDER"file"ANSI_RESET", in a compact binary\n" \
+                        "   \tformat (see src/trace.h).\n" \
+                        "   "ANSI_BOLD"--replay-trace "ANSI_RUNDER"file"ANSI_RBOLD", -R "ANSI_RUNDER"file"ANSI_RESET"\n" \
+                        "   \tSends the accesses of a trace written by --trace-out through the caches\n" \
+                        "   \tinstead of running a program, and prints the usual summary. Any cache\n" \
+                        "   \tsettings can be used; the program file is optional. Caches warmed while\n" \
+                        "   \tfast-forwarding the recorded run start out cold. A trace has no register\n" \
+                        "   \tdependences, so with --cache-mshrs no instruction waits for a load and\n" \
+                        "   \tthe cycles are optimistic.\n" \
+                        "   "ANSI_BOLD"--profile-functions"ANSI_RESET"\n" \
+                        "   \tPrints the cycles and instructions spent in each function of an ELF\n" \
+                        "   \texecutable, charged to the function the pipeline is fetching from.\n" \
+                        "\nEmail bug reports to /dev/null\n");
                 return -1; // caller should exit
             case 'i': // --interactive
                 flags |= MASK_INTERACTIVE;
@@ -376,6 +810,10 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 flags |= MASK_SANITY;
                 bprintf("Sanity checks enabled (flags = 0x%04x).\n",flags);
                 break;
+            case 'X': // --save-image
+                cpu_cfg->save_image = optarg;
+                bprintf("Program image will be written to %s.\n",cpu_cfg->save_image);
+                break;
             case 'V': // --version
                 printf("%s - MIPS I CPU simulator (v. %s)\n",TARGET_STRING,VERSION_STRING);
                 return -1; // caller should exit
@@ -393,7 +831,7 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 if (!srv) {
                     cprintf(ANSI_C_YELLOW,"Memory size must be a number: %s\n",optarg);
                 } else {
-                    if ((temp!=0) && !(temp&(temp-1)) && temp <= (2<<15)) {
+                    if ((temp > 0) && !(temp&(temp-1)) && temp <= (1<<30)) {
                         cpu_cfg->mem_size = temp;
                     } else {
                         cprintf(ANSI_C_YELLOW,"Invalid memory size: %d\n", temp);
@@ -401,6 +839,40 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 }
                 bprintf("CPU$ memory size set to %ld.\n",cpu_cfg->mem_size);
                 break;
+            case 'f': // --ff-insts
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv || temp < 0) {
+                    cprintf(ANSI_C_YELLOW,"Invalid fast-forward instruction count: %s\n",optarg);
+                } else {
+                    cpu_cfg->ff_insts = temp;
+                }
+                bprintf("CPU$ fast-forward set to %u instructions.\n",cpu_cfg->ff_insts);
+                break;
+            case 'w': // --ff-warm
+                cpu_cfg->ff_warm = true;
+                bprintf("CPU$ cache warming during fast-forward enabled.\n");
+                break;
+            case 'n': // --detail-insts
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv || temp < 0) {
+                    cprintf(ANSI_C_YELLOW,"Invalid detailed instruction count: %s\n",optarg);
+                } else {
+                    cpu_cfg->detail_insts = temp;
+                }
+                bprintf("CPU$ detailed simulation set to %u instructions.\n",cpu_cfg->detail_insts);
+                break;
+            case 'O': // --trace-out
+                cpu_cfg->trace_out = optarg;
+                bprintf("CPU$ memory reference trace will be written to %s.\n",cpu_cfg->trace_out);
+                break;
+            case 'R': // --replay-trace
+                cpu_cfg->replay_trace = optarg;
+                bprintf("CPU$ replaying trace %s through the caches.\n",cpu_cfg->replay_trace);
+                break;
+            case 'P': // --profile-functions
+                cpu_cfg->profile_functions = true;
+                bprintf("CPU$ per-function profile enabled.\n");
+                break;
             /* Cache options */
             case 'C': // --cache-mode
                 if (!strcmp(optarg,"disabled") || !strcmp(optarg,"d")) {
@@ -452,14 +924,20 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 bprintf("CACHE$ data cache block size set to %d.\n",cache_cfg->data_block);
                 break;
             case 'G': // --cache-dtype
-                if (!strcmp(optarg,"direct") || !strcmp(optarg,"d")) {
-                    cache_cfg->data_type = CACHE_DIRECT;
-                } else if (!strcmp(optarg,"sa2") || !strcmp(optarg,"2")) {
-                    cache_cfg->data_type = CACHE_SA2;
-                } else {
+                if (!parse_cache_type(optarg,&cache_cfg->data_type,&cache_cfg->data_ways)) {
                     cprintf(ANSI_C_YELLOW,"Invalid d-cache type: %s\n", optarg);
                 }
-                bprintf("CACHE$ data cache type set to %s.\n",CACHE_TYPE_STRINGS[cache_cfg->data_type]);
+                if (cache_cfg->data_type == CACHE_ASSOC) {
+                    bprintf("CACHE$ data cache type set to %d-way %s.\n",cache_cfg->data_ways,CACHE_TYPE_STRINGS[cache_cfg->data_type]);
+                } else {
+                    bprintf("CACHE$ data cache type set to %s.\n",CACHE_TYPE_STRINGS[cache_cfg->data_type]);
+                }
+                break;
+            case 'Q': // --cache-dreplace
+                if (!parse_cache_replace(optarg,&cache_cfg->data_replace)) {
+                    cprintf(ANSI_C_YELLOW,"Invalid d-cache replacement policy: %s\n", optarg);
+                }
+                bprintf("CACHE$ data cache replacement policy set to %s.\n",CACHE_REPLACE_STRINGS[cache_cfg->data_replace]);
                 break;
             case 'H': // --cache-dwrite
                 if (!strcmp(optarg,"through") || !strcmp(optarg,"thru") || !strcmp(optarg,"t")) {
@@ -471,6 +949,16 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 }
                 bprintf("CACHE$ data cache write policy set to %s.\n",CACHE_WPOLICY_STRINGS[cache_cfg->data_wpolicy]);
                 break;
+            case OPT_CACHE_DALLOC: // --cache-dalloc
+                if (!strcmp(optarg,"allocate") || !strcmp(optarg,"a")) {
+                    cache_cfg->data_alloc = CACHE_ALLOCATE;
+                } else if (!strcmp(optarg,"no-allocate") || !strcmp(optarg,"n")) {
+                    cache_cfg->data_alloc = CACHE_NO_ALLOCATE;
+                } else {
+                    cprintf(ANSI_C_YELLOW,"Invalid data cache allocation policy: %s\n", optarg);
+                }
+                bprintf("CACHE$ data cache store misses set to %s.\n",CACHE_ALLOC_STRINGS[cache_cfg->data_alloc]);
+                break;
             case 'I': // --cache-inst
                 if (!strcmp(optarg,"disabled") || !strcmp(optarg,"d") || !strcmp(optarg,"0")) {
                     cache_cfg->inst_enabled = false;
@@ -508,14 +996,20 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 bprintf("CACHE$ instruction cache block size set to %d.\n",cache_cfg->inst_block);
                 break;
             case 'L': // --cache-itype
-                if (!strcmp(optarg,"direct") || !strcmp(optarg,"d")) {
-                    cache_cfg->inst_type = CACHE_DIRECT;
-                } else if (!strcmp(optarg,"sa2") || !strcmp(optarg,"2")) {
-                    cache_cfg->inst_type = CACHE_SA2;
-                } else {
+                if (!parse_cache_type(optarg,&cache_cfg->inst_type,&cache_cfg->inst_ways)) {
                     cprintf(ANSI_C_YELLOW,"Invalid i-cache type: %s\n", optarg);
                 }
-                bprintf("CACHE$ instruction cache type set to %s.\n",CACHE_TYPE_STRINGS[cache_cfg->inst_type]);
+                if (cache_cfg->inst_type == CACHE_ASSOC) {
+                    bprintf("CACHE$ instruction cache type set to %d-way %s.\n",cache_cfg->inst_ways,CACHE_TYPE_STRINGS[cache_cfg->inst_type]);
+                } else {
+                    bprintf("CACHE$ instruction cache type set to %s.\n",CACHE_TYPE_STRINGS[cache_cfg->inst_type]);
+                }
+                break;
+            case 'U': // --cache-ireplace
+                if (!parse_cache_replace(optarg,&cache_cfg->inst_replace)) {
+                    cprintf(ANSI_C_YELLOW,"Invalid i-cache replacement policy: %s\n", optarg);
+                }
+                bprintf("CACHE$ instruction cache replacement policy set to %s.\n",CACHE_REPLACE_STRINGS[cache_cfg->inst_replace]);
                 break;
             case 'M': // --cache-iwrite
                 if (!strcmp(optarg,"through") || !strcmp(optarg,"thru") || !strcmp(optarg,"t")) {
@@ -555,14 +1049,20 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 bprintf("CACHE$ cache size set to %d.\n",cache_cfg->size);
                 break;
             case 'T': // --cache-type
-                if (!strcmp(optarg,"direct") || !strcmp(optarg,"d")) {
-                    cache_cfg->type = CACHE_DIRECT;
-                } else if (!strcmp(optarg,"sa2") || !strcmp(optarg,"2")) {
-                    cache_cfg->type = CACHE_SA2;
-                } else {
+                if (!parse_cache_type(optarg,&cache_cfg->type,&cache_cfg->ways)) {
                     cprintf(ANSI_C_YELLOW,"Invalid cache type: %s\n", optarg);
                 }
-                bprintf("CACHE$ cache type set to %s.\n",CACHE_TYPE_STRINGS[cache_cfg->type]);
+                if (cache_cfg->type == CACHE_ASSOC) {
+                    bprintf("CACHE$ cache type set to %d-way %s.\n",cache_cfg->ways,CACHE_TYPE_STRINGS[cache_cfg->type]);
+                } else {
+                    bprintf("CACHE$ cache type set to %s.\n",CACHE_TYPE_STRINGS[cache_cfg->type]);
+                }
+                break;
+            case 'A': // --cache-replace
+                if (!parse_cache_replace(optarg,&cache_cfg->replace)) {
+                    cprintf(ANSI_C_YELLOW,"Invalid cache replacement policy: %s\n", optarg);
+                }
+                bprintf("CACHE$ cache replacement policy set to %s.\n",CACHE_REPLACE_STRINGS[cache_cfg->replace]);
                 break;
             case 'W': // --cache-write
                 if (!strcmp(optarg,"through") || !strcmp(optarg,"thru") || !strcmp(optarg,"t")) {
@@ -574,6 +1074,258 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 }
                 bprintf("CACHE$ cache write policy set to %s.\n",CACHE_WPOLICY_STRINGS[cache_cfg->wpolicy]);
                 break;
+            /* Options for every cache */
+            case 'Z': // --fill-order
+                if (!strcmp(optarg,"sequential") || !strcmp(optarg,"seq") || !strcmp(optarg,"s")) {
+                    cache_cfg->fill_order = CACHE_FILL_SEQUENTIAL;
+                } else if (!strcmp(optarg,"critical-first") || !strcmp(optarg,"critical") || !strcmp(optarg,"c")) {
+                    cache_cfg->fill_order = CACHE_FILL_CRITICAL;
+                } else {
+                    cprintf(ANSI_C_YELLOW,"Invalid fill order: %s\n", optarg);
+                }
+                bprintf("CACHE$ fill order set to %s.\n",CACHE_FILL_STRINGS[cache_cfg->fill_order]);
+                break;
+            /* Write buffer options */
+            case 'N': // --write-buffer
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv) {
+                    cprintf(ANSI_C_YELLOW,"Write buffer size must be a number: %s\n",optarg);
+                } else {
+                    if ((temp > 0) && temp <= WRITE_BUFFER_MAX_ENTRIES) {
+                        cache_cfg->write_buffer = temp;
+                    } else {
+                        cprintf(ANSI_C_YELLOW,"Invalid write buffer size: %d\n", temp);
+                    }
+                }
+                bprintf("CACHE$ write buffer size set to %d.\n",cache_cfg->write_buffer);
+                break;
+            case 'Y': // --cache-mshrs
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv) {
+                    cprintf(ANSI_C_YELLOW,"Number of MSHRs must be a number: %s\n",optarg);
+                } else {
+                    if ((temp >= 0) && temp <= MSHR_MAX_ENTRIES) {
+                        cache_cfg->mshrs = temp;
+                    } else {
+                        cprintf(ANSI_C_YELLOW,"Invalid number of MSHRs: %d\n", temp);
+                    }
+                }
+                bprintf("CACHE$ number of MSHRs set to %d.\n",cache_cfg->mshrs);
+                break;
+            case OPT_CACHE_VICTIMS: // --cache-victims
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv) {
+                    cprintf(ANSI_C_YELLOW,"Number of victim cache entries must be a number: %s\n",optarg);
+                } else {
+                    if ((temp >= 0) && temp <= VICTIM_MAX_ENTRIES) {
+                        cache_cfg->victims = temp;
+                    } else {
+                        cprintf(ANSI_C_YELLOW,"Invalid number of victim cache entries: %d\n", temp);
+                    }
+                }
+                bprintf("CACHE$ number of victim cache entries set to %d.\n",cache_cfg->victims);
+                break;
+            /* Second level cache options */
+            case OPT_L2_SIZE: // --l2-size
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv) {
+                    cprintf(ANSI_C_YELLOW,"L2 cache size must be a number: %s\n",optarg);
+                } else {
+                    if ((temp >= 0) && !(temp&(temp-1)) && temp <= (1<<30)) {
+                        cache_cfg->l2_size = temp;
+                    } else {
+                        cprintf(ANSI_C_YELLOW,"Invalid L2 cache size: %d\n", temp);
+                    }
+                }
+                bprintf("CACHE$ L2 cache size set to %d.\n",cache_cfg->l2_size);
+                break;
+            case OPT_L2_BLOCK: // --l2-block
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv) {
+                    cprintf(ANSI_C_YELLOW,"L2 block size must be a number: %s\n",optarg);
+                } else {
+                    if ((temp!=0) && !(temp&(temp-1)) && temp <= (2<<7)) {
+                        cache_cfg->l2_block = temp;
+                    } else {
+                        cprintf(ANSI_C_YELLOW,"Invalid L2 block size: %d\n", temp);
+                    }
+                }
+                bprintf("CACHE$ L2 cache block size set to %d.\n",cache_cfg->l2_block);
+                break;
+            case OPT_L2_TYPE: // --l2-type
+                if (!parse_cache_type(optarg,&cache_cfg->l2_type,&cache_cfg->l2_ways)) {
+                    cprintf(ANSI_C_YELLOW,"Invalid L2 cache type: %s\n", optarg);
+                }
+                if (cache_cfg->l2_type == CACHE_ASSOC) {
+                    bprintf("CACHE$ L2 cache type set to %d-way %s.\n",cache_cfg->l2_ways,CACHE_TYPE_STRINGS[cache_cfg->l2_type]);
+                } else {
+                    bprintf("CACHE$ L2 cache type set to %s.\n",CACHE_TYPE_STRINGS[cache_cfg->l2_type]);
+                }
+                break;
+            case OPT_L2_REPLACE: // --l2-replace
+                if (!parse_cache_replace(optarg,&cache_cfg->l2_replace)) {
+                    cprintf(ANSI_C_YELLOW,"Invalid L2 cache replacement policy: %s\n", optarg);
+                }
+                bprintf("CACHE$ L2 cache replacement policy set to %s.\n",CACHE_REPLACE_STRINGS[cache_cfg->l2_replace]);
+                break;
+            case OPT_L2_LATENCY: // --l2-latency
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv) {
+                    cprintf(ANSI_C_YELLOW,"L2 latency must be a number: %s\n",optarg);
+                } else {
+                    if ((temp > 0) && temp <= 64) {
+                        cache_cfg->l2_latency = temp;
+                    } else {
+                        cprintf(ANSI_C_YELLOW,"Invalid L2 latency: %d\n", temp);
+                    }
+                }
+                bprintf("CACHE$ L2 cache latency set to %d.\n",cache_cfg->l2_latency);
+                break;
+            case OPT_L2_WRITE: // --l2-write
+                if (!strcmp(optarg,"through") || !strcmp(optarg,"thru") || !strcmp(optarg,"t")) {
+                    cache_cfg->l2_wpolicy = CACHE_WRITETHROUGH;
+                } else if (!strcmp(optarg,"back") || !strcmp(optarg,"b")) {
+                    cache_cfg->l2_wpolicy = CACHE_WRITEBACK;
+                } else {
+                    cprintf(ANSI_C_YELLOW,"Invalid L2 cache write policy: %s\n", optarg);
+                }
+                bprintf("CACHE$ L2 cache write policy set to %s.\n",CACHE_WPOLICY_STRINGS[cache_cfg->l2_wpolicy]);
+                break;
+            case OPT_L2_FILL: // --l2-fill
+                if (!strcmp(optarg,"inclusive") || !strcmp(optarg,"i")) {
+                    cache_cfg->l2_fill = CACHE_INCLUSIVE;
+                } else if (!strcmp(optarg,"exclusive") || !strcmp(optarg,"e")) {
+                    cache_cfg->l2_fill = CACHE_EXCLUSIVE;
+                } else {
+                    cprintf(ANSI_C_YELLOW,"Invalid L2 cache fill policy: %s\n", optarg);
+                }
+                bprintf("CACHE$ L2 cache fill policy set to %s.\n",CACHE_INCLUSION_STRINGS[cache_cfg->l2_fill]);
+                break;
+            /* Prefetch options */
+            case OPT_PREFETCH_I: // --prefetch-i
+                // A fetch has no load or store pc to find strides by
+                if (!strcmp(optarg,"stride") || !parse_cache_prefetch(optarg,&cache_cfg->inst_prefetch)) {
+                    cprintf(ANSI_C_YELLOW,"Invalid instruction prefetcher: %s\n", optarg);
+                }
+                bprintf("CACHE$ instruction prefetcher set to %s.\n",CACHE_PREFETCH_STRINGS[cache_cfg->inst_prefetch]);
+                break;
+            case OPT_PREFETCH_D: // --prefetch-d
+                if (!parse_cache_prefetch(optarg,&cache_cfg->data_prefetch)) {
+                    cprintf(ANSI_C_YELLOW,"Invalid data prefetcher: %s\n", optarg);
+                }
+                bprintf("CACHE$ data prefetcher set to %s.\n",CACHE_PREFETCH_STRINGS[cache_cfg->data_prefetch]);
+                break;
+            case OPT_PREFETCH_DEGREE: // --prefetch-degree
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv) {
+                    cprintf(ANSI_C_YELLOW,"Prefetch degree must be a number: %s\n",optarg);
+                } else {
+                    if ((temp > 0) && temp <= PREFETCH_MAX_DEGREE) {
+                        cache_cfg->prefetch_degree = temp;
+                    } else {
+                        cprintf(ANSI_C_YELLOW,"Invalid prefetch degree: %d\n", temp);
+                    }
+                }
+                bprintf("CACHE$ prefetch degree set to %d.\n",cache_cfg->prefetch_degree);
+                break;
+            case OPT_DRAM: // --dram
+                if (dram_read_config(optarg, &cache_cfg->dram)) {
+                    bprintf("CACHE$ DRAM configuration read from %s.\n",optarg);
+                } else {
+                    cprintf(ANSI_C_YELLOW,"Keeping the fixed memory penalties.\n");
+                }
+                break;
+            case OPT_BUS_MODE: // --bus-mode
+                if (!strcmp(optarg,"split")) {
+                    cache_cfg->bus.split = true;
+                } else if (!strcmp(optarg,"serial")) {
+                    cache_cfg->bus.split = false;
+                } else {
+                    cprintf(ANSI_C_YELLOW,"Invalid bus mode: %s\n", optarg);
+                }
+                bprintf("CACHE$ memory bus set to %s.\n",cache_cfg->bus.split ? "split transaction" : "serial");
+                break;
+            case OPT_BUS_WIDTH: // --bus-width
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv) {
+                    cprintf(ANSI_C_YELLOW,"Bus width must be a number: %s\n",optarg);
+                } else {
+                    if ((temp > 0) && temp <= BUS_MAX_WIDTH) {
+                        cache_cfg->bus.width = temp;
+                    } else {
+                        cprintf(ANSI_C_YELLOW,"Invalid bus width: %d\n", temp);
+                    }
+                }
+                bprintf("CACHE$ bus width set to %d.\n",cache_cfg->bus.width);
+                break;
+            case OPT_BUS_ARBITRATION: // --bus-arbitration
+                if (!strcmp(optarg,"fixed")) {
+                    cache_cfg->bus.arbitration = BUS_FIXED;
+                } else if (!strcmp(optarg,"round-robin") || !strcmp(optarg,"rr")) {
+                    cache_cfg->bus.arbitration = BUS_ROUND_ROBIN;
+                } else if (!strcmp(optarg,"read-first")) {
+                    cache_cfg->bus.arbitration = BUS_READ_FIRST;
+                } else {
+                    cprintf(ANSI_C_YELLOW,"Invalid bus arbitration: %s\n", optarg);
+                }
+                bprintf("CACHE$ bus arbitration set to %s.\n",BUS_ARBITRATION_STRINGS[cache_cfg->bus.arbitration]);
+                break;
+            case OPT_BUS_DRAIN: // --bus-drain
+                srv = sscanf(optarg,"%d:%d",&temp,&temp2);
+                if (srv != 2 || temp < 0 || temp2 < 0 || temp > WRITE_BUFFER_MAX_ENTRIES) {
+                    cprintf(ANSI_C_YELLOW,"Invalid write drain watermarks: %s\n", optarg);
+                } else {
+                    cache_cfg->bus.drain_high = temp;
+                    cache_cfg->bus.drain_low = temp2;
+                }
+                bprintf("CACHE$ write drain watermarks set to %d:%d.\n",cache_cfg->bus.drain_high,cache_cfg->bus.drain_low);
+                break;
+            /* Sweep options */
+            case 's': // --sweep
+                sweep_cfg->enabled = true;
+                bprintf("SWEEP$ sweep mode enabled.\n");
+                break;
+            case 'z': // --sweep-sizes
+                sweep_cfg->num_sizes = sweep_parse_sizes(optarg,sweep_cfg->inst_sizes,sweep_cfg->data_sizes);
+                if (!sweep_cfg->num_sizes) {
+                    cprintf(ANSI_C_YELLOW,"Invalid sweep cache sizes: %s\n",optarg);
+                } else {
+                    sweep_cfg->enabled = true;
+                }
+                bprintf("SWEEP$ sweeping %d cache sizes.\n",sweep_cfg->num_sizes);
+                break;
+            case 'b': // --sweep-blocks
+                sweep_cfg->num_blocks = sweep_parse_blocks(optarg,sweep_cfg->blocks);
+                if (!sweep_cfg->num_blocks) {
+                    cprintf(ANSI_C_YELLOW,"Invalid sweep block sizes: %s\n",optarg);
+                } else {
+                    sweep_cfg->enabled = true;
+                }
+                bprintf("SWEEP$ sweeping %d block sizes.\n",sweep_cfg->num_blocks);
+                break;
+            case 'p': // --sweep-dwrite
+                sweep_cfg->num_wpolicies = sweep_parse_wpolicies(optarg,sweep_cfg->wpolicies);
+                if (!sweep_cfg->num_wpolicies) {
+                    cprintf(ANSI_C_YELLOW,"Invalid sweep write policies: %s\n",optarg);
+                } else {
+                    sweep_cfg->enabled = true;
+                }
+                bprintf("SWEEP$ sweeping %d write policies.\n",sweep_cfg->num_wpolicies);
+                break;
+            case 't': // --sweep-threads
+                srv = sscanf(optarg,"%d",&temp);
+                if (!srv || temp < 0) {
+                    cprintf(ANSI_C_YELLOW,"Invalid sweep thread count: %s\n",optarg);
+                } else {
+                    sweep_cfg->threads = temp;
+                }
+                bprintf("SWEEP$ sweep threads set to %u.\n",sweep_cfg->threads);
+                break;
+            case 'o': // --sweep-single-pass
+                sweep_cfg->enabled = true;
+                sweep_cfg->single_pass = true;
+                bprintf("SWEEP$ single pass sweep enabled.\n");
+                break;
             case '?': // error
                 /* getopt_long already printed an error message. */
                 break;
@@ -595,79 +1347,147 @@ int arguments(int argc, char **argv, FILE** source_fp,
                 return 1; // exit with errors
             }
         }
-    } else {
+    } else if (!cpu_cfg->replay_trace) {
         cprintf(ANSI_C_RED,"Expected at least one argument. (Cannot simulate nothing!). Exiting.\n", NULL);
         return 1;
     }
     return 0;
 }
 
-int parse(FILE *fp, asm_line_t *lines, cpu_config_t cpu_cfg) {
-    uint32_t addr, inst, data, start = 0;
+/* Extract the word (and address, in the .s format) from a line of the source
+ * file, and the rest of the line into str. Returns 0 if the line holds no
+ * word, otherwise its asm_line_t type: 3 if there was more to the line, else 2.
+ * Lines in the .txt format have no address, so addr is left alone. */
+static char parse_line(const char *buf, uint32_t *addr, uint32_t *inst, char *str) {
+    if (flags & MASK_ALTFORMAT) {
+        if (sscanf(buf,"0x%x",inst) != 1) return 0;
+        // Read the comment if it exists
+        return (sscanf(buf,"0x%*x, // %[^\n]", str) == 1) ? 3 : 2;
+    }
+    // scanf magic to extract an address, colon, instruction, and the remaining line
+    if (sscanf(buf,"%x: %x %[^\n]",addr,inst,str) == 3) return 3;
+    if (sscanf(buf,"%x: %x\n",addr,inst) == 2) return 2;
+    return 0;
+}
+
+int parse(sim_t *sim, FILE *fp, cpu_config_t cpu_cfg) {
+    uint32_t addr, inst, start = 0, end = 0;
+    word_t data;
     int count = 0;
     char buf[180]; // for storing a line from the source file
-    char str[120]; // for the comment part of a line from the source file
+    char str[180]; // for the comment part of a line from the source file
     if (flags & MASK_ALTFORMAT) { // .txt "array" format
         addr = 0;
-        mem_init(cpu_cfg.mem_size,0); // memory is assumed to start at 0x0
+        mem_init(sim, cpu_cfg.mem_size,0); // memory is assumed to start at 0x0
         // Disable mem_write_w messages when parsing (@TODO make enabled by flag)
         int saved_debug_flag = flags & MASK_DEBUG;
         flags &= ~(saved_debug_flag);
         // Iterate through file line-by-line
         while (fgets(buf, sizeof(buf), fp) != NULL ) {
             // Read the instruction into memory
-            if (sscanf(buf,"0x%x",&inst) == 1) {
-                mem_write_w(addr,&inst);
-                lines[count].addr = addr;
-                lines[count].inst = inst;
-                lines[count].type = 2;
+            if (parse_line(buf, &addr, &inst, str)) {
+                mem_write_w(sim, addr,&inst);
                 addr += 4;
-                // Read the comment if it exists
-                if (sscanf(buf,"0x%*x, // %[^\n]", str) == 1) {
-                    strcpy(lines[count].comment, str);
-                    lines[count].type = 3;
-                }
                 ++count;
             }
         }
+        end = addr;
         flags |= saved_debug_flag;
         // Set registers
-        mem_read_w(0x0,&data);
-        reg_write(REG_SP, &data);
-        mem_read_w(0x1,&data);
-        reg_write(REG_FP, &data);
+        mem_read_w(sim, 0x0,&data);
+        reg_write(sim, REG_SP, &data);
+        mem_read_w(sim, 0x1,&data);
+        reg_write(sim, REG_FP, &data);
         // (program counter is set after initializing pipeline)
     } else { // .s format
         // iterate through file line-by-line
         while (fgets(buf, sizeof(buf), fp) != NULL ) {
-            // scanf magic to extract an address, colon, instruction, and the remaining line
-            if (sscanf(buf,"%x: %x %[^\n]",&addr,&inst,str) == 3) {
+            char type = parse_line(buf, &addr, &inst, str);
+            if (type == 3) {
                 if (count == 0) { // first instruction, set offset and initialize memory
                     bprintf("First instruction found. %s",buf);
-                    mem_init(cpu_cfg.mem_size,addr);
+                    mem_init(sim, cpu_cfg.mem_size,addr);
                     start = addr;
                 }
-                // write extracted instruction into memory and also into lines array
-                mem_write_w(addr,&inst);
-                lines[(addr>>2)-(start>>2)].addr = addr;
-                lines[(addr>>2)-(start>>2)].inst = inst;
-                strcpy(lines[(addr>>2)-(start>>2)].comment, str);
-                lines[(addr>>2)-(start>>2)].type = 3;
+                // write extracted instruction into memory
+                mem_write_w(sim, addr,&inst);
+                if (addr + 4 > end) end = addr + 4;
                 ++count;
-            } else if (sscanf(buf,"%x: %x\n",&addr,&data) == 2) {
-                // write extracted data into memory and also into lines array
-                mem_write_w(addr,&data);
-                lines[(addr>>2)-(start>>2)].addr = addr;
-                lines[(addr>>2)-(start>>2)].inst = data;
-                lines[(addr>>2)-(start>>2)].type = 2;
+            } else if (type == 2) {
+                // write extracted data into memory
+                mem_write_w(sim, addr,&inst);
+                if (addr + 4 > end) end = addr + 4;
                 ++count;
             }
         }
     }
     fclose(fp); // close the file
     bprintf("Successfully extracted %d lines\n",count);
+    // Predecode the loaded image so fetch and decode can skip re-parsing it
+    predecode_init(sim, start, end - start);
+    predecode_build(sim);
     return count;
 }
+
+static int annotation_compare(const void *a, const void *b) {
+    uint32_t x = ((const asm_line_t *)a)->addr, y = ((const asm_line_t *)b)->addr;
+    return (x > y) - (x < y);
+}
+// Read the source lines of filename (in the format parse() expects), returns the number read
+int annotations_load(asm_lines_t *notes, const char *filename) {
+    uint32_t addr = 0, inst;
+    char buf[180], str[180];
+    bool sorted = true;
+    notes->loaded = true;
+    FILE *fp = fopen(filename, "r");
+    if (!fp) return 0;
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+        char type = parse_line(buf, &addr, &inst, str);
+        if (!type) continue;
+        if (notes->count == notes->capacity) {
+            notes->capacity = notes->capacity ? notes->capacity * 2 : 1024;
+            notes->lines = (asm_line_t *)realloc(notes->lines, sizeof(asm_line_t) * notes->capacity);
+            // If the table didn't get allocated, crash the program
+            if (NULL == notes->lines) assert(0);
+        }
+        asm_line_t *line = &notes->lines[notes->count];
+        line->addr = addr;
+        line->inst = inst;
+        line->type = type;
+        line->comment = NULL;
+        if (type == 3) {
+            line->comment = (char *)malloc(strlen(str) + 1);
+            if (NULL == line->comment) assert(0);
+            strcpy(line->comment, str);
+        }
+        if (notes->count && notes->lines[notes->count-1].addr >= addr) sorted = false;
+        notes->count++;
+        // Lines in the .txt format are one word after another
+        if (flags & MASK_ALTFORMAT) addr += 4;
+    }
+    fclose(fp);
+    if (!sorted) qsort(notes->lines, notes->count, sizeof(asm_line_t), annotation_compare);
+    bprintf("Read %d source lines from %s\n",notes->count,filename);
+    return notes->count;
+}
+// Find the source line for an address, NULL if there isn't one
+asm_line_t *annotations_find(asm_lines_t *notes, uint32_t addr) {
+    uint32_t lo = 0, hi = notes->count;
+    while (lo < hi) {
+        uint32_t mid = lo + ((hi - lo) >> 1);
+        if (notes->lines[mid].addr < addr) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < notes->count && notes->lines[lo].addr == addr) return &notes->lines[lo];
+    return NULL;
+}
+void annotations_free(asm_lines_t *notes) {
+    for (uint32_t i = 0; i < notes->count; ++i) free(notes->lines[i].comment);
+    free(notes->lines);
+    notes->lines = NULL;
+    notes->count = notes->capacity = 0;
+    notes->loaded = false;
+}
 // Breakpoint wrappers
 int breakpoint_get_active(void) {
     int i, sum = 0;
@@ -722,12 +1542,12 @@ void breakpoint_check(pc_t current_pc) {
     }
 }
 // Provides a crude interactive debugger for the simulator
-int interactive(asm_line_t* lines, uint32_t cycles, char *filename) {
+int interactive(sim_t *sim, asm_lines_t *notes, uint32_t cycles, char *filename) {
     uint32_t i_addr = 0, i_data;
     int temp, rv, i;
-    asm_line_t line;
+    asm_line_t *line;
 PROMPT: // LOL gotos
-    cprintf(ANSI_C_GREEN, "(interactive @ %d cycles) > ", prof->cycles);
+    cprintf(ANSI_C_GREEN, "(interactive @ %d cycles) > ", sim->prof.cycles);
     rv = system ("/bin/stty raw"); // set terminal to raw/unbuffered
     char c = getchar();
     rv = system ("/bin/stty sane"); // set back to sane
@@ -740,7 +1560,7 @@ PROMPT: // LOL gotos
                 cprintf(ANSI_C_GREEN, "breakpoint address: ");
                 rv = scanf("%x",&i_addr); getchar();
                 if (rv != 1) goto PROMPT;
-                if (i_addr < mem_start() || i_addr > mem_end()) {
+                if (i_addr < mem_start(sim) || i_addr > mem_end(sim)) {
                     printf("Address out of range\n");
                     goto PROMPT;
                 }
@@ -772,11 +1592,18 @@ PROMPT: // LOL gotos
             cprintf(ANSI_C_GREEN, "input address: ");
             rv = scanf("%x",&i_addr); getchar();
             if (rv != 1) goto PROMPT;
-            line = lines[(i_addr>>2)-(mem_start()>>2)];
-            if (line.type == 3) {
-                printf("\t0x%08x: 0x%08x %s\n",line.addr,line.inst,line.comment);
-            } else if (line.type == 2) {
-                printf("\t0x%08x: 0x%08x\n",line.addr,line.inst);
+            if (symbols.count) { // executables have no source, but name their functions
+                elf_symbol_t *sym = elf_symbol_find(&symbols, i_addr);
+                printf("\t0x%08x: 0x%08x <%s+0x%x>\n",i_addr,mem_peek_w(sim,i_addr),
+                    sym ? sym->name : "?",sym ? i_addr - sym->addr : 0);
+                goto PROMPT;
+            }
+            if (!notes->loaded) annotations_load(notes, filename);
+            line = annotations_find(notes, i_addr);
+            if (line && line->type == 3) {
+                printf("\t0x%08x: 0x%08x %s\n",line->addr,line->inst,line->comment);
+            } else if (line) {
+                printf("\t0x%08x: 0x%08x\n",line->addr,line->inst);
             } else {
                 printf("\tNot a valid input line\n");
             }
@@ -785,29 +1612,29 @@ PROMPT: // LOL gotos
             cprintf(ANSI_C_GREEN, "memory address: ");
             rv = scanf("%x",&i_addr); getchar();
             if (rv != 1) goto PROMPT;
-            if (i_addr < mem_start() || i_addr > mem_end()) {
+            if (i_addr < mem_start(sim) || i_addr > mem_end(sim)) {
                 printf("Address out of range\n");
                 goto PROMPT;
             }
-            mem_read_w(i_addr, &i_data);
+            mem_read_w(sim, i_addr, &i_data);
             printf("mem[0x%08x]: 0x%08x (0d%d)\n",i_addr,i_data,i_data);
             goto PROMPT;
         case 'o': // view a region of memory
             cprintf(ANSI_C_GREEN,"memory address: ");
             rv = scanf("%x",&i_addr); getchar();
             if (rv != 1) goto PROMPT;
-            if (i_addr < mem_start() || i_addr > mem_end()) {
+            if (i_addr < mem_start(sim) || i_addr > mem_end(sim)) {
                 printf("Address out of range\n");
                 goto PROMPT;
             }
-            if (i_addr < mem_start()+(5<<2)) i_addr = mem_start()+(5<<2);
-            if (i_addr > mem_end()-(5<<2)) i_addr = mem_end()-(5<<2);
-            mem_dump_cute(i_addr-(5<<2),11);
+            if (i_addr < mem_start(sim)+(5<<2)) i_addr = mem_start(sim)+(5<<2);
+            if (i_addr > mem_end(sim)-(5<<2)) i_addr = mem_end(sim)-(5<<2);
+            mem_dump_cute(sim, i_addr-(5<<2),11);
             goto PROMPT;
         case 's': // step
             break;
         case 'r': // dump registers
-            reg_dump();
+            reg_dump(sim);
             goto PROMPT;
         case 'x': // exit
             cprintf(ANSI_C_GREEN, "Simulation halted in interactive mode.\n");
@@ -816,20 +1643,20 @@ PROMPT: // LOL gotos
             cprintf(ANSI_C_GREEN,"dcache block: ");
             rv = scanf("%d",&temp); getchar();
             if (rv != 1) goto PROMPT;
-            print_dcache(temp);
+            print_dcache(sim, temp);
             goto PROMPT;
         case 'F': // flush the data cache memory
-            flush_dcache();
+            flush_dcache(sim);
             cprintf(ANSI_C_GREEN, "dcache flushed\n");
             goto PROMPT;
         case 'I': // print instruction cache block
             cprintf(ANSI_C_GREEN,"icache block: ");
             rv = scanf("%d",&temp); getchar();
             if (rv != 1) goto PROMPT;
-            print_icache(temp);
+            print_icache(sim, temp);
             goto PROMPT;
         case 'W': // print write buffer
-            print_write_buffer();
+            print_write_buffer(sim);
             goto PROMPT;
         case '#': // dump memory to file
             cprintf(ANSI_C_GREEN,"words to dump: ");
@@ -846,14 +1673,14 @@ PROMPT: // LOL gotos
             }
             rv = flags & MASK_DEBUG; // abusing rv
             flags &= ~rv;
-            for (i = mem_start(); i <= (int)mem_start()+temp; ++i) {
-                mem_read_w(i<<2,&i_data);
+            for (i = mem_start(sim); i <= (int)mem_start(sim)+temp; ++i) {
+                mem_read_w(sim, i<<2,&i_data);
                 fprintf(output_fp,"%08x:%08x\n",i,i_data);
             }
             flags |= rv;
             fclose(output_fp);
             cprintf(ANSI_C_GREEN,"Memory from 0x%x - 0x%x dumped to %s\n",
-                mem_start(), mem_start()+temp, output_filename);
+                mem_start(sim), mem_start(sim)+temp, output_filename);
             goto PROMPT;
         case '?': // help
             printf("Available interactive commands: \n" \
@@ -17,6 +17,13 @@
 #include "alu.h"
 #include "fetch.h"
 #include "hazard.h"
+#include "predecode.h"
+#include "single.h"
+#include "sim.h"
+#include "sweep.h"
+#include "replay.h"
+#include "image.h"
+#include "elf_loader.h"
 
 // Set at compile time from the Makefile
 //#define VERSION_STRING      "?.?.????"
@@ -28,10 +35,21 @@
 typedef struct ASMLine {
     uint32_t addr;        // address
     uint32_t inst;        // instruction
-    char     comment[80]; // remaining string data
-    char     type;        // 0: invalid, 2/3: valid
+    char     *comment;    // remaining string data, NULL if there was none
+    char     type;        // 2: no comment, 3: with comment
 } asm_line_t;
 
+/* The source lines of the loaded program, sorted by address. Only the
+ * interactive debugger shows them, so they are read from the source file the
+ * first time it asks rather than while the program is loaded.
+ */
+typedef struct ASMLines {
+    asm_line_t *lines;
+    uint32_t   count;
+    uint32_t   capacity;
+    bool       loaded;    // the source file has been read (even if it failed)
+} asm_lines_t;
+
 const char * const CACHE_MODE_STRINGS[] = {
     [CACHE_DISABLE]         = "disabled",
     [CACHE_SPLIT]           = "split",
@@ -39,19 +57,61 @@ const char * const CACHE_MODE_STRINGS[] = {
 };
 const char * const CACHE_TYPE_STRINGS[] = {
     [CACHE_DIRECT]          = "direct-mapped",
-    [CACHE_SA2]             = "2-way set associative"
+    [CACHE_ASSOC]           = "set associative"
+};
+const char * const CACHE_REPLACE_STRINGS[] = {
+    [CACHE_LRU]             = "LRU",
+    [CACHE_PLRU]            = "tree pseudo-LRU",
+    [CACHE_FIFO]            = "FIFO",
+    [CACHE_RANDOM]          = "random"
+};
+const char * const CACHE_FILL_STRINGS[] = {
+    [CACHE_FILL_SEQUENTIAL] = "sequential",
+    [CACHE_FILL_CRITICAL]   = "critical word first"
+};
+const char * const CACHE_INCLUSION_STRINGS[] = {
+    [CACHE_INCLUSIVE]       = "inclusive",
+    [CACHE_EXCLUSIVE]       = "exclusive"
+};
+const char * const CACHE_PREFETCH_STRINGS[] = {
+    [PREFETCH_NONE]         = "none",
+    [PREFETCH_NEXT_LINE]    = "next-line",
+    [PREFETCH_STREAM]       = "stream",
+    [PREFETCH_STRIDE]       = "stride"
 };
 const char * const CACHE_WPOLICY_STRINGS[] = {
     [CACHE_WRITEBACK]       = "writeback",
     [CACHE_WRITETHROUGH]    = "writethrough"
 };
+const char * const CACHE_ALLOC_STRINGS[] = {
+    [CACHE_ALLOCATE]        = "write allocate",
+    [CACHE_NO_ALLOCATE]     = "no write allocate"
+};
+const char * const BUS_ARBITRATION_STRINGS[] = {
+    [BUS_FIXED]             = "fixed priority",
+    [BUS_ROUND_ROBIN]       = "round-robin",
+    [BUS_READ_FIRST]        = "read-first"
+};
+const char * const DRAM_PAGE_STRINGS[] = {
+    [DRAM_OPEN_PAGE]        = "open page",
+    [DRAM_CLOSED_PAGE]      = "closed page"
+};
+const char * const DRAM_SCHED_STRINGS[] = {
+    [DRAM_FCFS]             = "FCFS",
+    [DRAM_FR_FCFS]          = "FR-FCFS"
+};
 
 int arguments(int argc, char **argv, FILE** source_fp,
-        cpu_config_t *cpu_cfg, cache_config_t *cache_cfg);
+        cpu_config_t *cpu_cfg, cache_config_t *cache_cfg, sweep_config_t *sweep_cfg);
+
+int parse(sim_t *sim, FILE *fp, cpu_config_t cpu_cfg);
 
-int parse(FILE *fp, asm_line_t *lines, cpu_config_t cpu_cfg);
+// Source line annotations, see asm_lines_t
+int annotations_load(asm_lines_t *notes, const char *filename);
+asm_line_t *annotations_find(asm_lines_t *notes, uint32_t addr);
+void annotations_free(asm_lines_t *notes);
 
-int interactive(asm_line_t *lines, uint32_t cycles, char *filename);
+int interactive(sim_t *sim, asm_lines_t *notes, uint32_t cycles, char *filename);
 
 // Breakpoint wrappers
 int breakpoint_get_active(void);
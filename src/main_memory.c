@@ -2,173 +2,224 @@
  * Provides access to a byte-addressable memory
  */
 
+#include <string.h>
+
 #include "main_memory.h"
+#include "sim.h"
 
 extern int flags; // from util.c
 
-static word_t *mem; // pointer to memory block
-static uint32_t start; // internal offset, in bytes, should be word-aligned
-static uint32_t length; // length, in words
+// What every page holds before it is written
+static const word_t zero_page[MEM_PAGE_WORDS];
+
+/* Find the word holding address. Reads of pages that were never written
+ * get the shared zero page; writes allocate the page. */
+static inline word_t *mem_word(sim_t *sim, uint32_t address, bool write) {
+    main_memory_t *memory = &sim->memory;
+    uint32_t page = address >> MEM_PAGE_BITS;
+    uint32_t offset = (address & ((1 << MEM_PAGE_BITS) - 1)) >> 2;
+    uint32_t slot = page & (MEM_RECENT_SIZE - 1);
+    if (page == memory->recent_page[slot]) return &memory->recent[slot][offset];
+
+    word_t ***table = &memory->dir[page >> MEM_TABLE_BITS];
+    if (NULL == *table) {
+        if (!write) return (word_t *)&zero_page[offset];
+        *table = (word_t **)calloc(MEM_TABLE_SIZE, sizeof(word_t *));
+        // If memory didn't get allocated, crash the program. (Time to download more RAM)
+        if (NULL == *table) assert(0);
+    }
+    word_t **entry = &(*table)[page & (MEM_TABLE_SIZE - 1)];
+    if (NULL == *entry) {
+        if (!write) return (word_t *)&zero_page[offset];
+        *entry = (word_t *)calloc(MEM_PAGE_WORDS, sizeof(word_t));
+        if (NULL == *entry) assert(0);
+        memory->pages++;
+    }
+    memory->recent_page[slot] = page;
+    memory->recent[slot] = *entry;
+    return &(*entry)[offset];
+}
+
+static void mem_forget_recent(sim_t *sim) {
+    for (uint32_t i = 0; i < MEM_RECENT_SIZE; ++i) {
+        sim->memory.recent_page[i] = MEM_NO_PAGE;
+        sim->memory.recent[i] = NULL;
+    }
+}
 
 // Initialize the memory with a given size. Size and offset in bytes
-void mem_init(uint32_t size, uint32_t offset) {
-    mem = (word_t *)malloc(size);
-    // If memory didn't get allocated, crash the program. (Time to download more RAM)
-    if (NULL == mem) assert(0);
-    length = size>>2; // length in words is size in bytes divided by four
-    start = offset & 0xfffffffc; // start address is the offset in bytes, mask bottom two bits
+void mem_init(sim_t *sim, uint32_t size, uint32_t offset) {
+    // Nothing is allocated until it is written
+    mem_forget_recent(sim);
+    sim->memory.length = size>>2; // length in words is size in bytes divided by four
+    sim->memory.start = offset & 0xfffffffc; // start address is the offset in bytes, mask bottom two bits
     bprintf("Initializing memory. Size: %d B (%d words), offset: 0x%08x\n",
-        (length<<2),length, offset);
-#if (MEM_FILL)
-    for (uint32_t i = 0; i < (size>>2); ++i) {
-        mem[i] = MEM_FILL_VALUE;
+        (sim->memory.length<<2),sim->memory.length, offset);
+}
+// Copy every page another simulation has written
+void mem_copy(sim_t *sim, sim_t *image) {
+    mem_init(sim, mem_size_b(image), mem_start(image));
+    for (uint32_t d = 0; d < MEM_DIR_SIZE; ++d) {
+        if (NULL == image->memory.dir[d]) continue;
+        for (uint32_t t = 0; t < MEM_TABLE_SIZE; ++t) {
+            word_t *page = image->memory.dir[d][t];
+            if (NULL == page) continue;
+            uint32_t address = ((d << MEM_TABLE_BITS) | t) << MEM_PAGE_BITS;
+            memcpy(mem_word(sim, address, true), page, sizeof(word_t) * MEM_PAGE_WORDS);
+        }
     }
-#endif // MEM_FILL
+}
+// Find the first page numbered page or higher that has been written
+const word_t *mem_next_page(sim_t *sim, uint32_t *page) {
+    for (uint32_t p = *page; p < (MEM_DIR_SIZE << MEM_TABLE_BITS); ++p) {
+        word_t **table = sim->memory.dir[p >> MEM_TABLE_BITS];
+        if (NULL == table) {
+            p |= MEM_TABLE_SIZE - 1; // skip the whole table
+            continue;
+        }
+        if (NULL == table[p & (MEM_TABLE_SIZE - 1)]) continue;
+        *page = p;
+        return table[p & (MEM_TABLE_SIZE - 1)];
+    }
+    return NULL;
 }
 // Display memory state (does _not_ dump the entire memory!)
-void mem_dump(void) {
+void mem_dump(sim_t *sim) {
     eprintf("Memory statistics:\n");
-    eprintf("  Bytes - start: 0x%08x; end: 0x%08x\n",start,start + (length<<2) - 1);
-    eprintf("  Words - start: 0x%08x; end: 0x%08x\n",start,(start + ((length<<2)>>2) - 1));
-    eprintf("  Size: %d B (%d words)\n",(length<<2),length);
+    eprintf("  Bytes - start: 0x%08x; end: 0x%08x\n",sim->memory.start,sim->memory.start + (sim->memory.length<<2) - 1);
+    eprintf("  Words - start: 0x%08x; end: 0x%08x\n",sim->memory.start,(sim->memory.start + ((sim->memory.length<<2)>>2) - 1));
+    eprintf("  Size: %d B (%d words)\n",(sim->memory.length<<2),sim->memory.length);
+    eprintf("  Pages allocated: %d (%d B)\n",sim->memory.pages,sim->memory.pages<<MEM_PAGE_BITS);
     if (flags & MASK_DEBUG) {
         eprintf("Printing first 80 words of memory:\n");
         for (int i = 0; i < 16; ++i) {
             eprintf("  0x%02x: %08x | 0x%02x: %08x | 0x%02x: %08x | 0x%02x: %08x | 0x%02x: %08x\n",
-                i<<2,mem[i],
-                (i+16)<<2,mem[i+16],
-                (i+32)<<2,mem[i+32],
-                (i+48)<<2,mem[i+48],
-                (i+64)<<2,mem[i+64]);
+                i<<2,mem_peek_w(sim,i<<2),
+                (i+16)<<2,mem_peek_w(sim,(i+16)<<2),
+                (i+32)<<2,mem_peek_w(sim,(i+32)<<2),
+                (i+48)<<2,mem_peek_w(sim,(i+48)<<2),
+                (i+64)<<2,mem_peek_w(sim,(i+64)<<2));
         }
     }
 }
 // Display a small section of memory starting at an address
-void mem_dump_cute(uint32_t offset, uint32_t words) {
+void mem_dump_cute(sim_t *sim, uint32_t offset, uint32_t words) {
     eprintf("Printing %d words of memory starting at 0x%08x:\n",words,offset);
     offset = offset >> 2;
     for (uint32_t i = 0; i < words; ++i) {
         printf("\t0x%08x: 0x%08x (0d%d)\n",
             (offset+i)<<2,
-            mem[(offset+i)],
-            mem[(offset+i)]);
+            mem_peek_w(sim,(offset+i)<<2),
+            mem_peek_w(sim,(offset+i)<<2));
     }
 }
 
 // De-allocate memory space
-void mem_close(void) {
-    bprintf("De-initializing memory. Size: %d B (%d words)\n",(length<<2),length);
-    free(mem);
-    length = 0;
+void mem_close(sim_t *sim) {
+    bprintf("De-initializing memory. Size: %d B (%d words), %d pages allocated\n",
+        (sim->memory.length<<2),sim->memory.length,sim->memory.pages);
+    for (uint32_t d = 0; d < MEM_DIR_SIZE; ++d) {
+        if (NULL == sim->memory.dir[d]) continue;
+        for (uint32_t t = 0; t < MEM_TABLE_SIZE; ++t) {
+            free(sim->memory.dir[d][t]);
+        }
+        free(sim->memory.dir[d]);
+        sim->memory.dir[d] = NULL;
+    }
+    sim->memory.pages = 0;
+    mem_forget_recent(sim);
+    sim->memory.length = 0;
 }
 
 // Get memory size in bytes or words
-uint32_t mem_size_b(void) {
-    return length<<2;
+uint32_t mem_size_b(sim_t *sim) {
+    return sim->memory.length<<2;
 }
-uint32_t mem_size_w(void) {
-    return length;
+uint32_t mem_size_w(sim_t *sim) {
+    return sim->memory.length;
 }
 // Get memory start address (offset)
-uint32_t mem_start(void) {
-    return start;
+uint32_t mem_start(sim_t *sim) {
+    return sim->memory.start;
 }
 // Get memory end address
-uint32_t mem_end(void) {
-    return (start + (length<<2) - 1);
+uint32_t mem_end(sim_t *sim) {
+    return (sim->memory.start + (sim->memory.length<<2) - 1);
 }
 
-// Read a word from a (word-aligned) memory address
-void mem_read_w(uint32_t address, word_t *data) {
-    uint32_t index = (address>>2) - (start>>2);
-    if (flags & MASK_SANITY && index >= length) {
-        cprintf(ANSI_C_RED, "mem_read_w: out of range address 0x%08x (index %d >= length %d)\n",
-            address,index,length);
-        assert(!(index >= length)); // fail fast
+// Read a word without printing it
+word_t mem_peek_w(sim_t *sim, uint32_t address) {
+    return *mem_word(sim, address, false);
+}
+// Write count words starting at a word-aligned address, a page at a time
+void mem_load(sim_t *sim, uint32_t address, const word_t *words, uint32_t count) {
+    while (count) {
+        uint32_t offset = (address & ((1 << MEM_PAGE_BITS) - 1)) >> 2;
+        uint32_t n = MEM_PAGE_WORDS - offset;
+        if (n > count) n = count;
+        memcpy(mem_word(sim, address, true), words, sizeof(word_t) * n);
+        address += n << 2;
+        words += n;
+        count -= n;
     }
-    *data = mem[index];
+}
+// Read a word from a (word-aligned) memory address
+void mem_read_w(sim_t *sim, uint32_t address, word_t *data) {
+    *data = *mem_word(sim, address, false);
     if (flags & MASK_DEBUG) {
-        printf("mem_read_w: address 0x%08x, data 0x%08x, array index %d\n",
-            address,*data,index);
+        printf("mem_read_w: address 0x%08x, data 0x%08x, page %d\n",
+            address,*data,address>>MEM_PAGE_BITS);
     }
 }
 // Read a halfword from a (halfword-aligned) memory address
-void mem_read_h(uint32_t address, word_t *data) {
-    uint32_t index = (address>>2) - (start>>2);
+void mem_read_h(sim_t *sim, uint32_t address, word_t *data) {
     uint32_t shift = ((2-(address & 0x2))<<3); // shift amount based on byte position
-    if (flags & MASK_SANITY && index >= length) {
-        cprintf(ANSI_C_RED, "mem_read_h: out of range address 0x%08x (index %d >= length %d)\n",
-            address,index,length);
-        assert(!(index >= length)); // fail fast
-    }
-    *data = mem[index];
+    *data = *mem_word(sim, address, false);
     *data >>= shift;
     *data &= 0xffff;
     if (flags & MASK_DEBUG) {
-        printf("mem_read_h: address 0x%08x, data 0x%08x, array index %d\n",
-            address,*data,index);
+        printf("mem_read_h: address 0x%08x, data 0x%08x, page %d\n",
+            address,*data,address>>MEM_PAGE_BITS);
     }
 }
 // Read a byte from a memory address
-void mem_read_b(uint32_t address, word_t *data) {
-    uint32_t index = (address>>2) - (start>>2);
+void mem_read_b(sim_t *sim, uint32_t address, word_t *data) {
     uint32_t shift = ((3-(address & 0x3))<<3); // shift amount based on byte position
-    if (flags & MASK_SANITY && index >= length) {
-        cprintf(ANSI_C_RED, "mem_read_b: out of range address 0x%08x (index %d >= length %d)\n",
-            address,index,length);
-        assert(!(index >= length)); // fail fast
-    }
-    *data = mem[index];
+    *data = *mem_word(sim, address, false);
     *data >>= shift;
     *data &= 0xff;
     if (flags & MASK_DEBUG) {
-        printf("mem_read_b: address 0x%08x, data 0x%08x, array index %d\n",
-            address,*data,index);
+        printf("mem_read_b: address 0x%08x, data 0x%08x, page %d\n",
+            address,*data,address>>MEM_PAGE_BITS);
     }
 }
 // Write a word to a (word-aligned) memory address
-void mem_write_w(uint32_t address, word_t *data) {
-    uint32_t index = (address>>2) - (start>>2);
-    if (flags & MASK_SANITY && index >= length) {
-        cprintf(ANSI_C_RED, "mem_write_w: out of range address 0x%08x (index %d >= length %d)\n",
-            address,index,length);
-        assert(!(index >= length)); // fail fast
-    }
-    mem[index] = *data;
+void mem_write_w(sim_t *sim, uint32_t address, word_t *data) {
+    *mem_word(sim, address, true) = *data;
     if (flags & MASK_DEBUG) {
-        printf("mem_write_w: address 0x%08x, data 0x%08x, array index %d\n",
-            address,*data,index);
+        printf("mem_write_w: address 0x%08x, data 0x%08x, page %d\n",
+            address,*data,address>>MEM_PAGE_BITS);
     }
 }
 // Write a halfword to a (halfword-aligned) memory address
-void mem_write_h(uint32_t address, word_t *data) {
-    uint32_t index = (address>>2) - (start>>2);
+void mem_write_h(sim_t *sim, uint32_t address, word_t *data) {
     uint32_t shift = ((2-(address & 0x2))<<3); // shift amount based on byte position
-    if (flags & MASK_SANITY && index >= length) {
-        cprintf(ANSI_C_RED, "mem_write_h: out of range address 0x%08x (index %d >= length %d)\n",
-            address,index,length);
-        assert(!(index >= length)); // fail fast
-    }
-    mem[index] &= ~(0xffff << shift); // clear the byte we are writing to
-    mem[index] |= (*data & 0xffff)<<shift; // set the byte we are writing to
+    word_t *word = mem_word(sim, address, true);
+    *word &= ~(0xffff << shift); // clear the byte we are writing to
+    *word |= (*data & 0xffff)<<shift; // set the byte we are writing to
     if (flags & MASK_DEBUG) {
-        printf("mem_write_h: address 0x%08x, data 0x%08x, array index %d\n",
-            address,*data,index);
+        printf("mem_write_h: address 0x%08x, data 0x%08x, page %d\n",
+            address,*data,address>>MEM_PAGE_BITS);
     }
 }
 // Write a byte to a memory address
-void mem_write_b(uint32_t address, word_t *data) {
-    uint32_t index = (address>>2) - (start>>2);
+void mem_write_b(sim_t *sim, uint32_t address, word_t *data) {
     uint32_t shift = ((3-(address & 0x3))<<3); // shift amount based on byte position
-    if (flags & MASK_SANITY && index >= length) {
-        cprintf(ANSI_C_RED, "mem_write_h: out of range address 0x%08x (index %d >= length %d)\n",
-            address,index,length);
-        assert(!(index >= length)); // fail fast
-    }
-    mem[index] &= ~(0xff << shift); // clear the byte we are writing to
-    mem[index] |= (*data & 0xff)<<shift; // set the byte we are writing to
+    word_t *word = mem_word(sim, address, true);
+    *word &= ~(0xff << shift); // clear the byte we are writing to
+    *word |= (*data & 0xff)<<shift; // set the byte we are writing to
     if (flags & MASK_DEBUG) {
-        printf("mem_write_b: address 0x%08x, data 0x%08x, array index %d\n",
-            address,*data,index);
+        printf("mem_write_b: address 0x%08x, data 0x%08x, page %d\n",
+            address,*data,address>>MEM_PAGE_BITS);
     }
 }
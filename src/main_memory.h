@@ -13,30 +13,68 @@
 #include "types.h"
 
 #define ENDIANNESS BIG
-#define MEM_FILL 1
-#define MEM_FILL_VALUE 0x0
 
-// Initialize the memory. Size and offset in bytes
-void mem_init(uint32_t size, uint32_t offset);
+// 4 KB pages, found through a two-level table covering all 32 bits of address
+#define MEM_PAGE_BITS   12
+#define MEM_PAGE_WORDS  (1 << (MEM_PAGE_BITS - 2))
+#define MEM_TABLE_BITS  10
+#define MEM_TABLE_SIZE  (1 << MEM_TABLE_BITS)
+#define MEM_DIR_SIZE    (1 << (32 - MEM_PAGE_BITS - MEM_TABLE_BITS))
+// Recently used pages remembered, by the low bits of the page number
+#define MEM_RECENT_SIZE 8
+// Not a page number, for empty slots
+#define MEM_NO_PAGE     0xFFFFFFFF
+
+/* Main memory of one simulation (see sim.h). Every 32-bit address can be
+ * read and written. Pages are only allocated when they are first written,
+ * and read as zero until then, so the cost of a memory follows what the
+ * program touches rather than its size. start and length describe the
+ * program image (see mem_init()), which is what the dump, interactive and
+ * predecode code look at; accesses outside of it are allowed.
+ */
+typedef struct MAIN_MEMORY {
+    word_t **dir[MEM_DIR_SIZE]; // page tables, each MEM_TABLE_SIZE pages
+    uint32_t pages;             // pages allocated
+    /* The pages used last, so accesses skip the tables. Instruction fetches
+     * and data accesses usually alternate between a couple of pages, which
+     * one remembered page would keep swapping. */
+    uint32_t recent_page[MEM_RECENT_SIZE];  // address >> MEM_PAGE_BITS, or MEM_NO_PAGE
+    word_t *recent[MEM_RECENT_SIZE];
+    uint32_t start;             // image start, in bytes, should be word-aligned
+    uint32_t length;            // image length, in words
+} main_memory_t;
+
+// Set up an empty memory holding an image of size bytes at offset (in bytes)
+void mem_init(sim_t *sim, uint32_t size, uint32_t offset);
+// Set up sim's memory as a copy of image's
+void mem_copy(sim_t *sim, sim_t *image);
 // Display memory state (does _not_ dump the entire memory!)
-void mem_dump(void);
-void mem_dump_cute(uint32_t offset, uint32_t words); // dump a small section of memory
+void mem_dump(sim_t *sim);
+void mem_dump_cute(sim_t *sim, uint32_t offset, uint32_t words); // dump a small section of memory
 // De-allocate memory
-void mem_close(void);
+void mem_close(sim_t *sim);
 // Get memory size in bytes or words
-uint32_t mem_size_b(void);
-uint32_t mem_size_w(void);
+uint32_t mem_size_b(sim_t *sim);
+uint32_t mem_size_w(sim_t *sim);
 // Get memory start and end addresses
-uint32_t mem_start(void);
-uint32_t mem_end(void);
+uint32_t mem_start(sim_t *sim);
+uint32_t mem_end(sim_t *sim);
 
+// Read a word without any debugging output
+word_t mem_peek_w(sim_t *sim, uint32_t address);
+/* Find the first written page whose number (address >> MEM_PAGE_BITS) is
+ * *page or higher, set *page to its number and return its MEM_PAGE_WORDS
+ * words. Returns NULL if there is none. */
+const word_t *mem_next_page(sim_t *sim, uint32_t *page);
+// Write count words starting at a word-aligned address, a page at a time
+void mem_load(sim_t *sim, uint32_t address, const word_t *words, uint32_t count);
 // Read from a memory address
-void mem_read_w(uint32_t address, word_t *data); // read word
-void mem_read_h(uint32_t address, word_t *data); // read half-word
-void mem_read_b(uint32_t address, word_t *data); // read byte
+void mem_read_w(sim_t *sim, uint32_t address, word_t *data); // read word
+void mem_read_h(sim_t *sim, uint32_t address, word_t *data); // read half-word
+void mem_read_b(sim_t *sim, uint32_t address, word_t *data); // read byte
 // Write from a memory address
-void mem_write_w(uint32_t address, word_t *data); // write word
-void mem_write_h(uint32_t address, word_t *data); // write half-word
-void mem_write_b(uint32_t address, word_t *data); // write byte
+void mem_write_w(sim_t *sim, uint32_t address, word_t *data); // write word
+void mem_write_h(sim_t *sim, uint32_t address, word_t *data); // write half-word
+void mem_write_b(sim_t *sim, uint32_t address, word_t *data); // write byte
 
 #endif // _MAIN_MEMORY_H
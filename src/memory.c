@@ -3,11 +3,73 @@
  */
 
 #include "memory.h"
+#include "sim.h"
 
 extern int flags; // from util.c
-extern profile_t *prof;
 
-void memory(control_t * exmem, control_t * memwb, cache_config_t *cache_cfg) {
+// Bytes read or written by a load or store
+static uint32_t memory_access_size(opcode_t opCode) {
+    switch (opCode) {
+        case OPC_LB:
+        case OPC_LBU:
+        case OPC_SB:
+            return 1;
+        case OPC_LH:
+        case OPC_LHU:
+        case OPC_SH:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+// Address of the load or store. decode() adds the branch offset to pcNext
+// for every instruction that isn't a jump, so take it back off.
+static uint32_t memory_access_pc(control_t *exmem) {
+    return exmem->pcNext - (exmem->immed << 2) - 4;
+}
+
+word_t memory_load_value(opcode_t opCode, uint32_t address, word_t word) {
+    word_t value;
+    switch (opCode) {
+        case OPC_LBU:
+        case OPC_LB:
+            value = (word >> ((3-(address & 0x3))<<3)) & 0xff;
+            return opCode == OPC_LB ? SIGN_EXTEND_B(value) : value;
+        case OPC_LHU:
+        case OPC_LH:
+            value = (word >> ((2-(address & 0x2))<<3)) & 0xffff;
+            return opCode == OPC_LH ? SIGN_EXTEND_H(value) : value;
+        default:
+            return word;
+    }
+}
+
+// The word a store goes into. It waits until the loads of its block that an
+// MSHR holds have their words, so they cannot see the store.
+static cache_status_t memory_store_read(sim_t *sim, uint32_t address, word_t *data) {
+    if (sim->mshr && mshr_holds(sim, address)) return CACHE_MISS;
+    //It waits for the fill, then misses
+    if (d_cache_replacing(sim, address)) return CACHE_MISS;
+    return d_cache_read_w(sim, &address, data);
+}
+
+/* Under no-write-allocate, a store to a block the D cache does not have goes
+* around it, as the bytes of data that mask selects, instead of filling the
+* block first. Returns false if the store goes through the cache instead. */
+static bool memory_store_around(sim_t *sim, uint32_t address, word_t data, word_t mask, cache_status_t *status) {
+    if (sim->cache_cfg.data_alloc != CACHE_NO_ALLOCATE || d_cache_has_block(sim, address)) return false;
+    if (sim->mshr && mshr_holds(sim, address)) {
+        // The loads waiting for the block must not see it
+        *status = CACHE_MISS;
+    } else {
+        *status = d_cache_write_around(sim, address, data, mask);
+    }
+    return true;
+}
+
+void memory(sim_t *sim, control_t *exmem, control_t *memwb) {
+    cache_config_t *cache_cfg = &sim->cache_cfg;
     if(flags & MASK_DEBUG){
         cprintf(ANSI_C_CYAN, "MEMORY:\n", NULL);
         printf("\tInstruction: 0x%08x\n", exmem->instr);
@@ -20,30 +82,28 @@ void memory(control_t * exmem, control_t * memwb, cache_config_t *cache_cfg) {
             case OPC_LBU:
             case OPC_LB:
                 if (cache_cfg->mode != CACHE_DISABLE && cache_cfg->data_enabled) {
-                    status = d_cache_read_w(&exmem->ALUresult, &temp);
-                    temp = temp >> ((3-(exmem->ALUresult & 0x3))<<3);
-                    temp &= 0xff;
+                    status = d_cache_read_w(sim, &exmem->ALUresult, &temp);
+                    temp = memory_load_value(exmem->opCode, exmem->ALUresult, temp);
                 } else {
-                    mem_read_b(exmem->ALUresult, &temp);
+                    mem_read_b(sim, exmem->ALUresult, &temp);
+                    if (exmem->opCode == OPC_LB) temp = SIGN_EXTEND_B(temp);
                 }
-                if (exmem->opCode == OPC_LB) temp = SIGN_EXTEND_B(temp);
                 break;
             case OPC_LHU:
             case OPC_LH:
                 if (cache_cfg->mode != CACHE_DISABLE && cache_cfg->data_enabled) {
-                    status = d_cache_read_w(&exmem->ALUresult, &temp);
-                    temp = temp >> ((2-(exmem->ALUresult & 0x2))<<3);
-                    temp &= 0xffff;
+                    status = d_cache_read_w(sim, &exmem->ALUresult, &temp);
+                    temp = memory_load_value(exmem->opCode, exmem->ALUresult, temp);
                 } else {
-                    mem_read_h(exmem->ALUresult,&temp);
+                    mem_read_h(sim, exmem->ALUresult,&temp);
+                    if (exmem->opCode == OPC_LH) temp = SIGN_EXTEND_H(temp);
                 }
-                if (exmem->opCode == OPC_LH) temp = SIGN_EXTEND_H(temp);
                 break;
             case OPC_LW:
                 if (cache_cfg->mode != CACHE_DISABLE && cache_cfg->data_enabled) {
-                    status = d_cache_read_w(&exmem->ALUresult, &temp);
+                    status = d_cache_read_w(sim, &exmem->ALUresult, &temp);
                 } else {
-                    mem_read_w(exmem->ALUresult, &temp);
+                    mem_read_w(sim, exmem->ALUresult, &temp);
                 }
                 break;
             default: // We should not get here. Complain and crash.
@@ -53,8 +113,20 @@ void memory(control_t * exmem, control_t * memwb, cache_config_t *cache_cfg) {
         if (flags & MASK_DEBUG) {
             printf("\tLoaded 0x%08x from address 0x%08x\n", temp, exmem->ALUresult);
         }
+        if (status == CACHE_MISS && sim->mshr) {
+            // Leave the load to an MSHR, and write nothing back for now
+            status = mshr_load(sim, exmem->opCode, exmem->ALUresult, memwb->regRt);
+            if (status == CACHE_PENDING) memwb->regWrite = false;
+        }
+        if (sim->d_prefetch && !sim->frozen) {
+            prefetch_access(sim, sim->d_prefetch, memory_access_pc(exmem), exmem->ALUresult, status);
+        }
         memwb->memData = temp;
         memwb->status = status;
+        if (sim->trace_out && status != CACHE_MISS) {
+            trace_writer_stage(sim->trace_out, TRACE_READ, memory_access_pc(exmem),
+                exmem->ALUresult, memory_access_size(exmem->opCode));
+        }
     }
     if (exmem->memWrite) {
         word_t data_in_cache;
@@ -62,52 +134,64 @@ void memory(control_t * exmem, control_t * memwb, cache_config_t *cache_cfg) {
             case OPC_SB:
                 temp = exmem->regRtValue;
                 if (cache_cfg->mode != CACHE_DISABLE && cache_cfg->data_enabled) {
-                    status = d_cache_read_w(&exmem->ALUresult, &data_in_cache);
+                    uint32_t shift = ((3-(exmem->ALUresult & 0x3))<<3);
+                    if (memory_store_around(sim, exmem->ALUresult, temp << shift, 0xff << shift, &status)) break;
+                    status = memory_store_read(sim, exmem->ALUresult, &data_in_cache);
                     if (status == CACHE_HIT) {
-                        uint32_t shift = ((3-(exmem->ALUresult & 0x3))<<3);
                         temp = temp << shift;
                         data_in_cache &= ~(0xff << shift);
                         temp = temp | data_in_cache;
-                        status = d_cache_write_w(&exmem->ALUresult, &temp);
+                        status = d_cache_write_w(sim, &exmem->ALUresult, &temp);
                     }
                 } else {
-                    mem_write_b(exmem->ALUresult, &temp);
+                    mem_write_b(sim, exmem->ALUresult, &temp);
                 }
                 break;
             case OPC_SH:
                 temp = exmem->regRtValue;
                 if (cache_cfg->mode != CACHE_DISABLE && cache_cfg->data_enabled) {
-                    status = d_cache_read_w(&exmem->ALUresult, &data_in_cache);
+                    uint32_t shift = ((2-(exmem->ALUresult & 0x2))<<3);
+                    if (memory_store_around(sim, exmem->ALUresult, temp << shift, 0xffff << shift, &status)) break;
+                    status = memory_store_read(sim, exmem->ALUresult, &data_in_cache);
                     if (status == CACHE_HIT) {
-                        uint32_t shift = ((2-(exmem->ALUresult & 0x2))<<3);
                         temp = temp << shift; // shift amount based on byte position
                         data_in_cache &= ~(0xffff << shift);
                         temp = temp | data_in_cache;
-                        status = d_cache_write_w(&exmem->ALUresult, &temp);
+                        status = d_cache_write_w(sim, &exmem->ALUresult, &temp);
                     }
                 } else {
-                    mem_write_h(exmem->ALUresult, &temp);
+                    mem_write_h(sim, exmem->ALUresult, &temp);
                 }
                 break;
             case OPC_SW:
                 temp = exmem->regRtValue;
                 if (cache_cfg->mode != CACHE_DISABLE && cache_cfg->data_enabled) {
-                    status = d_cache_read_w(&exmem->ALUresult, &data_in_cache);
+                    if (memory_store_around(sim, exmem->ALUresult, temp, 0xffffffff, &status)) break;
+                    status = memory_store_read(sim, exmem->ALUresult, &data_in_cache);
                     if (status == CACHE_HIT) {
-                        status = d_cache_write_w(&exmem->ALUresult, &temp);
+                        status = d_cache_write_w(sim, &exmem->ALUresult, &temp);
                     }
                 } else {
-                    mem_write_w(exmem->ALUresult, &temp);
+                    mem_write_w(sim, exmem->ALUresult, &temp);
                 }
                 break;
             default: // We should not get here. Complain and crash.
                 cprintf(ANSI_C_RED, "Illegal memory operation, opcode 0x%02x, (memWrite asserted). Halting.\n", exmem->opCode);
                 assert(0);
         }
+        if (sim->d_prefetch && !sim->frozen) {
+            prefetch_access(sim, sim->d_prefetch, memory_access_pc(exmem), exmem->ALUresult, status);
+        }
         memwb->status = status;
+        if (sim->trace_out && status != CACHE_MISS) {
+            trace_writer_stage(sim->trace_out, TRACE_WRITE, memory_access_pc(exmem),
+                exmem->ALUresult, memory_access_size(exmem->opCode));
+        }
+        // Any predecoded copy of the stored-to word is now stale
+        predecode_invalidate(sim, exmem->ALUresult);
         if (flags & MASK_DEBUG) {
             if (cache_cfg->mode != CACHE_DISABLE && cache_cfg->data_enabled) {
-                if (memwb->status == CACHE_HIT) {
+                if (memwb->status != CACHE_MISS) {
                     printf("\tStored 0x%08x to address 0x%08x\n", temp, exmem->ALUresult);
                 } else {
                     printf("\tTried to store 0x%08x to address 0x%08x\n", temp, exmem->ALUresult);
@@ -9,7 +9,11 @@
 #include "util.h"
 #include "main_memory.h"
 #include "cache.h"
+#include "predecode.h"
 
-void memory(control_t *exmem, control_t *memwb, cache_config_t *cache_cfg);
+void memory(sim_t *sim, control_t *exmem, control_t *memwb);
+
+// The value a load of opCode from address takes out of the word holding it
+word_t memory_load_value(opcode_t opCode, uint32_t address, word_t word);
 
 #endif
@@ -0,0 +1,155 @@
+/*
+* src/mshr.c
+* Miss status holding registers, for a data cache that does not block on loads
+*/
+
+#include "mshr.h"
+#include "memory.h"
+#include "registers.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+mshr_file_t * mshr_init(uint32_t entries, uint32_t block_size){
+    mshr_file_t *mshr = (mshr_file_t *)malloc(sizeof(mshr_file_t));
+    if(mshr == NULL){
+        cprintf(ANSI_C_RED, "mshr_init: Unable to allocate MSHRs\n");
+        assert(0);
+    }
+    mshr->entries = (mshr_t *)malloc(sizeof(mshr_t) * entries);
+    if(mshr->entries == NULL){
+        cprintf(ANSI_C_RED, "mshr_init: Unable to allocate MSHRs\n");
+        assert(0);
+    }
+    mshr->size = entries;
+    mshr->block_bytes = block_size << 2;
+    mshr->count = 0;
+    for(uint32_t i = 0; i < 32; i++){
+        mshr->owner[i] = 0;
+    }
+    mshr->next_tag = 1;
+    return mshr;
+}
+
+void mshr_free(mshr_file_t *mshr){
+    free(mshr->entries);
+    free(mshr);
+}
+
+// The MSHR waiting for the block of address, or NULL
+static mshr_t *mshr_find(mshr_file_t *mshr, uint32_t address){
+    uint32_t block = address & ~(mshr->block_bytes - 1);
+    for(uint32_t i = 0; i < mshr->count; i++){
+        if(mshr->entries[i].block == block) return &mshr->entries[i];
+    }
+    return NULL;
+}
+
+cache_status_t mshr_load(sim_t *sim, opcode_t opCode, uint32_t address, uint32_t reg){
+    mshr_file_t *mshr = sim->mshr;
+    mshr_t *entry = mshr_find(mshr, address);
+    if(entry){
+        for(uint32_t i = 0; i < entry->targets; i++){
+            mshr_target_t *target = &entry->target[i];
+            if(target->address == address && target->opCode == opCode && target->reg == reg &&
+                (reg == REG_ZERO || mshr->owner[reg] == target->tag)){
+                //Already waiting
+                return CACHE_PENDING;
+            }
+        }
+        if(entry->targets == MSHR_TARGETS){
+            gprintf("\tmshr_load: no room for another load of block 0x%08x\n", entry->block);
+            return CACHE_MISS;
+        }
+    } else {
+        if(mshr->count == mshr->size){
+            gprintf("\tmshr_load: every MSHR is in use\n");
+            return CACHE_MISS;
+        }
+        entry = &mshr->entries[mshr->count++];
+        entry->block = address & ~(mshr->block_bytes - 1);
+        entry->targets = 0;
+    }
+    mshr_target_t *target = &entry->target[entry->targets++];
+    target->opCode = opCode;
+    target->address = address;
+    target->reg = reg;
+    target->tag = mshr->next_tag++;
+    //A load into $zero is still made, but nothing waits for it
+    if(reg != REG_ZERO) mshr->owner[reg] = target->tag;
+    sim->prof.mshr_loads++;
+    gprintf("\tmshr_load: load of 0x%08x into $%s waits for block 0x%08x\n", address, get_register_name_string(reg), entry->block);
+    cache_event(sim);
+    return CACHE_PENDING;
+}
+
+bool mshr_holds(sim_t *sim, uint32_t address){
+    return mshr_find(sim->mshr, address) != NULL;
+}
+
+bool mshr_pending(sim_t *sim, uint32_t reg){
+    return sim->mshr->owner[reg] != 0;
+}
+
+void mshr_written(sim_t *sim, uint32_t reg){
+    sim->mshr->owner[reg] = 0;
+}
+
+bool mshr_busy(sim_t *sim){
+    return sim->mshr->count != 0;
+}
+
+void mshr_digest(sim_t *sim){
+    mshr_file_t *mshr = sim->mshr;
+    word_t word, value;
+    uint32_t i = 0;
+    while(i < mshr->count){
+        mshr_t *entry = &mshr->entries[i];
+        //Finish the loads whose words are in
+        uint32_t kept = 0;
+        for(uint32_t j = 0; j < entry->targets; j++){
+            mshr_target_t *target = &entry->target[j];
+            if(!d_cache_probe_w(sim, target->address, &word)){
+                entry->target[kept++] = *target;
+                continue;
+            }
+            cache_event(sim);
+            if(target->reg != REG_ZERO && mshr->owner[target->reg] == target->tag){
+                value = memory_load_value(target->opCode, target->address, word);
+                gprintf("\tmshr_digest: loaded 0x%08x from 0x%08x into $%s\n", value, target->address, get_register_name_string(target->reg));
+                reg_write(sim, target->reg, &value);
+                mshr->owner[target->reg] = 0;
+            }
+        }
+        entry->targets = kept;
+        if(kept){
+            i++;
+            continue;
+        }
+        //Every load is done, free the MSHR
+        for(uint32_t j = i + 1; j < mshr->count; j++){
+            mshr->entries[j - 1] = mshr->entries[j];
+        }
+        mshr->count--;
+    }
+    //The oldest MSHR asks for its block, if the cache can start a fill
+    if(mshr->count){
+        d_cache_request(sim, mshr->entries[0].target[0].address);
+    }
+}
+
+void mshr_print(sim_t *sim){
+    mshr_file_t *mshr = sim->mshr;
+    if(mshr == NULL){
+        eprintf("The D cache blocks on misses (no MSHRs)\n");
+        return;
+    }
+    eprintf("MSHRs: %d of %d in use\n", mshr->count, mshr->size);
+    for(uint32_t i = 0; i < mshr->count; i++){
+        eprintf("Block 0x%08x:", mshr->entries[i].block);
+        for(uint32_t j = 0; j < mshr->entries[i].targets; j++){
+            eprintf(" $%s <- 0x%08x", get_register_name_string(mshr->entries[i].target[j].reg), mshr->entries[i].target[j].address);
+        }
+        eprintf("\n");
+    }
+}
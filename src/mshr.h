@@ -0,0 +1,90 @@
+/*
+* src/mshr.h
+* Miss status holding registers, for a data cache that does not block on loads
+*/
+
+#ifndef _MSHR_H
+#define _MSHR_H
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "types.h"
+
+// Loads that one MSHR can hold for its block
+#define MSHR_TARGETS 4
+
+/* With MSHRs, a load that misses in the D cache does not stop the pipeline.
+* It is handed to the MSHR of its block (a new one, or the one an earlier
+* load already missed on) and goes on to write back without its data, and
+* its register is marked pending. The hazard unit holds an instruction that
+* uses a pending register in decode, so only the loads' dependents wait.
+*
+* The cache still fills one block at a time. The MSHRs ask for their blocks
+* oldest first, whenever the D cache is not busy with a fill (see
+* mshr_digest(), run by cache_digest()). A load is finished, writing its
+* register, as soon as its word is in the cache, and in the meantime other
+* loads and stores that hit go ahead. A load that finds no MSHR to use, and a
+* store to a block an MSHR is waiting for, stall the pipeline as before.
+*
+* A later instruction that writes a pending register first makes the value
+* of the load stale, so writeback() tells the MSHRs (mshr_written()) and the
+* load leaves the register alone.
+*/
+typedef struct MSHR_TARGET {
+    opcode_t opCode;        // which load, for the part of the word it wants
+    uint32_t address;
+    uint32_t reg;
+    uint32_t tag;           // owner[reg] while reg still waits on this load
+} mshr_target_t;
+
+typedef struct MSHR {
+    uint32_t block;         // first byte of the block
+    uint32_t targets;       // loads still waiting
+    mshr_target_t target[MSHR_TARGETS];
+} mshr_t;
+
+typedef struct MSHR_FILE {
+    uint32_t size;
+    uint32_t block_bytes;
+    mshr_t *entries;        // the first count are in use, oldest first
+    uint32_t count;
+    uint32_t owner[32];     // tag of the load each register waits on, 0 for none
+    uint32_t next_tag;
+} mshr_file_t;
+
+/*
+* mshr_file_t * mshr_init(uint32_t entries, uint32_t block_size)
+* Creates entries MSHRs for a D cache with blocks of block_size words
+*/
+mshr_file_t * mshr_init(uint32_t entries, uint32_t block_size);
+
+void mshr_free(mshr_file_t *mshr);
+
+/* Hand a load of reg from address that missed to an MSHR. Returns
+* CACHE_PENDING if one took it, or CACHE_MISS if the pipeline has to wait. A
+* load already handed over (a retry while the pipeline is frozen) is not
+* added again. */
+cache_status_t mshr_load(sim_t *sim, opcode_t opCode, uint32_t address, uint32_t reg);
+
+// True while an MSHR is waiting for the block of address
+bool mshr_holds(sim_t *sim, uint32_t address);
+
+// True while reg waits on a load that missed
+bool mshr_pending(sim_t *sim, uint32_t reg);
+
+// A later instruction wrote reg, so the load it waits on must not
+void mshr_written(sim_t *sim, uint32_t reg);
+
+// Finish the loads whose words have arrived, and start the next fill
+void mshr_digest(sim_t *sim);
+
+// True while any load is waiting
+bool mshr_busy(sim_t *sim);
+
+/* Debugging functions */
+void mshr_print(sim_t *sim);
+
+#endif /* _MSHR_H */
@@ -0,0 +1,98 @@
+/* src/predecode.c
+ * Predecoded instruction store, built from the program image at load time
+ */
+
+#include "predecode.h"
+#include "fetch.h"
+#include "decode.h"
+#include "main_memory.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+void predecode_init(sim_t *sim, uint32_t offset, uint32_t size) {
+    predecode_table_t *pd = &sim->predecode;
+    pd->length = size>>2;
+    pd->start = offset & 0xfffffffc;
+    pd->table = (predecode_entry_t *)malloc(sizeof(predecode_entry_t)*(pd->length ? pd->length : 1));
+    // If the table didn't get allocated, crash the program
+    if (NULL == pd->table) assert(0);
+    for (uint32_t i = 0; i < pd->length; ++i) pd->table[i].valid = false;
+    bprintf("Initializing predecode table. Size: %d words, offset: 0x%08x\n", pd->length, pd->start);
+}
+
+void predecode_build(sim_t *sim) {
+    predecode_table_t *pd = &sim->predecode;
+    uint32_t count = 0;
+    // Peek at the image (mem_read_w() would print every word when debugging)
+    for (uint32_t i = 0; i < pd->length; ++i) {
+        predecode_load(sim, pd->start + (i<<2), mem_peek_w(sim, pd->start + (i<<2)));
+        if (pd->table[i].valid) ++count;
+    }
+    bprintf("Predecoded %d of %d words\n", count, pd->length);
+}
+
+void predecode_close(sim_t *sim) {
+    free(sim->predecode.table);
+    sim->predecode.table = NULL;
+    sim->predecode.length = 0;
+}
+
+void predecode_load(sim_t *sim, uint32_t address, inst_t instr) {
+    predecode_table_t *pd = &sim->predecode;
+    uint32_t index = (address>>2) - (pd->start>>2);
+    if (index >= pd->length) return;
+    predecode_entry_t *entry = &pd->table[index];
+    entry->instr = instr;
+    // Split the fields exactly as fetch() does...
+    flush(&entry->fetched);
+    entry->fetched.instr = instr;
+    fetch_fields(&entry->fetched);
+    // ...and set the control bits exactly as decode() does
+    flush(&entry->decoded);
+    copy_pipeline_register(&entry->fetched, &entry->decoded);
+    entry->valid = (decode_control(&entry->decoded) == 0);
+}
+
+void predecode_invalidate(sim_t *sim, uint32_t address) {
+    predecode_table_t *pd = &sim->predecode;
+    uint32_t index = (address>>2) - (pd->start>>2);
+    if (index < pd->length) pd->table[index].valid = false;
+}
+
+predecode_entry_t *predecode_lookup(sim_t *sim, uint32_t address, inst_t instr) {
+    predecode_table_t *pd = &sim->predecode;
+    uint32_t index = (address>>2) - (pd->start>>2);
+    if (index >= pd->length) return NULL;
+    predecode_entry_t *entry = &pd->table[index];
+    if (!entry->valid || entry->instr != instr) return NULL;
+    return entry;
+}
+
+void predecode_apply_fetch(predecode_entry_t *entry, control_t *ifid) {
+    ifid->opCode    = entry->fetched.opCode;
+    ifid->regRs     = entry->fetched.regRs;
+    ifid->regRt     = entry->fetched.regRt;
+    ifid->regRd     = entry->fetched.regRd;
+    ifid->shamt     = entry->fetched.shamt;
+    ifid->funct     = entry->fetched.funct;
+    ifid->address   = entry->fetched.address;
+    ifid->immed     = entry->fetched.immed;
+}
+
+void predecode_apply_decode(predecode_entry_t *entry, control_t *idex) {
+    idex->regDst    = entry->decoded.regDst;
+    idex->regWrite  = entry->decoded.regWrite;
+    idex->ALUSrc    = entry->decoded.ALUSrc;
+    idex->PCSrc     = entry->decoded.PCSrc;
+    idex->memRead   = entry->decoded.memRead;
+    idex->memWrite  = entry->decoded.memWrite;
+    idex->memToReg  = entry->decoded.memToReg;
+    idex->ALUop     = entry->decoded.ALUop;
+    idex->jump      = entry->decoded.jump;
+    // J/JAL override the register fields and LUI the shift amount
+    idex->regRs     = entry->decoded.regRs;
+    idex->regRt     = entry->decoded.regRt;
+    idex->regRd     = entry->decoded.regRd;
+    idex->shamt     = entry->decoded.shamt;
+}
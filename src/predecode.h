@@ -0,0 +1,53 @@
+/* src/predecode.h
+ * Predecoded instruction store, built from the program image at load time
+ */
+
+#ifndef _PREDECODE_H
+#define _PREDECODE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "types.h"
+#include "util.h"
+
+/* Every word of the loaded program image gets an entry holding the fields
+ * fetch() would split out of it and the control bits decode() would set for
+ * it, so the pipeline can copy them instead of re-parsing the instruction
+ * every cycle. Entries are dropped when the word is stored to, and words that
+ * do not decode to a legal instruction (data) never get a valid entry. */
+typedef struct PREDECODE_ENTRY {
+    bool        valid;
+    inst_t      instr;      // raw instruction the entry was built from
+    control_t   fetched;    // instruction fields, as split by fetch()
+    control_t   decoded;    // control bits and operation, as set by decode()
+} predecode_entry_t;
+
+// Predecode table of one simulation (see sim.h)
+typedef struct PREDECODE_TABLE {
+    predecode_entry_t *table;   // one entry per word of the program image
+    uint32_t start;             // first address covered, in bytes, word-aligned
+    uint32_t length;            // length, in words
+} predecode_table_t;
+
+// Allocate an (all invalid) table covering size bytes starting at offset
+void predecode_init(sim_t *sim, uint32_t offset, uint32_t size);
+// Build entries for every word of main memory covered by the table
+void predecode_build(sim_t *sim);
+// De-allocate the table
+void predecode_close(sim_t *sim);
+
+// Build the entry for a single word
+void predecode_load(sim_t *sim, uint32_t address, inst_t instr);
+// Drop the entry for the word containing address (called on stores)
+void predecode_invalidate(sim_t *sim, uint32_t address);
+// Returns the entry for address if it is valid and was built from instr, or NULL
+predecode_entry_t *predecode_lookup(sim_t *sim, uint32_t address, inst_t instr);
+
+// Copy the predecoded fields into the IF/ID or ID/EX pipeline register
+void predecode_apply_fetch(predecode_entry_t *entry, control_t *ifid);
+void predecode_apply_decode(predecode_entry_t *entry, control_t *idex);
+
+#endif /* _PREDECODE_H */
@@ -0,0 +1,196 @@
+/*
+* src/prefetch.c
+* Hardware prefetchers for the I and D caches
+*/
+
+#include "prefetch.h"
+#include "cache.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+prefetcher_t * prefetch_init(cache_prefetch_t type, bool inst, uint32_t degree, uint32_t block_size){
+    prefetcher_t *pf = (prefetcher_t *)calloc(1, sizeof(prefetcher_t));
+    if(pf == NULL){
+        cprintf(ANSI_C_RED, "prefetch_init: Unable to allocate prefetcher\n");
+        assert(0);
+    }
+    pf->type = type;
+    pf->inst = inst;
+    pf->degree = degree;
+    pf->block_bytes = block_size << 2;
+    return pf;
+}
+
+void prefetch_free(prefetcher_t *pf){
+    free(pf);
+}
+
+// Queue the block starting at block, unless it is already waiting or unused
+static void prefetch_queue(prefetcher_t *pf, uint32_t block){
+    for(uint32_t i = 0; i < pf->queued; i++){
+        if(pf->queue[i] == block) return;
+    }
+    for(uint32_t i = 0; i < pf->tracking; i++){
+        if(pf->tracked[i] == block) return;
+    }
+    if(pf->queued == PREFETCH_QUEUE){
+        //The newest guesses are the likeliest to be in time, drop the oldest
+        for(uint32_t i = 1; i < PREFETCH_QUEUE; i++){
+            pf->queue[i - 1] = pf->queue[i];
+        }
+        pf->queued--;
+    }
+    gprintf("\tprefetch_queue: block 0x%08x\n", block);
+    pf->queue[pf->queued++] = block;
+}
+
+// Forget a tracked block. Returns false if it was not tracked.
+static bool prefetch_untrack(prefetcher_t *pf, uint32_t block){
+    for(uint32_t i = 0; i < pf->tracking; i++){
+        if(pf->tracked[i] == block){
+            pf->tracked[i] = pf->tracked[--pf->tracking];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void prefetch_track(prefetcher_t *pf, uint32_t block){
+    if(pf->tracking < PREFETCH_TRACKED){
+        pf->tracked[pf->tracking++] = block;
+        return;
+    }
+    //Long unused blocks were most likely replaced, reuse their slots in turn
+    pf->tracked[pf->next_tracked] = block;
+    pf->next_tracked = (pf->next_tracked + 1) % PREFETCH_TRACKED;
+}
+
+// Queue the blocks ahead of block number n in direction dir, up to degree of them
+static void prefetch_ahead(prefetcher_t *pf, uint32_t n, int32_t dir){
+    for(uint32_t i = 1; i <= pf->degree; i++){
+        prefetch_queue(pf, (n + dir * (int32_t)i) * pf->block_bytes);
+    }
+}
+
+/* Stream prefetching, on a miss or a first use of block number n: go on with
+* a stream it continues, set the direction of one it is next to, or start a
+* new stream */
+static void prefetch_stream(prefetcher_t *pf, uint32_t n){
+    prefetch_stream_t *stream;
+    for(uint32_t i = 0; i < PREFETCH_STREAMS; i++){
+        stream = &pf->streams[i];
+        if(stream->dir == 0) continue;
+        //Past the last block that trained it, up to the furthest one queued
+        bool within = stream->dir > 0 ? (n > stream->last && n <= stream->ahead) :
+            (n < stream->last && n >= stream->ahead);
+        if(within){
+            stream->last = n;
+            for(uint32_t ahead = n + stream->dir * (int32_t)pf->degree; stream->ahead != ahead;){
+                stream->ahead += stream->dir;
+                prefetch_queue(pf, stream->ahead * pf->block_bytes);
+            }
+            return;
+        }
+    }
+    //A stream with no direction yet that has only seen the block next to it.
+    //(One that never saw any is all zeroes.)
+    for(uint32_t i = 0; i < PREFETCH_STREAMS; i++){
+        stream = &pf->streams[i];
+        if(stream->dir == 0 && stream->last != 0 && (n == stream->last + 1 || n == stream->last - 1)){
+            stream->dir = (n == stream->last + 1) ? 1 : -1;
+            stream->last = n;
+            stream->ahead = n + stream->dir * (int32_t)pf->degree;
+            prefetch_ahead(pf, n, stream->dir);
+            return;
+        }
+    }
+    stream = &pf->streams[pf->next_stream];
+    pf->next_stream = (pf->next_stream + 1) % PREFETCH_STREAMS;
+    stream->last = n;
+    stream->dir = 0;
+    stream->ahead = n;
+}
+
+// Stride prefetching, on every access to address by the instruction at pc
+static void prefetch_stride(prefetcher_t *pf, uint32_t pc, uint32_t address){
+    prefetch_stride_t *entry = &pf->strides[(pc >> 2) % PREFETCH_STRIDES];
+    if(entry->pc != pc){
+        entry->pc = pc;
+        entry->last = address;
+        entry->stride = 0;
+        entry->confirmed = 0;
+        return;
+    }
+    int32_t stride = (int32_t)(address - entry->last);
+    if(stride == 0) return;
+    if(stride == entry->stride){
+        entry->confirmed++;
+    } else {
+        entry->stride = stride;
+        entry->confirmed = 0;
+    }
+    entry->last = address;
+    if(entry->confirmed == 0) return;
+    uint32_t block = address & ~(pf->block_bytes - 1);
+    for(uint32_t i = 1; i <= pf->degree; i++){
+        uint32_t next = (address + stride * (int32_t)i) & ~(pf->block_bytes - 1);
+        if(next != block) prefetch_queue(pf, next);
+    }
+}
+
+void prefetch_access(sim_t *sim, prefetcher_t *pf, uint32_t pc, uint32_t address, cache_status_t status){
+    uint32_t block = address & ~(pf->block_bytes - 1);
+    bool missed = (status == CACHE_MISS || status == CACHE_PENDING);
+    bool trigger = missed;
+    if(prefetch_untrack(pf, block)){
+        //The first use of a prefetched block
+        if(!missed){
+            pf->useful++;
+        } else if(cache_fetching_block(sim, pf->inst, block)){
+            pf->late++;
+        } else {
+            //Replaced before it was used
+            pf->misses++;
+        }
+        trigger = true;
+    } else if(missed){
+        pf->misses++;
+    }
+    switch(pf->type){
+        case PREFETCH_NEXT_LINE:
+            if(trigger) prefetch_ahead(pf, block / pf->block_bytes, 1);
+            break;
+        case PREFETCH_STREAM:
+            if(trigger) prefetch_stream(pf, block / pf->block_bytes);
+            break;
+        case PREFETCH_STRIDE:
+            prefetch_stride(pf, pc, address);
+            break;
+        default:
+            break;
+    }
+}
+
+void prefetch_digest(sim_t *sim, prefetcher_t *pf){
+    while(pf->queued && cache_idle(sim)){
+        uint32_t block = pf->queue[0];
+        for(uint32_t i = 1; i < pf->queued; i++){
+            pf->queue[i - 1] = pf->queue[i];
+        }
+        pf->queued--;
+        if(cache_holds_block(sim, pf->inst, block)) continue;
+        if(!cache_request_block(sim, pf->inst, block)) continue;
+        gprintf("\tprefetch_digest: prefetching block 0x%08x into the %c cache\n", block, pf->inst ? 'I' : 'D');
+        pf->issued++;
+        prefetch_track(pf, block);
+    }
+}
+
+void prefetch_print(prefetcher_t *pf){
+    eprintf("%c prefetcher: %d blocks queued, %d prefetched and not used yet\n", pf->inst ? 'I' : 'D', pf->queued, pf->tracking);
+    for(uint32_t i = 0; i < pf->queued; i++){
+        eprintf(" 0x%08x", pf->queue[i]);
+    }
+    if(pf->queued) eprintf("\n");
+}
@@ -0,0 +1,102 @@
+/*
+* src/prefetch.h
+* Hardware prefetchers for the I and D caches
+*/
+
+#ifndef _PREFETCH_H
+#define _PREFETCH_H
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "types.h"
+
+// Blocks waiting to be prefetched
+#define PREFETCH_QUEUE 8
+// Prefetched blocks remembered until they are used
+#define PREFETCH_TRACKED 32
+// Streams followed at once
+#define PREFETCH_STREAMS 4
+// Entries of the stride table, indexed by the PC of the load or store
+#define PREFETCH_STRIDES 16
+
+/* A prefetcher watches the demand accesses of one port (fetches for the I
+* prefetcher, loads and stores for the D prefetcher) and queues the blocks it
+* expects to be used next:
+*   next-line - the degree blocks after a block that missed, or after a
+*               prefetched block on its first use.
+*   stream    - the same, once two misses to neighbouring blocks set a
+*               direction, so it follows streams going down as well as up.
+*   stride    - the next degree addresses of a load or store whose address
+*               changed by the same amount twice in a row.
+* Only the first attempt of an access trains it, not the retries while the
+* pipeline is frozen.
+*
+* Prefetches go through the same fill as a miss, so they take the same memory
+* time (and replace a block the same way). They have lower priority than
+* demand accesses: cache_digest() starts one (see prefetch_digest()) only when
+* memory has nothing else to do, no cache is fetching, the write buffer is
+* empty and no MSHR is waiting. A demand miss that comes while a prefetch fill
+* is under way waits for it like for any other fill.
+*
+* A prefetched block is useful if an access hits it before it is replaced,
+* and late if the access comes while it is still being fetched. Accuracy is
+* the share of prefetches that were used, coverage the share of the misses
+* there would have been that they removed, and timeliness the share of used
+* prefetches that were not late.
+*/
+typedef struct PREFETCH_STREAM {
+    uint32_t last;          // block number of the last access that trained it
+    int32_t dir;            // +1 or -1, or 0 until a second miss sets it
+    uint32_t ahead;         // block number of the furthest block queued
+} prefetch_stream_t;
+
+typedef struct PREFETCH_STRIDE {
+    uint32_t pc;
+    uint32_t last;          // address of the last access
+    int32_t stride;
+    uint32_t confirmed;     // times in a row the stride was seen again
+} prefetch_stride_t;
+
+typedef struct PREFETCHER {
+    cache_prefetch_t type;
+    bool inst;              // fills the I cache, otherwise the D cache
+    uint32_t degree;
+    uint32_t block_bytes;
+    uint32_t queue[PREFETCH_QUEUE];     // first bytes of blocks, oldest first
+    uint32_t queued;
+    uint32_t tracked[PREFETCH_TRACKED]; // prefetched blocks not used yet
+    uint32_t tracking;
+    uint32_t next_tracked;              // slot to reuse when all are in use
+    prefetch_stream_t streams[PREFETCH_STREAMS];
+    uint32_t next_stream;
+    prefetch_stride_t strides[PREFETCH_STRIDES];
+    //Statistics
+    uint32_t issued;
+    uint32_t useful;        // hit before they were replaced
+    uint32_t late;          // wanted while still being fetched
+    uint32_t misses;        // demand misses not to a prefetched block
+} prefetcher_t;
+
+/*
+* prefetcher_t * prefetch_init(cache_prefetch_t type, bool inst, uint32_t degree, uint32_t block_size)
+* Creates a prefetcher for the I (inst) or D cache with blocks of block_size words
+*/
+prefetcher_t * prefetch_init(cache_prefetch_t type, bool inst, uint32_t degree, uint32_t block_size);
+
+void prefetch_free(prefetcher_t *pf);
+
+/* The first attempt of a demand access to address by the instruction at pc,
+* with the status the cache gave it (CACHE_PENDING for a load left to an
+* MSHR counts as a miss) */
+void prefetch_access(sim_t *sim, prefetcher_t *pf, uint32_t pc, uint32_t address, cache_status_t status);
+
+// Start fetching the oldest queued block, if memory is free for it
+void prefetch_digest(sim_t *sim, prefetcher_t *pf);
+
+/* Debugging functions */
+void prefetch_print(prefetcher_t *pf);
+
+#endif /* _PREFETCH_H */
@@ -3,22 +3,22 @@
  */
 
 #include "registers.h"
+#include "sim.h"
 
-static word_t regfile[32];
-
-void reg_init(void) {
-    for (int i = 0; i < 32; ++i) regfile[i] = 0;
+void reg_init(sim_t *sim) {
+    for (int i = 0; i < 32; ++i) sim->regfile[i] = 0;
 }
 
-void reg_read(int reg, word_t *value) {
-    *value = regfile[reg];
+void reg_read(sim_t *sim, int reg, word_t *value) {
+    *value = sim->regfile[reg];
 }
 
-void reg_write(int reg, word_t *value) {
-    if (reg) regfile[reg] = *value;
+void reg_write(sim_t *sim, int reg, word_t *value) {
+    if (reg) sim->regfile[reg] = *value;
 }
 
-void reg_dump(void) {
+void reg_dump(sim_t *sim) {
+    word_t *regfile = sim->regfile;
     int i;
     eprintf("Dumping registers:\n");
     eprintf("\t$zero: 0x%08x (%d)\n",regfile[REG_ZERO],regfile[REG_ZERO]);
@@ -10,14 +10,14 @@
 #include "util.h"
 
 // Initialize the registers
-void reg_init(void);
+void reg_init(sim_t *sim);
 // Print all the register values
-void reg_dump(void);
+void reg_dump(sim_t *sim);
 
 // Read from a register by register number
-void reg_read(int reg, word_t *value);
+void reg_read(sim_t *sim, int reg, word_t *value);
 // Write to a register by register number
-void reg_write(int reg, word_t *value);
+void reg_write(sim_t *sim, int reg, word_t *value);
 
 // Mapping register names to register numbers
 enum RegNames {
@@ -0,0 +1,57 @@
+/* src/replay.c
+ * Trace-driven cache simulation, replaying a --trace-out recording
+ */
+
+#include "replay.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+// The load or store memory() makes for an access of this kind and size
+static opcode_t replay_opcode(trace_kind_t kind, uint32_t size) {
+    if (kind == TRACE_READ) {
+        return size == 1 ? OPC_LBU : size == 2 ? OPC_LHU : OPC_LW;
+    }
+    return size == 1 ? OPC_SB : size == 2 ? OPC_SH : OPC_SW;
+}
+
+uint32_t replay_run(sim_t *sim, trace_reader_t *reader) {
+    trace_record_t record;
+    bool more = trace_reader_next(reader, &record);
+    bool fetch;
+    uint32_t cycle = (uint32_t)-1;  // recorded cycle of the previous accesses
+    while (more) {
+        // Recorded cycles skip the cycles the hazard unit charges for
+        // resolving branches late (see hazard()), which make no accesses
+        sim->prof.cycles += record.cycle - cycle - 1;
+        // Gather the accesses of one recorded cycle into the EX/MEM register and pc
+        cycle = record.cycle;
+        control_t *exmem = sim->exmem;
+        exmem->memRead = false;
+        exmem->memWrite = false;
+        fetch = false;
+        while (more && record.cycle == cycle) {
+            if (record.kind == TRACE_FETCH) {
+                sim->pc = record.pc;
+                fetch = true;
+            } else {
+                exmem->memRead = (record.kind == TRACE_READ);
+                exmem->memWrite = (record.kind == TRACE_WRITE);
+                exmem->opCode = replay_opcode(record.kind, record.size);
+                exmem->ALUresult = record.address;
+                exmem->regRtValue = 0;
+                // So the memory stage sees the pc of the access (see memory.c)
+                exmem->immed = 0;
+                exmem->pcNext = record.pc + 4;
+            }
+            more = trace_reader_next(reader, &record);
+        }
+        // Retry the cycle for as long as it misses, as the pipeline would
+        do {
+            sim_replay_cycle(sim, !(flags & MASK_DEBUG), fetch);
+        } while (sim->frozen);
+    }
+    sim_drain(sim);
+    sim->prof.instruction_count = reader->instructions;
+    return sim->prof.cycles;
+}
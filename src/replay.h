@@ -0,0 +1,27 @@
+/* src/replay.h
+ * Trace-driven cache simulation, replaying a --trace-out recording
+ */
+
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "util.h"
+#include "trace.h"
+
+/* Feed every access of the trace through the caches of sim, one recorded
+ * cycle at a time, and fill in its profile. A trace records the cycles the
+ * pipeline latched, and a frozen pipeline does not move at all, so that
+ * sequence of cycles is the same whatever the caches were when it was
+ * recorded. Replaying it against any cache configuration gives the same
+ * cycles, hit rates and instruction count as running the program with that
+ * configuration, without fetching, decoding or executing anything.
+ * Main memory must cover every address in the trace (its contents do not
+ * matter). Returns the number of cycles replayed.
+ */
+uint32_t replay_run(sim_t *sim, trace_reader_t *reader);
+
+#endif /* _REPLAY_H */
@@ -0,0 +1,349 @@
+/* src/sim.c
+ * Simulator context, holding the state of one simulation
+ */
+
+#include "sim.h"
+#include "registers.h"
+#include "fetch.h"
+#include "decode.h"
+#include "alu.h"
+#include "memory.h"
+#include "write.h"
+#include "hazard.h"
+#include "single.h"
+
+extern int flags; // from util.c
+
+sim_t *sim_init(cpu_config_t *cpu_cfg, cache_config_t *cache_cfg) {
+    sim_t *sim = (sim_t *)calloc(1, sizeof(sim_t));
+    // If the context didn't get allocated, crash the program
+    if (NULL == sim) assert(0);
+    sim->cpu_cfg = *cpu_cfg;
+    sim->cache_cfg = *cache_cfg;
+    reg_init(sim);
+    pipeline_init(&sim->ifid, &sim->idex, &sim->exmem, &sim->memwb, &sim->pc, 0);
+    pipeline_init(&sim->ifid_next, &sim->idex_next, &sim->exmem_next, &sim->memwb_next, &sim->pc, 0);
+    sim->frozen = false;
+    sim->memory_status = MEM_IDLE;
+    sim->memory_events = 0;
+    if (sim->cache_cfg.mode != CACHE_DISABLE) {
+        cache_init(sim);
+    }
+    // Logistics initialization
+    sim->prof.i_cache_status_prev = CACHE_HIT;
+    sim->prof.i_cache_status = CACHE_NO_ACCESS;
+    sim->prof.d_cache_status = CACHE_NO_ACCESS;
+    sim->prof.d_cache_status_prev = CACHE_NO_ACCESS;
+    return sim;
+}
+
+void sim_destroy(sim_t *sim) {
+    pipeline_destroy(&sim->ifid, &sim->idex, &sim->exmem, &sim->memwb);
+    pipeline_destroy(&sim->ifid_next, &sim->idex_next, &sim->exmem_next, &sim->memwb_next);
+    cache_destroy(sim);
+    if (sim->predecode.table) predecode_close(sim);
+    mem_close(sim);
+    free(sim);
+}
+
+void sim_copy_image(sim_t *sim, sim_t *image) {
+    mem_copy(sim, image);
+    predecode_init(sim, image->predecode.start, image->predecode.length<<2);
+    memcpy(sim->predecode.table, image->predecode.table,
+        sizeof(predecode_entry_t)*image->predecode.length);
+    memcpy(sim->regfile, image->regfile, sizeof(sim->regfile));
+    sim->pc = image->pc;
+}
+
+uint32_t sim_fast_forward(sim_t *sim) {
+    uint32_t ff = single_cycle_run(sim, &sim->pc, sim->cpu_cfg.ff_insts, sim->cpu_cfg.ff_warm);
+    // The detailed model restarts from pc alone, so finish any pending delay slot
+    if (sim->pc != 0 && single_cycle_in_delay_slot(sim)) {
+        ff += single_cycle_run(sim, &sim->pc, 1, sim->cpu_cfg.ff_warm);
+    }
+    return ff;
+}
+
+bool sim_done(sim_t *sim) {
+    // Check for a magic halt number (beq zero zero -1 or jr zero)
+    if (sim->pc == 0) return true;
+    // End of the detailed simulation window
+    return sim->cpu_cfg.detail_insts && sim->prof.instruction_count >= sim->cpu_cfg.detail_insts;
+}
+
+uint32_t sim_drain(sim_t *sim) {
+    uint32_t cycles = 0;
+    while (sim->mshr && mshr_busy(sim)) {
+        cache_digest(sim);
+        cycles++;
+    }
+    sim->prof.cycles += cycles;
+    return cycles;
+}
+
+/* Latch the next pipeline registers at the end of a cycle. The old ones
+ * are recycled as the next inputs, since every stage overwrites its output. */
+static void sim_latch(sim_t *sim) {
+    control_t *temp;
+    temp = sim->ifid;  sim->ifid  = sim->ifid_next;  sim->ifid_next  = temp;
+    temp = sim->idex;  sim->idex  = sim->idex_next;  sim->idex_next  = temp;
+    temp = sim->exmem; sim->exmem = sim->exmem_next; sim->exmem_next = temp;
+    temp = sim->memwb; sim->memwb = sim->memwb_next; sim->memwb_next = temp;
+}
+
+// Freeze the pipeline if the memory or fetch access of this cycle missed
+static bool sim_freeze(sim_t *sim) {
+    cache_config_t *cache_cfg = &sim->cache_cfg;
+    sim->frozen = cache_cfg->mode != CACHE_DISABLE &&
+        (cache_cfg->inst_enabled || cache_cfg->data_enabled) &&
+        (sim->memwb_next->status == CACHE_MISS || sim->ifid_next->status == CACHE_MISS);
+    if (sim->frozen) {
+        gprintf("\tcache miss! Freezing the pipeline\n");
+    }
+    return sim->frozen;
+}
+
+/* Count the cache accesses of the cycle, advance the memory system, skip
+ * ahead if nothing can change, and latch the pipeline unless it froze.
+ * retry and events are as they were at the start of the cycle. */
+static uint32_t sim_end_cycle(sim_t *sim, bool skip, bool retry, uint32_t events) {
+    cache_config_t *cache_cfg = &sim->cache_cfg;
+    profile_t *prof = &sim->prof;
+    uint32_t skipped = 0;   // cycles skipped ahead to the next memory system event
+
+    if (cache_cfg->mode != CACHE_DISABLE) {
+        if (cache_cfg->inst_enabled) {
+            prof->i_cache_status = sim->ifid_next->status;
+            if (prof->i_cache_status_prev == CACHE_HIT) {
+                prof->i_cache_access_count++;
+                if (prof->i_cache_status == CACHE_HIT) {
+                    prof->i_cache_hit_count++;
+                }
+            }
+            prof->i_cache_status_prev = prof->i_cache_status;
+        }
+        if (cache_cfg->data_enabled) {
+            prof->d_cache_status = sim->memwb_next->status;
+            if (prof->d_cache_status == CACHE_HIT && prof->d_cache_status_prev != CACHE_MISS) {
+                prof->d_cache_hit_count++;
+                prof->d_cache_access_count++;
+            } else if (prof->d_cache_status == CACHE_MISS && prof->d_cache_status_prev != CACHE_MISS) {
+                prof->d_cache_access_count++;
+            } else if (prof->d_cache_status == CACHE_PENDING && !retry) {
+                prof->d_cache_access_count++;
+            }
+            prof->d_cache_status_prev = prof->d_cache_status;
+            // The load is gone from the pipeline, so later cycles do not count it again
+            if (sim->memwb_next->status == CACHE_PENDING) sim->memwb_next->status = CACHE_NO_ACCESS;
+        }
+        cache_digest(sim);
+    }
+    // A retried cycle that changed nothing in the memory system will be
+    // repeated exactly until the active penalty counter expires, so jump
+    // straight to the next event.
+    if (skip && retry && sim->frozen && sim->memory_events == events) {
+        skipped = cache_cycles_to_event(sim);
+        cache_skip(sim, skipped);
+        prof->cycles += skipped;
+        if (cache_cfg->inst_enabled && prof->i_cache_status == CACHE_HIT) {
+            prof->i_cache_access_count += skipped;
+            prof->i_cache_hit_count += skipped;
+        }
+        if (cache_cfg->data_enabled && prof->d_cache_status == CACHE_HIT) {
+            prof->d_cache_access_count += skipped;
+            prof->d_cache_hit_count += skipped;
+        }
+    }
+    if (sim->frozen) sim->frozen_cycles += skipped + 1;
+    if (sim->write_buffer && sim->write_buffer->full) {
+        // A write stayed in the pipeline for want of a write buffer entry
+        prof->write_buffer_full += skipped + 1;
+        sim->write_buffer->full = false;
+    }
+    if (sim->trace_out) {
+        // Traces count cycles as if the caches never missed, so the same
+        // program always gives the same trace
+        if (sim->frozen) {
+            trace_writer_discard(sim->trace_out);
+        } else {
+            trace_writer_commit(sim->trace_out, prof->cycles - sim->frozen_cycles);
+        }
+    }
+    if (!sim->frozen) sim_latch(sim);
+    prof->cycles++;
+    return skipped + 1;
+}
+
+uint32_t sim_cycle(sim_t *sim, bool skip) {
+    bool retry;             // this cycle retries the memory accesses of a frozen one
+    uint32_t events;        // memory system events before this cycle
+
+    // Run a pipeline cycle. Each stage reads the current pipeline registers
+    // and fills in the next ones, which are only latched if no cache access
+    // missed. A cycle that misses freezes the pipeline, and while it is
+    // frozen only the memory accesses are retried: the register file was
+    // already written back and the other stages would compute the same thing.
+    retry = sim->frozen;
+    events = sim->memory_events;
+    if (!sim->frozen) {
+        writeback(sim, sim->memwb);
+        // memory() only sets the status for loads and stores
+        sim->memwb_next->status = sim->memwb->status;
+    }
+    memory(sim, sim->exmem, sim->memwb_next);
+    fetch(sim, sim->ifid_next, &sim->pc);
+    if (!sim_freeze(sim)) {
+        execute(sim->idex, sim->exmem_next);
+        decode(sim, sim->ifid, sim->idex_next);
+        hazard(sim, sim->ifid_next, sim->idex_next, sim->exmem_next, sim->memwb_next, &sim->pc);
+    }
+    return sim_end_cycle(sim, skip, retry, events);
+}
+
+uint32_t sim_replay_cycle(sim_t *sim, bool skip, bool fetch) {
+    cache_config_t *cache_cfg = &sim->cache_cfg;
+    bool retry = sim->frozen;
+    uint32_t events = sim->memory_events;
+
+    // Only the memory accesses of the cycle are made, as sim_cycle() makes them
+    if (!sim->frozen) {
+        sim->memwb_next->status = sim->memwb->status;
+    }
+    memory(sim, sim->exmem, sim->memwb_next);
+    if (fetch && cache_cfg->mode != CACHE_DISABLE && cache_cfg->inst_enabled) {
+        sim->ifid_next->status = i_cache_read_w(sim, &sim->pc, &sim->ifid_next->instr);
+        if (sim->i_prefetch && !retry) prefetch_access(sim, sim->i_prefetch, sim->pc, sim->pc, sim->ifid_next->status);
+    }
+    sim_freeze(sim);
+    return sim_end_cycle(sim, skip, retry, events);
+}
+
+void sim_print_summary_header(void) {
+    printf("$# %-6s | %-6s | %-6s | %-6s | %-6s | %-6s | %-6s | %-6s | %-8s | %-8s | File\n",
+        "Isize", "Dsize", "Iblock", "Dblock", "Dwrite", "Ihit %", "Dhit %", "CPI", "Cycles", "Icount");
+}
+
+void sim_print_summary(sim_t *sim, const char *filename) {
+    cache_config_t *cache_cfg = &sim->cache_cfg;
+    profile_t *prof = &sim->prof;
+    if (cache_cfg->mode == CACHE_UNIFIED) {
+        // One cache: the hit rates of each port, then of both together
+        printf("$# %6d | %6d | %6d | %6d | %6s | %6.2f | %6.2f | %6.3f | %8d | %8d | %s\n",
+            cache_cfg->size, cache_cfg->size, cache_cfg->block, cache_cfg->block,
+            (cache_cfg->wpolicy==CACHE_WRITEBACK?"WB":"WT"),
+            100*((float)prof->i_cache_hit_count)/((float)prof->i_cache_access_count),
+            100*((float)prof->d_cache_hit_count)/((float)prof->d_cache_access_count),
+            ((float)prof->cycles)/((float)prof->instruction_count), prof->cycles,
+            prof->instruction_count, filename);
+        printf("Unified cache hit rate: %.2f%% (%u of %u accesses)\n",
+            100*((float)(prof->i_cache_hit_count + prof->d_cache_hit_count))/
+                ((float)(prof->i_cache_access_count + prof->d_cache_access_count)),
+            prof->i_cache_hit_count + prof->d_cache_hit_count,
+            prof->i_cache_access_count + prof->d_cache_access_count);
+    } else if (cache_cfg->mode != CACHE_DISABLE) {
+        printf("$# %6d | %6d | %6d | %6d | %6s | %6.2f | %6.2f | %6.3f | %8d | %8d | %s\n",
+            cache_cfg->inst_size, cache_cfg->data_size,
+            cache_cfg->inst_block, cache_cfg->data_block,
+            (cache_cfg->data_wpolicy==CACHE_WRITEBACK?"WB":"WT"),
+            100*((float)prof->i_cache_hit_count)/((float)prof->i_cache_access_count),
+            100*((float)prof->d_cache_hit_count)/((float)prof->d_cache_access_count),
+            ((float)prof->cycles)/((float)prof->instruction_count), prof->cycles,
+            prof->instruction_count, filename);
+    } else {
+        printf("$# %6s | %6s | %6s | %6s | %6s | %6s | %6s | %6.3f | %8d | %8d | %s\n",
+            "n/a", "n/a", "n/a", "n/a", "n/a", "n/a", "n/a",
+            ((float)prof->cycles)/((float)prof->instruction_count), prof->cycles,
+            prof->instruction_count, filename);
+    }
+}
+
+void sim_print_write_buffer(sim_t *sim) {
+    profile_t *prof = &sim->prof;
+    if (sim->write_buffer == NULL) return;
+    printf("Write buffer: %u %s, full for %u cycles (%.2f%%)\n",
+        sim->write_buffer->size, sim->write_buffer->size == 1 ? "entry" : "entries",
+        prof->write_buffer_full, 100*((float)prof->write_buffer_full)/((float)prof->cycles));
+}
+
+void sim_print_mshr(sim_t *sim) {
+    profile_t *prof = &sim->prof;
+    if (sim->mshr == NULL) return;
+    printf("MSHRs: %u, %u loads missed without stalling, dependents waited %u cycles (%.2f%%)\n",
+        sim->mshr->size, prof->mshr_loads,
+        prof->mshr_held, 100*((float)prof->mshr_held)/((float)prof->cycles));
+}
+
+// One prefetcher's line of sim_print_prefetch()
+static void sim_print_prefetcher(prefetcher_t *pf) {
+    static const char * const names[] = {
+        [PREFETCH_NONE] = "none", [PREFETCH_NEXT_LINE] = "next-line",
+        [PREFETCH_STREAM] = "stream", [PREFETCH_STRIDE] = "stride"
+    };
+    uint32_t used = pf->useful + pf->late;
+    printf("%c prefetcher: %s, degree %u, %u prefetched, accuracy %.2f%%, coverage %.2f%%, timeliness %.2f%%\n",
+        pf->inst ? 'I' : 'D', names[pf->type], pf->degree, pf->issued,
+        pf->issued ? 100*((float)used)/((float)pf->issued) : 0,
+        used + pf->misses ? 100*((float)used)/((float)(used + pf->misses)) : 0,
+        used ? 100*((float)pf->useful)/((float)used) : 0);
+}
+
+// One victim cache's line of sim_print_victims()
+static void sim_print_victim(const char *name, victim_cache_t *vc) {
+    printf("%s victim cache: %u %s, %u of %u fills hit (%.2f%%)\n",
+        name, vc->entries, vc->entries == 1 ? "entry" : "entries", vc->hits, vc->fills,
+        vc->fills ? 100*((float)vc->hits)/((float)vc->fills) : 0);
+}
+
+void sim_print_victims(sim_t *sim) {
+    const char *data = sim->cache_cfg.mode == CACHE_UNIFIED ? "Unified" : "D";
+    if (sim->i_cache && sim->i_cache->victims) sim_print_victim("I", sim->i_cache->victims);
+    if (sim->d_cache && sim->d_cache->victims) sim_print_victim(data, sim->d_cache->victims);
+}
+
+void sim_print_prefetch(sim_t *sim) {
+    if (sim->i_prefetch) sim_print_prefetcher(sim->i_prefetch);
+    if (sim->d_prefetch) sim_print_prefetcher(sim->d_prefetch);
+}
+
+void sim_print_l2(sim_t *sim) {
+    profile_t *prof = &sim->prof;
+    l2_cache_t *l2 = sim->l2;
+    if (l2 == NULL) return;
+    uint32_t accesses = prof->i_cache_access_count + prof->d_cache_access_count;
+    uint32_t hits = prof->i_cache_hit_count + prof->d_cache_hit_count;
+    float l1_hit = accesses ? ((float)hits)/((float)accesses) : 1;
+    float l2_hit = l2->accesses ? ((float)l2->hits)/((float)l2->accesses) : 1;
+    // A first level hit takes a cycle, a miss waits for the L2, and an L2
+    // miss for memory as well
+    float memory = CACHE_MISS_PENALTY;
+    if (sim->dram && (sim->dram->reads + sim->dram->writes)) {
+        memory = ((float)sim->dram->latency)/((float)(sim->dram->reads + sim->dram->writes));
+    }
+    float amat = 1 + (1 - l1_hit) * (l2->latency + (1 - l2_hit) * memory);
+    printf("L2 cache: %u bytes, hit rate %.2f%% (%u of %u fills), %u of %u writes hit, %u writebacks, %u back-invalidations\n",
+        sim->cache_cfg.l2_size, 100*l2_hit, l2->hits, l2->accesses,
+        l2->write_hits, l2->writes, l2->writebacks, l2->back_invalidations);
+    printf("Average memory access time: %.3f cycles (L1 hit rate %.2f%%, L2 hit rate %.2f%%)\n",
+        amat, 100*l1_hit, 100*l2_hit);
+}
+
+void sim_print_dram(sim_t *sim) {
+    dram_t *dram = sim->dram;
+    if (dram == NULL) return;
+    uint32_t accesses = dram->reads + dram->writes;
+    uint32_t misses = accesses - dram->row_hits - dram->row_conflicts;
+    printf("DRAM: %u reads, %u writes, %u row hits (%.2f%%), %u row misses, %u row conflicts, %.2f cycles to the first word\n",
+        dram->reads, dram->writes, dram->row_hits, accesses ? 100*((float)dram->row_hits)/((float)accesses) : 0,
+        misses, dram->row_conflicts, accesses ? ((float)dram->latency)/((float)accesses) : 0);
+}
+
+void sim_print_bus(sim_t *sim) {
+    bus_t *bus = sim->bus;
+    if (bus == NULL) return;
+    printf("Bus: %s, %u word%s wide, %s arbitration: %u transactions, %llu cycles of waits overlapped",
+        bus->config.split ? "split transaction" : "serial", bus->config.width, bus->config.width == 1 ? "" : "s",
+        bus->config.arbitration == BUS_ROUND_ROBIN ? "round-robin" : bus->config.arbitration == BUS_READ_FIRST ? "read-first" : "fixed priority",
+        bus->transactions, (unsigned long long)bus->overlapped);
+    if (bus->config.arbitration == BUS_READ_FIRST) printf(", %u write drains", bus->drains);
+    printf("\n");
+}
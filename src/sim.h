@@ -0,0 +1,141 @@
+/* src/sim.h
+ * Simulator context, holding the state of one simulation
+ */
+
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "types.h"
+#include "util.h"
+#include "main_memory.h"
+#include "predecode.h"
+#include "cache.h"
+#include "trace.h"
+
+/* Everything one simulation reads or writes lives here: the configuration,
+ * pipeline registers, register file, main memory, predecoded instructions,
+ * caches and statistics. Every stateful function takes the context as its
+ * first argument, so several simulations can run side by side in one process
+ * (one context per thread). Only the output flags in util.c are shared, and
+ * those are set once before any simulation starts.
+ */
+struct SIM {
+    cpu_config_t        cpu_cfg;
+    cache_config_t      cache_cfg;
+
+    /* Pipeline */
+    control_t           *ifid, *idex, *exmem, *memwb;
+    // Next-state pipeline registers, written by the stages during a cycle
+    control_t           *ifid_next, *idex_next, *exmem_next, *memwb_next;
+    pc_t                pc;
+    bool                frozen;     // the last cycle missed in a cache
+    uint32_t            frozen_cycles;  // cycles spent frozen, which traces leave out
+
+    /* Single-cycle engine: address of the instruction after the one at
+     * npc_for, which is the delay slot after a branch (see single.c) */
+    pc_t                npc;
+    pc_t                npc_for;
+
+    /* Architectural state */
+    word_t              regfile[32];
+    main_memory_t       memory;
+    predecode_table_t   predecode;
+
+    /* Memory system (see cache.c). Each cache is either direct mapped or set
+     * associative, so only one of its two pointers is set. */
+    direct_cache_t      *d_cache;
+    direct_cache_t      *i_cache;
+    assoc_cache_t       *d_assoc;
+    assoc_cache_t       *i_assoc;
+    // Unified mode has only the D cache, which the I port shares
+    cache_latch_t       d_latch;
+    cache_latch_t       i_latch;
+    write_buffer_t      *write_buffer;
+    // The D cache blocks on a miss if NULL
+    mshr_file_t         *mshr;
+    // Second level cache, if not NULL
+    l2_cache_t          *l2;
+    // Banks of main memory, or NULL for the fixed memory penalties
+    dram_t              *dram;
+    // Split transaction or arbitrated bus, or NULL for the fixed order
+    bus_t               *bus;
+    // Prefetchers of the two ports, if not NULL
+    prefetcher_t        *d_prefetch;
+    prefetcher_t        *i_prefetch;
+    memory_status_t     memory_status;
+    uint32_t            memory_events;
+
+    profile_t           prof;
+
+    // Address trace recorded by the single-cycle engine, if not NULL
+    addr_trace_t        *trace;
+    // Memory reference trace file written by the pipeline, if not NULL
+    trace_writer_t      *trace_out;
+};
+
+/* Allocate a context with empty registers, pipeline and statistics, and
+ * caches built from cache_cfg. Main memory and the predecode table are set up
+ * by the caller (see parse()), which also sets the starting pc.
+ */
+sim_t *sim_init(cpu_config_t *cpu_cfg, cache_config_t *cache_cfg);
+// Free everything the context owns, including main memory
+void sim_destroy(sim_t *sim);
+
+// Copy the loaded program (memory, predecode table, registers and pc) of image into sim
+void sim_copy_image(sim_t *sim, sim_t *image);
+
+/* Run the first cpu_cfg.ff_insts instructions functionally with the
+ * single-cycle engine, warming the caches if cpu_cfg.ff_warm is set, and
+ * finish any pending delay slot so the pipeline can restart from pc.
+ * Returns the number of instructions fast-forwarded.
+ */
+uint32_t sim_fast_forward(sim_t *sim);
+
+// True once the program has halted or the detailed window is complete
+bool sim_done(sim_t *sim);
+
+/* Run the memory system until the loads still waiting in MSHRs have their
+ * data, once the pipeline has stopped. Returns the number of cycles taken,
+ * which are added to the profile. */
+uint32_t sim_drain(sim_t *sim);
+
+/* Simulate one pipeline clock cycle, or several if the pipeline is frozen on
+ * a cache miss and nothing can change until the memory system finishes (see
+ * cache_cycles_to_event()). Returns the number of cycles simulated.
+ * Skipping is only done if skip is true.
+ */
+uint32_t sim_cycle(sim_t *sim, bool skip);
+
+/* Replay one cycle of a recorded trace (see replay.c): the load or store set
+ * up in the EX/MEM register and, if fetch is true, the instruction fetch at
+ * pc go through the caches exactly as sim_cycle() would send them, with
+ * the same freezing, statistics and skipping. Nothing is executed.
+ */
+uint32_t sim_replay_cycle(sim_t *sim, bool skip, bool fetch);
+
+// Print the "$#" statistics summary: the header line, and one line for sim
+void sim_print_summary_header(void);
+void sim_print_summary(sim_t *sim, const char *filename);
+// Print the size of the write buffer and how long it was full, if there is one
+void sim_print_write_buffer(sim_t *sim);
+// Print the number of MSHRs and how much they were used, if there are any
+void sim_print_mshr(sim_t *sim);
+// Print the fills each victim cache served, if there are any
+void sim_print_victims(sim_t *sim);
+/* Print how many blocks each prefetcher fetched, and how accurate, covering
+ * and timely they were (see prefetch.h), if there are any */
+void sim_print_prefetch(sim_t *sim);
+/* Print the hit rates of the L2 and the average memory access time of the
+ * two levels, if there is an L2 */
+void sim_print_l2(sim_t *sim);
+// Print how the DRAM accesses found their rows, if there is a DRAM model
+void sim_print_dram(sim_t *sim);
+// Print how the bus was shared, if there is a bus model
+void sim_print_bus(sim_t *sim);
+
+#endif /* _SIM_H */
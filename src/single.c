@@ -0,0 +1,140 @@
+/* src/single.c
+ * Functional single-cycle CPU model
+ */
+
+#include "single.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+uint32_t single_cycle_run(sim_t *sim, pc_t *pc, uint32_t max_insts, bool warm) {
+    inst_t instr;
+    control_t scratch;
+    control_t *c;
+    predecode_entry_t *entry;
+    word_t rs, rt, arg2, result, data;
+    pc_t target;
+    bool zero, taken, write;
+    uint32_t count = 0;
+    bool warm_i = false, warm_d = false;
+
+    if (warm && sim->cache_cfg.mode != CACHE_DISABLE) {
+        warm_i = sim->cache_cfg.inst_enabled;
+        warm_d = sim->cache_cfg.data_enabled;
+    }
+    // Address of the instruction after the one at the program counter. This
+    // is the delay slot after a branch, so it persists between calls.
+    pc_t npc = sim->npc;
+
+    // Starting somewhere new (not resuming a previous run), so no branch is pending
+    if (sim->npc_for != *pc) npc = *pc + 4;
+
+    while (*pc != 0 && (max_insts == 0 || count < max_insts)) {
+        // Fetch and decode, from the predecoded template if there is one
+        mem_read_w(sim, *pc, &instr);
+        if (warm_i) i_cache_warm(sim, *pc);
+        if (sim->trace) trace_append(&sim->trace->inst, *pc);
+        entry = predecode_lookup(sim, *pc, instr);
+        if (entry) {
+            c = &entry->decoded;
+        } else {
+            flush(&scratch);
+            scratch.instr = instr;
+            fetch_fields(&scratch);
+            if (decode_control(&scratch) != 0) {
+                cprintf(ANSI_C_RED, "Illegal instruction 0x%08x at 0x%08x. Halting.\n", instr, *pc);
+                assert(0);
+            }
+            c = &scratch;
+        }
+        gprintf("SINGLE: 0x%08x: 0x%08x\n", *pc, instr);
+
+        reg_read(sim, (int)c->regRs, &rs);
+        reg_read(sim, (int)c->regRt, &rt);
+
+        // Resolve the next program counter, taking effect after the delay slot
+        target = npc + 4;
+        if (c->jump) {
+            if (c->opCode == OPC_RTYPE) {
+                target = rs; // jr
+            } else {
+                target = (npc & 0xF0000000) | (c->address << 2);
+                rt = npc + 4; // return address, added to $zero for jal
+            }
+        } else if (c->PCSrc) {
+            switch (c->opCode) {
+                case OPC_BEQ:  taken = (rs == rt);          break;
+                case OPC_BNE:  taken = (rs != rt);          break;
+                case OPC_BLTZ: taken = ((int32_t)rs <  0);  break;
+                case OPC_BGTZ: taken = ((int32_t)rs >  0);  break;
+                case OPC_BLEZ: taken = ((int32_t)rs <= 0);  break;
+                default:       taken = false;               break;
+            }
+            if (taken) target = npc + (c->immed << 2);
+        }
+
+        // Execute, memory access and write back
+        if (c->regWrite || c->memRead || c->memWrite) {
+            arg2 = c->ALUSrc ? c->immed : rt;
+            // As in the pipeline, the result is preloaded from rd so that
+            // MOVZ/MOVN (and overflowing ADD/SUB) leave it unmodified
+            reg_read(sim, (int)c->regRd, &result);
+            alu(c->ALUop, rs, arg2, c->shamt, &result, &zero);
+            write = c->regWrite &&
+                !((c->ALUop == OPR_MOVZ && arg2 != 0) ||
+                  (c->ALUop == OPR_MOVN && arg2 == 0));
+            if (c->memRead) {
+                switch (c->opCode) {
+                    case OPC_LB:
+                        mem_read_b(sim, result, &data);
+                        data = SIGN_EXTEND_B(data);
+                        break;
+                    case OPC_LBU:
+                        mem_read_b(sim, result, &data);
+                        break;
+                    case OPC_LH:
+                        mem_read_h(sim, result, &data);
+                        data = SIGN_EXTEND_H(data);
+                        break;
+                    case OPC_LHU:
+                        mem_read_h(sim, result, &data);
+                        break;
+                    default:
+                        mem_read_w(sim, result, &data);
+                        break;
+                }
+                if (warm_d) d_cache_warm(sim, result, false);
+                if (sim->trace) trace_append(&sim->trace->data, result);
+                result = data;
+            } else if (c->memWrite) {
+                switch (c->opCode) {
+                    case OPC_SB:
+                        mem_write_b(sim, result, &rt);
+                        break;
+                    case OPC_SH:
+                        mem_write_h(sim, result, &rt);
+                        break;
+                    default:
+                        mem_write_w(sim, result, &rt);
+                        break;
+                }
+                predecode_invalidate(sim, result);
+                if (warm_d) d_cache_warm(sim, result, true);
+                if (sim->trace) trace_append(&sim->trace->data, result);
+            }
+            if (write) reg_write(sim, (int)(c->regDst ? c->regRd : c->regRt), &result);
+        }
+
+        *pc = npc;
+        npc = target;
+        ++count;
+    }
+    if (sim->trace) sim->trace->insts += count;
+    sim->npc = npc;
+    sim->npc_for = *pc;
+    return count;
+}
+
+bool single_cycle_in_delay_slot(sim_t *sim) {
+    return sim->npc != sim->npc_for + 4;
+}
@@ -0,0 +1,42 @@
+/* src/single.h
+ * Functional single-cycle CPU model
+ */
+
+#ifndef _SINGLE_H
+#define _SINGLE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "types.h"
+#include "util.h"
+#include "registers.h"
+#include "main_memory.h"
+#include "predecode.h"
+#include "fetch.h"
+#include "decode.h"
+#include "alu.h"
+#include "cache.h"
+
+/* single_cycle_run() executes instructions starting at *pc directly against
+ * the register file and main memory, one instruction per cycle, with no
+ * pipeline registers, hazard unit or caches. Branch delay slots behave as in
+ * the pipeline, and the run stops when the program counter reaches zero (the
+ * halt convention used by the pipeline) or after max_insts instructions,
+ * if max_insts is not zero. *pc is left at the next instruction to execute.
+ * Returns the number of instructions executed, which counts the same way as
+ * the pipeline's instruction count.
+ * If warm is true and caching is enabled, every instruction fetch and data
+ * access also warms the corresponding cache (no timing is modeled).
+ * If the simulation has a trace attached, every fetch and data access is
+ * appended to it.
+ */
+uint32_t single_cycle_run(sim_t *sim, pc_t *pc, uint32_t max_insts, bool warm);
+
+/* Returns true if the last run stopped between a branch and its delay slot,
+ * in which case the next instruction is not simply at pc + 4.
+ */
+bool single_cycle_in_delay_slot(sim_t *sim);
+
+#endif /* _SINGLE_H */
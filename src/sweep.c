@@ -0,0 +1,336 @@
+/* src/sweep.c
+ * Design-space sweep: run many cache configurations of one program in parallel
+ */
+
+#define _POSIX_C_SOURCE 200112L // for sysconf()
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "sweep.h"
+#include "sim.h"
+#include "single.h"
+#include "trace.h"
+
+extern int flags; // from util.c
+
+// One configuration of the sweep, and the simulation that ran it
+typedef struct SWEEP_JOB {
+    cache_config_t  cache_cfg;
+    sim_t           *sim;
+} sweep_job_t;
+
+/* Work shared by the worker threads, which take jobs in order until none
+ * are left and hand each one to work() */
+typedef struct SWEEP_POOL {
+    void            (*work)(struct SWEEP_POOL *pool, uint32_t job);
+    sim_t           *image;
+    sweep_job_t     *jobs;
+    uint32_t        num_jobs;
+    uint32_t        next_job;
+    pthread_mutex_t lock;
+
+    /* Single pass: one job per stream and distinct block size, which finds
+     * the hits of every cache size for that block size */
+    addr_stream_t   **streams;
+    uint32_t        *blocks;
+    uint32_t        *levels;        // largest cache needed, as log2 of its blocks
+    uint32_t        (*hits)[TRACE_MAX_LEVEL + 1];
+} sweep_pool_t;
+
+static bool power_of_two(unsigned long value, unsigned long max) {
+    return value != 0 && !(value & (value - 1)) && value <= max;
+}
+
+uint32_t sweep_parse_sizes(const char *arg, uint32_t *inst_sizes, uint32_t *data_sizes) {
+    uint32_t count = 0;
+    char *end;
+    while (*arg && count < SWEEP_LIST_MAX) {
+        unsigned long isize = strtoul(arg, &end, 10);
+        unsigned long dsize = isize;
+        if (end == arg) return 0;
+        if (*end == ':') {
+            arg = end + 1;
+            dsize = strtoul(arg, &end, 10);
+            if (end == arg) return 0;
+        }
+        if (!power_of_two(isize, 2<<15) || !power_of_two(dsize, 2<<15)) return 0;
+        inst_sizes[count] = isize;
+        data_sizes[count] = dsize;
+        ++count;
+        if (*end == ',') {
+            arg = end + 1;
+        } else if (*end) {
+            return 0;
+        } else {
+            arg = end;
+        }
+    }
+    return *arg ? 0 : count;
+}
+
+uint32_t sweep_parse_blocks(const char *arg, uint32_t *blocks) {
+    uint32_t count = 0;
+    char *end;
+    while (*arg && count < SWEEP_LIST_MAX) {
+        unsigned long block = strtoul(arg, &end, 10);
+        if (end == arg || !power_of_two(block, 2<<7)) return 0;
+        blocks[count++] = block;
+        if (*end == ',') {
+            arg = end + 1;
+        } else if (*end) {
+            return 0;
+        } else {
+            arg = end;
+        }
+    }
+    return *arg ? 0 : count;
+}
+
+uint32_t sweep_parse_wpolicies(const char *arg, cache_wpolicy_t *wpolicies) {
+    uint32_t count = 0;
+    size_t length;
+    while (*arg && count < SWEEP_LIST_MAX) {
+        length = strcspn(arg, ",");
+        if (length == 0) return 0;
+        if (!strncmp(arg,"back",length) || !strncmp(arg,"b",length)) {
+            wpolicies[count++] = CACHE_WRITEBACK;
+        } else if (!strncmp(arg,"through",length) || !strncmp(arg,"thru",length) ||
+                !strncmp(arg,"t",length)) {
+            wpolicies[count++] = CACHE_WRITETHROUGH;
+        } else {
+            return 0;
+        }
+        arg += length;
+        if (*arg == ',') ++arg;
+    }
+    return *arg ? 0 : count;
+}
+
+// Run one configuration from start to finish, without any debugger hooks
+static void sweep_simulate(sim_t *sim) {
+    if (sim->cpu_cfg.ff_insts) sim_fast_forward(sim);
+    while (!sim_done(sim)) {
+        sim_cycle(sim, !(flags & MASK_DEBUG));
+    }
+    sim_drain(sim);
+}
+
+static void sweep_simulate_job(sweep_pool_t *pool, uint32_t job) {
+    sim_t *sim = sim_init(&pool->image->cpu_cfg, &pool->jobs[job].cache_cfg);
+    sim_copy_image(sim, pool->image);
+    sweep_simulate(sim);
+    pool->jobs[job].sim = sim;
+}
+
+static void sweep_evaluate_job(sweep_pool_t *pool, uint32_t job) {
+    trace_direct_hits(pool->streams[job], pool->blocks[job], pool->levels[job], pool->hits[job]);
+}
+
+static void *sweep_worker(void *arg) {
+    sweep_pool_t *pool = (sweep_pool_t *)arg;
+    uint32_t job;
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        job = pool->next_job++;
+        pthread_mutex_unlock(&pool->lock);
+        if (job >= pool->num_jobs) break;
+        pool->work(pool, job);
+    }
+    return NULL;
+}
+
+// Run every job of the pool on up to num_threads threads (0 for one per online CPU)
+static void sweep_parallel(sweep_pool_t *pool, uint32_t num_threads) {
+    if (num_threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus > 0 ? (uint32_t)cpus : 1;
+    }
+    if (num_threads > pool->num_jobs) num_threads = pool->num_jobs;
+    if (num_threads == 0) return;
+    bprintf("Sweeping %d jobs on %d threads\n", pool->num_jobs, num_threads);
+
+    uint32_t started = 0;
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+    if (NULL == threads) assert(0);
+    pool->next_job = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    for (uint32_t t = 0; t < num_threads; ++t) {
+        if (pthread_create(&threads[t], NULL, sweep_worker, pool) != 0) break;
+        ++started;
+    }
+    if (started == 0) {
+        // No threads to be had, so do all the work here
+        sweep_worker(pool);
+    }
+    for (uint32_t t = 0; t < started; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(threads);
+}
+
+static uint32_t log2_of(uint32_t value) {
+    uint32_t log = 0;
+    while ((1u << log) < value) ++log;
+    return log;
+}
+
+/* Find the stream and block size job of the single pass, adding it if it is
+ * new, and make sure it covers caches of num_blocks blocks */
+static uint32_t sweep_pass_job(sweep_pool_t *pool, addr_stream_t *stream,
+        uint32_t block, uint32_t num_blocks) {
+    uint32_t job;
+    for (job = 0; job < pool->num_jobs; ++job) {
+        if (pool->streams[job] == stream && pool->blocks[job] == block) break;
+    }
+    if (job == pool->num_jobs) {
+        pool->streams[job] = stream;
+        pool->blocks[job] = block;
+        pool->levels[job] = 0;
+        pool->num_jobs++;
+    }
+    if (log2_of(num_blocks) > pool->levels[job]) pool->levels[job] = log2_of(num_blocks);
+    return job;
+}
+
+/* Record the program's address stream once with the single-cycle engine,
+ * over the same window the pipeline would simulate, then find the hits of
+ * every configuration from it. */
+static int sweep_run_single_pass(sweep_config_t *sweep, sweep_pool_t *pool,
+        const char *filename) {
+    sweep_job_t *jobs = pool->jobs;
+    uint32_t num_configs = pool->num_jobs;
+    cache_config_t no_cache = jobs[0].cache_cfg;
+    no_cache.mode = CACHE_DISABLE;
+    addr_trace_t trace;
+    trace_init(&trace);
+
+    sim_t *sim = sim_init(&pool->image->cpu_cfg, &no_cache);
+    sim_copy_image(sim, pool->image);
+    if (sim->cpu_cfg.ff_insts) {
+        // Fast-forwarded accesses only count when they warm the caches
+        if (sim->cpu_cfg.ff_warm) sim->trace = &trace;
+        single_cycle_run(sim, &sim->pc, sim->cpu_cfg.ff_insts, false);
+    }
+    sim->trace = &trace;
+    trace_start_counting(&trace);
+    single_cycle_run(sim, &sim->pc, sim->cpu_cfg.detail_insts, false);
+    sim_destroy(sim);
+    bprintf("Recorded %d fetches and %d data accesses\n",
+        trace.inst.length - trace.inst.start, trace.data.length - trace.data.start);
+
+    // One pass per stream and block size covers every cache size
+    uint32_t *inst_job = (uint32_t *)malloc(sizeof(uint32_t) * num_configs);
+    uint32_t *data_job = (uint32_t *)malloc(sizeof(uint32_t) * num_configs);
+    pool->streams = (addr_stream_t **)malloc(sizeof(addr_stream_t *) * 2 * num_configs);
+    pool->blocks = (uint32_t *)malloc(sizeof(uint32_t) * 2 * num_configs);
+    pool->levels = (uint32_t *)malloc(sizeof(uint32_t) * 2 * num_configs);
+    pool->hits = (uint32_t (*)[TRACE_MAX_LEVEL + 1])malloc(sizeof(*pool->hits) * 2 * num_configs);
+    if (!inst_job || !data_job || !pool->streams || !pool->blocks || !pool->levels || !pool->hits) {
+        assert(0);
+    }
+    int rv = 0;
+    pool->work = sweep_evaluate_job;
+    pool->num_jobs = 0;
+    for (uint32_t i = 0; i < num_configs; ++i) {
+        cache_config_t *cfg = &jobs[i].cache_cfg;
+        uint32_t inst_blocks = (cfg->inst_size >> 2) / cfg->inst_block;
+        uint32_t data_blocks = (cfg->data_size >> 2) / cfg->data_block;
+        if (inst_blocks == 0 || data_blocks == 0 ||
+                log2_of(inst_blocks) > TRACE_MAX_LEVEL || log2_of(data_blocks) > TRACE_MAX_LEVEL) {
+            cprintf(ANSI_C_RED, "Sweep configuration %d has no valid cache geometry\n", i);
+            inst_job[i] = data_job[i] = UINT32_MAX;
+            rv = 1;
+            continue;
+        }
+        inst_job[i] = sweep_pass_job(pool, &trace.inst, cfg->inst_block, inst_blocks);
+        data_job[i] = sweep_pass_job(pool, &trace.data, cfg->data_block, data_blocks);
+    }
+    sweep_parallel(pool, sweep->threads);
+
+    // Timing is not modeled, so only the hit rates and instruction count are known
+    sim_print_summary_header();
+    uint32_t inst_accesses = trace.inst.length - trace.inst.start;
+    uint32_t data_accesses = trace.data.length - trace.data.start;
+    for (uint32_t i = 0; i < num_configs; ++i) {
+        cache_config_t *cfg = &jobs[i].cache_cfg;
+        if (inst_job[i] == UINT32_MAX) continue;
+        uint32_t inst_hits = pool->hits[inst_job[i]][log2_of((cfg->inst_size >> 2) / cfg->inst_block)];
+        uint32_t data_hits = pool->hits[data_job[i]][log2_of((cfg->data_size >> 2) / cfg->data_block)];
+        printf("$# %6d | %6d | %6d | %6d | %6s | %6.2f | %6.2f | %6s | %8s | %8d | %s\n",
+            cfg->inst_size, cfg->data_size, cfg->inst_block, cfg->data_block,
+            (cfg->data_wpolicy==CACHE_WRITEBACK?"WB":"WT"),
+            100*((float)inst_hits)/((float)inst_accesses),
+            100*((float)data_hits)/((float)data_accesses),
+            "n/a", "n/a", trace.insts, filename);
+    }
+    free(inst_job);
+    free(data_job);
+    free(pool->streams);
+    free(pool->blocks);
+    free(pool->levels);
+    free(pool->hits);
+    trace_free(&trace);
+    return rv;
+}
+
+int sweep_run(sweep_config_t *sweep, sim_t *image, cache_config_t *cache_cfg,
+        const char *filename) {
+    // Lists left empty take their one value from the base configuration
+    uint32_t num_sizes = sweep->num_sizes ? sweep->num_sizes : 1;
+    uint32_t num_blocks = sweep->num_blocks ? sweep->num_blocks : 1;
+    uint32_t num_wpolicies = sweep->num_wpolicies ? sweep->num_wpolicies : 1;
+    sweep_pool_t pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.image = image;
+    pool.num_jobs = num_sizes * num_blocks * num_wpolicies;
+    pool.jobs = (sweep_job_t *)calloc(pool.num_jobs, sizeof(sweep_job_t));
+    if (NULL == pool.jobs) assert(0);
+    uint32_t job = 0;
+    for (uint32_t s = 0; s < num_sizes; ++s) {
+        for (uint32_t b = 0; b < num_blocks; ++b) {
+            for (uint32_t w = 0; w < num_wpolicies; ++w) {
+                cache_config_t *cfg = &pool.jobs[job++].cache_cfg;
+                *cfg = *cache_cfg;
+                cfg->mode = CACHE_SPLIT;
+                if (sweep->num_sizes) {
+                    cfg->inst_size = sweep->inst_sizes[s];
+                    cfg->data_size = sweep->data_sizes[s];
+                }
+                if (sweep->num_blocks) {
+                    cfg->inst_block = sweep->blocks[b];
+                    cfg->data_block = sweep->blocks[b];
+                }
+                if (sweep->num_wpolicies) {
+                    cfg->data_wpolicy = sweep->wpolicies[w];
+                }
+            }
+        }
+    }
+
+    if (sweep->single_pass) {
+        int rv = sweep_run_single_pass(sweep, &pool, filename);
+        free(pool.jobs);
+        return rv;
+    }
+
+    int rv = 0;
+    pool.work = sweep_simulate_job;
+    sweep_parallel(&pool, sweep->threads);
+
+    // Print the results in sweep order, whichever order they finished in
+    sim_print_summary_header();
+    for (job = 0; job < pool.num_jobs; ++job) {
+        if (pool.jobs[job].sim) {
+            sim_print_summary(pool.jobs[job].sim, filename);
+            sim_destroy(pool.jobs[job].sim);
+        } else {
+            cprintf(ANSI_C_RED, "Sweep configuration %d did not run\n", job);
+            rv = 1;
+        }
+    }
+    free(pool.jobs);
+    return rv;
+}
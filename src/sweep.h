@@ -0,0 +1,55 @@
+/* src/sweep.h
+ * Design-space sweep: run many cache configurations of one program in parallel
+ */
+
+#ifndef _SWEEP_H
+#define _SWEEP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "util.h"
+
+// Most values any one sweep list can hold
+#define SWEEP_LIST_MAX 16
+
+/* The sweep runs the cross product of its lists, in the same order as the
+ * run matrix scripts: I/D size pairs outermost, then block sizes (used for
+ * both caches), then data cache write policies. An empty list means the
+ * corresponding value of the base cache configuration is used.
+ */
+typedef struct SWEEP_CONFIG {
+    bool            enabled;
+    bool            single_pass;                    // evaluate from one recorded trace
+    uint32_t        threads;                        // worker threads, 0 for one per online CPU
+    uint32_t        num_sizes;
+    uint32_t        inst_sizes[SWEEP_LIST_MAX];     // paired with data_sizes
+    uint32_t        data_sizes[SWEEP_LIST_MAX];
+    uint32_t        num_blocks;
+    uint32_t        blocks[SWEEP_LIST_MAX];
+    uint32_t        num_wpolicies;
+    cache_wpolicy_t wpolicies[SWEEP_LIST_MAX];
+} sweep_config_t;
+
+/* List parsers for the command line, returning the number of values parsed
+ * or 0 if the list is malformed. Sizes are "I:D" pairs, or a single number
+ * used for both caches, separated by commas; policies are back/thru.
+ */
+uint32_t sweep_parse_sizes(const char *arg, uint32_t *inst_sizes, uint32_t *data_sizes);
+uint32_t sweep_parse_blocks(const char *arg, uint32_t *blocks);
+uint32_t sweep_parse_wpolicies(const char *arg, cache_wpolicy_t *wpolicies);
+
+/* Simulate every configuration of the sweep, starting each from a private
+ * copy of the program loaded in image, and print one "$#" summary table in
+ * sweep order. cache_cfg is the base configuration the lists are applied to.
+ * With single_pass set, the program is run once to record its address stream
+ * and the hit rates of every configuration are found from that (see
+ * trace_direct_hits()); cycles are not modeled, and the write policy does not
+ * change which accesses hit. Returns 0 on success.
+ */
+int sweep_run(sweep_config_t *sweep, sim_t *image, cache_config_t *cache_cfg,
+        const char *filename);
+
+#endif /* _SWEEP_H */
@@ -0,0 +1,290 @@
+/* src/trace.c
+ * Recorded memory address streams, and evaluating caches against them
+ */
+
+#include <string.h>
+
+#include "trace.h"
+
+extern int flags; // from util.c
+
+// Tag of an empty cache block; block numbers never get this large
+#define TRACE_NO_BLOCK 0xFFFFFFFF
+
+static void stream_init(addr_stream_t *stream) {
+    stream->addrs = NULL;
+    stream->length = 0;
+    stream->capacity = 0;
+    stream->start = 0;
+}
+
+void trace_init(addr_trace_t *trace) {
+    stream_init(&trace->inst);
+    stream_init(&trace->data);
+    trace->insts = 0;
+}
+
+void trace_free(addr_trace_t *trace) {
+    free(trace->inst.addrs);
+    free(trace->data.addrs);
+    trace_init(trace);
+}
+
+void trace_start_counting(addr_trace_t *trace) {
+    trace->inst.start = trace->inst.length;
+    trace->data.start = trace->data.length;
+    trace->insts = 0;
+}
+
+void trace_append(addr_stream_t *stream, uint32_t address) {
+    if (stream->length == stream->capacity) {
+        stream->capacity = stream->capacity ? stream->capacity * 2 : 4096;
+        stream->addrs = (uint32_t *)realloc(stream->addrs, sizeof(uint32_t) * stream->capacity);
+        // If the stream didn't get allocated, crash the program
+        if (NULL == stream->addrs) assert(0);
+    }
+    stream->addrs[stream->length++] = address;
+}
+
+void trace_direct_hits(addr_stream_t *stream, uint32_t block_words,
+        uint32_t max_level, uint32_t *hits) {
+    assert(max_level <= TRACE_MAX_LEVEL);
+    uint32_t shift = 2;
+    while ((1u << (shift - 2)) < block_words) ++shift;
+
+    // The tag arrays of every cache, smallest first: 2^k blocks at offset 2^k - 1
+    uint32_t total = (2u << max_level) - 1;
+    uint32_t *tags = (uint32_t *)malloc(sizeof(uint32_t) * total);
+    if (NULL == tags) assert(0);
+    for (uint32_t i = 0; i < total; ++i) tags[i] = TRACE_NO_BLOCK;
+
+    // first[k] counts the accesses whose smallest hitting cache has 2^k blocks
+    uint32_t first[TRACE_MAX_LEVEL + 1];
+    memset(first, 0, sizeof(first));
+    for (uint32_t i = 0; i < stream->length; ++i) {
+        uint32_t block = stream->addrs[i] >> shift;
+        uint32_t k;
+        for (k = 0; k <= max_level; ++k) {
+            uint32_t *tag = &tags[(1u << k) - 1 + (block & ((1u << k) - 1))];
+            if (*tag == block) break;
+            *tag = block;
+        }
+        if (k <= max_level && i >= stream->start) first[k]++;
+    }
+    free(tags);
+
+    uint32_t sum = 0;
+    for (uint32_t k = 0; k <= max_level; ++k) {
+        sum += first[k];
+        hits[k] = sum;
+    }
+    gprintf("trace_direct_hits: %d accesses, block of %d words\n",
+        stream->length - stream->start, block_words);
+}
+
+static void trace_writer_flush(trace_writer_t *writer) {
+    if (writer->used) fwrite(writer->buffer, 1, writer->used, writer->fp);
+    writer->used = 0;
+}
+
+static void put_le(uint8_t *out, uint64_t value, uint32_t bytes) {
+    for (uint32_t i = 0; i < bytes; ++i) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static void trace_write_header(trace_writer_t *writer) {
+    uint8_t header[TRACE_HEADER_SIZE];
+    memcpy(header, TRACE_MAGIC, 4);
+    put_le(header + 4, TRACE_VERSION, 2);
+    put_le(header + 6, TRACE_HEADER_SIZE, 2);
+    put_le(header + 8, writer->records, 8);
+    put_le(header + 16, writer->instructions, 8);
+    fwrite(header, 1, TRACE_HEADER_SIZE, writer->fp);
+}
+
+trace_writer_t *trace_writer_open(const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (NULL == fp) return NULL;
+    trace_writer_t *writer = (trace_writer_t *)calloc(1, sizeof(trace_writer_t));
+    if (NULL == writer) assert(0);
+    writer->buffer = (uint8_t *)malloc(TRACE_BUFFER_SIZE);
+    if (NULL == writer->buffer) assert(0);
+    writer->fp = fp;
+    // The record count is filled in on close
+    trace_write_header(writer);
+    return writer;
+}
+
+int trace_writer_close(trace_writer_t *writer) {
+    int rv = 0;
+    trace_writer_flush(writer);
+    // Pipes can't be rewound, in which case the count stays 0 (unknown)
+    if (fseek(writer->fp, 0, SEEK_SET) == 0) trace_write_header(writer);
+    if (ferror(writer->fp)) rv = 1;
+    if (fclose(writer->fp) != 0) rv = 1;
+    free(writer->buffer);
+    free(writer);
+    return rv;
+}
+
+static uint8_t *put_varint(uint8_t *out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+// Signed deltas are zigzag encoded so small negative values stay short
+static uint8_t *put_signed(uint8_t *out, uint32_t delta) {
+    return put_varint(out, (delta << 1) ^ (uint32_t)((int32_t)delta >> 31));
+}
+
+void trace_writer_put(trace_writer_t *writer, trace_record_t *record) {
+    // Longest record: tag, then three 5 byte varints
+    if (writer->used + 16 > TRACE_BUFFER_SIZE) trace_writer_flush(writer);
+    uint8_t *start = writer->buffer + writer->used;
+    uint8_t *out = start + 1;
+    uint8_t tag = (uint8_t)record->kind;
+    tag |= (record->size == 1 ? 0 : record->size == 2 ? 1 : 2) << 2;
+    uint32_t cycles = record->cycle - writer->cycle;
+    if (cycles == 0) {
+        tag |= 1 << 5;
+    } else if (cycles == 1) {
+        tag |= 1 << 6;
+    } else {
+        out = put_varint(out, cycles);
+    }
+    if (record->kind == TRACE_FETCH) {
+        if (record->pc == writer->fetch_pc + 4) {
+            tag |= 1 << 4;
+        } else {
+            out = put_signed(out, record->pc - (writer->fetch_pc + 4));
+        }
+        writer->fetch_pc = record->pc;
+    } else {
+        out = put_signed(out, record->pc - writer->fetch_pc);
+        out = put_signed(out, record->address - writer->data_address);
+        writer->data_address = record->address;
+    }
+    *start = tag;
+    writer->cycle = record->cycle;
+    writer->used = out - writer->buffer;
+    writer->records++;
+}
+
+void trace_writer_stage(trace_writer_t *writer, trace_kind_t kind, uint32_t pc,
+        uint32_t address, uint32_t size) {
+    assert(writer->num_staged < 2);
+    trace_record_t *record = &writer->staged[writer->num_staged++];
+    record->kind = kind;
+    record->pc = pc;
+    record->address = address;
+    record->size = size;
+}
+
+void trace_writer_commit(trace_writer_t *writer, uint32_t cycle) {
+    for (uint32_t i = 0; i < writer->num_staged; ++i) {
+        writer->staged[i].cycle = cycle;
+        trace_writer_put(writer, &writer->staged[i]);
+    }
+    writer->num_staged = 0;
+}
+
+void trace_writer_discard(trace_writer_t *writer) {
+    writer->num_staged = 0;
+}
+
+static uint64_t get_le(const uint8_t *in, uint32_t bytes) {
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < bytes; ++i) {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+trace_reader_t *trace_reader_open(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (NULL == fp) return NULL;
+    uint8_t header[TRACE_HEADER_SIZE];
+    if (fread(header, 1, TRACE_HEADER_SIZE, fp) != TRACE_HEADER_SIZE ||
+            memcmp(header, TRACE_MAGIC, 4) != 0 || get_le(header + 4, 2) != TRACE_VERSION) {
+        fclose(fp);
+        return NULL;
+    }
+    // Skip anything a longer header might add
+    if (fseek(fp, (long)get_le(header + 6, 2), SEEK_SET) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    trace_reader_t *reader = (trace_reader_t *)calloc(1, sizeof(trace_reader_t));
+    if (NULL == reader) assert(0);
+    reader->buffer = (uint8_t *)malloc(TRACE_BUFFER_SIZE);
+    if (NULL == reader->buffer) assert(0);
+    reader->fp = fp;
+    reader->records = get_le(header + 8, 8);
+    reader->instructions = get_le(header + 16, 8);
+    return reader;
+}
+
+void trace_reader_close(trace_reader_t *reader) {
+    fclose(reader->fp);
+    free(reader->buffer);
+    free(reader);
+}
+
+// Returns false if the record runs past the end of the buffer
+static bool get_varint(trace_reader_t *reader, uint32_t *value) {
+    uint32_t shift = 0;
+    *value = 0;
+    while (reader->used < reader->length && shift < 35) {
+        uint8_t byte = reader->buffer[reader->used++];
+        *value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+        shift += 7;
+    }
+    return false;
+}
+
+static bool get_signed(trace_reader_t *reader, uint32_t *delta) {
+    uint32_t value;
+    if (!get_varint(reader, &value)) return false;
+    *delta = (value >> 1) ^ (uint32_t)-(int32_t)(value & 1);
+    return true;
+}
+
+bool trace_reader_next(trace_reader_t *reader, trace_record_t *record) {
+    // Keep at least one whole record in the buffer
+    if (reader->length - reader->used < 16 && !feof(reader->fp)) {
+        uint32_t left = reader->length - reader->used;
+        memmove(reader->buffer, reader->buffer + reader->used, left);
+        reader->length = left + fread(reader->buffer + left, 1, TRACE_BUFFER_SIZE - left, reader->fp);
+        reader->used = 0;
+    }
+    if (reader->used >= reader->length) return false;
+    uint8_t tag = reader->buffer[reader->used++];
+    uint32_t value;
+    record->kind = (trace_kind_t)(tag & 0x3);
+    record->size = 1 << ((tag >> 2) & 0x3);
+    if (tag & (1 << 5)) {
+        value = 0;
+    } else if (tag & (1 << 6)) {
+        value = 1;
+    } else if (!get_varint(reader, &value)) {
+        return false;
+    }
+    record->cycle = reader->cycle += value;
+    if (record->kind == TRACE_FETCH) {
+        value = 0;
+        if (!(tag & (1 << 4)) && !get_signed(reader, &value)) return false;
+        record->pc = record->address = reader->fetch_pc += 4 + value;
+    } else {
+        if (!get_signed(reader, &value)) return false;
+        record->pc = reader->fetch_pc + value;
+        if (!get_signed(reader, &value)) return false;
+        record->address = reader->data_address += value;
+    }
+    return true;
+}
@@ -0,0 +1,151 @@
+/* src/trace.h
+ * Recorded memory address streams, and evaluating caches against them
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "types.h"
+#include "util.h"
+
+// Largest cache evaluated, as log2 of its number of blocks
+#define TRACE_MAX_LEVEL 16
+
+/* The byte addresses of every access of one kind (instruction fetches or
+ * loads and stores), in program order. Accesses before start only warm the
+ * caches and are not counted.
+ */
+typedef struct ADDR_STREAM {
+    uint32_t    *addrs;
+    uint32_t    length;
+    uint32_t    capacity;
+    uint32_t    start;
+} addr_stream_t;
+
+/* What the functional engine records while a trace is attached to a
+ * simulation (see single_cycle_run()). Only the order of the accesses is
+ * kept, so the trace can be used to find hits and misses but not timing.
+ */
+typedef struct ADDR_TRACE {
+    addr_stream_t   inst;
+    addr_stream_t   data;
+    uint32_t        insts;      // instructions in the counted part of the trace
+} addr_trace_t;
+
+void trace_init(addr_trace_t *trace);
+void trace_free(addr_trace_t *trace);
+// Count everything recorded from now on
+void trace_start_counting(addr_trace_t *trace);
+
+void trace_append(addr_stream_t *stream, uint32_t address);
+
+/* Evaluate every direct-mapped cache with block_words words per block and
+ * 2^k blocks, for 0 <= k <= max_level, in a single pass over the stream.
+ * hits[k] is set to the number of counted accesses that hit in the cache of
+ * 2^k blocks; the number of accesses is stream->length - stream->start.
+ *
+ * Direct-mapped caches indexed by the low bits of the block number obey
+ * inclusion: a block is in the cache of 2^k blocks if no other block with
+ * the same k low bits was used since it was last used, so it is also in
+ * every larger cache. Each access is looked up from the smallest cache up,
+ * and the first hit settles every larger one.
+ */
+void trace_direct_hits(addr_stream_t *stream, uint32_t block_words,
+        uint32_t max_level, uint32_t *hits);
+
+/* Memory reference trace files, as written by --trace-out
+ *
+ * A 24 byte header ("MTRC", version and header length as 16 bit values, then
+ * the number of records and the number of instructions the pipeline
+ * completed as 64 bit values, all little-endian) is followed by the records.
+ * Each record starts with a tag byte:
+ *   bits 0-1   kind (trace_kind_t)
+ *   bits 2-3   log2 of the access size in bytes
+ *   bit 4      fetch at the previous fetch pc + 4, so no pc follows
+ *   bit 5      same cycle as the previous record
+ *   bit 6      cycle after the previous record
+ * then, as LEB128 varints, the cycle delta (unless bit 5 or 6 is set), the pc
+ * (fetches: signed delta from the previous fetch pc + 4, unless bit 4 is set;
+ * data accesses: signed delta from the previous fetch pc), and for data
+ * accesses the signed delta from the previous data address. Fetches always
+ * read 4 bytes at pc. A straight line of fetches takes one byte per record.
+ *
+ * Cycles are counted as if every cache access hit: cycles the pipeline spent
+ * frozen are left out, so a program always gives the same trace.
+ */
+#define TRACE_MAGIC "MTRC"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 24
+// Bytes buffered between writes to the file
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+typedef enum TRACE_KIND {
+    TRACE_FETCH,
+    TRACE_READ,
+    TRACE_WRITE
+} trace_kind_t;
+
+typedef struct TRACE_RECORD {
+    trace_kind_t    kind;
+    uint32_t        pc;
+    uint32_t        address;
+    uint32_t        size;       // bytes: 1, 2 or 4
+    uint32_t        cycle;
+} trace_record_t;
+
+typedef struct TRACE_WRITER {
+    FILE            *fp;
+    uint8_t         *buffer;
+    uint32_t        used;
+    uint64_t        records;
+    uint64_t        instructions;   // set by the caller before closing
+    // Previous values the next record is encoded against
+    uint32_t        fetch_pc;
+    uint32_t        data_address;
+    uint32_t        cycle;
+    // Accesses made this cycle, written if the cycle completes (see sim_cycle())
+    trace_record_t  staged[2];
+    uint32_t        num_staged;
+} trace_writer_t;
+
+// Create the trace file at path, returns NULL if it can't be opened
+trace_writer_t *trace_writer_open(const char *path);
+// Write out everything buffered and the record count, and close the file. Returns 0 on success.
+int trace_writer_close(trace_writer_t *writer);
+
+void trace_writer_put(trace_writer_t *writer, trace_record_t *record);
+
+/* The pipeline stages an access when a stage makes it, and sim_cycle()
+ * commits the staged accesses with the cycle number once the cycle latches,
+ * or discards them if it froze and will retry them.
+ */
+void trace_writer_stage(trace_writer_t *writer, trace_kind_t kind, uint32_t pc,
+        uint32_t address, uint32_t size);
+void trace_writer_commit(trace_writer_t *writer, uint32_t cycle);
+void trace_writer_discard(trace_writer_t *writer);
+
+typedef struct TRACE_READER {
+    FILE            *fp;
+    uint8_t         *buffer;
+    uint32_t        used;           // bytes of the buffer already decoded
+    uint32_t        length;         // bytes in the buffer
+    uint64_t        records;        // from the header, 0 if unknown
+    uint64_t        instructions;   // from the header
+    // Previous values the next record is decoded against
+    uint32_t        fetch_pc;
+    uint32_t        data_address;
+    uint32_t        cycle;
+} trace_reader_t;
+
+// Open the trace file at path, returns NULL if it can't be opened or is not a trace
+trace_reader_t *trace_reader_open(const char *path);
+void trace_reader_close(trace_reader_t *reader);
+// Decode the next record, returns false at the end of the trace
+bool trace_reader_next(trace_reader_t *reader, trace_record_t *record);
+
+#endif /* _TRACE_H */
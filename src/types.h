@@ -14,6 +14,8 @@ typedef uint32_t inst_t;
 typedef uint32_t pc_t;
 // Represents a single word (32b) of memory, with ambiguous signedness
 typedef uint32_t word_t;
+// Simulator context, holding the state of one simulation (defined in sim.h)
+typedef struct SIM sim_t;
 
 // Ignored MIPS I instructions
 // BGEZAL: Branch on Greater Than or Equal to Zero and Link
@@ -163,7 +165,9 @@ typedef enum Operations {
 typedef enum CACHE_STATUS {
     CACHE_NO_ACCESS,
     CACHE_MISS,         //Data isn't in cache, stall
-    CACHE_HIT           //Data returned is valid
+    CACHE_HIT,          //Data returned is valid
+    CACHE_PENDING       //Missed without a stall: an MSHR will finish the load (see mshr.h),
+                        //or the store went around the cache (see d_cache_write_around())
 } cache_status_t;
 
 typedef struct CONTROL_REGISTER {
@@ -216,6 +220,7 @@ typedef enum ACCESS_REQUEST{
 typedef struct CACHE_ACCESS_INFO {
     cache_access_request_t request;
     uint32_t index;
+    uint32_t way;       // line within the set (set associative caches only)
     uint32_t tag;
     uint32_t inner_index;
     bool dirty;
@@ -4,6 +4,8 @@
 
 #include "util.h"
 
+int flags;
+
 // Print all of the struct fields of a pipeline register
 void print_pipeline_register(control_t * reg){
     printf("\tInstruction: 0x%08x\n", reg->instr);
@@ -110,6 +112,11 @@ void pipeline_init(control_t** ifid, control_t** idex, control_t** exmem, contro
     flush(*idex);
     flush(*exmem);
     flush(*memwb);
+    // No cache access has happened yet (flush() leaves the status alone)
+    (*ifid)->status  = CACHE_NO_ACCESS;
+    (*idex)->status  = CACHE_NO_ACCESS;
+    (*exmem)->status = CACHE_NO_ACCESS;
+    (*memwb)->status = CACHE_NO_ACCESS;
     // Initialize program counter from first memory address
     *pc = pc_start;
 }
@@ -46,12 +46,20 @@
 #define gcprintf(COLOR__,...) if (flags & MASK_DEBUG) cprintf(COLOR__,__VA_ARGS__)
 #define bcprintf(COLOR__,...) if (flags & MASK_VERBOSE) cprintf(COLOR__,__VA_ARGS__)
 
-int flags;
+// Output and debugging flags, shared by every simulation (defined in util.c)
+extern int flags;
 
 
 typedef struct cpu_config_t {
     bool single_cycle;
     unsigned long mem_size;
+    uint32_t ff_insts;      // instructions to fast-forward before detailed simulation
+    uint32_t detail_insts;  // instructions to simulate in detail, 0 for no limit
+    bool ff_warm;           // warm up the caches while fast-forwarding
+    const char *trace_out;  // file to write the memory reference trace to, or NULL
+    const char *replay_trace; // trace file to replay through the caches, or NULL
+    const char *save_image; // file to write the loaded program image to, or NULL
+    bool profile_functions; // count cycles and instructions per function (ELF symbols)
 } cpu_config_t;
 
 typedef enum cache_mode_t {
@@ -61,12 +69,81 @@ typedef enum cache_mode_t {
 } cache_mode_t;
 typedef enum cache_type_t {
     CACHE_DIRECT,       // Direct-mapped
-    CACHE_SA2           // Two-way set associative
+    CACHE_ASSOC         // Set associative, with the ways and replacement policy below
 } cache_type_t;
+typedef enum cache_replace_t {
+    CACHE_LRU,          // Least recently used
+    CACHE_PLRU,         // Tree pseudo-LRU
+    CACHE_FIFO,         // Oldest fill
+    CACHE_RANDOM        // Pseudo-random, the same sequence on every run
+} cache_replace_t;
+typedef enum cache_fill_t {
+    CACHE_FILL_SEQUENTIAL,  // A block comes in from its first word on
+    CACHE_FILL_CRITICAL     // The word that missed first, then the rest wrapping around
+} cache_fill_t;
+typedef enum cache_inclusion_t {
+    CACHE_INCLUSIVE,    // The L2 is filled along with the first level
+    CACHE_EXCLUSIVE     // A block is in one level or the other
+} cache_inclusion_t;
+typedef enum cache_prefetch_t {
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE, // The blocks after one that missed or was prefetched
+    PREFETCH_STREAM,    // The blocks ahead of a run of misses, either way
+    PREFETCH_STRIDE     // The next addresses of a load or store that strides
+} cache_prefetch_t;
+// Most blocks a prefetcher can fetch ahead
+#define PREFETCH_MAX_DEGREE 8
+// Most ways a set associative cache can have
+#define CACHE_MAX_WAYS 16
+// Most entries the write buffer can have
+#define WRITE_BUFFER_MAX_ENTRIES 64
+// Most MSHRs the D cache can have
+#define MSHR_MAX_ENTRIES 16
+// Most entries the victim cache of a direct mapped cache can have
+#define VICTIM_MAX_ENTRIES 16
 typedef enum cache_wpolicy_t {
     CACHE_WRITEBACK,
     CACHE_WRITETHROUGH
 } cache_wpolicy_t;
+// Most banks the DRAM can have
+#define DRAM_MAX_BANKS 64
+typedef enum dram_sched_t {
+    DRAM_FCFS,          // Memory goes to the D cache, the I cache, then the write buffer
+    DRAM_FR_FCFS        // The same, but an access to an open row goes first
+} dram_sched_t;
+typedef enum dram_page_t {
+    DRAM_OPEN_PAGE,     // A row stays open after an access
+    DRAM_CLOSED_PAGE    // Every access precharges its bank when it is done
+} dram_page_t;
+typedef struct dram_config_t {
+    bool            enabled;        // otherwise memory takes the fixed penalties
+    unsigned int    banks;          // up to DRAM_MAX_BANKS
+    unsigned int    row_size;       // bytes of a row of one bank
+    unsigned int    t_cas;          // cycles to the first word of an open row
+    unsigned int    t_rcd;          // to open a row
+    unsigned int    t_rp;           // to close (precharge) the open row
+    unsigned int    t_burst;        // for each word after the first
+    dram_page_t     page;
+    dram_sched_t    scheduling;
+} dram_config_t;
+// Most words the memory bus can carry at a time
+#define BUS_MAX_WIDTH 8
+typedef enum bus_arbitration_t {
+    BUS_FIXED,          // The D cache, then the I cache, then the write buffer
+    BUS_ROUND_ROBIN,    // Each in turn, starting after the last one served
+    BUS_READ_FIRST      // Fills first, until the write buffer reaches a watermark
+} bus_arbitration_t;
+typedef struct bus_config_t {
+    bool            split;          // waits for memory overlap, only the words hold the bus
+    unsigned int    width;          // words carried at a time, up to BUS_MAX_WIDTH
+    bus_arbitration_t arbitration;
+    unsigned int    drain_high;     // write buffer entries that start draining it, 0 for all
+    unsigned int    drain_low;      // and the entries left that stop it
+} bus_config_t;
+typedef enum cache_alloc_t {
+    CACHE_ALLOCATE,     // A store that misses fills its block, then writes it
+    CACHE_NO_ALLOCATE   // A store that misses goes around to the write buffer
+} cache_alloc_t;
 
 typedef struct cache_config_t {
     cache_mode_t    mode;
@@ -75,17 +152,48 @@ typedef struct cache_config_t {
     unsigned int    data_size;
     unsigned int    data_block;
     cache_type_t    data_type;
+    unsigned int    data_ways;
+    cache_replace_t data_replace;
     cache_wpolicy_t data_wpolicy;
     bool            inst_enabled;
     unsigned int    inst_size;
     unsigned int    inst_block;
     cache_type_t    inst_type;
+    unsigned int    inst_ways;
+    cache_replace_t inst_replace;
     cache_wpolicy_t inst_wpolicy;
     /* Unified cache options */
     unsigned int    size;
     unsigned int    block;
     cache_type_t    type;
+    unsigned int    ways;
+    cache_replace_t replace;
     cache_wpolicy_t wpolicy;
+    /* Options for every cache */
+    cache_fill_t    fill_order;
+    cache_alloc_t   data_alloc;     // of the D cache, or the unified cache
+    /* Second level cache options */
+    unsigned int    l2_size;        // bytes, 0 for no L2
+    unsigned int    l2_block;
+    cache_type_t    l2_type;
+    unsigned int    l2_ways;
+    cache_replace_t l2_replace;
+    unsigned int    l2_latency;     // cycles for the first word of a hit
+    cache_wpolicy_t l2_wpolicy;
+    cache_inclusion_t l2_fill;
+    /* Write buffer options */
+    unsigned int    write_buffer;   // entries, 1 to WRITE_BUFFER_MAX_ENTRIES
+    /* Non-blocking D cache options */
+    unsigned int    mshrs;          // 0 blocks on every miss, up to MSHR_MAX_ENTRIES
+    /* Main memory options */
+    bus_config_t    bus;
+    dram_config_t   dram;
+    /* Victim cache options */
+    unsigned int    victims;        // entries beside each direct mapped cache, up to VICTIM_MAX_ENTRIES
+    /* Prefetch options */
+    cache_prefetch_t inst_prefetch; // for instruction fetches, not stride
+    cache_prefetch_t data_prefetch; // for loads and stores
+    unsigned int    prefetch_degree; // blocks ahead, 1 to PREFETCH_MAX_DEGREE
 } cache_config_t;
 
 typedef struct PROFILE {
@@ -97,13 +205,14 @@ typedef struct PROFILE {
     cache_status_t  d_cache_status_prev;
     uint32_t        d_cache_hit_count;
     uint32_t        d_cache_access_count;
+    uint32_t        write_buffer_full;  // cycles a write waited for a free write buffer entry
+    uint32_t        mshr_loads;         // loads that missed and were left to an MSHR
+    uint32_t        mshr_held;          // cycles an instruction waited in decode for one
     uint32_t        instruction_count;
     uint32_t        cycles;
     uint32_t        debug;
 } profile_t;
 
-profile_t *prof;
-
 void print_pipeline_register(control_t *reg);
 
 void copy_pipeline_register(control_t *orig, control_t *copy);
@@ -0,0 +1,80 @@
+/*
+* src/victim.c
+* Victim caches, for the blocks the direct mapped caches replace
+*/
+
+#include "victim.h"
+#include "l2.h"
+#include "sim.h"
+
+extern int flags; // from util.c
+
+victim_cache_t * victim_init(uint32_t entries){
+    victim_cache_t *vc = (victim_cache_t *)calloc(1, sizeof(victim_cache_t));
+    if(vc == NULL){
+        cprintf(ANSI_C_RED, "victim_init: Unable to allocate victim cache\n");
+        assert(0);
+    }
+    vc->entries = entries;
+    return vc;
+}
+
+void victim_free(victim_cache_t *vc){
+    free(vc);
+}
+
+// Take the block starting at block out. Returns false if it was not there.
+static bool victim_remove(victim_cache_t *vc, uint32_t block){
+    for(uint32_t i = 0; i < vc->held; i++){
+        if(vc->blocks[i] == block){
+            for(uint32_t j = i + 1; j < vc->held; j++){
+                vc->blocks[j - 1] = vc->blocks[j];
+            }
+            vc->held--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Put the block starting at block in as the newest. Returns true and sets
+* dropped if the oldest had to make room for it. */
+static bool victim_insert(victim_cache_t *vc, uint32_t block, uint32_t *dropped){
+    bool full = (vc->held == vc->entries);
+    if(full){
+        *dropped = vc->blocks[0];
+        victim_remove(vc, *dropped);
+    }
+    vc->blocks[vc->held++] = block;
+    return full;
+}
+
+void victim_invalidate(victim_cache_t *vc, uint32_t block){
+    if(vc != NULL) victim_remove(vc, block);
+}
+
+bool victim_fill(sim_t *sim, victim_cache_t *vc, uint32_t block, bool replacing, uint32_t victim, uint32_t *penalty, uint32_t *subsequent){
+    if(vc == NULL){
+        return l2_fill(sim, block, replacing, victim, penalty, subsequent);
+    }
+    vc->fills++;
+    uint32_t dropped = 0;
+    if(victim_remove(vc, block)){
+        gprintf("\tvictim_fill: victim cache hit for 0x%08x\n", block);
+        vc->hits++;
+        //There is room for the victim where the block was
+        if(replacing) victim_insert(vc, victim, &dropped);
+        *penalty = VICTIM_HIT_PENALTY;
+        *subsequent = VICTIM_SUBSEQUENT_PENALTY;
+        return false;
+    }
+    bool dropping = replacing && victim_insert(vc, victim, &dropped);
+    return l2_fill(sim, block, dropping, dropped, penalty, subsequent);
+}
+
+void victim_warm(victim_cache_t *vc, uint32_t block, bool replacing, uint32_t victim){
+    uint32_t dropped;
+    if(vc == NULL) return;
+    victim_remove(vc, block);
+    if(replacing) victim_insert(vc, victim, &dropped);
+}
@@ -0,0 +1,65 @@
+/*
+* src/victim.h
+* Victim caches, for the blocks the direct mapped caches replace
+*/
+
+#ifndef _VICTIM_H
+#define _VICTIM_H
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "types.h"
+
+// Cycles for the first word of a victim cache hit, and for each one after it
+#define VICTIM_HIT_PENALTY 1
+#define VICTIM_SUBSEQUENT_PENALTY 1
+
+/* A victim cache is a few fully associative entries next to a direct mapped
+* cache, holding the last blocks the cache replaced. Two blocks that map to
+* the same index then take turns in the cache and the victim cache, instead
+* of going back to memory every time.
+*
+* Like the L2 it keeps only which blocks it has. The block a fill replaces
+* still goes to the write buffer if it is dirty, and a fill still reads its
+* words from memory, so the victim cache changes how long a fill takes but
+* not what a program computes. A fill whose block is in the victim cache
+* swaps it with the block it replaces, and takes VICTIM_HIT_PENALTY for the
+* first word and VICTIM_SUBSEQUENT_PENALTY for each one after it. Any other
+* fill puts the block it replaces into the victim cache, and goes on to the
+* L2 or memory with the block the victim cache dropped for it, the oldest
+* one, as the block leaving the first level.
+*/
+typedef struct VICTIM_CACHE {
+    uint32_t entries;
+    uint32_t blocks[VICTIM_MAX_ENTRIES];    // first bytes of the blocks, oldest first
+    uint32_t held;
+    //Statistics
+    uint32_t fills;         // fills of the cache in front
+    uint32_t hits;
+} victim_cache_t;
+
+/*
+* victim_cache_t * victim_init(uint32_t entries)
+* Creates an empty victim cache of entries blocks
+*/
+victim_cache_t * victim_init(uint32_t entries);
+
+void victim_free(victim_cache_t *vc);
+
+/* The penalties of a fill of the block starting at block, into a cache with
+* victim cache vc (or none, if NULL). replacing says whether the fill
+* replaces the block starting at victim. Anything the victim cache does not
+* have comes from l2_fill(), and it returns true if that goes on to main
+* memory. */
+bool victim_fill(sim_t *sim, victim_cache_t *vc, uint32_t block, bool replacing, uint32_t victim, uint32_t *penalty, uint32_t *subsequent);
+
+// The same, without timing, when warming up the caches
+void victim_warm(victim_cache_t *vc, uint32_t block, bool replacing, uint32_t victim);
+
+// Forget the block starting at block, if vc has it (see cache_back_invalidate())
+void victim_invalidate(victim_cache_t *vc, uint32_t block);
+
+#endif /* _VICTIM_H */
@@ -3,10 +3,11 @@
 */
 
 #include "write.h"
+#include "sim.h"
 
 extern int flags;  // from util.c
 
-void writeback(control_t *memwb){
+void writeback(sim_t *sim, control_t *memwb){
     word_t writeRegister = 0;
     word_t writeRegisterValue = 0;
     // Determine the WB register based on regDst
@@ -33,6 +34,8 @@ void writeback(control_t *memwb){
             writeRegister,
             writeRegister,
             get_register_name_string(writeRegister));
-        reg_write(writeRegister, &writeRegisterValue);
+        reg_write(sim, writeRegister, &writeRegisterValue);
+        // A load still waiting in an MSHR must not overwrite this
+        if (sim->mshr) mshr_written(sim, writeRegister);
     }
 }
@@ -9,6 +9,6 @@
 #include "util.h"
 #include "registers.h"
 
-void writeback(control_t *memwb);
+void writeback(sim_t *sim, control_t *memwb);
 
 #endif
@@ -0,0 +1,204 @@
+/* test/assoc-test.c
+* Unit tests for the set associative cache and its replacement policies
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "cache-fixture.h"
+#include "../src/assoc.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+
+/* 8 one-word blocks in 2 sets of 4 lines: addresses 8 bytes apart are in
+ * the same set */
+cache_config_t cache_config = {
+    .mode           = CACHE_SPLIT,
+    .data_enabled   = true,
+    .data_size      = 32,
+    .data_block     = 1,
+    .data_type      = CACHE_ASSOC,
+    .data_ways      = 4,
+    .data_replace   = CACHE_LRU,
+    .data_wpolicy   = CACHE_WRITEBACK,
+    .inst_enabled   = true,
+    .inst_size      = 32,
+    .inst_block     = 1,
+    .inst_type      = CACHE_DIRECT,
+    .inst_wpolicy   = CACHE_WRITETHROUGH,
+    .write_buffer   = 1,
+};
+
+static sim_t *make_sim(cache_replace_t replace) {
+    cache_config.data_replace = replace;
+    return fixture_sim(&cpu_config, &cache_config);
+}
+
+static bool cached(sim_t *sim, uint32_t address) {
+    cache_access_t info;
+    assoc_cache_get_tag_and_index(&info, sim->d_assoc, &address);
+    return assoc_cache_find(sim->d_assoc, info.index, info.tag) < sim->d_assoc->ways;
+}
+
+// Fill set 0 with the blocks at 0x00, 0x08, 0x10 and 0x18, use 0x00 again, then add 0x20
+static void fill_and_replace(sim_t *sim) {
+    for (uint32_t address = 0x00; address < 0x20; address += 0x08) {
+        d_cache_warm(sim, address, false);
+    }
+    d_cache_warm(sim, 0x00, false);
+    d_cache_warm(sim, 0x20, false);
+}
+
+/* LRU replaces the block used longest ago */
+static char * test_assoc_lru() {
+    sim_t *sim = make_sim(CACHE_LRU);
+    fill_and_replace(sim);
+    mu_assert(_FL "recently used block replaced", cached(sim, 0x00));
+    mu_assert(_FL "least recently used block kept", !cached(sim, 0x08));
+    mu_assert(_FL "block lost", cached(sim, 0x10) && cached(sim, 0x18) && cached(sim, 0x20));
+    sim_destroy(sim);
+    return 0;
+}
+
+/* Tree PLRU only remembers which half of the set was used last: after 0x00
+ * the victim is in the other pair, and in that pair 0x18 was used last */
+static char * test_assoc_plru() {
+    sim_t *sim = make_sim(CACHE_PLRU);
+    fill_and_replace(sim);
+    mu_assert(_FL "recently used block replaced", cached(sim, 0x00) && cached(sim, 0x08));
+    mu_assert(_FL "wrong block replaced", !cached(sim, 0x10) && cached(sim, 0x18));
+    sim_destroy(sim);
+    return 0;
+}
+
+/* FIFO replaces the oldest fill, however recently it was used */
+static char * test_assoc_fifo() {
+    sim_t *sim = make_sim(CACHE_FIFO);
+    fill_and_replace(sim);
+    mu_assert(_FL "oldest block kept", !cached(sim, 0x00));
+    mu_assert(_FL "block lost", cached(sim, 0x08) && cached(sim, 0x10) && cached(sim, 0x18));
+    sim_destroy(sim);
+    return 0;
+}
+
+/* Random replacement uses up the empty lines first, then replaces one block
+ * of the set */
+static char * test_assoc_random() {
+    sim_t *sim = make_sim(CACHE_RANDOM);
+    for (uint32_t address = 0x00; address < 0x20; address += 0x08) {
+        d_cache_warm(sim, address, false);
+    }
+    for (uint32_t address = 0x00; address < 0x20; address += 0x08) {
+        mu_assert(_FL "empty line not used first", cached(sim, address));
+    }
+    d_cache_warm(sim, 0x20, false);
+    uint32_t kept = 0;
+    for (uint32_t address = 0x00; address < 0x20; address += 0x08) {
+        kept += cached(sim, address);
+    }
+    mu_assert(_FL "not exactly one block replaced", kept == 3 && cached(sim, 0x20));
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A read miss takes CACHE_MISS_PENALTY cycles, and two blocks that would
+ * conflict in a direct mapped cache both stay */
+static char * test_assoc_miss() {
+    sim_t *sim = make_sim(CACHE_LRU);
+    uint32_t address;
+    word_t data;
+    uint32_t cycles;
+    for (address = 0x00; address <= 0x08; address += 0x08) {
+        mu_assert(_FL "hit in an empty line", d_cache_read_w(sim, &address, &data) == CACHE_MISS);
+        for (cycles = 1; cycles < 20; ++cycles) {
+            cache_digest(sim);
+            if (d_cache_read_w(sim, &address, &data) == CACHE_HIT) break;
+        }
+        mu_assert(_FL "wrong miss penalty", cycles == CACHE_MISS_PENALTY);
+        mu_assert(_FL "wrong data", data == fixture_word(address));
+    }
+    address = 0x00;
+    mu_assert(_FL "first block lost", d_cache_read_w(sim, &address, &data) == CACHE_HIT);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A dirty victim goes to the write buffer before its line is refilled */
+static char * test_assoc_writeback() {
+    sim_t *sim = make_sim(CACHE_LRU);
+    fill_and_replace(sim);
+    uint32_t address = 0x10;
+    word_t data = 0x1234;
+    mu_assert(_FL "write missed", d_cache_write_w(sim, &address, &data) == CACHE_HIT);
+    address = 0x00;
+    d_cache_read_w(sim, &address, &data);
+    address = 0x18;
+    d_cache_read_w(sim, &address, &data);
+    address = 0x20;
+    d_cache_read_w(sim, &address, &data);
+    // 0x10 is now the least recently used
+    address = 0x28;
+    mu_assert(_FL "hit on a block not cached", d_cache_read_w(sim, &address, &data) == CACHE_MISS);
+    mu_assert(_FL "dirty block not written back", write_buffer_get_address(sim) == 0x10);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A critical word first fill brings in the word that missed after
+ * CACHE_MISS_PENALTY cycles, and it hits while the rest of the block,
+ * wrapping around to its first word, is still on its way */
+static char * test_assoc_critical_first() {
+    cache_config.data_block = 4;
+    cache_config.fill_order = CACHE_FILL_CRITICAL;
+    sim_t *sim = make_sim(CACHE_LRU);
+    cache_config.data_block = 1;
+    cache_config.fill_order = CACHE_FILL_SEQUENTIAL;
+    uint32_t address = 0x28, first = 0x20;
+    word_t data;
+    uint32_t cycles;
+    mu_assert(_FL "hit in an empty line", d_cache_read_w(sim, &address, &data) == CACHE_MISS);
+    for (cycles = 1; cycles < 20; ++cycles) {
+        cache_digest(sim);
+        if (d_cache_read_w(sim, &address, &data) == CACHE_HIT) break;
+    }
+    mu_assert(_FL "critical word not first", cycles == CACHE_MISS_PENALTY);
+    mu_assert(_FL "wrong data", data == fixture_word(address));
+    mu_assert(_FL "first word of the block already in", d_cache_read_w(sim, &first, &data) == CACHE_MISS);
+    for (cycles = 1; cycles < 20; ++cycles) {
+        cache_digest(sim);
+        if (d_cache_read_w(sim, &first, &data) == CACHE_HIT) break;
+    }
+    mu_assert(_FL "block did not wrap around", cycles == 2 * CACHE_MISS_SUBSEQUENT_PENALTY);
+    mu_assert(_FL "wrong data", data == fixture_word(first));
+    sim_destroy(sim);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_assoc_lru);
+    mu_run_test(test_assoc_plru);
+    mu_run_test(test_assoc_fifo);
+    mu_run_test(test_assoc_random);
+    mu_run_test(test_assoc_miss);
+    mu_run_test(test_assoc_writeback);
+    mu_run_test(test_assoc_critical_first);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,167 @@
+/* test/bus-test.c
+* Unit tests for the memory bus
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "../src/bus.h"
+#include "../src/cache.h"
+#include "../src/types.h"
+#include "../src/util.h"
+#include "../src/main_memory.h"
+#include "../src/sim.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+
+// Direct mapped caches of 64 four word blocks, and a four entry write buffer
+cache_config_t cache_config = {
+    .mode           = CACHE_SPLIT,
+    .data_enabled   = true,
+    .data_size      = 1024,
+    .data_block     = 4,
+    .data_type      = CACHE_DIRECT,
+    .data_wpolicy   = CACHE_WRITEBACK,
+    .inst_enabled   = true,
+    .inst_size      = 1024,
+    .inst_block     = 4,
+    .inst_type      = CACHE_DIRECT,
+    .inst_wpolicy   = CACHE_WRITETHROUGH,
+    .write_buffer   = 4,
+    .bus            = { .width = 1 },
+};
+
+static sim_t *make_sim(bool split, bus_arbitration_t arbitration) {
+    cache_config.bus.split = split;
+    cache_config.bus.arbitration = arbitration;
+    sim_t *sim = sim_init(&cpu_config, &cache_config);
+    mem_init(sim, 0x1000, 0);
+    return sim;
+}
+
+/* Miss in the D cache at data and, if inst is not 0, in the I cache at inst
+ * in the same cycle. Returns the cycles until both blocks are in. */
+static uint32_t fill(sim_t *sim, uint32_t data, uint32_t inst) {
+    word_t word;
+    uint32_t cycles = 0;
+    d_cache_read_w(sim, &data, &word);
+    if (inst) i_cache_read_w(sim, &inst, &word);
+    while (cycles < 200 && !cache_idle(sim)) {
+        cache_digest(sim);
+        ++cycles;
+    }
+    return cycles;
+}
+
+// A fill on its own takes as long whether the bus is split or not
+static char * test_bus_lone_fill() {
+    sim_t *serial = make_sim(false, BUS_ROUND_ROBIN);
+    sim_t *split = make_sim(true, BUS_FIXED);
+    mu_assert(_FL "lone fill slower on a split bus", fill(serial, 0x100, 0) == fill(split, 0x100, 0));
+    mu_assert(_FL "lone fill overlapped", split->bus->overlapped == 0);
+    sim_destroy(serial);
+    sim_destroy(split);
+    return 0;
+}
+
+/* A D and an I fill missing together: on a split bus the I fill waits for
+ * its first word while the D fill has the bus */
+static char * test_bus_split_overlap() {
+    sim_t *serial = make_sim(false, BUS_ROUND_ROBIN);
+    sim_t *split = make_sim(true, BUS_FIXED);
+    uint32_t serial_cycles = fill(serial, 0x100, 0x200);
+    uint32_t split_cycles = fill(split, 0x100, 0x200);
+    mu_assert(_FL "split bus not faster", split_cycles < serial_cycles);
+    mu_assert(_FL "no overlap counted", split->bus->overlapped > 0);
+    mu_assert(_FL "both fills saved no more than one wait", serial_cycles - split_cycles <= CACHE_MISS_PENALTY);
+    mu_assert(_FL "fill lost", cache_holds_block(split, false, 0x100) && cache_holds_block(split, true, 0x200));
+    sim_destroy(serial);
+    sim_destroy(split);
+    return 0;
+}
+
+// Round-robin starts after the unit served last
+static char * test_bus_round_robin() {
+    sim_t *sim = make_sim(false, BUS_ROUND_ROBIN);
+    memory_status_t order[BUS_UNITS];
+    bus_order(sim, 0, order);
+    mu_assert(_FL "D cache not first", order[0] == MEM_READING_D);
+    bus_grant(sim, MEM_READING_D);
+    bus_order(sim, 0, order);
+    mu_assert(_FL "wrong order after D", order[0] == MEM_READING_I && order[1] == MEM_WRITING && order[2] == MEM_READING_D);
+    bus_grant(sim, MEM_WRITING);
+    bus_order(sim, 0, order);
+    mu_assert(_FL "wrong order after the write buffer", order[0] == MEM_READING_D && order[1] == MEM_READING_I);
+    sim_destroy(sim);
+    return 0;
+}
+
+// Read-first drains the write buffer from the high watermark down to the low one
+static char * test_bus_read_first() {
+    cache_config.bus.drain_high = 3;
+    cache_config.bus.drain_low = 1;
+    sim_t *sim = make_sim(false, BUS_READ_FIRST);
+    memory_status_t order[BUS_UNITS];
+    bus_order(sim, 2, order);
+    mu_assert(_FL "drained below the watermark", order[0] == MEM_READING_D && order[2] == MEM_WRITING);
+    bus_order(sim, 3, order);
+    mu_assert(_FL "not draining at the watermark", order[0] == MEM_WRITING && order[1] == MEM_READING_D);
+    bus_order(sim, 2, order);
+    mu_assert(_FL "stopped draining above the low watermark", order[0] == MEM_WRITING);
+    bus_order(sim, 1, order);
+    mu_assert(_FL "still draining at the low watermark", order[0] == MEM_READING_D);
+    mu_assert(_FL "drain not counted", sim->bus->drains == 1);
+    // It only drains again after a fill, and for at most high - low entries
+    bus_order(sim, 3, order);
+    mu_assert(_FL "drained again before a fill", order[0] == MEM_READING_D);
+    bus_grant(sim, MEM_READING_D);
+    bus_order(sim, 3, order);
+    mu_assert(_FL "not draining after a fill", order[0] == MEM_WRITING && sim->bus->drains == 2);
+    bus_grant(sim, MEM_WRITING);
+    bus_grant(sim, MEM_WRITING);
+    bus_order(sim, 3, order);
+    mu_assert(_FL "drained more than high - low entries", order[0] == MEM_READING_D);
+    sim_destroy(sim);
+    cache_config.bus.drain_high = 0;
+    cache_config.bus.drain_low = 0;
+    return 0;
+}
+
+// A wider bus divides the time of the words after the first, down to a cycle
+static char * test_bus_width() {
+    cache_config.bus.width = 2;
+    sim_t *sim = make_sim(false, BUS_FIXED);
+    mu_assert(_FL "2 cycles not halved", bus_word_cycles(sim, 2) == 1);
+    mu_assert(_FL "3 cycles not rounded up", bus_word_cycles(sim, 3) == 2);
+    mu_assert(_FL "below a cycle", bus_word_cycles(sim, 1) == 1);
+    sim_destroy(sim);
+    cache_config.bus.width = 1;
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_bus_lone_fill);
+    mu_run_test(test_bus_split_overlap);
+    mu_run_test(test_bus_round_robin);
+    mu_run_test(test_bus_read_first);
+    mu_run_test(test_bus_width);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,55 @@
+/* test/cache-fixture.h
+* Setup shared by the cache unit tests. Each test keeps its own
+* cache_config_t and passes it to fixture_sim().
+*/
+
+#ifndef _CACHE_FIXTURE_H
+#define _CACHE_FIXTURE_H
+
+#include "../src/cache.h"
+#include "../src/types.h"
+#include "../src/util.h"
+#include "../src/main_memory.h"
+#include "../src/sim.h"
+
+// Bytes of memory fixture_sim() sets up, from address 0
+#define FIXTURE_MEM_SIZE 0x1000
+
+// What fixture_sim() puts in the word at address, so loads can be checked
+static inline word_t fixture_word(uint32_t address) {
+    return address | 0x80000000;
+}
+
+/* A simulation with the given caches, over FIXTURE_MEM_SIZE bytes of memory
+ * where every word holds fixture_word() of its address */
+static inline sim_t *fixture_sim(cpu_config_t *cpu_config, cache_config_t *cache_config) {
+    sim_t *sim = sim_init(cpu_config, cache_config);
+    mem_init(sim, FIXTURE_MEM_SIZE, 0);
+    for (uint32_t i = 0; i < FIXTURE_MEM_SIZE; i += 4) {
+        word_t word = fixture_word(i);
+        mem_write_w(sim, i, &word);
+    }
+    return sim;
+}
+
+// Digest until the D cache has its whole block and memory is idle, up to a limit
+static inline void fixture_fill(sim_t *sim) {
+    for (int i = 0; i < 100 && (sim->d_cache->fetching || get_mem_status(sim) != MEM_IDLE); ++i) {
+        cache_digest(sim);
+    }
+}
+
+/* Load address through the D cache, and return the cycles it took to hit.
+ * The rest of the block is in by the time this returns. */
+static inline uint32_t fixture_load(sim_t *sim, uint32_t address) {
+    word_t data;
+    uint32_t cycles = 0;
+    while (cycles < 100 && d_cache_read_w(sim, &address, &data) == CACHE_MISS) {
+        cache_digest(sim);
+        ++cycles;
+    }
+    fixture_fill(sim);
+    return cycles;
+}
+
+#endif /* _CACHE_FIXTURE_H */
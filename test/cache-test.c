@@ -1,5 +1,6 @@
 /* test/cache-test.c
-* Test a bunch of cache instructions and watch magic right before your eyes
+* Unit tests for the cache wrappers: the unified cache shared by both ports,
+* the write buffer, and stores around the cache
 */
 
 #include <stdio.h>
@@ -7,28 +8,194 @@
 #include <stdlib.h>
 
 #include "minunit.h"
-#include "../src/cache.h"
+#include "cache-fixture.h"
 #include "../src/direct.h"
-#include "../src/types.h"
-#include "../src/util.h"
 
 
 int tests_run = 0;
 
 extern int flags;
 
-static char * test_cache(){
-    mem_init(2<<14, 0);
-    cache_init();
+cpu_config_t cpu_config = { .single_cycle = false };
+
+// A unified cache of a single 4 word block, so every two blocks conflict
+cache_config_t cache_config = {
+    .mode           = CACHE_UNIFIED,
+    .data_enabled   = true,
+    .inst_enabled   = true,
+    .size           = 16,
+    .block          = 4,
+    .type           = CACHE_DIRECT,
+    .ways           = 2,
+    .replace        = CACHE_LRU,
+    .wpolicy        = CACHE_WRITETHROUGH,
+    .write_buffer   = 1,
+};
+
+static sim_t *make_sim(uint32_t write_buffer) {
+    cache_config.write_buffer = write_buffer;
+    return fixture_sim(&cpu_config, &cache_config);
 }
 
-static char * all_tests() {
+// Digest until the block being fetched is in, leaving the write buffer alone
+static void fetch(sim_t *sim) {
+    for (int i = 0; i < 100 && sim->d_cache->fetching; ++i) {
+        cache_digest(sim);
+    }
+}
+
+/* When a load and a fetch miss in the same cycle, the load's block comes first */
+static char * test_unified_arbitration() {
+    sim_t *sim = make_sim(1);
+    uint32_t d_address = 0x100, i_address = 0x000;
+    word_t data;
+    mu_assert(_FL "load hit in an empty cache", d_cache_read_w(sim, &d_address, &data) == CACHE_MISS);
+    sim->frozen = true;
+    mu_assert(_FL "fetch hit in an empty cache", i_cache_read_w(sim, &i_address, &data) == CACHE_MISS);
+    cache_digest(sim);
+    mu_assert(_FL "load not served first", get_mem_status(sim) == MEM_READING_D &&
+        (sim->d_cache->target_address & ~0xf) == d_address);
+    fixture_fill(sim);
+    mu_assert(_FL "load block not filled", d_cache_read_w(sim, &d_address, &data) == CACHE_HIT);
+    mu_assert(_FL "wrong data", data == fixture_word(d_address));
+    sim_destroy(sim);
+    return 0;
+}
+
+/* While the pipeline is frozen, a port that hit keeps its word even after a
+ * fill for the other port replaced the block, so the two cannot evict each
+ * other forever. Once the pipeline moves on, the cache is asked again. */
+static char * test_unified_latch() {
+    sim_t *sim = make_sim(1);
+    uint32_t d_address = 0x104, i_address = 0x008;
+    word_t data;
+    d_cache_read_w(sim, &d_address, &data);
+    sim->frozen = true;
+    fixture_fill(sim);
+    mu_assert(_FL "load missed after its fill", d_cache_read_w(sim, &d_address, &data) == CACHE_HIT);
+    mu_assert(_FL "fetch hit the load's block", i_cache_read_w(sim, &i_address, &data) == CACHE_MISS);
+    fixture_fill(sim);
+    mu_assert(_FL "fetch missed after its fill", i_cache_read_w(sim, &i_address, &data) == CACHE_HIT);
+    mu_assert(_FL "wrong instruction", data == fixture_word(i_address));
+    mu_assert(_FL "latched load lost", d_cache_read_w(sim, &d_address, &data) == CACHE_HIT);
+    mu_assert(_FL "wrong latched data", data == fixture_word(d_address));
+    sim->frozen = false;
+    mu_assert(_FL "replaced block still hit", d_cache_read_w(sim, &d_address, &data) == CACHE_MISS);
+    sim_destroy(sim);
+    return 0;
+}
 
+/* Stores to the block of the entry being written go into a new entry, and
+ * later stores to that block are merged into it. The buffer hands out the
+ * newest value of a word it holds, and writes everything in order. */
+static char * test_write_buffer_coalesce() {
+    sim_t *sim = make_sim(4);
+    uint32_t address = 0x100;
+    word_t data;
+    d_cache_read_w(sim, &address, &data);
+    fixture_fill(sim);
+    word_t stores[4] = { 0x1234, 0x5678, 0x9abc, 0xdef0 };
+    for (uint32_t i = 0; i < 4; i++) {
+        address = 0x100 + ((i & 1) << 2) + ((i & 2) << 2);
+        mu_assert(_FL "store missed", d_cache_write_w(sim, &address, &stores[i]) == CACHE_HIT);
+    }
+    // 0x100 is being written, 0x104, 0x108 and 0x10c are in one entry
+    mu_assert(_FL "stores not merged", sim->write_buffer->count == 2);
+    mu_assert(_FL "pending word not forwarded", write_buffer_forward(sim, 0x104, &data) && data == stores[1]);
+    mu_assert(_FL "pending word not forwarded", write_buffer_forward(sim, 0x10c, &data) && data == stores[3]);
+    mu_assert(_FL "forwarded a word not written", !write_buffer_forward(sim, 0x110, &data));
+    address = 0x200;
+    d_cache_read_w(sim, &address, &data);
+    fixture_fill(sim);
+    address = 0x108;
+    mu_assert(_FL "replaced block still hit", d_cache_read_w(sim, &address, &data) == CACHE_MISS);
+    for (int i = 0; i < 100 && d_cache_read_w(sim, &address, &data) == CACHE_MISS; ++i) {
+        cache_digest(sim);
+    }
+    mu_assert(_FL "wrong data after the fill", data == stores[2]);
+    mu_assert(_FL "oldest entry not written", mem_peek_w(sim, 0x100) == stores[0]);
+    flush_dcache(sim);
+    mu_assert(_FL "merged entry lost", mem_peek_w(sim, 0x104) == stores[1] &&
+        mem_peek_w(sim, 0x108) == stores[2] && mem_peek_w(sim, 0x10c) == stores[3]);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A fill goes before the writes, and picks up the words of its block that
+ * are waiting in the buffer behind the entry being written */
+static char * test_write_buffer_forward() {
+    sim_t *sim = make_sim(4);
+    uint32_t address = 0x100;
+    word_t data, store_a = 0x1234, store_b = 0x5678;
+    d_cache_read_w(sim, &address, &data);
+    fixture_fill(sim);
+    mu_assert(_FL "store missed", d_cache_write_w(sim, &address, &store_a) == CACHE_HIT);
+    address = 0x200;
+    d_cache_read_w(sim, &address, &data);
+    fetch(sim);
+    address = 0x204;
+    mu_assert(_FL "store missed", d_cache_write_w(sim, &address, &store_b) == CACHE_HIT);
+    address = 0x300;
+    d_cache_read_w(sim, &address, &data);
+    fetch(sim);
+    mu_assert(_FL "writes done before the fills", sim->write_buffer->count == 2);
+    address = 0x204;
+    mu_assert(_FL "replaced block still hit", d_cache_read_w(sim, &address, &data) == CACHE_MISS);
+    fetch(sim);
+    mu_assert(_FL "store written before the fill", mem_peek_w(sim, 0x204) != store_b);
+    mu_assert(_FL "pending word not forwarded", d_cache_read_w(sim, &address, &data) == CACHE_HIT && data == store_b);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A store that finds every entry in use waits, and says so */
+static char * test_write_buffer_full() {
+    sim_t *sim = make_sim(1);
+    uint32_t address = 0x100;
+    word_t data = 0x1234;
+    d_cache_read_w(sim, &address, &data);
+    fixture_fill(sim);
+    mu_assert(_FL "store missed", d_cache_write_w(sim, &address, &data) == CACHE_HIT);
+    address = 0x104;
+    mu_assert(_FL "store to a full buffer hit", d_cache_write_w(sim, &address, &data) == CACHE_MISS);
+    mu_assert(_FL "full buffer not reported", sim->write_buffer->full);
+    for (int i = 0; i < 100 && d_cache_write_w(sim, &address, &data) == CACHE_MISS; ++i) {
+        cache_digest(sim);
+    }
+    mu_assert(_FL "first store not written", mem_peek_w(sim, 0x100) == data);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* With no-write-allocate, stores to a block the cache does not have go
+ * straight to the write buffer without a fill, and a partial store keeps the
+ * rest of its word, including a store still waiting in the buffer */
+static char * test_write_around() {
+    sim_t *sim = make_sim(4);
+    mu_assert(_FL "missing block found", !d_cache_has_block(sim, 0x200));
+    mu_assert(_FL "halfword store stalled", d_cache_write_around(sim, 0x202, 0xbeef, 0xffff) == CACHE_PENDING);
+    mu_assert(_FL "byte store stalled", d_cache_write_around(sim, 0x200, 0x12000000, 0xff000000) == CACHE_PENDING);
+    mu_assert(_FL "store filled the block", !sim->d_cache->fetching && !d_cache_has_block(sim, 0x200));
+    word_t data;
+    mu_assert(_FL "stores not merged", write_buffer_forward(sim, 0x200, &data) && data == 0x1200beef);
+    for (int i = 0; i < 100 && write_buffer_writing(sim); ++i) cache_digest(sim);
+    mu_assert(_FL "stores not written", mem_peek_w(sim, 0x200) == 0x1200beef);
+    sim_destroy(sim);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_unified_arbitration);
+    mu_run_test(test_unified_latch);
+    mu_run_test(test_write_buffer_coalesce);
+    mu_run_test(test_write_buffer_forward);
+    mu_run_test(test_write_buffer_full);
+    mu_run_test(test_write_around);
     return 0;
 }
 
 int main(int argc, char **argv) {
-    flags = MASK_DEBUG | MASK_VERBOSE | MASK_SANITY;
+    flags = MASK_SANITY;
     char *result = all_tests();
     if (result != 0) {
         printf("%s\n", result);
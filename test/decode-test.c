@@ -10,11 +10,16 @@
 #include "../src/decode.h"
 #include "../src/types.h"
 #include "../src/util.h"
+#include "../src/sim.h"
 
 int tests_run = 0;
 
 extern int flags;
 
+sim_t *sim;
+cpu_config_t cpu_config = { .single_cycle = false };
+cache_config_t cache_config = { .mode = CACHE_DISABLE };
+
 word_t i, p;
 control_t *ifid, *idex, *dummy_exmem, *dummy_memwb; // dummy vars for pipeline_init
 pc_t dummy_pc;
@@ -33,7 +38,7 @@ static char * test_decode_add() {
     ifid->regRd = REG_S1;
     ifid->funct = FNC_ADD;
     ifid->pcNext = p + 4;
-    decode(ifid, idex);
+    decode(sim, ifid, idex);
     mu_assert(_FL "instruction add, $s1, $s2, $s1 bad regDst", idex->regDst == 1);
     mu_assert(_FL "instruction add, $s1, $s2, $s1 badregWrite", idex->regWrite == 1);
     mu_assert(_FL "instruction add, $s1, $s2, $s1 bad ALUSrc", idex->ALUSrc == 0);
@@ -63,7 +68,7 @@ static char * test_decode_addi() {
     ifid->regRs = REG_S5;
     ifid->regRt = REG_T0;
     ifid->pcNext = p + 4;
-    decode(ifid, idex);
+    decode(sim, ifid, idex);
     mu_assert(_FL "instruction addi $t0, $s5, -100 bad regDst", idex->regDst == 0);
     mu_assert(_FL "instruction addi $t0, $s5, -100 bad regWrite", idex->regWrite == 1);
     mu_assert(_FL "instruction addi $t0, $s5, -100 bad ALUSrc", idex->ALUSrc == 1);
@@ -94,9 +99,9 @@ static char * test_decode_beq() {
     ifid->immed = 0x0fff;
     ifid->pcNext = p + 4;
     // Branch Taken
-    reg_write(REG_S0, &temp);
-    reg_write(REG_S1, &temp);
-    decode(ifid, idex);
+    reg_write(sim, REG_S0, &temp);
+    reg_write(sim, REG_S1, &temp);
+    decode(sim, ifid, idex);
     mu_assert(_FL "instruction beq $s0, $s1, 0x4000 (equal) regWrite", idex->regWrite == 0);
     mu_assert(_FL "instruction beq $s0, $s1, 0x4000 (equal) ALUSrc", idex->ALUSrc == 0);
     mu_assert(_FL "instruction beq $s0, $s1, 0x4000 (equal) PCSrc", idex->PCSrc == 1);
@@ -108,10 +113,10 @@ static char * test_decode_beq() {
     mu_assert(_FL "instruction beq $s0, $s1, 0x4000 (equal) pcNext", idex->pcNext == 0x4004);
 
     // Branch not taken
-    reg_write(REG_S0, &temp);
+    reg_write(sim, REG_S0, &temp);
     temp = 9;
-    reg_write(REG_S1, &temp);
-    decode(ifid, idex);
+    reg_write(sim, REG_S1, &temp);
+    decode(sim, ifid, idex);
     mu_assert(_FL "instruction beq $s0, $s1, 0x4000 (not equal) regWrite", idex->regWrite == 0);
     mu_assert(_FL "instruction beq $s0, $s1, 0x4000 (not equal) ALUSrc", idex->ALUSrc == 0);
     mu_assert(_FL "instruction beq $s0, $s1, 0x4000 (not equal) PCSrc", idex->PCSrc == 0);
@@ -137,15 +142,15 @@ static char * test_decode_bne() {
     p = 0x40006020;
 
     uint32_t temp = 0;
-    reg_write(REG_A0, &temp);
+    reg_write(sim, REG_A0, &temp);
     temp = 5;
-    reg_write(REG_V1, &temp);
+    reg_write(sim, REG_V1, &temp);
     ifid->opCode = OPC_BNE;
     ifid->regRs = REG_A0;
     ifid->regRt = REG_V1;
     ifid->immed = 0xfffffff7;
     ifid->pcNext = p + 4;
-    decode(ifid, idex);
+    decode(sim, ifid, idex);
     mu_assert(_FL "Instruction: bne $a0, $v1, -32 (not equal) regWrite", idex->regWrite == 0);
     mu_assert(_FL "Instruction: bne $a0, $v1, -32 (not equal) ALUSrc", idex->ALUSrc == 0);
     mu_assert(_FL "Instruction: bne $a0, $v1, -32 (not equal) PCSrc", idex->PCSrc == 1);
@@ -157,8 +162,8 @@ static char * test_decode_bne() {
     mu_assert(_FL "Instruction: bne $a0, $v1, -32 (not equal) pcNext", idex->pcNext == 0x40006000);
 
     temp = 0;
-    reg_write(REG_V1, &temp);
-    decode(ifid, idex);
+    reg_write(sim, REG_V1, &temp);
+    decode(sim, ifid, idex);
     mu_assert(_FL "Instruction: bne $a0, $v1, -32 (equal) regWrite", idex->regWrite == 0);
     mu_assert(_FL "Instruction: bne $a0, $v1, -32 (equal) ALUSrc", idex->ALUSrc == 0);
     mu_assert(_FL "Instruction: bne $a0, $v1, -32 (equal) PCSrc", idex->PCSrc == 0);
@@ -188,7 +193,7 @@ static char * test_decode_lw() {
     ifid->regRt = REG_S2;
     ifid->immed = 0x0004;
     ifid->pcNext = p + 4;
-    decode(ifid, idex);
+    decode(sim, ifid, idex);
     mu_assert(_FL "Instruction: lw $s2, 4($t0) regDst", idex->regDst == 0);
     mu_assert(_FL "Instruction: lw $s2, 4($t0) regWrite", idex->regWrite == 1);
     mu_assert(_FL "Instruction: lw $s2, 4($t0) ALUSrc", idex->ALUSrc == 1);
@@ -217,7 +222,7 @@ static char * test_decode_sw() {
     ifid->regRs = REG_T0;
     ifid->regRt = REG_RA;
     ifid->pcNext = p+4;
-    decode(ifid, idex);
+    decode(sim, ifid, idex);
     mu_assert(_FL "Instruction: sw $ra, 0($t0) regWrite", idex->regWrite == 0);
     mu_assert(_FL "Instruction: sw $ra, 0($t0) ALUSrc", idex->ALUSrc == 1);
     mu_assert(_FL "Instruction: sw $ra, 0($t0) PCSrc", idex->PCSrc == 0);
@@ -245,7 +250,7 @@ static char * test_decode_slti() {
     ifid->regRt = REG_T0;
     ifid->immed = 0xfffff000;
     ifid->pcNext = p + 4;
-    decode(ifid, idex);
+    decode(sim, ifid, idex);
     mu_assert(_FL "slti $t0, $s1, 0xf000 regDst", idex->regDst == 0);
     mu_assert(_FL "slti $t0, $s1, 0xf000 regWrite", idex->regWrite == 1);
     mu_assert(_FL "slti $t0, $s1, 0xf000 ALUSrc", idex->ALUSrc == 1);
@@ -273,7 +278,7 @@ static char * test_decode_sltiu() {
     ifid->regRt = REG_T0;
     ifid->immed = 0x0000f000;
     ifid->pcNext = p + 4;
-    decode(ifid, idex);
+    decode(sim, ifid, idex);
     mu_assert(_FL "sltiu $t0, $s1, 0xf000 regDst", idex->regDst == 0);
     mu_assert(_FL "sltiu $t0, $s1, 0xf000 regWrite", idex->regWrite == 1);
     mu_assert(_FL "sltiu $t0, $s1, 0xf000 ALUSrc", idex->ALUSrc == 1);
@@ -300,7 +305,7 @@ static char * test_decode_j() {
     ifid->opCode = OPC_J;
     ifid->address = 0x00002010;
     ifid->pcNext = p + 4;
-    decode(ifid, idex);
+    decode(sim, ifid, idex);
     mu_assert(_FL "j 0x2011 regDst", idex->regDst == 1);
     mu_assert(_FL "j 0x2011 regWrite", idex->regWrite == 1);
     mu_assert(_FL "j 0x2011 ALUSrc", idex->ALUSrc == 0);
@@ -318,10 +323,10 @@ static char * test_decode_j() {
 
 static char * all_tests() {
     // Initialize the register file with some values
-    reg_init();
+    reg_init(sim);
     uint32_t i = 0;
     for(i = 0; i < 32; i++){
-        reg_write(i, &i);
+        reg_write(sim, i, &i);
     }
     mu_run_test(test_decode_add);
     mu_run_test(test_decode_addi);
@@ -337,7 +342,9 @@ static char * all_tests() {
 
 int main(int argc, char **argv) {
     flags = MASK_SANITY;
+    sim = sim_init(&cpu_config, &cache_config);
     char *result = all_tests();
+    sim_destroy(sim);
     if (result != 0) {
         printf("%s\n", result);
     } else {
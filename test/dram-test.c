@@ -0,0 +1,155 @@
+/* test/dram-test.c
+* Unit tests for the DRAM timing model
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "../src/dram.h"
+#include "../src/cache.h"
+#include "../src/types.h"
+#include "../src/util.h"
+#include "../src/main_memory.h"
+#include "../src/sim.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+
+// Direct mapped write-through caches, over 8 banks of 2KB rows
+cache_config_t cache_config = {
+    .mode           = CACHE_SPLIT,
+    .data_enabled   = true,
+    .data_size      = 1024,
+    .data_block     = 4,
+    .data_type      = CACHE_DIRECT,
+    .data_wpolicy   = CACHE_WRITETHROUGH,
+    .inst_enabled   = true,
+    .inst_size      = 1024,
+    .inst_block     = 4,
+    .inst_type      = CACHE_DIRECT,
+    .inst_wpolicy   = CACHE_WRITETHROUGH,
+    .write_buffer   = 1,
+    .dram           = {
+        .enabled    = true,
+        .banks      = 8,
+        .row_size   = 2048,
+        .t_cas      = 3,
+        .t_rcd      = 5,
+        .t_rp       = 7,
+        .t_burst    = 2,
+    },
+};
+
+static sim_t *make_sim(dram_page_t page, dram_sched_t scheduling) {
+    cache_config.dram.page = page;
+    cache_config.dram.scheduling = scheduling;
+    sim_t *sim = sim_init(&cpu_config, &cache_config);
+    mem_init(sim, 0x8000, 0);
+    return sim;
+}
+
+static uint32_t first_word(sim_t *sim, uint32_t address) {
+    uint32_t first, subsequent;
+    dram_timing(sim, address, false, &first, &subsequent);
+    return first;
+}
+
+/* An access to the open row takes tCAS, one to a bank with no open row
+ * tRCD + tCAS, and one to another row of a bank tRP + tRCD + tCAS */
+static char * test_dram_rows() {
+    sim_t *sim = make_sim(DRAM_OPEN_PAGE, DRAM_FCFS);
+    dram_config_t *c = &cache_config.dram;
+    mu_assert(_FL "closed bank not a row miss", first_word(sim, 0x100) == c->t_rcd + c->t_cas);
+    mu_assert(_FL "open row not a row hit", first_word(sim, 0x7fc) == c->t_cas);
+    // 0x800 is the first row of the next bank, 0x4000 the second row of bank 0
+    mu_assert(_FL "other bank not a row miss", first_word(sim, 0x800) == c->t_rcd + c->t_cas);
+    mu_assert(_FL "other row not a row conflict", first_word(sim, 0x4000) == c->t_rp + c->t_rcd + c->t_cas);
+    mu_assert(_FL "first bank lost its row", dram_row_open(sim, 0x800) && !dram_row_open(sim, 0x100));
+    dram_t *dram = sim->dram;
+    mu_assert(_FL "wrong counts", dram->reads == 4 && dram->row_hits == 1 && dram->row_conflicts == 1);
+    sim_destroy(sim);
+    return 0;
+}
+
+// A closed page policy never leaves a row open
+static char * test_dram_closed_page() {
+    sim_t *sim = make_sim(DRAM_CLOSED_PAGE, DRAM_FCFS);
+    dram_config_t *c = &cache_config.dram;
+    first_word(sim, 0x100);
+    mu_assert(_FL "row left open", !dram_row_open(sim, 0x100));
+    mu_assert(_FL "same row not a row miss", first_word(sim, 0x104) == c->t_rcd + c->t_cas);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* While the I cache fills from a row, a D fill of another row of the same
+ * bank and a write to the open row wait. FCFS gives memory to the D fill
+ * next, FR-FCFS to the write. */
+static memory_status_t next_after_i_fill(dram_sched_t scheduling) {
+    sim_t *sim = make_sim(DRAM_OPEN_PAGE, scheduling);
+    uint32_t address = 0x0;
+    word_t data;
+    i_cache_read_w(sim, &address, &data);
+    cache_digest(sim);
+    address = 0x4000;
+    d_cache_read_w(sim, &address, &data);
+    write_buffer_enqueue_word(sim, 0x100, 0x1234);
+    // The fill gives memory up when it is done, and the next digest passes it on
+    for (int i = 0; i < 100 && (get_mem_status(sim) == MEM_READING_I || get_mem_status(sim) == MEM_IDLE); ++i) {
+        cache_digest(sim);
+    }
+    memory_status_t next = get_mem_status(sim);
+    sim_destroy(sim);
+    return next;
+}
+
+static char * test_dram_scheduling() {
+    mu_assert(_FL "FCFS did not take the D fill", next_after_i_fill(DRAM_FCFS) == MEM_READING_D);
+    mu_assert(_FL "FR-FCFS did not take the row hit", next_after_i_fill(DRAM_FR_FCFS) == MEM_WRITING);
+    return 0;
+}
+
+// Keys of a configuration file replace the values given, and a bad key fails
+static char * test_dram_config() {
+    const char *path = "/tmp/dram-test.cfg";
+    FILE *file = fopen(path, "w");
+    fprintf(file, "# test\nbanks 4\nt-cas 9   # comment\n\npage closed\nscheduling fcfs\n");
+    fclose(file);
+    dram_config_t config = cache_config.dram;
+    config.enabled = false;
+    mu_assert(_FL "good file rejected", dram_read_config(path, &config));
+    mu_assert(_FL "values not read", config.enabled && config.banks == 4 && config.t_cas == 9 &&
+        config.page == DRAM_CLOSED_PAGE && config.scheduling == DRAM_FCFS);
+    mu_assert(_FL "value not given changed", config.t_rcd == cache_config.dram.t_rcd);
+    file = fopen(path, "w");
+    fprintf(file, "row-size 100\n");
+    fclose(file);
+    mu_assert(_FL "row size not a power of two accepted", !dram_read_config(path, &config));
+    remove(path);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_dram_rows);
+    mu_run_test(test_dram_closed_page);
+    mu_run_test(test_dram_scheduling);
+    mu_run_test(test_dram_config);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
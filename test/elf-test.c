@@ -0,0 +1,165 @@
+/* test/elf-test.c
+* Unit tests for the ELF executable loader
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minunit.h"
+#include "../src/elf_loader.h"
+#include "../src/types.h"
+#include "../src/util.h"
+#include "../src/registers.h"
+#include "../src/main_memory.h"
+#include "../src/predecode.h"
+#include "../src/sim.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+cache_config_t cache_config = { .mode = CACHE_DISABLE };
+
+uint8_t file[0x400];
+
+static void put16(uint32_t offset, uint32_t value) {
+    file[offset] = value >> 8;
+    file[offset + 1] = value;
+}
+
+static void put32(uint32_t offset, uint32_t value) {
+    put16(offset, value >> 16);
+    put16(offset + 2, value);
+}
+
+/* An executable with a code segment at 0x00400000 holding two functions, a
+ * data segment at 0x10000000 with some .bss after it, and a symbol table
+ * naming the functions and _gp. */
+static void build_elf(void) {
+    memset(file, 0, sizeof(file));
+    memcpy(file, "\177ELF\001\002\001", 7);
+    put16(16, 2);           // e_type: executable
+    put16(18, 8);           // e_machine: MIPS
+    put32(20, 1);
+    put32(24, 0x00400008);  // e_entry
+    put32(28, 0x34);        // e_phoff
+    put32(32, 0x200);       // e_shoff
+    put16(40, 0x34);
+    put16(42, 32);          // e_phentsize
+    put16(44, 2);           // e_phnum
+    put16(46, 40);          // e_shentsize
+    put16(48, 3);           // e_shnum
+    // Code: 4 words from offset 0x100
+    put32(0x34 + 0, 1);     put32(0x34 + 4, 0x100);     put32(0x34 + 8, 0x00400000);
+    put32(0x34 + 16, 16);   put32(0x34 + 20, 16);       put32(0x34 + 24, 5);
+    put32(0x100, 0x22a8ff9c);   // addi $t0, $s5, -100
+    put32(0x104, 0x03e00008);   // jr $ra
+    put32(0x108, 0x8c430000);   // lw $v1, 0($v0)
+    put32(0x10c, 0x03e00008);   // jr $ra
+    // Data: 2 words from offset 0x110, then 8 bytes of .bss
+    put32(0x54 + 0, 1);     put32(0x54 + 4, 0x110);     put32(0x54 + 8, 0x10000000);
+    put32(0x54 + 16, 8);    put32(0x54 + 20, 16);       put32(0x54 + 24, 6);
+    put32(0x110, 0xdeadbeef);
+    put32(0x114, 0x12345678);
+    // Symbols from offset 0x140 (the first is the null symbol), names from 0x1a0
+    memcpy(file + 0x1a0, "\0helper\0main\0_gp", 17);
+    put32(0x150, 1);    put32(0x154, 0x00400000);   put32(0x158, 8);    file[0x15c] = 0x12;
+    put32(0x160, 8);    put32(0x164, 0x00400008);   put32(0x168, 8);    file[0x16c] = 0x12;
+    put32(0x170, 13);   put32(0x174, 0x10008000);
+    // Section headers: null, .symtab, .strtab
+    put32(0x228 + 4, 2);    put32(0x228 + 16, 0x140);   put32(0x228 + 20, 0x40);
+    put32(0x228 + 24, 2);   put32(0x228 + 36, 16);
+    put32(0x250 + 4, 3);    put32(0x250 + 16, 0x1a0);   put32(0x250 + 20, 17);
+}
+
+static FILE *write_file(const char *path, uint32_t length) {
+    FILE *fp = fopen(path, "wb");
+    fwrite(file, 1, length, fp);
+    fclose(fp);
+    return fopen(path, "rb");
+}
+
+/* Segments, registers, entry point and symbols all come from the file */
+static char * test_elf_load() {
+    const char *path = "test/elf-test.elf";
+    elf_symbols_t symbols = { .syms = NULL, .count = 0, .last = 0 };
+    build_elf();
+    FILE *fp = write_file(path, sizeof(file));
+    mu_assert(_FL "ELF not detected", elf_detect(fp));
+    sim_t *sim = sim_init(&cpu_config, &cache_config);
+    mu_assert(_FL "wrong number of bytes loaded", elf_load(sim, fp, &symbols) == 24);
+    fclose(fp);
+    remove(path);
+
+    mu_assert(_FL "bad code", mem_peek_w(sim, 0x00400008) == 0x8c430000);
+    mu_assert(_FL "bad data", mem_peek_w(sim, 0x10000000) == 0xdeadbeef);
+    mu_assert(_FL "bss not zero", mem_peek_w(sim, 0x10000008) == 0);
+    mu_assert(_FL "wrong memory start", mem_start(sim) == 0x00400000);
+    mu_assert(_FL "memory does not cover the data", mem_end(sim) == 0x1000000f);
+    mu_assert(_FL "wrong entry point", sim->pc == 0x00400008);
+    word_t value;
+    reg_read(sim, REG_SP, &value);
+    mu_assert(_FL "wrong $sp", value == ELF_STACK_TOP);
+    reg_read(sim, REG_GP, &value);
+    mu_assert(_FL "wrong $gp", value == 0x10008000);
+    mu_assert(_FL "code not predecoded", predecode_lookup(sim, 0x00400000, 0x22a8ff9c) != NULL);
+    mu_assert(_FL "data predecoded", sim->predecode.length == 4);
+
+    mu_assert(_FL "wrong symbol count", symbols.count == 2);
+    elf_symbol_t *sym = elf_symbol_find(&symbols, 0x0040000c);
+    mu_assert(_FL "function not found", sym != NULL && !strcmp(sym->name, "main"));
+    sym = elf_symbol_find(&symbols, 0x00400004);
+    mu_assert(_FL "function not found", sym != NULL && !strcmp(sym->name, "helper"));
+    mu_assert(_FL "found a function past the code", elf_symbol_find(&symbols, 0x00400010) == NULL);
+    mu_assert(_FL "found a function before the code", elf_symbol_find(&symbols, 0x003ffffc) == NULL);
+    elf_symbols_free(&symbols);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* Anything but a big-endian 32-bit MIPS executable is refused */
+static char * test_elf_reject() {
+    const char *path = "test/elf-test.elf";
+    build_elf();
+    file[5] = 1; // little-endian
+    FILE *fp = write_file(path, sizeof(file));
+    sim_t *sim = sim_init(&cpu_config, &cache_config);
+    mu_assert(_FL "loaded a little-endian file", elf_load(sim, fp, NULL) == -1);
+    fclose(fp);
+    build_elf();
+    fp = write_file(path, 0x110); // data segment cut off
+    mu_assert(_FL "loaded a truncated file", elf_load(sim, fp, NULL) == -1);
+    fclose(fp);
+    build_elf();
+    // A third segment that takes no memory but claims more bytes than the file has
+    put16(44, 3);
+    put32(0x74 + 0, 1);     put32(0x74 + 4, 0x110);     put32(0x74 + 8, 0x20000000);
+    put32(0x74 + 16, 0x40000000);
+    fp = write_file(path, sizeof(file));
+    mu_assert(_FL "loaded a segment past the end of the file", elf_load(sim, fp, NULL) == -1);
+    fclose(fp);
+    remove(path);
+    sim_destroy(sim);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_elf_load);
+    mu_run_test(test_elf_reject);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
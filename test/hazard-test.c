@@ -11,11 +11,16 @@
 #include "../src/types.h"
 #include "../src/util.h"
 #include "../src/registers.h"
+#include "../src/sim.h"
 
 int tests_run = 0;
 
 extern int flags;
 
+sim_t *sim;
+cpu_config_t cpu_config = { .single_cycle = false };
+cache_config_t cache_config = { .mode = CACHE_DISABLE };
+
 pc_t pc;
 control_t *ifid, *idex, *exmem, *memwb;
 
@@ -35,7 +40,7 @@ static char * test_forwarding_exmem(){
     idex->regRs = REG_T0;
     idex->regRsValue = 0;       //Make sure this isn't 100 before test is run
 
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
 
     mu_assert(_FL "Incorrect exmem forwarding ALUresult Rd->Rs", idex->regRsValue == 0x64);
 
@@ -48,7 +53,7 @@ static char * test_forwarding_exmem(){
     idex->regRt = REG_S3;
     idex->regRtValue = 0;
 
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
 
     mu_assert(_FL "Incorrect exmem forwarding ALUresult Rd->Rt", idex->regRtValue == 0x69);
 
@@ -62,7 +67,7 @@ static char * test_forwarding_exmem(){
     idex->regRs = REG_S3;
     idex->regRsValue = 0;
 
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
 
     mu_assert(_FL "Incorrect exmem forwarding ALUresult (both) Rd->Rt", idex->regRtValue == 0x23);
     mu_assert(_FL "Incorrect exmem forwarding ALUresult (both) Rd->Rs", idex->regRsValue == 0x23);
@@ -93,7 +98,7 @@ static char * test_forwarding_memwb(){
     exmem->regWrite = false;
     idex->regRs = REG_T5;
     idex->regRsValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect memwb forwarding memData Rd->Rs", idex->regRsValue == 0x16);
 
     //Rt Forwarding
@@ -104,7 +109,7 @@ static char * test_forwarding_memwb(){
     exmem->regWrite = false;
     idex->regRt = REG_A0;
     idex->regRtValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect memwb forwarding memData Rd->Rt", idex->regRtValue == 0x92);
 
     //Forwarding to both rs and rt
@@ -117,7 +122,7 @@ static char * test_forwarding_memwb(){
     idex->regRtValue = 0;
     idex->regRs = REG_V1;
     idex->regRsValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect memwb forwarding memData (both) Rd->Rt", idex->regRtValue == 0xff);
     mu_assert(_FL "Incorrect memwb forwarding memData (both) Rd->Rs", idex->regRsValue == 0xff);
 
@@ -131,7 +136,7 @@ static char * test_forwarding_memwb(){
     exmem->regWrite = false;
     idex->regRs = REG_T5;
     idex->regRsValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect memwb forwarding ALUresult Rd->Rs", idex->regRsValue == 0x56);
 
     //Rt Forwarding
@@ -142,7 +147,7 @@ static char * test_forwarding_memwb(){
     exmem->regWrite = false;
     idex->regRt = REG_A0;
     idex->regRtValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect memwb forwarding ALUresult Rd->Rt", idex->regRtValue == 0x22);
 
     //Forwarding to both rs and rt
@@ -155,7 +160,7 @@ static char * test_forwarding_memwb(){
     idex->regRtValue = 0;
     idex->regRs = REG_V1;
     idex->regRsValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect memwb forwarding ALUresult (both) Rd->Rt", idex->regRtValue == 0xa7);
     mu_assert(_FL "Incorrect memwb forwarding ALUresult (both) Rd->Rs", idex->regRsValue == 0xa7);
 
@@ -189,7 +194,7 @@ static char * test_forwarding_exmem_not_memwb(){
     exmem->ALUresult = 0x56;
     idex->regRs = REG_S6;
     idex->regRsValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect exmem (not memwb) forwarding ALUresult Rd->Rs", idex->regRsValue == 0x56);
 
     //Forwarding from rd in exmem to rt in idex despite memwb rd
@@ -202,7 +207,7 @@ static char * test_forwarding_exmem_not_memwb(){
     exmem->ALUresult = 0x6f;
     idex->regRt = REG_S6;
     idex->regRtValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect exmem (not memwb) forwarding ALUresult Rd->Rt", idex->regRtValue == 0x6f);
 
     //Forwarding from rd in exmem to rt and rs in idex despite memwb rd
@@ -217,7 +222,7 @@ static char * test_forwarding_exmem_not_memwb(){
     idex->regRsValue = 0;
     idex->regRt = REG_S6;
     idex->regRtValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect exmem (not memwb) forwarding ALUresult Rd->Rs", idex->regRsValue == 0x1883);
     mu_assert(_FL "Incorrect exmem (not memwb) forwarding ALUresult Rd->Rt", idex->regRtValue == 0x1883);
 
@@ -233,7 +238,7 @@ static char * test_forwarding_exmem_not_memwb(){
     idex->regRsValue = 0;
     idex->regRt = REG_T3;
     idex->regRtValue = 0;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "Incorrect memwb forwarding ALUresult Rd->Rs", idex->regRsValue == 0x9);
     mu_assert(_FL "Incorrect exmem (not memwb) forwarding ALUresult Rd->Rt", idex->regRtValue == 0x13);
 
@@ -266,7 +271,7 @@ static char * test_branch_flush(){
     ifid->regRt = REG_S2;
     ifid->immed = 0x0004;
     ifid->pcNext = pc + 4;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "no nop in ifid! instr", ifid->instr == 0);
     mu_assert(_FL "no nop in ifid! opCode", ifid->opCode == 0);
     mu_assert(_FL "no nop in ifid! regRs", ifid->regRs == 0);
@@ -295,7 +300,7 @@ static char * test_load_data_dependency(){
     //Next instruction in ifid that depends on value from Load
     ifid->opCode = OPC_ADDI;
     ifid->regRs = REG_S2;
-    hazard(ifid, idex, exmem, memwb, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
     mu_assert(_FL "no nop in ifid! instr", ifid->instr == 0);
     mu_assert(_FL "no nop in ifid! opCode", ifid->opCode == 0);
     mu_assert(_FL "no nop in ifid! regRs", ifid->regRs == 0);
@@ -322,7 +327,9 @@ static char * all_tests() {
 
 int main(int argc, char **argv) {
     flags = MASK_DEBUG | MASK_VERBOSE | MASK_SANITY;
+    sim = sim_init(&cpu_config, &cache_config);
     char *result = all_tests();
+    sim_destroy(sim);
     if (result != 0) {
         printf("%s\n", result);
     } else {
@@ -0,0 +1,138 @@
+/* test/image-test.c
+* Unit tests for binary program images
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "../src/image.h"
+#include "../src/types.h"
+#include "../src/util.h"
+#include "../src/registers.h"
+#include "../src/main_memory.h"
+#include "../src/predecode.h"
+#include "../src/sim.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+cache_config_t cache_config = { .mode = CACHE_DISABLE };
+
+/* A saved image loads back to the same memory, registers, pc and predecode table */
+static char * test_image_round_trip() {
+    const char *path = "test/image-test.img";
+    inst_t program[] = {
+        0x22a8ff9c, // addi $t0, $s5, -100
+        0x8c430000, // lw $v1, 0($v0)
+        0x1444fffc, // bne $v0, $a0, -4
+        0xffffffff  // data
+    };
+    uint32_t n = sizeof(program)/sizeof(program[0]);
+    // Loaded the way parse() would, straddling a page boundary
+    sim_t *sim = sim_init(&cpu_config, &cache_config);
+    uint32_t start = 0x00400ff8;
+    mem_init(sim, 0x2000, 0x00400000);
+    for (uint32_t k = 0; k < n; ++k) mem_write_w(sim, start + (k<<2), &program[k]);
+    predecode_init(sim, start, n<<2);
+    predecode_build(sim);
+    word_t sp = 4000, fp = 4004;
+    reg_write(sim, REG_SP, &sp);
+    reg_write(sim, REG_FP, &fp);
+    sim->pc = start + 4;
+    mu_assert(_FL "unable to save image", image_save(sim, path) == 0);
+
+    sim_t *loaded = sim_init(&cpu_config, &cache_config);
+    FILE *file = fopen(path, "rb");
+    mu_assert(_FL "image not detected", image_detect(file));
+    // The two pages the program straddles
+    mu_assert(_FL "wrong number of pages loaded", image_load(loaded, file) == 2);
+    fclose(file);
+    remove(path);
+    for (uint32_t k = 0; k < n; ++k) {
+        mu_assert(_FL "wrong word loaded", mem_peek_w(loaded, start + (k<<2)) == program[k]);
+    }
+    mu_assert(_FL "memory outside the program not empty", mem_peek_w(loaded, start - 4) == 0);
+    mu_assert(_FL "wrong memory start", mem_start(loaded) == 0x00400000);
+    mu_assert(_FL "wrong memory size", mem_size_b(loaded) == 0x2000);
+    mu_assert(_FL "wrong entry point", loaded->pc == start + 4);
+    reg_read(loaded, REG_SP, &sp);
+    reg_read(loaded, REG_FP, &fp);
+    mu_assert(_FL "wrong registers", sp == 4000 && fp == 4004);
+    mu_assert(_FL "instruction not predecoded", predecode_lookup(loaded, start, program[0]) != NULL);
+    mu_assert(_FL "data predecoded", predecode_lookup(loaded, start + 12, program[3]) == NULL);
+    mu_assert(_FL "wrong code range", loaded->predecode.start == start && loaded->predecode.length == n);
+    sim_destroy(loaded);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* Segments far apart save only the pages they use, and load back to them */
+static char * test_image_distant_segments() {
+    const char *path = "test/image-test.img";
+    word_t code = 0x22a8ff9c, data = 0xdeadbeef, zero = 0;
+    // Laid out as elf_load() leaves an executable with .text and .data in their usual places
+    sim_t *sim = sim_init(&cpu_config, &cache_config);
+    mem_init(sim, 0x10000010 - 0x00400000, 0x00400000);
+    mem_write_w(sim, 0x00400000, &code);
+    mem_write_w(sim, 0x1000000c, &data);
+    // A page that was written but holds nothing is left out
+    mem_write_w(sim, 0x20000000, &zero);
+    predecode_init(sim, 0x00400000, 4);
+    predecode_build(sim);
+    sim->pc = 0x00400000;
+    mu_assert(_FL "unable to save image", image_save(sim, path) == 0);
+    FILE *file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    mu_assert(_FL "image holds more than the two pages", ftell(file) == IMAGE_HEADER_SIZE + 2 * IMAGE_RECORD_SIZE);
+    fseek(file, 0, SEEK_SET);
+
+    sim_t *loaded = sim_init(&cpu_config, &cache_config);
+    mu_assert(_FL "wrong number of pages loaded", image_load(loaded, file) == 2);
+    fclose(file);
+    remove(path);
+    mu_assert(_FL "only the two pages allocated", loaded->memory.pages == 2);
+    mu_assert(_FL "wrong code", mem_peek_w(loaded, 0x00400000) == code);
+    mu_assert(_FL "wrong data", mem_peek_w(loaded, 0x1000000c) == data);
+    mu_assert(_FL "memory between the segments not empty", mem_peek_w(loaded, 0x08000000) == 0);
+    mu_assert(_FL "wrong memory start", mem_start(loaded) == 0x00400000);
+    mu_assert(_FL "wrong memory size", mem_size_b(loaded) == 0x10000010 - 0x00400000);
+    mu_assert(_FL "wrong entry point", loaded->pc == 0x00400000);
+    sim_destroy(loaded);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* Source files are not images */
+static char * test_image_reject() {
+    FILE *file = fopen("test/image-test.c", "r");
+    mu_assert(_FL "unable to open a source file", file != NULL);
+    mu_assert(_FL "source file detected as an image", !image_detect(file));
+    sim_t *sim = sim_init(&cpu_config, &cache_config);
+    mu_assert(_FL "source file loaded as an image", image_load(sim, file) == -1);
+    sim_destroy(sim);
+    fclose(file);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_image_round_trip);
+    mu_run_test(test_image_distant_segments);
+    mu_run_test(test_image_reject);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,178 @@
+/* test/l2-test.c
+* Unit tests for the second level cache
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "cache-fixture.h"
+#include "../src/l2.h"
+#include "../src/dram.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+
+// Direct mapped L1s of 16 four word blocks, over a 2-way L2 of 64 blocks
+cache_config_t cache_config = {
+    .mode           = CACHE_SPLIT,
+    .data_enabled   = true,
+    .data_size      = 256,
+    .data_block     = 4,
+    .data_type      = CACHE_DIRECT,
+    .data_wpolicy   = CACHE_WRITEBACK,
+    .inst_enabled   = true,
+    .inst_size      = 256,
+    .inst_block     = 4,
+    .inst_type      = CACHE_DIRECT,
+    .inst_wpolicy   = CACHE_WRITETHROUGH,
+    .write_buffer   = 1,
+    .l2_size        = 1024,
+    .l2_block       = 4,
+    .l2_type        = CACHE_ASSOC,
+    .l2_ways        = 2,
+    .l2_replace     = CACHE_LRU,
+    .l2_latency     = 2,
+    .l2_wpolicy     = CACHE_WRITEBACK,
+};
+
+static sim_t *make_sim(cache_inclusion_t fill, cache_wpolicy_t data_wpolicy) {
+    cache_config.l2_fill = fill;
+    cache_config.data_wpolicy = data_wpolicy;
+    return fixture_sim(&cpu_config, &cache_config);
+}
+
+static bool l2_has(sim_t *sim, uint32_t address) {
+    cache_access_t info;
+    assoc_cache_get_tag_and_index(&info, sim->l2->tags, &address);
+    return assoc_cache_find(sim->l2->tags, info.index, info.tag) < sim->l2->tags->ways;
+}
+
+/* An inclusive L2 keeps a block the D cache replaced, and a miss that finds
+ * it there takes the L2 latency instead of going to memory */
+static char * test_l2_inclusive() {
+    sim_t *sim = make_sim(CACHE_INCLUSIVE, CACHE_WRITEBACK);
+    uint32_t miss = fixture_load(sim, 0x104);
+    mu_assert(_FL "block not filled into the L2", l2_has(sim, 0x100));
+    // 0x200 has the same D cache index as 0x100
+    fixture_load(sim, 0x200);
+    mu_assert(_FL "L2 lost the replaced block", l2_has(sim, 0x100) && l2_has(sim, 0x200));
+    uint32_t hit = fixture_load(sim, 0x104);
+    mu_assert(_FL "L2 hit not counted", sim->l2->hits == 1 && sim->l2->accesses == 3);
+    mu_assert(_FL "L2 hit no faster than memory", hit < miss);
+    mu_assert(_FL "L2 hit too slow", hit <= cache_config.l2_latency + L2_SUBSEQUENT_PENALTY);
+    mu_assert(_FL "L2 miss faster than memory", miss >= cache_config.l2_latency + CACHE_MISS_PENALTY);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* An exclusive L2 only takes the blocks the D cache replaces, and gives
+ * them up again when they hit */
+static char * test_l2_exclusive() {
+    sim_t *sim = make_sim(CACHE_EXCLUSIVE, CACHE_WRITEBACK);
+    fixture_load(sim, 0x100);
+    mu_assert(_FL "missing block filled into the L2", !l2_has(sim, 0x100));
+    fixture_load(sim, 0x200);
+    mu_assert(_FL "replaced block not moved down", l2_has(sim, 0x100) && !l2_has(sim, 0x200));
+    fixture_load(sim, 0x100);
+    mu_assert(_FL "L2 hit not counted", sim->l2->hits == 1);
+    mu_assert(_FL "block kept in both levels", !l2_has(sim, 0x100) && l2_has(sim, 0x200));
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A writeback L2 takes the write buffer's entry for a block it holds,
+ * leaving it dirty, and does it faster than memory */
+static char * test_l2_write_hit() {
+    sim_t *sim = make_sim(CACHE_INCLUSIVE, CACHE_WRITETHROUGH);
+    uint32_t address = 0x100;
+    word_t data = 0x1234;
+    fixture_load(sim, address);
+    mu_assert(_FL "store missed", d_cache_write_w(sim, &address, &data) == CACHE_HIT);
+    mu_assert(_FL "write hit not counted", sim->l2->writes == 1 && sim->l2->write_hits == 1);
+    mu_assert(_FL "write hit at the memory penalty", sim->write_buffer->penalty == cache_config.l2_latency);
+    cache_access_t info;
+    assoc_cache_get_tag_and_index(&info, sim->l2->tags, &address);
+    uint32_t way = assoc_cache_find(sim->l2->tags, info.index, info.tag);
+    mu_assert(_FL "written block not dirty", sim->l2->tags->dirty[info.index * sim->l2->tags->ways + way]);
+    for (int i = 0; i < 100 && write_buffer_writing(sim); ++i) cache_digest(sim);
+    mu_assert(_FL "store never reached memory", mem_peek_w(sim, 0x100) == data);
+    sim_destroy(sim);
+    return 0;
+}
+
+// Fetch the instruction at address through the I cache, until it hits
+static void fetch(sim_t *sim, uint32_t address) {
+    word_t data;
+    for (int i = 0; i < 100 && i_cache_read_w(sim, &address, &data) == CACHE_MISS; ++i) cache_digest(sim);
+    for (int i = 0; i < 100 && !cache_idle(sim); ++i) cache_digest(sim);
+}
+
+/* An inclusive L2 takes the block it replaces out of the D cache, and a
+ * dirty one still reaches memory */
+static char * test_l2_back_invalidate() {
+    sim_t *sim = make_sim(CACHE_INCLUSIVE, CACHE_WRITEBACK);
+    uint32_t address = 0x104;
+    word_t data = 0x1234;
+    fixture_load(sim, address);
+    mu_assert(_FL "store missed", d_cache_write_w(sim, &address, &data) == CACHE_HIT);
+    // 0x300 and 0x500 are in the same set of the L2 as 0x100, but go to the I cache
+    fetch(sim, 0x300);
+    mu_assert(_FL "block dropped too early", cache_holds_block(sim, false, 0x100));
+    fetch(sim, 0x500);
+    mu_assert(_FL "replaced block still in the L2", !l2_has(sim, 0x100));
+    mu_assert(_FL "replaced block still in the D cache", !cache_holds_block(sim, false, 0x100));
+    mu_assert(_FL "back-invalidation not counted", sim->l2->back_invalidations == 1);
+    for (int i = 0; i < 100 && write_buffer_writing(sim); ++i) cache_digest(sim);
+    mu_assert(_FL "dirty block lost", mem_peek_w(sim, address) == data);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A dirty block the L2 replaces is written to memory through the DRAM model,
+ * like any other write */
+static char * test_l2_writeback_dram() {
+    cache_config.dram = (dram_config_t){ .enabled = true, .banks = 8, .row_size = 2048,
+        .t_cas = 3, .t_rcd = 5, .t_rp = 7, .t_burst = 2, .page = DRAM_OPEN_PAGE };
+    sim_t *sim = make_sim(CACHE_INCLUSIVE, CACHE_WRITETHROUGH);
+    cache_config.dram.enabled = false;
+    uint32_t address = 0x100;
+    word_t data = 0x1234;
+    fixture_load(sim, address);
+    mu_assert(_FL "store missed", d_cache_write_w(sim, &address, &data) == CACHE_HIT);
+    for (int i = 0; i < 100 && write_buffer_writing(sim); ++i) cache_digest(sim);
+    mu_assert(_FL "write hit went to memory", sim->dram->writes == 0);
+    // 0x300 and 0x500 are in the same set of the L2, which pushes out 0x100
+    fixture_load(sim, 0x300);
+    fixture_load(sim, 0x500);
+    mu_assert(_FL "dirty block still in the L2", !l2_has(sim, 0x100));
+    mu_assert(_FL "writeback not counted", sim->l2->writebacks == 1);
+    mu_assert(_FL "writeback not timed by the DRAM", sim->dram->writes == 1);
+    sim_destroy(sim);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_l2_inclusive);
+    mu_run_test(test_l2_exclusive);
+    mu_run_test(test_l2_write_hit);
+    mu_run_test(test_l2_back_invalidate);
+    mu_run_test(test_l2_writeback_dram);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -9,11 +9,16 @@
 #include "../src/main_memory.h"
 #include "../src/types.h"
 #include "../src/util.h"
+#include "../src/sim.h"
 
 int tests_run = 0;
 
 extern int flags;
 
+sim_t *sim;
+cpu_config_t cpu_config = { .single_cycle = false };
+cache_config_t cache_config = { .mode = CACHE_DISABLE };
+
 word_t data;
 uint64_t size, addr, offs;
 
@@ -21,56 +26,56 @@ static char * test_mem_small_word() {
     // Test a small memory with words
     size = 0x140;
     offs = 0x80;
-    mem_init(size,offs);
+    mem_init(sim, size,offs);
     // check the size
-    size = mem_size_b();
+    size = mem_size_b(sim);
     mu_assert(_FL "bad assert", size == 320);
-    size = mem_size_w();
+    size = mem_size_w(sim);
     mu_assert(_FL "bad assert", size == 80);
     // write to the first word
     data = 0xf0a50000;
-    mem_write_w(offs + 0, &data);
+    mem_write_w(sim, offs + 0, &data);
     // write to the second word
     data = 0xdead1111;
-    mem_write_w(0x84, &data);
+    mem_write_w(sim, 0x84, &data);
     // write to the third word
     data = 0xdead2222;
-    mem_write_w(offs + 8, &data);
+    mem_write_w(sim, offs + 8, &data);
     // write to third last word
     data = 0xdead4444;
-    mem_write_w(offs + 308, &data);
+    mem_write_w(sim, offs + 308, &data);
     // write to second last word
     data = 0xdead8888;
-    mem_write_w(offs + 312, &data);
+    mem_write_w(sim, offs + 312, &data);
     // write to the last word
     data = 0xf0a5cccc;
-    mem_write_w(offs + 316, &data);
+    mem_write_w(sim, offs + 316, &data);
 
-    mem_dump();
+    mem_dump(sim);
     // read from first word
-    mem_read_w(offs, &data);
+    mem_read_w(sim, offs, &data);
     mu_assert(_FL "bad assert", data == 0xf0a50000);
     // read from second word
-    mem_read_w(0x84, &data);
+    mem_read_w(sim, 0x84, &data);
     mu_assert(_FL "bad assert", data == 0xdead1111);
     // read from third word
-    mem_read_w(0x88, &data);
+    mem_read_w(sim, 0x88, &data);
     mu_assert(_FL "bad assert", data == 0xdead2222);
     // read from third last word
-    mem_read_w(0x1b4, &data);
+    mem_read_w(sim, 0x1b4, &data);
     mu_assert(_FL "bad assert", data == 0xdead4444);
     // read from second last word
-    mem_read_w(0x1b8, &data);
+    mem_read_w(sim, 0x1b8, &data);
     mu_assert(_FL "bad assert", data == 0xdead8888);
     // read from last word
-    mem_read_w(0x1bc, &data);
+    mem_read_w(sim, 0x1bc, &data);
     mu_assert(_FL "bad assert", data == 0xf0a5cccc);
 
     // De-allocate memory and make sure it worked
-    mem_close();
-    size = mem_size_b();
+    mem_close(sim);
+    size = mem_size_b(sim);
     mu_assert(_FL "bad assert", size == 0);
-    size = mem_size_w();
+    size = mem_size_w(sim);
     mu_assert(_FL "bad assert", size == 0);
     return 0;
 }
@@ -79,56 +84,56 @@ static char * test_mem_small_halfword() {
     // Test a small memory with halfwords
     size = 0x140;
     offs = 0x80;
-    mem_init(size,offs);
+    mem_init(sim, size,offs);
     // check the size
-    size = mem_size_b();
+    size = mem_size_b(sim);
     mu_assert(_FL "bad assert", size == 320);
-    size = mem_size_w();
+    size = mem_size_w(sim);
     mu_assert(_FL "bad assert", size == 80);
     // write to first halfword
     data = 0xff11;
-    mem_write_h(offs + 0, &data);
+    mem_write_h(sim, offs + 0, &data);
     // write to second halfword
     data = 0xff22;
-    mem_write_h(offs + 2, &data);
+    mem_write_h(sim, offs + 2, &data);
     // write to third halfword
     data = 0xff33;
-    mem_write_h(offs + 4, &data);
+    mem_write_h(sim, offs + 4, &data);
     // write to fourth halfword
     data = 0xff44;
-    mem_write_h(0x86, &data);
+    mem_write_h(sim, 0x86, &data);
     // write to second last halfword
     data = 0xffcc;
-    mem_write_h(0x1bc, &data);
+    mem_write_h(sim, 0x1bc, &data);
     // write to last halfword
     data = 0xffee;
-    mem_write_h(0x1be, &data);
-    mem_dump();
+    mem_write_h(sim, 0x1be, &data);
+    mem_dump(sim);
 
     // read from first halfword
-    mem_read_h(offs, &data);
+    mem_read_h(sim, offs, &data);
     mu_assert(_FL "bad assert", data == 0xff11);
     // read from second halfword
-    mem_read_h(0x82, &data);
+    mem_read_h(sim, 0x82, &data);
     mu_assert(_FL "bad assert", data == 0xff22);
     // read from third halfword
-    mem_read_h(0x84, &data);
+    mem_read_h(sim, 0x84, &data);
     mu_assert(_FL "bad assert", data == 0xff33);
     // read from fourth halfword
-    mem_read_h(0x86, &data);
+    mem_read_h(sim, 0x86, &data);
     mu_assert(_FL "bad assert", data == 0xff44);
     // read from second last halfword
-    mem_read_h(0x1bc, &data);
+    mem_read_h(sim, 0x1bc, &data);
     mu_assert(_FL "bad assert", data == 0xffcc);
     // read from last halfword
-    mem_read_h(0x1be, &data);
+    mem_read_h(sim, 0x1be, &data);
     mu_assert(_FL "bad assert", data == 0xffee);
 
     // De-allocate memory and make sure it worked
-    mem_close();
-    size = mem_size_b();
+    mem_close(sim);
+    size = mem_size_b(sim);
     mu_assert(_FL "bad assert", size == 0);
-    size = mem_size_w();
+    size = mem_size_w(sim);
     mu_assert(_FL "bad assert", size == 0);
     return 0;
 }
@@ -137,68 +142,68 @@ static char * test_mem_small_byte() {
     // Test a small memory with bytes
     size = 0x140;
     offs = 0x80;
-    mem_init(size,offs);
+    mem_init(sim, size,offs);
     // check the size
-    size = mem_size_b();
+    size = mem_size_b(sim);
     mu_assert(_FL "bad assert", size == 320);
-    size = mem_size_w();
+    size = mem_size_w(sim);
     mu_assert(_FL "bad assert", size == 80);
     // write to first byte
     data = 0x11;
-    mem_write_b(offs + 0, &data);
+    mem_write_b(sim, offs + 0, &data);
     // write to second byte
     data = 0x22;
-    mem_write_b(offs + 1, &data);
+    mem_write_b(sim, offs + 1, &data);
     // write to third byte
     data = 0x33;
-    mem_write_b(offs + 2, &data);
+    mem_write_b(sim, offs + 2, &data);
     // write to fourth byte
     data = 0x44;
-    mem_write_b(0x83, &data);
+    mem_write_b(sim, 0x83, &data);
     // write to fifth byte
     data = 0x55;
-    mem_write_b(offs + 4, &data);
+    mem_write_b(sim, offs + 4, &data);
     // write to eighth byte
     data = 0x88;
-    mem_write_b(offs + 7, &data);
+    mem_write_b(sim, offs + 7, &data);
     // write to fourth last byte
     data = 0xcc;
-    mem_write_b(0x1bc, &data);
+    mem_write_b(sim, 0x1bc, &data);
     // write to last byte
     data = 0xff;
-    mem_write_b(0x1bf, &data);
-    mem_dump();
+    mem_write_b(sim, 0x1bf, &data);
+    mem_dump(sim);
 
     // read from first byte
-    mem_read_b(offs, &data);
+    mem_read_b(sim, offs, &data);
     mu_assert(_FL "bad assert", data == 0x11);
     // read from second byte
-    mem_read_b(0x81, &data);
+    mem_read_b(sim, 0x81, &data);
     mu_assert(_FL "bad assert", data == 0x22);
     // read from third byte
-    mem_read_b(0x82, &data);
+    mem_read_b(sim, 0x82, &data);
     mu_assert(_FL "bad assert", data == 0x33);
     // read from fourth byte
-    mem_read_b(0x83, &data);
+    mem_read_b(sim, 0x83, &data);
     mu_assert(_FL "bad assert", data == 0x44);
     // read from fifth byte
-    mem_read_b(0x84, &data);
+    mem_read_b(sim, 0x84, &data);
     mu_assert(_FL "bad assert", data == 0x55);
     // read from eigth byte
-    mem_read_b(0x87, &data);
+    mem_read_b(sim, 0x87, &data);
     mu_assert(_FL "bad assert", data == 0x88);
     // read from fourth last byte
-    mem_read_b(0x1bc, &data);
+    mem_read_b(sim, 0x1bc, &data);
     mu_assert(_FL "bad assert", data == 0xcc);
     // read from last byte
-    mem_read_b(0x1bf, &data);
+    mem_read_b(sim, 0x1bf, &data);
     mu_assert(_FL "bad assert", data == 0xff);
 
     // De-allocate memory and make sure it worked
-    mem_close();
-    size = mem_size_b();
+    mem_close(sim);
+    size = mem_size_b(sim);
     mu_assert(_FL "bad assert", size == 0);
-    size = mem_size_w();
+    size = mem_size_w(sim);
     mu_assert(_FL "bad assert", size == 0);
     return 0;
 }
@@ -212,20 +217,20 @@ static char * test_mem_word() {
     for (i = 0; i < (size>>2); ++i) {
         test[i] = rand()<<1; // data
     }
-    mem_init(size,offs);
+    mem_init(sim, size,offs);
     // disable debug statements and write data
     flags &= ~(MASK_DEBUG);
     for (i = 0; i < (size>>2); ++i) {
-        mem_write_w((i<<2) + offs,&test[i]);
+        mem_write_w(sim, (i<<2) + offs,&test[i]);
     }
     // read data and check
     for (i = 0; i < (size>>2); ++i) {
-        mem_read_w((i<<2) + offs,&data);
+        mem_read_w(sim, (i<<2) + offs,&data);
         mu_assert(_FL "bad assert", test[i] == data);
     }
     // restore debug flag
     flags |= MASK_DEBUG;
-    mem_close();
+    mem_close(sim);
     free(test);
     return 0;
 }
@@ -239,20 +244,20 @@ static char * test_mem_halfword() {
     for (i = 0; i < (size>>1); ++i) {
         test[i] = rand() & 0xffff; // data
     }
-    mem_init(size,offs);
+    mem_init(sim, size,offs);
     // disable debug statements and write data
     flags &= ~(MASK_DEBUG);
     for (i = 0; i < (size>>1); ++i) {
-        mem_write_h((i<<1) + offs,&test[i]);
+        mem_write_h(sim, (i<<1) + offs,&test[i]);
     }
     // read data and check
     for (i = 0; i < (size>>1); ++i) {
-        mem_read_h((i<<1) + offs,&data);
+        mem_read_h(sim, (i<<1) + offs,&data);
         mu_assert(_FL "bad assert", test[i] == data);
     }
     // restore debug flag
     flags |= MASK_DEBUG;
-    mem_close();
+    mem_close(sim);
     free(test);
     return 0;
 }
@@ -266,24 +271,60 @@ static char * test_mem_byte() {
     for (i = 0; i < size; ++i) {
         test[i] = rand() & 0xff; // data
     }
-    mem_init(size,offs);
+    mem_init(sim, size,offs);
     // disable debug statements and write data
     flags &= ~(MASK_DEBUG);
     for (i = 0; i < size; ++i) {
-        mem_write_b(i + offs,&test[i]);
+        mem_write_b(sim, i + offs,&test[i]);
     }
     // read data and check
     for (i = 0; i < size; ++i) {
-        mem_read_b(i + offs,&data);
+        mem_read_b(sim, i + offs,&data);
         mu_assert(_FL "bad assert", test[i] == data);
     }
     // restore debug flag
     flags |= MASK_DEBUG;
-    mem_close();
+    mem_close(sim);
     free(test);
     return 0;
 }
 
+static char * test_mem_sparse() {
+    sim_t *copy = sim_init(&cpu_config, &cache_config);
+    mem_init(sim, 0x100, 0);
+    // Untouched memory reads as zero and takes no space
+    mem_read_w(sim, 0x7fffeffc, &data);
+    mu_assert(_FL "untouched memory not zero", data == 0);
+    mu_assert(_FL "reading allocated a page", sim->memory.pages == 0);
+    // Addresses far outside the loaded size can be used
+    data = 0xdeadbeef;
+    mem_write_w(sim, 0xfffffffc, &data);
+    data = 0x12345678;
+    mem_write_w(sim, 0x7fffeffc, &data);
+    data = 0xab;
+    mem_write_b(sim, 0x7fffe000, &data);
+    mu_assert(_FL "wrong number of pages", sim->memory.pages == 2);
+    mem_read_w(sim, 0xfffffffc, &data);
+    mu_assert(_FL "bad assert", data == 0xdeadbeef);
+    mem_read_w(sim, 0x7fffeffc, &data);
+    mu_assert(_FL "bad assert", data == 0x12345678);
+    mem_read_w(sim, 0x7fffe000, &data);
+    mu_assert(_FL "bad assert", data == 0xab000000);
+    // A copy has the same contents in its own pages
+    mem_copy(copy, sim);
+    mu_assert(_FL "copy has wrong number of pages", copy->memory.pages == 2);
+    mu_assert(_FL "copy has wrong size", mem_size_b(copy) == 0x100);
+    mu_assert(_FL "bad copy", mem_peek_w(copy, 0xfffffffc) == 0xdeadbeef);
+    data = 0;
+    mem_write_w(copy, 0x7fffeffc, &data);
+    mu_assert(_FL "copy shares a page", mem_peek_w(sim, 0x7fffeffc) == 0x12345678);
+    sim_destroy(copy);
+    mem_close(sim);
+    mu_assert(_FL "pages not freed", sim->memory.pages == 0);
+    mu_assert(_FL "freed memory not zero", mem_peek_w(sim, 0xfffffffc) == 0);
+    return 0;
+}
+
 static char * all_tests() {
     mu_run_test(test_mem_small_word);
     mu_run_test(test_mem_small_halfword);
@@ -291,12 +332,15 @@ static char * all_tests() {
     mu_run_test(test_mem_word);
     mu_run_test(test_mem_halfword);
     mu_run_test(test_mem_byte);
+    mu_run_test(test_mem_sparse);
     return 0;
 }
 
 int main(int argc, char **argv) {
     flags = MASK_SANITY;
+    sim = sim_init(&cpu_config, &cache_config);
     char *result = all_tests();
+    sim_destroy(sim);
     if (result != 0) {
         printf("%s\n", result);
     } else {
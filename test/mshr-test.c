@@ -0,0 +1,159 @@
+/* test/mshr-test.c
+* Unit tests for the MSHRs of a non-blocking data cache
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "cache-fixture.h"
+#include "../src/mshr.h"
+#include "../src/registers.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+
+// A direct mapped D cache of 16 four word blocks
+cache_config_t cache_config = {
+    .mode           = CACHE_SPLIT,
+    .data_enabled   = true,
+    .data_size      = 256,
+    .data_block     = 4,
+    .data_type      = CACHE_DIRECT,
+    .data_wpolicy   = CACHE_WRITETHROUGH,
+    .inst_enabled   = true,
+    .inst_size      = 256,
+    .inst_block     = 4,
+    .inst_type      = CACHE_DIRECT,
+    .inst_wpolicy   = CACHE_WRITETHROUGH,
+    .write_buffer   = 1,
+};
+
+static sim_t *make_sim(uint32_t mshrs) {
+    cache_config.mshrs = mshrs;
+    return fixture_sim(&cpu_config, &cache_config);
+}
+
+// A load as the memory stage makes it: try the cache, and on a miss hand it over
+static cache_status_t load(sim_t *sim, opcode_t opCode, uint32_t address, uint32_t reg) {
+    word_t data;
+    cache_status_t status = d_cache_read_w(sim, &address, &data);
+    if (status == CACHE_MISS) status = mshr_load(sim, opCode, address, reg);
+    return status;
+}
+
+static word_t reg(sim_t *sim, uint32_t r) {
+    word_t value;
+    reg_read(sim, r, &value);
+    return value;
+}
+
+// Digest until reg has its data, up to a limit, and return the cycles taken
+static uint32_t wait_for(sim_t *sim, uint32_t r) {
+    uint32_t cycles = 0;
+    while (cycles < 100 && mshr_pending(sim, r)) {
+        cache_digest(sim);
+        ++cycles;
+    }
+    return cycles;
+}
+
+/* A load that misses waits in an MSHR while another block keeps hitting,
+ * and gets its register written once its word is in */
+static char * test_mshr_hit_under_miss() {
+    sim_t *sim = make_sim(2);
+    uint32_t address = 0x200;
+    word_t data;
+    d_cache_warm(sim, 0x200, false);
+    mu_assert(_FL "load not handed to an MSHR", load(sim, OPC_LW, 0x104, REG_T0) == CACHE_PENDING);
+    mu_assert(_FL "register not pending", mshr_pending(sim, REG_T0) && !mshr_pending(sim, REG_T1));
+    cache_digest(sim);
+    mu_assert(_FL "hit under the miss missed", d_cache_read_w(sim, &address, &data) == CACHE_HIT);
+    mu_assert(_FL "wrong data under the miss", data == fixture_word(0x200));
+    mu_assert(_FL "load never finished", wait_for(sim, REG_T0) < 100);
+    mu_assert(_FL "wrong data loaded", reg(sim, REG_T0) == fixture_word(0x104));
+    for (int i = 0; i < 100 && mshr_busy(sim); ++i) cache_digest(sim);
+    mu_assert(_FL "MSHR not freed", !mshr_busy(sim));
+    sim_destroy(sim);
+    return 0;
+}
+
+/* Misses to two blocks are both taken, and fetched one after the other;
+ * a second load of a block already waiting shares its MSHR */
+static char * test_mshr_queue() {
+    sim_t *sim = make_sim(2);
+    mu_assert(_FL "first miss not taken", load(sim, OPC_LW, 0x100, REG_T0) == CACHE_PENDING);
+    mu_assert(_FL "second miss not taken", load(sim, OPC_LW, 0x300, REG_T1) == CACHE_PENDING);
+    mu_assert(_FL "load of a waiting block not taken", load(sim, OPC_LBU, 0x30f, REG_S0) == CACHE_PENDING);
+    mu_assert(_FL "blocks not in their own MSHRs", sim->mshr->count == 2);
+    uint32_t first = wait_for(sim, REG_T0);
+    mu_assert(_FL "second block arrived first", mshr_pending(sim, REG_T1));
+    uint32_t second = wait_for(sim, REG_T1);
+    mu_assert(_FL "second fill never finished", second < 100);
+    mu_assert(_FL "wrong data loaded", reg(sim, REG_T0) == fixture_word(0x100) &&
+        reg(sim, REG_T1) == fixture_word(0x300));
+    wait_for(sim, REG_S0);
+    mu_assert(_FL "wrong byte loaded", reg(sim, REG_S0) == 0x0c);
+    mu_assert(_FL "first fill too slow", first >= CACHE_MISS_PENALTY);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A miss with every MSHR in use stalls, and so does a store to a block that
+ * is still on its way */
+static char * test_mshr_full() {
+    sim_t *sim = make_sim(1);
+    word_t data = 0x1234;
+    mu_assert(_FL "miss not taken", load(sim, OPC_LW, 0x100, REG_T0) == CACHE_PENDING);
+    mu_assert(_FL "miss taken with no MSHR free", load(sim, OPC_LW, 0x300, REG_T1) == CACHE_MISS);
+    mu_assert(_FL "store to a waiting block allowed", mshr_holds(sim, 0x108) && !mshr_holds(sim, 0x110));
+    wait_for(sim, REG_T0);
+    // The MSHR is free once its load has its word, before the rest of the block
+    mu_assert(_FL "MSHR kept after its load finished", !mshr_busy(sim) && !mshr_holds(sim, 0x108));
+    for (int i = 0; i < 100 && sim->d_cache->fetching; ++i) cache_digest(sim);
+    uint32_t address = 0x108;
+    mu_assert(_FL "store missed after the fill", d_cache_write_w(sim, &address, &data) == CACHE_HIT);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A later write to the register of a waiting load wins over the load, and
+ * a signed byte load is sign extended */
+static char * test_mshr_written() {
+    sim_t *sim = make_sim(2);
+    word_t value = 0x5555;
+    mu_assert(_FL "miss not taken", load(sim, OPC_LW, 0x100, REG_T0) == CACHE_PENDING);
+    mu_assert(_FL "miss not taken", load(sim, OPC_LB, 0x100, REG_T1) == CACHE_PENDING);
+    reg_write(sim, REG_T0, &value);
+    mshr_written(sim, REG_T0);
+    mu_assert(_FL "written register still pending", !mshr_pending(sim, REG_T0));
+    wait_for(sim, REG_T1);
+    mu_assert(_FL "stale load overwrote the register", reg(sim, REG_T0) == value);
+    mu_assert(_FL "byte not sign extended", reg(sim, REG_T1) == 0xffffff80);
+    sim_destroy(sim);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_mshr_hit_under_miss);
+    mu_run_test(test_mshr_queue);
+    mu_run_test(test_mshr_full);
+    mu_run_test(test_mshr_written);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
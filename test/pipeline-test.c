@@ -20,11 +20,14 @@
 #include "../src/types.h"
 #include "../src/util.h"
 #include "../src/hazard.h"
+#include "../src/sim.h"
 
 int tests_run = 0;
 
 extern int flags;
-extern profile_t *prof;
+
+sim_t *sim;
+cpu_config_t cpu_config = { .single_cycle = false };
 
 control_t * ifid;
 control_t * idex;
@@ -55,41 +58,41 @@ cache_config_t cache_config = {
 void execute_pipeline() {
     bcprintf(ANSI_C_CYAN,"PC:\n");
     bprintf("\t0x%08x\n", pc);
-    writeback(memwb);
-    memory(exmem, memwb, &cache_config);
+    writeback(sim, memwb);
+    memory(sim, exmem, memwb);
     execute(idex, exmem);
-    decode(ifid, idex);
-    fetch(ifid, &pc, &cache_config);
-    hazard(ifid, idex, exmem, memwb, &pc, &cache_config);
+    decode(sim, ifid, idex);
+    fetch(sim, ifid, &pc);
+    hazard(sim, ifid, idex, exmem, memwb, &pc);
 }
 
 static char * test_basic_add() {
-    reg_init();
+    reg_init(sim);
     pipeline_init(&ifid, &idex, &exmem, &memwb, &pc, 0);
     // Load instructions
     pc = 0x00000000;
     word_t data = 0x20110064;       //addi $s1, $zero, 100
-    mem_write_w(pc, &data);
+    mem_write_w(sim, pc, &data);
     data = 0x20120031;              //addi $s2, $zero, 49
-    mem_write_w(pc+4, &data);
+    mem_write_w(sim, pc+4, &data);
     data = 0x02519820;              //add $s3, $s2, $s1
-    mem_write_w(pc+8, &data);
+    mem_write_w(sim, pc+8, &data);
     data = 0x00000000;              //nop
-    mem_write_w(pc+12, &data);
-    mem_write_w(pc+16, &data);
-    mem_write_w(pc+20, &data);
+    mem_write_w(sim, pc+12, &data);
+    mem_write_w(sim, pc+16, &data);
+    mem_write_w(sim, pc+20, &data);
     // Execute pipeline six times
     clock = 0;
     for (clock = 0; clock <= 6; clock++) {
         execute_pipeline();
     }
     // Check that the registers have expected values
-    //reg_dump();
-    reg_read(REG_S1, &data);
+    //reg_dump(sim);
+    reg_read(sim, REG_S1, &data);
     mu_assert(_FL "$S1 does not equal 100!", data == 100);
-    reg_read(REG_S2, &data);
+    reg_read(sim, REG_S2, &data);
     mu_assert(_FL "$S2 does not equal 49!", data == 49);
-    reg_read(REG_S3, &data);
+    reg_read(sim, REG_S3, &data);
     mu_assert(_FL "$S3 does not equal 149!", data == 149);
 
     pipeline_destroy(&ifid, &idex, &exmem, &memwb);
@@ -97,41 +100,41 @@ static char * test_basic_add() {
 }
 
 static char * test_bne() {
-    reg_init();
+    reg_init(sim);
     pipeline_init(&ifid, &idex, &exmem, &memwb, &pc, 0);
     // Load instructions
     pc = 0x00000000;
     word_t data = 0x20110064;       //addi $s1, $zero, 100
-    mem_write_w(pc, &data);
+    mem_write_w(sim, pc, &data);
     data = 0x20120040;              //addi $s2, $zero, 64
-    mem_write_w(pc+4, &data);
+    mem_write_w(sim, pc+4, &data);
     data = 0x16320002;              //bne $s1, $s2, 0x14
-    mem_write_w(pc+8, &data);
+    mem_write_w(sim, pc+8, &data);
     data = 0xae510000;              //sw $s1, 0($s2)
-    mem_write_w(pc+12, &data);
+    mem_write_w(sim, pc+12, &data);
     data = 0x02324022;              //sub $t0, $s1, $s2
-    mem_write_w(pc+16, &data);
+    mem_write_w(sim, pc+16, &data);
     data = 0x001160c2;              //srl $t4, $s1, 3
-    mem_write_w(pc+20, &data);
+    mem_write_w(sim, pc+20, &data);
     data = 0x00000000;              //nop
-    mem_write_w(pc+24, &data);
-    mem_write_w(pc+28, &data);
-    mem_write_w(pc+32, &data);
-    mem_write_w(pc+36, &data);
+    mem_write_w(sim, pc+24, &data);
+    mem_write_w(sim, pc+28, &data);
+    mem_write_w(sim, pc+32, &data);
+    mem_write_w(sim, pc+36, &data);
     // Execute pipeline six times
     clock = 0;
     for (clock = 0; clock <= 9; clock++) {
         execute_pipeline();
     }
     // Check that the registers have expected values
-    //reg_dump();
-    reg_read(REG_S1, &data);
+    //reg_dump(sim);
+    reg_read(sim, REG_S1, &data);
     mu_assert(_FL "$S1 does not equal 100!", data == 100);
-    reg_read(REG_S2, &data);
+    reg_read(sim, REG_S2, &data);
     mu_assert(_FL "$S2 does not equal 64!", data == 64);
-    reg_read(REG_T4, &data);
+    reg_read(sim, REG_T4, &data);
     mu_assert(_FL "$T4 does not equal 12!", data == 12);
-    reg_read(REG_T0, &data);
+    reg_read(sim, REG_T0, &data);
     mu_assert(_FL "Incorrect instruction executed: $T0 = 36", data != 36);
 
 
@@ -140,40 +143,40 @@ static char * test_bne() {
 }
 
 static char * test_beq() {
-    reg_init();
+    reg_init(sim);
     pipeline_init(&ifid, &idex, &exmem, &memwb, &pc, 0);
     // Load instructions
     pc = 0x00000000;
     word_t data = 0x20110064;       //addi $s1, $zero, 100
-    mem_write_w(pc, &data);
+    mem_write_w(sim, pc, &data);
     data = 0x20120064;              //addi $s2, $zero, 100
-    mem_write_w(pc+4, &data);
+    mem_write_w(sim, pc+4, &data);
     data = 0x12320002;              //beq $s1, $s2, 0x14
-    mem_write_w(pc+8, &data);
+    mem_write_w(sim, pc+8, &data);
     data = 0xae510000;              //sw $s1, 0($s2)
-    mem_write_w(pc+12, &data);
+    mem_write_w(sim, pc+12, &data);
     data = 0x2008ffec;              //addi $t0, $zero, -20
-    mem_write_w(pc+16, &data);
+    mem_write_w(sim, pc+16, &data);
     data = 0x001160c2;              //srl $t4, $s1, 3
-    mem_write_w(pc+20, &data);
+    mem_write_w(sim, pc+20, &data);
     data = 0x00000000;              //nop
-    mem_write_w(pc+24, &data);
-    mem_write_w(pc+28, &data);
-    mem_write_w(pc+32, &data);
+    mem_write_w(sim, pc+24, &data);
+    mem_write_w(sim, pc+28, &data);
+    mem_write_w(sim, pc+32, &data);
     // Execute pipeline six times
     clock = 0;
     for (clock = 0; clock <= 9; clock++) {
         execute_pipeline();
     }
     //C heck that the registers have expected values
-    // reg_dump();
-    reg_read(REG_S1, &data);
+    // reg_dump(sim);
+    reg_read(sim, REG_S1, &data);
     mu_assert(_FL "$S1 does not equal 100!", data == 100);
-    reg_read(REG_S2, &data);
+    reg_read(sim, REG_S2, &data);
     mu_assert(_FL "$S2 does not equal 64!", data == 100);
-    reg_read(REG_T4, &data);
+    reg_read(sim, REG_T4, &data);
     mu_assert(_FL "$T4 does not equal 12!", data == 12);
-    reg_read(REG_T0, &data);
+    reg_read(sim, REG_T0, &data);
     mu_assert(_FL "Incorrect instruction executed: $T0 = -20", data != -20);
 
     pipeline_destroy(&ifid, &idex, &exmem, &memwb);
@@ -190,49 +193,49 @@ static char * test_load_dependency() {
     //0x8e120000        lw $s2, 0($s0)
     //0x8e130004        lw $s3, 4($s0)
     //0x0253a020        add $s4, $s2, $s3
-    reg_init();
+    reg_init(sim);
     pipeline_init(&ifid, &idex, &exmem, &memwb, &pc, 0);
     // Load instructions
     pc = 0x00000000;
     word_t data = 0x20100800;       //addi $s0, $zero, 2048
-    mem_write_w(pc, &data);
+    mem_write_w(sim, pc, &data);
     data = 0x2011000a;              //addi $s1, $zero, 10
-    mem_write_w(pc+4, &data);
+    mem_write_w(sim, pc+4, &data);
     data = 0xae110000;              //sw $s1, 0($s0)
-    mem_write_w(pc+8, &data);
+    mem_write_w(sim, pc+8, &data);
     data = 0x22310001;              //addi $s1, $s1, 1
-    mem_write_w(pc+12, &data);
+    mem_write_w(sim, pc+12, &data);
     data = 0xae110004;              //sw $s1, 4($s0)
-    mem_write_w(pc+16, &data);
+    mem_write_w(sim, pc+16, &data);
     data = 0x22310001;              //addi $s1, $s1, 1
-    mem_write_w(pc+20, &data);
+    mem_write_w(sim, pc+20, &data);
     data = 0x8e120000;              //lw $s2, 0($s0)
-    mem_write_w(pc+24, &data);
+    mem_write_w(sim, pc+24, &data);
     data = 0x8e130004;              //lw $s3, 4($s0)
-    mem_write_w(pc+28, &data);
+    mem_write_w(sim, pc+28, &data);
     data = 0x0253a020;              //add $s4, $s2, $s3
-    mem_write_w(pc+32, &data);
+    mem_write_w(sim, pc+32, &data);
     data = 0x00000000;              //nop
-    mem_write_w(pc+36, &data);
-    mem_write_w(pc+40, &data);
-    mem_write_w(pc+44, &data);
-    mem_write_w(pc+48, &data);
+    mem_write_w(sim, pc+36, &data);
+    mem_write_w(sim, pc+40, &data);
+    mem_write_w(sim, pc+44, &data);
+    mem_write_w(sim, pc+48, &data);
     // Execute pipeline six times
     clock = 0;
     for (clock = 0; clock <= 13; clock++) {
         execute_pipeline();
     }
     // Check that the registers have expected values
-    // reg_dump();
-    reg_read(REG_S0, &data);
+    // reg_dump(sim);
+    reg_read(sim, REG_S0, &data);
     mu_assert(_FL "$S0 does not equal 2048!", data == 2048);
-    reg_read(REG_S1, &data);
+    reg_read(sim, REG_S1, &data);
     mu_assert(_FL "$S1 does not equal 12!", data == 12);
-    reg_read(REG_S2, &data);
+    reg_read(sim, REG_S2, &data);
     mu_assert(_FL "$S2 does not equal 10!", data == 10);
-    reg_read(REG_S3, &data);
+    reg_read(sim, REG_S3, &data);
     mu_assert(_FL "$S3 does not equal 11!", data == 11);
-    reg_read(REG_S4, &data);
+    reg_read(sim, REG_S4, &data);
     mu_assert(_FL "$S4 does not equal 21!", data == 21);
 
     pipeline_destroy(&ifid, &idex, &exmem, &memwb);
@@ -241,8 +244,8 @@ static char * test_load_dependency() {
 
 static char * all_tests() {
     // Pipeline initialization
-    reg_init();
-    mem_init(0x3000,0x0);
+    reg_init(sim);
+    mem_init(sim, 0x3000,0x0);
     // Tests
     mu_run_test(test_basic_add);
     mu_run_test(test_bne);
@@ -253,14 +256,14 @@ static char * all_tests() {
 
 int main(int argc, char **argv) {
     flags = MASK_SANITY;
-    prof = (profile_t*)malloc(sizeof(profile_t));
+    sim = sim_init(&cpu_config, &cache_config);
     char *result = all_tests();
+    sim_destroy(sim);
     if (result != 0) {
         printf("%s\n", result);
     } else {
         printf(__FILE__": ALL TESTS PASSED\n");
     }
     printf("Tests run: %d\n", tests_run);
-    free(prof);
     return result != 0;
 }
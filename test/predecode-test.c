@@ -0,0 +1,134 @@
+/* test/predecode-test.c
+* Unit tests for the predecoded instruction store
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "../src/predecode.h"
+#include "../src/fetch.h"
+#include "../src/decode.h"
+#include "../src/types.h"
+#include "../src/util.h"
+#include "../src/registers.h"
+#include "../src/main_memory.h"
+#include "../src/sim.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+sim_t *sim;
+cpu_config_t cpu_config = { .single_cycle = false };
+cache_config_t cache_config = { .mode = CACHE_DISABLE };
+
+word_t data;
+control_t *ifid, *idex, *dummy_exmem, *dummy_memwb; // dummy vars for pipeline_init
+pc_t dummy_pc;
+
+/* Predecoded fields and control bits must match what fetch/decode produce */
+static char * test_predecode_matches() {
+    inst_t program[] = {
+        0x02518820, // add $s1, $s2, $s1
+        0x22a8ff9c, // addi $t0, $s5, -100
+        0x3c01ffff, // lui $at, 0xffff
+        0x8c430000, // lw $v1, 0($v0)
+        0xaca30000, // sw $v1, 0($a1)
+        0x1444fffc, // bne $v0, $a0, -4
+        0x0c000010, // jal 0x40
+        0x7c021420  // seb $v0, $v0
+    };
+    uint32_t n = sizeof(program)/sizeof(program[0]);
+    pipeline_init(&ifid, &idex, &dummy_exmem, &dummy_memwb, &dummy_pc, 0);
+    predecode_init(sim, 0, n<<2);
+    for (uint32_t k = 0; k < n; ++k) {
+        predecode_load(sim, k<<2, program[k]);
+        predecode_entry_t *entry = predecode_lookup(sim, k<<2, program[k]);
+        mu_assert(_FL "legal instruction was not predecoded", entry != NULL);
+        // Compare against the slow path
+        flush(ifid);
+        ifid->instr = program[k];
+        fetch_fields(ifid);
+        mu_assert(_FL "bad predecoded opCode", entry->fetched.opCode == ifid->opCode);
+        mu_assert(_FL "bad predecoded regRs", entry->fetched.regRs == ifid->regRs);
+        mu_assert(_FL "bad predecoded regRt", entry->fetched.regRt == ifid->regRt);
+        mu_assert(_FL "bad predecoded immed", entry->fetched.immed == ifid->immed);
+        mu_assert(_FL "bad predecoded address", entry->fetched.address == ifid->address);
+        copy_pipeline_register(ifid, idex);
+        mu_assert(_FL "slow path failed to decode", decode_control(idex) == 0);
+        mu_assert(_FL "bad predecoded ALUop", entry->decoded.ALUop == idex->ALUop);
+        mu_assert(_FL "bad predecoded regDst", entry->decoded.regDst == idex->regDst);
+        mu_assert(_FL "bad predecoded regWrite", entry->decoded.regWrite == idex->regWrite);
+        mu_assert(_FL "bad predecoded ALUSrc", entry->decoded.ALUSrc == idex->ALUSrc);
+        mu_assert(_FL "bad predecoded memRead", entry->decoded.memRead == idex->memRead);
+        mu_assert(_FL "bad predecoded memWrite", entry->decoded.memWrite == idex->memWrite);
+        mu_assert(_FL "bad predecoded jump", entry->decoded.jump == idex->jump);
+        mu_assert(_FL "bad predecoded regRd", entry->decoded.regRd == idex->regRd);
+        mu_assert(_FL "bad predecoded shamt", entry->decoded.shamt == idex->shamt);
+    }
+    predecode_close(sim);
+    pipeline_destroy(&ifid, &idex, &dummy_exmem, &dummy_memwb);
+    return 0;
+}
+
+/* Data words, stores and changed instructions must fall back to the slow path */
+static char * test_predecode_invalid() {
+    predecode_init(sim, 0x40, 0x10);
+    // Data word with an illegal opcode
+    predecode_load(sim, 0x40, 0xffffffff);
+    mu_assert(_FL "illegal instruction predecoded", predecode_lookup(sim, 0x40, 0xffffffff) == NULL);
+    // Legal instruction, then a store to it
+    predecode_load(sim, 0x44, 0x02518820);
+    mu_assert(_FL "legal instruction not predecoded", predecode_lookup(sim, 0x44, 0x02518820) != NULL);
+    mu_assert(_FL "entry returned for a different word", predecode_lookup(sim, 0x44, 0x03e2e822) == NULL);
+    predecode_invalidate(sim, 0x46); // halfword store into the same word
+    mu_assert(_FL "entry not invalidated by store", predecode_lookup(sim, 0x44, 0x02518820) == NULL);
+    // Out of range addresses
+    mu_assert(_FL "entry returned below the table", predecode_lookup(sim, 0x3c, 0x02518820) == NULL);
+    mu_assert(_FL "entry returned above the table", predecode_lookup(sim, 0x50, 0x02518820) == NULL);
+    predecode_close(sim);
+    return 0;
+}
+
+/* predecode_build(sim) reads the program image out of main memory */
+static char * test_predecode_build() {
+    mem_init(sim, 0x20, 0x0);
+    data = 0x02518820; // add $s1, $s2, $s1
+    mem_write_w(sim, 0x0, &data);
+    data = 0x00000000; // data word that happens to decode (nop)
+    mem_write_w(sim, 0x4, &data);
+    data = 0xfc000000; // data word that does not decode
+    mem_write_w(sim, 0x8, &data);
+    predecode_init(sim, 0x0, 0x10);
+    predecode_build(sim);
+    mu_assert(_FL "word 0 not predecoded", predecode_lookup(sim, 0x0, 0x02518820) != NULL);
+    mu_assert(_FL "word 1 not predecoded", predecode_lookup(sim, 0x4, 0x00000000) != NULL);
+    mu_assert(_FL "word 2 predecoded", predecode_lookup(sim, 0x8, 0xfc000000) == NULL);
+    predecode_close(sim);
+    mem_close(sim);
+    return 0;
+}
+
+static char * all_tests() {
+    reg_init(sim);
+    mu_run_test(test_predecode_matches);
+    mu_run_test(test_predecode_invalid);
+    mu_run_test(test_predecode_build);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    sim = sim_init(&cpu_config, &cache_config);
+    char *result = all_tests();
+    sim_destroy(sim);
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,118 @@
+/* test/prefetch-test.c
+* Unit tests for the prefetchers
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "cache-fixture.h"
+#include "../src/prefetch.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+
+// Direct mapped caches of 64 four word blocks, with a D prefetcher
+cache_config_t cache_config = {
+    .mode           = CACHE_SPLIT,
+    .data_enabled   = true,
+    .data_size      = 1024,
+    .data_block     = 4,
+    .data_type      = CACHE_DIRECT,
+    .data_wpolicy   = CACHE_WRITEBACK,
+    .inst_enabled   = true,
+    .inst_size      = 1024,
+    .inst_block     = 4,
+    .inst_type      = CACHE_DIRECT,
+    .inst_wpolicy   = CACHE_WRITETHROUGH,
+    .write_buffer   = 1,
+    .prefetch_degree = 1,
+};
+
+static sim_t *make_sim(cache_prefetch_t type) {
+    cache_config.data_prefetch = type;
+    return fixture_sim(&cpu_config, &cache_config);
+}
+
+/* Load address for the instruction at pc, the way the memory stage does, and
+ * digest until the memory system has nothing left to do. Returns whether the
+ * first try hit. */
+static bool load(sim_t *sim, uint32_t pc, uint32_t address) {
+    word_t data;
+    cache_status_t status = d_cache_read_w(sim, &address, &data);
+    cache_status_t first = status;
+    prefetch_access(sim, sim->d_prefetch, pc, address, status);
+    for (int i = 0; i < 100 && status == CACHE_MISS; ++i) {
+        cache_digest(sim);
+        status = d_cache_read_w(sim, &address, &data);
+    }
+    for (int i = 0; i < 200 && (sim->d_prefetch->queued || !cache_idle(sim)); ++i) cache_digest(sim);
+    return first == CACHE_HIT;
+}
+
+/* A miss prefetches the next block, and its first use prefetches the one
+ * after that */
+static char * test_prefetch_next_line() {
+    sim_t *sim = make_sim(PREFETCH_NEXT_LINE);
+    mu_assert(_FL "cold load hit", !load(sim, 0, 0x104));
+    mu_assert(_FL "next block not prefetched", cache_holds_block(sim, false, 0x110));
+    mu_assert(_FL "prefetched block missed", load(sim, 0, 0x110));
+    mu_assert(_FL "block after a used prefetch not prefetched", cache_holds_block(sim, false, 0x120));
+    prefetcher_t *pf = sim->d_prefetch;
+    mu_assert(_FL "wrong counts", pf->issued == 2 && pf->useful == 1 && pf->late == 0 && pf->misses == 1);
+    sim_destroy(sim);
+    return 0;
+}
+
+// Two misses to neighbouring blocks going down start a stream going down
+static char * test_prefetch_stream() {
+    sim_t *sim = make_sim(PREFETCH_STREAM);
+    load(sim, 0, 0x300);
+    mu_assert(_FL "single miss prefetched", sim->d_prefetch->issued == 0);
+    load(sim, 0, 0x2f0);
+    mu_assert(_FL "block below not prefetched", cache_holds_block(sim, false, 0x2e0));
+    mu_assert(_FL "block above prefetched", !cache_holds_block(sim, false, 0x310));
+    mu_assert(_FL "prefetched block missed", load(sim, 0, 0x2e4));
+    mu_assert(_FL "stream did not go on", cache_holds_block(sim, false, 0x2d0));
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A load whose address changes by the same stride twice prefetches the next
+ * one, and a load at another pc does not disturb it */
+static char * test_prefetch_stride() {
+    sim_t *sim = make_sim(PREFETCH_STRIDE);
+    load(sim, 0x40, 0x100);
+    load(sim, 0x40, 0x140);
+    load(sim, 0x84, 0x800);
+    mu_assert(_FL "prefetched before the stride was seen twice", sim->d_prefetch->issued == 0);
+    load(sim, 0x40, 0x180);
+    mu_assert(_FL "next stride not prefetched", cache_holds_block(sim, false, 0x1c0));
+    mu_assert(_FL "next block prefetched", !cache_holds_block(sim, false, 0x190));
+    mu_assert(_FL "prefetched block missed", load(sim, 0x40, 0x1c0));
+    sim_destroy(sim);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_prefetch_next_line);
+    mu_run_test(test_prefetch_stream);
+    mu_run_test(test_prefetch_stride);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -8,28 +8,32 @@
 #include "minunit.h"
 #include "../src/registers.h"
 #include "../src/types.h"
+#include "../src/sim.h"
 
 int tests_run = 0;
 
 word_t a;
 bool z;
+sim_t *sim;
+cpu_config_t cpu_config = { .single_cycle = false };
+cache_config_t cache_config = { .mode = CACHE_DISABLE };
 
 static char * test_register_init() {
-    reg_init();
-    reg_read(0,&a);
-    // reg_dump();
+    reg_init(sim);
+    reg_read(sim, 0,&a);
+    // reg_dump(sim);
     mu_assert(_FL "bad assert", a == 0);
     return 0;
 }
 
 static char * test_register_zero() {
     a = 0xffffffff;
-    reg_write(REG_ZERO,&a);
-    reg_read(REG_ZERO,&a);
+    reg_write(sim, REG_ZERO,&a);
+    reg_read(sim, REG_ZERO,&a);
     mu_assert(_FL "bad assert", a == 0);
     a = 0;
-    reg_write(REG_ZERO,&a);
-    reg_read(REG_ZERO,&a);
+    reg_write(sim, REG_ZERO,&a);
+    reg_read(sim, REG_ZERO,&a);
     mu_assert(_FL "bad assert", a == 0);
     return 0;
 }
@@ -38,18 +42,18 @@ static char * test_registers() {
     int i;
     for (i = REG_AT; i <= REG_RA; ++i) {
         a = i + (i<<8);
-        reg_write(i,&a);
+        reg_write(sim, i,&a);
     }
     for (i = REG_AT; i <= REG_RA; ++i) {
-        reg_read(i,&a);
+        reg_read(sim, i,&a);
         mu_assert(_FL "bad assert", a == (i + (i<<8)));
     }
     for (i = REG_AT; i <= REG_RA; ++i) {
         a = 0x80000000 + i;
-        reg_write(i,&a);
+        reg_write(sim, i,&a);
     }
     for (i = REG_AT; i <= REG_RA; ++i) {
-        reg_read(i,&a);
+        reg_read(sim, i,&a);
         mu_assert(_FL "bad assert", a == 0x80000000 + i);
     }
     return 0;
@@ -63,7 +67,9 @@ static char * all_tests() {
 }
 
 int main(int argc, char **argv) {
+    sim = sim_init(&cpu_config, &cache_config);
     char *result = all_tests();
+    sim_destroy(sim);
     if (result != 0) {
         printf("%s\n", result);
     } else {
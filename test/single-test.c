@@ -0,0 +1,224 @@
+/* test/single-test.c
+* Unit tests for the single-cycle CPU model. Each test loads a short program
+* ending in jr $zero, runs it to completion, and checks the architectural state.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "minunit.h"
+#include "../src/single.h"
+#include "../src/main_memory.h"
+#include "../src/predecode.h"
+#include "../src/cache.h"
+#include "../src/registers.h"
+#include "../src/types.h"
+#include "../src/util.h"
+#include "../src/sim.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+sim_t *sim;
+cpu_config_t cpu_config = { .single_cycle = false };
+cache_config_t cache_config = { .mode = CACHE_DISABLE };
+
+pc_t pc;
+word_t value;
+
+// Write a program into memory starting at address 0x100
+static void load_program(inst_t *program, uint32_t n) {
+    reg_init(sim);
+    for (uint32_t k = 0; k < n; ++k) {
+        mem_write_w(sim, 0x100 + (k<<2), &program[k]);
+    }
+    pc = 0x100;
+}
+
+static char * test_single_arithmetic() {
+    inst_t program[] = {
+        0x20080005, // addi $t0, $zero, 5
+        0x2009ffff, // addi $t1, $zero, -1
+        0x01095020, // add $t2, $t0, $t1
+        0x00000008, // jr $zero
+        0x00000000  // nop
+    };
+    load_program(program, 5);
+    mu_assert(_FL "wrong instruction count", single_cycle_run(sim, &pc, 0, false) == 5);
+    mu_assert(_FL "did not halt", pc == 0);
+    reg_read(sim, 10, &value);
+    mu_assert(_FL "wrong add result", value == 4);
+    return 0;
+}
+
+static char * test_single_branch_delay_slot() {
+    inst_t program[] = {
+        0x20080001, // addi $t0, $zero, 1
+        0x15000002, // bne $t0, $zero, 2
+        0x20090007, // addi $t1, $zero, 7 (delay slot)
+        0x200a0009, // addi $t2, $zero, 9 (skipped)
+        0x00000008, // jr $zero
+        0x00000000  // nop
+    };
+    load_program(program, 6);
+    mu_assert(_FL "wrong instruction count", single_cycle_run(sim, &pc, 0, false) == 5);
+    reg_read(sim, 9, &value);
+    mu_assert(_FL "delay slot not executed", value == 7);
+    reg_read(sim, 10, &value);
+    mu_assert(_FL "branch not taken", value == 0);
+    return 0;
+}
+
+static char * test_single_jal_jr() {
+    inst_t program[] = {
+        0x0c000044, // jal 0x110
+        0x00000000, // nop (delay slot)
+        0x00000008, // jr $zero
+        0x00000000, // nop
+        0x03e00008, // jr $ra
+        0x00000000  // nop (delay slot)
+    };
+    load_program(program, 6);
+    mu_assert(_FL "wrong instruction count", single_cycle_run(sim, &pc, 0, false) == 6);
+    reg_read(sim, 31, &value);
+    mu_assert(_FL "wrong return address", value == 0x108);
+    return 0;
+}
+
+static char * test_single_load_store() {
+    inst_t program[] = {
+        0x2008ff80, // addi $t0, $zero, -128
+        0xa0080200, // sb $t0, 0x200($zero)
+        0x80090200, // lb $t1, 0x200($zero)
+        0x900a0200, // lbu $t2, 0x200($zero)
+        0x00000008, // jr $zero
+        0x00000000  // nop
+    };
+    load_program(program, 6);
+    mu_assert(_FL "wrong instruction count", single_cycle_run(sim, &pc, 0, false) == 6);
+    mem_read_w(sim, 0x200, &value);
+    mu_assert(_FL "sb stored to the wrong byte", value == 0x80000000);
+    reg_read(sim, 9, &value);
+    mu_assert(_FL "lb not sign extended", value == 0xffffff80);
+    reg_read(sim, 10, &value);
+    mu_assert(_FL "lbu sign extended", value == 0x80);
+    return 0;
+}
+
+/* A store over a predecoded instruction must execute the new instruction */
+static char * test_single_self_modifying() {
+    inst_t program[] = {
+        0x3c08200a, // lui $t0, 0x200a
+        0x35080009, // ori $t0, $t0, 9
+        0xac08010c, // sw $t0, 0x10c($zero)
+        0x00000000, // nop, replaced by addi $t2, $zero, 9
+        0x00000008, // jr $zero
+        0x00000000  // nop
+    };
+    load_program(program, 6);
+    predecode_init(sim, 0x100, 0x18);
+    predecode_build(sim);
+    single_cycle_run(sim, &pc, 0, false);
+    predecode_close(sim);
+    reg_read(sim, 10, &value);
+    mu_assert(_FL "stale instruction executed", value == 9);
+    return 0;
+}
+
+/* Stepping one instruction at a time, including across a delay slot */
+static char * test_single_step() {
+    inst_t program[] = {
+        0x20080001, // addi $t0, $zero, 1
+        0x15000002, // bne $t0, $zero, 2
+        0x20090007, // addi $t1, $zero, 7 (delay slot)
+        0x200a0009, // addi $t2, $zero, 9 (skipped)
+        0x00000008, // jr $zero
+        0x00000000  // nop
+    };
+    pc_t expected[] = {0x104, 0x108, 0x110, 0x114, 0x0}; // 0x108 and 0x114 are delay slots
+    uint32_t count = 0;
+    load_program(program, 6);
+    while (pc != 0) {
+        mu_assert(_FL "step executed more than one instruction", single_cycle_run(sim, &pc, 1, false) == 1);
+        mu_assert(_FL "wrong pc after step", pc == expected[count]);
+        mu_assert(_FL "wrong delay slot state", single_cycle_in_delay_slot(sim) == (count == 1 || count == 3));
+        ++count;
+    }
+    mu_assert(_FL "wrong instruction count", count == 5);
+    reg_read(sim, 10, &value);
+    mu_assert(_FL "branch not taken", value == 0);
+    return 0;
+}
+
+/* Warming installs the blocks that were touched, without memory traffic */
+static char * test_single_warm() {
+    cache_config_t warm_config = {
+        .mode           = CACHE_SPLIT,
+        .data_enabled   = true,
+        .data_size      = 256,
+        .data_block     = 4,
+        .data_type      = CACHE_DIRECT,
+        .data_wpolicy   = CACHE_WRITEBACK,
+        .inst_enabled   = true,
+        .inst_size      = 256,
+        .inst_block     = 4,
+        .inst_type      = CACHE_DIRECT,
+        .inst_wpolicy   = CACHE_WRITEBACK,
+    };
+    inst_t program[] = {
+        0x2008ff80, // addi $t0, $zero, -128
+        0xa0080200, // sb $t0, 0x200($zero)
+        0x80090200, // lb $t1, 0x200($zero)
+        0x900a0200, // lbu $t2, 0x200($zero)
+        0x00000008, // jr $zero
+        0x00000000  // nop
+    };
+    uint32_t address;
+    load_program(program, 6);
+    sim->cache_cfg = warm_config;
+    cache_init(sim);
+    single_cycle_run(sim, &pc, 0, true);
+    mu_assert(_FL "memory system not idle", get_mem_status(sim) == MEM_IDLE);
+    for (address = 0x100; address < 0x118; address += 4) {
+        mu_assert(_FL "instruction not warmed", i_cache_read_w(sim, &address, &value) == CACHE_HIT);
+        mu_assert(_FL "wrong instruction warmed", value == program[(address - 0x100)>>2]);
+    }
+    address = 0x20c; // same block as the stored byte
+    mu_assert(_FL "data block not warmed", d_cache_read_w(sim, &address, &value) == CACHE_HIT);
+    address = 0x200;
+    mu_assert(_FL "stored word not warmed", d_cache_read_w(sim, &address, &value) == CACHE_HIT);
+    mu_assert(_FL "stale data warmed", value == 0x80000000);
+    address = 0x300;
+    mu_assert(_FL "untouched block warmed", d_cache_read_w(sim, &address, &value) == CACHE_MISS);
+    cache_destroy(sim);
+    sim->cache_cfg = cache_config;
+    return 0;
+}
+
+static char * all_tests() {
+    mem_init(sim, 0x400, 0x0);
+    mu_run_test(test_single_arithmetic);
+    mu_run_test(test_single_branch_delay_slot);
+    mu_run_test(test_single_jal_jr);
+    mu_run_test(test_single_load_store);
+    mu_run_test(test_single_self_modifying);
+    mu_run_test(test_single_step);
+    mu_run_test(test_single_warm);
+    mem_close(sim);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    sim = sim_init(&cpu_config, &cache_config);
+    char *result = all_tests();
+    sim_destroy(sim);
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,184 @@
+/* test/trace-test.c
+* Unit tests for recorded address streams and single pass cache evaluation
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "../src/trace.h"
+#include "../src/types.h"
+#include "../src/util.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+addr_trace_t trace;
+
+// Hits of one direct-mapped cache of num_blocks blocks, simulated the slow way
+static uint32_t direct_hits(addr_stream_t *stream, uint32_t block_words, uint32_t num_blocks) {
+    uint32_t *tags = (uint32_t *)malloc(sizeof(uint32_t) * num_blocks);
+    bool *valid = (bool *)calloc(num_blocks, sizeof(bool));
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < stream->length; ++i) {
+        uint32_t block = stream->addrs[i] / (4 * block_words);
+        uint32_t index = block % num_blocks;
+        if (valid[index] && tags[index] == block) {
+            if (i >= stream->start) hits++;
+        } else {
+            valid[index] = true;
+            tags[index] = block;
+        }
+    }
+    free(tags);
+    free(valid);
+    return hits;
+}
+
+/* Streams grow as they are appended to, and counting starts on request */
+static char * test_trace_record() {
+    trace_init(&trace);
+    for (uint32_t i = 0; i < 10000; ++i) {
+        trace_append(&trace.inst, i << 2);
+    }
+    trace_append(&trace.data, 0x100);
+    trace_start_counting(&trace);
+    trace_append(&trace.data, 0x104);
+    mu_assert(_FL "wrong instruction stream length", trace.inst.length == 10000);
+    mu_assert(_FL "wrong recorded address", trace.inst.addrs[9999] == 9999 << 2);
+    mu_assert(_FL "wrong data stream length", trace.data.length == 2);
+    mu_assert(_FL "wrong counting start", trace.inst.start == 10000 && trace.data.start == 1);
+    trace_free(&trace);
+    mu_assert(_FL "stream not freed", trace.inst.addrs == NULL && trace.inst.length == 0);
+    return 0;
+}
+
+/* One pass must give the same hits as simulating every cache size alone */
+static char * test_trace_direct_hits() {
+    uint32_t hits[TRACE_MAX_LEVEL + 1];
+    uint32_t blocks[] = { 1, 4, 16 };
+    trace_init(&trace);
+    // Loops over a few arrays, plus some scattered accesses
+    srand(1);
+    for (uint32_t i = 0; i < 20000; ++i) {
+        uint32_t address;
+        switch (rand() % 4) {
+            case 0:  address = 0x1000 + ((i % 64) << 2);        break;
+            case 1:  address = 0x2000 + ((i % 300) << 2);       break;
+            case 2:  address = 0x2400 + ((i % 17) << 4);        break;
+            default: address = (rand() % 0x4000) & ~0x3;        break;
+        }
+        trace_append(&trace.data, address);
+        if (i == 1000) trace_start_counting(&trace);
+    }
+    for (uint32_t b = 0; b < sizeof(blocks)/sizeof(blocks[0]); ++b) {
+        trace_direct_hits(&trace.data, blocks[b], 10, hits);
+        for (uint32_t k = 0; k <= 10; ++k) {
+            mu_assert(_FL "single pass hits differ from direct simulation",
+                hits[k] == direct_hits(&trace.data, blocks[b], 1 << k));
+        }
+        mu_assert(_FL "hits must not shrink as the cache grows", hits[0] <= hits[10]);
+    }
+    trace_free(&trace);
+    return 0;
+}
+
+/* Straight line fetches take one byte each, after the header */
+static char * test_trace_writer() {
+    const char *path = "test/trace-test.bin";
+    trace_writer_t *writer = trace_writer_open(path);
+    mu_assert(_FL "unable to open trace file", writer != NULL);
+    trace_record_t record = { .kind = TRACE_FETCH, .size = 4 };
+    for (uint32_t i = 0; i < 100; ++i) {
+        record.pc = record.address = (i + 1) << 2;
+        record.cycle = i + 1;
+        trace_writer_put(writer, &record);
+    }
+    // A load in the same cycle as the last fetch, and a store a while later
+    trace_writer_stage(writer, TRACE_READ, 0x180, 0x1000, 1);
+    trace_writer_commit(writer, 100);
+    trace_writer_stage(writer, TRACE_WRITE, 0x184, 0x1004, 4);
+    trace_writer_discard(writer);
+    trace_writer_stage(writer, TRACE_WRITE, 0x184, 0x1004, 4);
+    trace_writer_commit(writer, 300);
+    mu_assert(_FL "wrong record count", writer->records == 102);
+    mu_assert(_FL "trace file not closed cleanly", trace_writer_close(writer) == 0);
+
+    uint8_t bytes[256];
+    FILE *fp = fopen(path, "rb");
+    size_t length = fread(bytes, 1, sizeof(bytes), fp);
+    fclose(fp);
+    remove(path);
+    mu_assert(_FL "bad magic", bytes[0] == 'M' && bytes[1] == 'T' && bytes[2] == 'R' && bytes[3] == 'C');
+    mu_assert(_FL "bad record count in header", bytes[8] == 102 && bytes[9] == 0);
+    // Fetches are a tag each; the load is tag, pc and address (2 bytes);
+    // the store is tag, cycle delta (2 bytes), pc and address
+    mu_assert(_FL "wrong trace length", length == TRACE_HEADER_SIZE + 100 + 4 + 5);
+    mu_assert(_FL "bad read tag", bytes[TRACE_HEADER_SIZE + 100] == (TRACE_READ | (1 << 5)));
+    return 0;
+}
+
+/* Everything written must read back the same */
+static char * test_trace_reader() {
+    const char *path = "test/trace-test.bin";
+    trace_record_t records[2000];
+    trace_writer_t *writer = trace_writer_open(path);
+    mu_assert(_FL "unable to open trace file", writer != NULL);
+    srand(2);
+    uint32_t cycle = 0, pc = 0x400;
+    for (uint32_t i = 0; i < 2000; ++i) {
+        trace_record_t *record = &records[i];
+        record->kind = (trace_kind_t)(rand() % 3);
+        record->size = record->kind == TRACE_FETCH ? 4 : 1 << (rand() % 3);
+        cycle += rand() % 4 == 0 ? rand() % 1000 : rand() % 2;
+        record->cycle = cycle;
+        pc = rand() % 8 == 0 ? (uint32_t)rand() & ~0x3 : pc + 4;
+        record->pc = pc;
+        record->address = record->kind == TRACE_FETCH ? pc : (uint32_t)rand() * 2;
+        trace_writer_put(writer, record);
+    }
+    writer->instructions = 1234;
+    mu_assert(_FL "trace file not closed cleanly", trace_writer_close(writer) == 0);
+
+    trace_reader_t *reader = trace_reader_open(path);
+    mu_assert(_FL "unable to read trace file", reader != NULL);
+    mu_assert(_FL "bad header counts", reader->records == 2000 && reader->instructions == 1234);
+    trace_record_t record;
+    uint32_t count = 0;
+    while (trace_reader_next(reader, &record)) {
+        mu_assert(_FL "too many records", count < 2000);
+        trace_record_t *expect = &records[count++];
+        mu_assert(_FL "wrong kind", record.kind == expect->kind);
+        mu_assert(_FL "wrong size", record.size == expect->size);
+        mu_assert(_FL "wrong cycle", record.cycle == expect->cycle);
+        mu_assert(_FL "wrong pc", record.pc == expect->pc);
+        mu_assert(_FL "wrong address", record.address == expect->address);
+    }
+    mu_assert(_FL "records missing", count == 2000);
+    trace_reader_close(reader);
+    remove(path);
+    mu_assert(_FL "opened a missing trace", trace_reader_open(path) == NULL);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_trace_record);
+    mu_run_test(test_trace_direct_hits);
+    mu_run_test(test_trace_writer);
+    mu_run_test(test_trace_reader);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,96 @@
+/* test/victim-test.c
+* Unit tests for the victim cache
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+#include "cache-fixture.h"
+#include "../src/victim.h"
+
+int tests_run = 0;
+
+extern int flags;
+
+cpu_config_t cpu_config = { .single_cycle = false };
+
+// Direct mapped caches of 16 four word blocks, with 2-entry victim caches
+cache_config_t cache_config = {
+    .mode           = CACHE_SPLIT,
+    .data_enabled   = true,
+    .data_size      = 256,
+    .data_block     = 4,
+    .data_type      = CACHE_DIRECT,
+    .data_wpolicy   = CACHE_WRITEBACK,
+    .inst_enabled   = true,
+    .inst_size      = 256,
+    .inst_block     = 4,
+    .inst_type      = CACHE_DIRECT,
+    .inst_wpolicy   = CACHE_WRITETHROUGH,
+    .write_buffer   = 1,
+    .victims        = 2,
+};
+
+static sim_t *make_sim() {
+    return fixture_sim(&cpu_config, &cache_config);
+}
+
+/* Two blocks with the same index take turns in the D cache and its victim
+ * cache, and swapping one back in is faster than memory */
+static char * test_victim_swap() {
+    sim_t *sim = make_sim();
+    victim_cache_t *vc = sim->d_cache->victims;
+    uint32_t miss = fixture_load(sim, 0x104);
+    // 0x200 and 0x300 have the same index as 0x100
+    fixture_load(sim, 0x200);
+    fixture_load(sim, 0x300);
+    mu_assert(_FL "replaced blocks not caught", vc->held == 2);
+    uint32_t hit = fixture_load(sim, 0x104);
+    mu_assert(_FL "victim hit not counted", vc->hits == 1 && vc->fills == 4);
+    mu_assert(_FL "victim hit no faster than memory", hit < miss);
+    mu_assert(_FL "victim hit too slow", hit <= VICTIM_HIT_PENALTY + VICTIM_SUBSEQUENT_PENALTY);
+    // 0x300 went into the victim cache in its place, and 0x200 is still there
+    mu_assert(_FL "swapped out block missing", fixture_load(sim, 0x300) <= VICTIM_HIT_PENALTY + VICTIM_SUBSEQUENT_PENALTY);
+    mu_assert(_FL "oldest block missing", fixture_load(sim, 0x200) <= VICTIM_HIT_PENALTY + VICTIM_SUBSEQUENT_PENALTY);
+    mu_assert(_FL "victim hits not counted", vc->hits == 3);
+    sim_destroy(sim);
+    return 0;
+}
+
+/* A dirty block still goes to memory when it is replaced, so swapping it
+ * back in finds the stored word */
+static char * test_victim_dirty() {
+    sim_t *sim = make_sim();
+    uint32_t address = 0x108;
+    word_t data = 0x1234, read;
+    fixture_load(sim, address);
+    mu_assert(_FL "store missed", d_cache_write_w(sim, &address, &data) == CACHE_HIT);
+    fixture_load(sim, 0x200);
+    for (int i = 0; i < 100 && write_buffer_writing(sim); ++i) cache_digest(sim);
+    mu_assert(_FL "dirty block not written back", mem_peek_w(sim, address) == data);
+    fixture_load(sim, address);
+    mu_assert(_FL "victim hit not counted", sim->d_cache->victims->hits == 1);
+    mu_assert(_FL "stored word lost", d_cache_read_w(sim, &address, &read) == CACHE_HIT && read == data);
+    sim_destroy(sim);
+    return 0;
+}
+
+static char * all_tests() {
+    mu_run_test(test_victim_swap);
+    mu_run_test(test_victim_dirty);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    flags = MASK_SANITY;
+    char *result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf(__FILE__": ALL TESTS PASSED\n");
+    }
+    printf("Tests run: %d\n", tests_run);
+    return result != 0;
+}